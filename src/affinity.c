@@ -0,0 +1,205 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include "affinity.h"
+#include "rtp2httpd.h"
+#include "status.h"
+
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+
+#ifndef MPOL_LOCAL
+#define MPOL_LOCAL 4
+#endif
+
+static int affinity_cpus[STATUS_MAX_WORKERS];
+static int affinity_count = 0;
+
+static int affinity_add_cpu(int cpu)
+{
+    if (cpu < 0 || cpu >= CPU_SETSIZE || affinity_count >= STATUS_MAX_WORKERS)
+        return -1;
+    affinity_cpus[affinity_count++] = cpu;
+    return 0;
+}
+
+int affinity_init(const char *spec, int num_workers)
+{
+    affinity_count = 0;
+    if (!spec || spec[0] == '\0')
+        return 0;
+
+    if (strcasecmp(spec, "auto") == 0)
+    {
+        cpu_set_t set;
+        int cpu;
+
+        if (sched_getaffinity(0, sizeof(set), &set) < 0)
+        {
+            logger(LOG_ERROR, "CPU affinity: sched_getaffinity failed: %s", strerror(errno));
+            return 0;
+        }
+        for (cpu = 0; cpu < CPU_SETSIZE && affinity_count < num_workers; cpu++)
+        {
+            if (CPU_ISSET(cpu, &set))
+                affinity_add_cpu(cpu);
+        }
+    }
+    else
+    {
+        const char *p = spec;
+        while (*p)
+        {
+            char *end;
+            long first = strtol(p, &end, 10);
+            long last = first;
+
+            if (end == p)
+                break;
+            p = end;
+            if (*p == '-')
+            {
+                last = strtol(p + 1, &end, 10);
+                if (end == p + 1)
+                    break;
+                p = end;
+            }
+            for (long cpu = first; cpu <= last; cpu++)
+            {
+                if (affinity_add_cpu((int)cpu) < 0)
+                    break;
+            }
+            while (*p == ',' || *p == ' ')
+                p++;
+        }
+
+        if (*p != '\0')
+        {
+            logger(LOG_ERROR, "CPU affinity: Invalid CPU list \"%s\", not pinning workers", spec);
+            affinity_count = 0;
+            return 0;
+        }
+    }
+
+    if (affinity_count > 0 && affinity_count < num_workers)
+    {
+        logger(LOG_WARN, "CPU affinity: %d CPUs for %d workers, some workers share a CPU",
+               affinity_count, num_workers);
+    }
+    return affinity_count;
+}
+
+int affinity_worker_cpu(int worker)
+{
+    if (affinity_count == 0 || worker < 0)
+        return -1;
+    return affinity_cpus[worker % affinity_count];
+}
+
+int affinity_pin_worker(int worker)
+{
+    int cpu = affinity_worker_cpu(worker);
+    cpu_set_t set;
+
+    if (cpu < 0)
+        return 0;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) < 0)
+    {
+        logger(LOG_ERROR, "CPU affinity: Failed to pin worker %d to CPU %d: %s", worker, cpu, strerror(errno));
+        return -1;
+    }
+
+#ifdef SYS_set_mempolicy
+    /* Override any inherited policy (e.g. numactl --interleave) so pool pages
+     * come from this CPU's node */
+    if (syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0) < 0 && errno != ENOSYS)
+    {
+        logger(LOG_DEBUG, "CPU affinity: set_mempolicy(MPOL_LOCAL) failed: %s", strerror(errno));
+    }
+#endif
+
+    logger(LOG_INFO, "CPU affinity: Worker %d pinned to CPU %d", worker, cpu);
+    return 0;
+}
+
+int affinity_attach_reuseport_cbpf(int sock, int num_workers)
+{
+    struct sock_filter code[6 * STATUS_MAX_WORKERS + 3];
+    struct sock_fprog prog;
+    int n = 0;
+    int slots;
+    int i, j;
+
+    if (affinity_count == 0 || num_workers < 2)
+        return 0;
+    if (num_workers > STATUS_MAX_WORKERS)
+        num_workers = STATUS_MAX_WORKERS;
+
+    /* Worker w runs on cpu[w % affinity_count]; a CPU listed twice would need
+     * a second group of workers, so leave such lists to the kernel's hash */
+    for (i = 0; i < affinity_count; i++)
+    {
+        for (j = i + 1; j < affinity_count; j++)
+        {
+            if (affinity_cpus[i] == affinity_cpus[j])
+            {
+                logger(LOG_WARN, "CPU affinity: CPU %d listed twice, not steering connections", affinity_cpus[i]);
+                return 0;
+            }
+        }
+    }
+
+    /* A = CPU that is processing the incoming SYN */
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+
+    /* if (A == cpu[i]) return one of the workers i, i + count, i + 2 * count, ... */
+    slots = affinity_count < num_workers ? affinity_count : num_workers;
+    for (i = 0; i < slots; i++)
+    {
+        uint32_t sharing = (uint32_t)((num_workers - i + affinity_count - 1) / affinity_count);
+
+        if (sharing == 1)
+        {
+            code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)affinity_cpus[i], 0, 1);
+            code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, (uint32_t)i);
+            continue;
+        }
+
+        /* Workers sharing the CPU get its connections at random */
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, (uint32_t)affinity_cpus[i], 0, 5);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_RANDOM);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, sharing);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, (uint32_t)affinity_count);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, (uint32_t)i);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+    }
+
+    /* CPUs without a worker: spread by CPU number */
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, (uint32_t)num_workers);
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    prog.len = (unsigned short)n;
+    prog.filter = code;
+    if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0)
+    {
+        logger(LOG_ERROR, "CPU affinity: SO_ATTACH_REUSEPORT_CBPF failed: %s", strerror(errno));
+        return -1;
+    }
+
+    logger(LOG_INFO, "CPU affinity: Steering connections to the worker on the receiving CPU");
+    return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/**
+ * Worker CPU placement.
+ *
+ * Worker N is pinned to the Nth CPU of the configured list. The listening
+ * sockets get a classic BPF reuseport program that picks the socket of the
+ * worker pinned on the CPU that took the connection, so RX processing,
+ * accept and the stream's sends stay on one core. Workers also switch to
+ * local NUMA allocation before their buffer pools are created.
+ */
+
+/**
+ * Resolve the CPU list. Call before fork.
+ * @param spec "auto" or a list like "0,2,4-7" (NULL disables pinning)
+ * @param num_workers Number of worker processes
+ * @return Number of CPUs in the list, 0 if pinning is disabled
+ */
+int affinity_init(const char *spec, int num_workers);
+
+/**
+ * CPU a worker is pinned to
+ * @return CPU number, -1 if pinning is disabled
+ */
+int affinity_worker_cpu(int worker);
+
+/**
+ * Pin the calling worker to its CPU and prefer node-local memory
+ * @param worker Worker id
+ * @return 0 on success or when disabled, -1 on error
+ */
+int affinity_pin_worker(int worker);
+
+/**
+ * Attach the CPU steering program to a SO_REUSEPORT group
+ * The group's sockets must have been bound in worker order.
+ * @param sock Any listening socket of the group
+ * @param num_workers Number of worker processes
+ * @return 0 on success, -1 on error
+ */
+int affinity_attach_reuseport_cbpf(int sock, int num_workers);
+
+#endif /* AFFINITY_H */
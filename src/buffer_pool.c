@@ -11,6 +11,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <sys/mman.h>
 
 #define WORKER_STATS_INC(field)                             \
     do                                                      \
@@ -50,41 +51,184 @@ void buffer_pool_update_stats(buffer_pool_t *pool)
     }
 }
 
+static inline const char *buffer_pool_name(buffer_pool_t *pool)
+{
+    if (pool == &zerocopy_state.pool)
+        return "Buffer pool";
+    if (pool == &zerocopy_state.small_pool)
+        return "Small pool";
+    if (pool == &zerocopy_state.jumbo_pool)
+        return "Jumbo pool";
+    return "Control pool";
+}
+
+/**
+ * Map segment memory on huge pages: reserved ones (MAP_HUGETLB) if the
+ * system has them, else transparent huge pages on a huge-page aligned
+ * mapping
+ * @param size Length, a multiple of BUFFER_POOL_HUGE_PAGE_SIZE
+ * @return Mapping, or NULL (caller falls back to the heap)
+ */
+static uint8_t *buffer_pool_map_huge(size_t size)
+{
+    uint8_t *mem;
+
+#ifdef MAP_HUGETLB
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (mem != MAP_FAILED)
+        return mem;
+#endif
+
+#ifdef MADV_HUGEPAGE
+    /* Over-map by one huge page and trim, so the kernel can use huge pages throughout */
+    uint8_t *raw = mmap(NULL, size + BUFFER_POOL_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+
+    uintptr_t aligned = ((uintptr_t)raw + BUFFER_POOL_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(BUFFER_POOL_HUGE_PAGE_SIZE - 1);
+    mem = (uint8_t *)aligned;
+    if (mem > raw)
+        munmap(raw, (size_t)(mem - raw));
+    if (raw + size + BUFFER_POOL_HUGE_PAGE_SIZE > mem + size)
+        munmap(mem + size, (size_t)(raw + size + BUFFER_POOL_HUGE_PAGE_SIZE - (mem + size)));
+
+    if (madvise(mem, size, MADV_HUGEPAGE) < 0)
+        logger(LOG_DEBUG, "Buffer pool: madvise(MADV_HUGEPAGE) failed: %s", strerror(errno));
+    return mem;
+#else
+    (void)size;
+    return NULL;
+#endif
+}
+
+/* Segments enter the available list when they get a free buffer back */
+static void buffer_pool_avail_push(buffer_pool_t *pool, buffer_pool_segment_t *seg)
+{
+    seg->avail_prev = NULL;
+    seg->avail_next = pool->avail;
+    if (pool->avail)
+        pool->avail->avail_prev = seg;
+    else
+        pool->avail_tail = seg;
+    pool->avail = seg;
+}
+
+/* New segments go last so existing ones are used (and new ones drain) first */
+static void buffer_pool_avail_append(buffer_pool_t *pool, buffer_pool_segment_t *seg)
+{
+    seg->avail_next = NULL;
+    seg->avail_prev = pool->avail_tail;
+    if (pool->avail_tail)
+        pool->avail_tail->avail_next = seg;
+    else
+        pool->avail = seg;
+    pool->avail_tail = seg;
+}
+
+static void buffer_pool_avail_unlink(buffer_pool_t *pool, buffer_pool_segment_t *seg)
+{
+    if (seg->avail_prev)
+        seg->avail_prev->avail_next = seg->avail_next;
+    else
+        pool->avail = seg->avail_next;
+    if (seg->avail_next)
+        seg->avail_next->avail_prev = seg->avail_prev;
+    else
+        pool->avail_tail = seg->avail_prev;
+    seg->avail_prev = NULL;
+    seg->avail_next = NULL;
+}
+
+static void buffer_pool_add_segment(buffer_pool_t *pool, buffer_pool_segment_t *seg)
+{
+    seg->prev = NULL;
+    seg->next = pool->segments;
+    if (pool->segments)
+        pool->segments->prev = seg;
+    pool->segments = seg;
+    buffer_pool_avail_append(pool, seg);
+
+    pool->num_buffers += seg->num_buffers;
+    pool->num_free += seg->num_buffers;
+}
+
+static void buffer_pool_segment_free(buffer_pool_segment_t *segment)
+{
+    if (segment->buffers)
+    {
+        if (segment->map_size)
+            munmap(segment->buffers, segment->map_size);
+        else
+            free(segment->buffers);
+    }
+    free(segment->refs);
+    free(segment);
+}
+
 static buffer_pool_segment_t *buffer_pool_segment_create(size_t buffer_size, size_t num_buffers, buffer_pool_t *pool)
 {
     buffer_pool_segment_t *segment = malloc(sizeof(buffer_pool_segment_t));
     if (!segment)
         return NULL;
 
-    segment->num_buffers = num_buffers;
-    segment->num_free = num_buffers;
+    segment->buffers = NULL;
+    segment->map_size = 0;
     segment->create_time_us = buffer_pool_time_us();
     segment->parent = pool;
+    segment->free_list = NULL;
+    segment->prev = NULL;
     segment->next = NULL;
+    segment->avail_prev = NULL;
+    segment->avail_next = NULL;
+
+    if (pool->huge_pages)
+    {
+        /* Whole huge pages: fill the rounded-up tail with buffers as long as the pool has room */
+        size_t size = (buffer_size * num_buffers + BUFFER_POOL_HUGE_PAGE_SIZE - 1) &
+                      ~(size_t)(BUFFER_POOL_HUGE_PAGE_SIZE - 1);
+        size_t room = pool->max_buffers > pool->num_buffers ? pool->max_buffers - pool->num_buffers : num_buffers;
+        segment->buffers = buffer_pool_map_huge(size);
+        if (segment->buffers)
+        {
+            segment->map_size = size;
+            num_buffers = size / buffer_size;
+            if (num_buffers > room && room > 0)
+                num_buffers = room;
+        }
+        else
+        {
+            logger(LOG_DEBUG, "%s: Huge pages unavailable, using regular memory", buffer_pool_name(pool));
+        }
+    }
 
-    if (posix_memalign((void **)&segment->buffers, BUFFER_POOL_ALIGNMENT, buffer_size * num_buffers) != 0)
+    if (!segment->buffers &&
+        posix_memalign((void **)&segment->buffers, BUFFER_POOL_ALIGNMENT, buffer_size * num_buffers) != 0)
     {
         logger(LOG_ERROR, "Buffer pool: Failed to allocate aligned memory for %zu buffers", num_buffers);
         free(segment);
         return NULL;
     }
 
+    segment->num_buffers = num_buffers;
+    segment->num_free = num_buffers;
+
     segment->refs = calloc(num_buffers, sizeof(buffer_ref_t));
     if (!segment->refs)
     {
-        free(segment->buffers);
-        free(segment);
+        buffer_pool_segment_free(segment);
         return NULL;
     }
 
-    for (size_t i = 0; i < num_buffers; i++)
+    /* Built backwards so buffers are handed out in address order */
+    for (size_t i = num_buffers; i-- > 0;)
     {
         buffer_ref_t *ref = &segment->refs[i];
         ref->data = segment->buffers + (i * buffer_size);
         ref->refcount = 0;
         ref->segment = segment;
-        ref->free_next = pool->free_list;
-        pool->free_list = ref;
+        ref->free_next = segment->free_list;
+        segment->free_list = ref;
     }
 
     return segment;
@@ -92,7 +236,7 @@ static buffer_pool_segment_t *buffer_pool_segment_create(size_t buffer_size, siz
 
 int buffer_pool_init(buffer_pool_t *pool, size_t buffer_size, size_t initial_buffers,
                      size_t max_buffers, size_t expand_size, size_t low_watermark,
-                     size_t high_watermark)
+                     size_t high_watermark, int huge_pages)
 {
     memset(pool, 0, sizeof(*pool));
 
@@ -101,28 +245,29 @@ int buffer_pool_init(buffer_pool_t *pool, size_t buffer_size, size_t initial_buf
     pool->expand_size = expand_size;
     pool->low_watermark = low_watermark;
     pool->high_watermark = high_watermark;
-    pool->free_list = NULL;
     pool->segments = NULL;
+    pool->avail = NULL;
+    pool->avail_tail = NULL;
     pool->num_buffers = 0;
     pool->num_free = 0;
+    pool->huge_pages = huge_pages;
+    pool->demand = 0;
+    pool->demand_time_us = buffer_pool_time_us();
 
-    buffer_pool_segment_t *initial_segment = buffer_pool_segment_create(buffer_size, initial_buffers, pool);
-    if (!initial_segment)
-        return -1;
+    /* Pools without initial buffers get their first segment on demand */
+    if (initial_buffers > 0)
+    {
+        buffer_pool_segment_t *initial_segment = buffer_pool_segment_create(buffer_size, initial_buffers, pool);
+        if (!initial_segment)
+            return -1;
 
-    pool->segments = initial_segment;
-    pool->num_buffers = initial_buffers;
-    pool->num_free = initial_buffers;
+        buffer_pool_add_segment(pool, initial_segment);
+    }
 
     buffer_pool_update_stats(pool);
     return 0;
 }
 
-static inline const char *buffer_pool_name(buffer_pool_t *pool)
-{
-    return (pool == &zerocopy_state.pool) ? "Buffer pool" : "Control pool";
-}
-
 static int buffer_pool_expand(buffer_pool_t *pool)
 {
     if (pool->num_buffers >= pool->max_buffers)
@@ -148,10 +293,7 @@ static int buffer_pool_expand(buffer_pool_t *pool)
         return -1;
     }
 
-    new_segment->next = pool->segments;
-    pool->segments = new_segment;
-    pool->num_buffers += buffers_to_add;
-    pool->num_free += buffers_to_add;
+    buffer_pool_add_segment(pool, new_segment);
 
     if (pool == &zerocopy_state.pool)
     {
@@ -176,16 +318,13 @@ void buffer_pool_cleanup(buffer_pool_t *pool)
     while (segment)
     {
         buffer_pool_segment_t *next = segment->next;
-        if (segment->buffers)
-            free(segment->buffers);
-        if (segment->refs)
-            free(segment->refs);
-        free(segment);
+        buffer_pool_segment_free(segment);
         segment = next;
     }
 
     pool->segments = NULL;
-    pool->free_list = NULL;
+    pool->avail = NULL;
+    pool->avail_tail = NULL;
     pool->num_free = 0;
     pool->num_buffers = 0;
 
@@ -206,7 +345,7 @@ void buffer_ref_put(buffer_ref_t *ref)
     ref->refcount--;
     if (ref->refcount <= 0)
     {
-        if (ref->type == BUFFER_TYPE_FILE)
+        if (ref->type == BUFFER_TYPE_FILE || ref->type == BUFFER_TYPE_PIPE)
         {
             if (ref->file_fd >= 0)
             {
@@ -216,15 +355,13 @@ void buffer_ref_put(buffer_ref_t *ref)
             return;
         }
 
-        buffer_pool_t *pool = ref->segment ? ref->segment->parent : &zerocopy_state.pool;
-
-        if (ref->segment)
-        {
-            ref->segment->num_free++;
-        }
+        buffer_pool_segment_t *seg = ref->segment;
+        buffer_pool_t *pool = seg->parent;
 
-        ref->free_next = pool->free_list;
-        pool->free_list = ref;
+        ref->free_next = seg->free_list;
+        seg->free_list = ref;
+        if (seg->num_free++ == 0)
+            buffer_pool_avail_push(pool, seg);
         pool->num_free++;
 
         buffer_pool_update_stats(pool);
@@ -236,7 +373,7 @@ buffer_ref_t *buffer_pool_alloc_from(buffer_pool_t *pool)
     if (!pool)
         return NULL;
 
-    if (!pool->free_list)
+    if (!pool->avail)
     {
         if (pool == &zerocopy_state.pool)
         {
@@ -254,9 +391,9 @@ buffer_ref_t *buffer_pool_alloc_from(buffer_pool_t *pool)
             return NULL;
         }
 
-        if (!pool->free_list)
+        if (!pool->avail)
         {
-            logger(LOG_ERROR, "%s: Expansion succeeded but free_list is still empty",
+            logger(LOG_ERROR, "%s: Expansion succeeded but no segment has free buffers",
                    buffer_pool_name(pool));
             return NULL;
         }
@@ -273,14 +410,15 @@ buffer_ref_t *buffer_pool_alloc_from(buffer_pool_t *pool)
         }
     }
 
-    buffer_ref_t *ref = pool->free_list;
-    pool->free_list = ref->free_next;
+    buffer_pool_segment_t *seg = pool->avail;
+    buffer_ref_t *ref = seg->free_list;
+    seg->free_list = ref->free_next;
+    if (--seg->num_free == 0)
+        buffer_pool_avail_unlink(pool, seg);
     pool->num_free--;
 
-    if (ref->segment)
-    {
-        ref->segment->num_free--;
-    }
+    if (pool->num_buffers - pool->num_free > pool->demand)
+        pool->demand = pool->num_buffers - pool->num_free;
 
     ref->refcount = 1;
     ref->data_offset = 0;
@@ -302,100 +440,111 @@ buffer_ref_t *buffer_pool_alloc_control(void)
     return buffer_pool_alloc_from(&zerocopy_state.control_pool);
 }
 
-static void buffer_pool_try_shrink_pool(buffer_pool_t *pool, size_t min_buffers)
+buffer_ref_t *buffer_pool_alloc_size(size_t size)
 {
-    if (pool->num_free <= pool->high_watermark || pool->num_buffers <= min_buffers)
+    if (size <= BUFFER_POOL_SMALL_SIZE)
     {
-        return;
+        buffer_ref_t *ref = buffer_pool_alloc_from(&zerocopy_state.small_pool);
+        if (ref)
+            return ref;
     }
+    if (size <= BUFFER_POOL_BUFFER_SIZE)
+        return buffer_pool_alloc_from(&zerocopy_state.pool);
+    if (size <= BUFFER_POOL_JUMBO_SIZE)
+        return buffer_pool_alloc_from(&zerocopy_state.jumbo_pool);
+    return NULL;
+}
 
-    logger(LOG_DEBUG, "%s: Checking for shrink opportunity (free: %zu, high_watermark: %zu, total: %zu)",
-           buffer_pool_name(pool), pool->num_free, pool->high_watermark, pool->num_buffers);
-
-    buffer_pool_segment_t *prev = NULL;
-    buffer_pool_segment_t *seg = pool->segments;
-    size_t segments_freed = 0;
+size_t buffer_ref_capacity(const buffer_ref_t *ref)
+{
+    if (!ref || ref->type != BUFFER_TYPE_MEMORY || !ref->segment)
+        return 0;
+    return ref->segment->parent->buffer_size;
+}
 
-    while (seg != NULL)
+/**
+ * Decay the in-use peak by whole half-lives since it was last decayed
+ * Bursts raise it at once in buffer_pool_alloc_from; it then falls off
+ * gradually, so capacity needed a moment ago is not freed and re-expanded.
+ */
+static void buffer_pool_decay_demand(buffer_pool_t *pool, uint64_t now)
+{
+    uint64_t halvings = (now - pool->demand_time_us) / BUFFER_POOL_DEMAND_HALF_LIFE_US;
+    if (halvings > 0)
     {
-        buffer_pool_segment_t *next = seg->next;
-
-        if (seg->num_free == seg->num_buffers &&
-            pool->num_buffers - seg->num_buffers >= min_buffers)
-        {
-            buffer_ref_t **free_ptr = &pool->free_list;
-            size_t removed_count = 0;
+        pool->demand = halvings < 64 ? pool->demand >> halvings : 0;
+        pool->demand_time_us += halvings * BUFFER_POOL_DEMAND_HALF_LIFE_US;
+    }
 
-            while (*free_ptr != NULL)
-            {
-                buffer_ref_t *ref = *free_ptr;
-                uint8_t *buf_addr = (uint8_t *)ref->data;
-                uint8_t *seg_start = seg->buffers;
-                uint8_t *seg_end = seg->buffers + (seg->num_buffers * pool->buffer_size);
-
-                if (buf_addr >= seg_start && buf_addr < seg_end)
-                {
-                    *free_ptr = ref->free_next;
-                    removed_count++;
-                }
-                else
-                {
-                    free_ptr = &(ref->free_next);
-                }
-            }
+    if (pool->demand < pool->num_buffers - pool->num_free)
+        pool->demand = pool->num_buffers - pool->num_free;
+}
 
-            if (removed_count != seg->num_buffers)
-            {
-                logger(LOG_ERROR, "%s: Shrink inconsistency - expected %zu free buffers, found %zu",
-                       buffer_pool_name(pool), seg->num_buffers, removed_count);
-            }
+/* Unlink and free a segment whose buffers are all free */
+static void buffer_pool_release_segment(buffer_pool_t *pool, buffer_pool_segment_t *seg, uint64_t now)
+{
+    buffer_pool_avail_unlink(pool, seg);
+    if (seg->prev)
+        seg->prev->next = seg->next;
+    else
+        pool->segments = seg->next;
+    if (seg->next)
+        seg->next->prev = seg->prev;
+
+    pool->num_buffers -= seg->num_buffers;
+    pool->num_free -= seg->num_buffers;
+
+    logger(LOG_DEBUG, "%s: Freeing idle segment with %zu buffers (age: %.1fs, total: %zu -> %zu)",
+           buffer_pool_name(pool),
+           seg->num_buffers,
+           (now - seg->create_time_us) / 1000000.0,
+           pool->num_buffers + seg->num_buffers,
+           pool->num_buffers);
+
+    buffer_pool_segment_free(seg);
 
-            pool->num_buffers -= seg->num_buffers;
-            pool->num_free -= removed_count;
+    if (pool == &zerocopy_state.pool)
+    {
+        WORKER_STATS_INC(pool_shrinks);
+    }
+    else if (pool == &zerocopy_state.control_pool)
+    {
+        WORKER_STATS_INC(control_pool_shrinks);
+    }
+}
 
-            if (prev)
-            {
-                prev->next = next;
-            }
-            else
-            {
-                pool->segments = next;
-            }
+static void buffer_pool_try_shrink_pool(buffer_pool_t *pool, size_t min_buffers)
+{
+    if (pool->num_free <= pool->high_watermark || pool->num_buffers <= min_buffers)
+    {
+        return;
+    }
 
-            logger(LOG_DEBUG, "%s: Freeing idle segment with %zu buffers (age: %.1fs, total: %zu -> %zu)",
-                   buffer_pool_name(pool),
-                   seg->num_buffers,
-                   (buffer_pool_time_us() - seg->create_time_us) / 1000000.0,
-                   pool->num_buffers + seg->num_buffers,
-                   pool->num_buffers);
+    uint64_t now = buffer_pool_time_us();
+    buffer_pool_decay_demand(pool, now);
 
-            free(seg->refs);
-            free(seg->buffers);
-            free(seg);
+    /* Keep recent demand plus the low watermark as headroom */
+    size_t keep = pool->demand + pool->low_watermark;
+    if (keep < min_buffers)
+        keep = min_buffers;
 
-            segments_freed++;
+    logger(LOG_DEBUG, "%s: Checking for shrink opportunity (free: %zu, high_watermark: %zu, total: %zu, demand: %zu)",
+           buffer_pool_name(pool), pool->num_free, pool->high_watermark, pool->num_buffers, pool->demand);
 
-            if (pool == &zerocopy_state.pool)
-            {
-                WORKER_STATS_INC(pool_shrinks);
-            }
-            else if (pool == &zerocopy_state.control_pool)
-            {
-                WORKER_STATS_INC(control_pool_shrinks);
-            }
+    buffer_pool_segment_t *seg = pool->segments;
+    size_t segments_freed = 0;
 
-            seg = next;
+    while (seg != NULL && pool->num_free > pool->high_watermark)
+    {
+        buffer_pool_segment_t *next = seg->next;
 
-            if (pool->num_free <= pool->high_watermark)
-            {
-                break;
-            }
-        }
-        else
+        if (seg->num_free == seg->num_buffers && pool->num_buffers - seg->num_buffers >= keep)
         {
-            prev = seg;
-            seg = next;
+            buffer_pool_release_segment(pool, seg, now);
+            segments_freed++;
         }
+
+        seg = next;
     }
 
     if (segments_freed > 0)
@@ -407,8 +556,29 @@ static void buffer_pool_try_shrink_pool(buffer_pool_t *pool, size_t min_buffers)
     }
 }
 
+void buffer_pool_set_max(buffer_pool_t *pool, size_t max_buffers)
+{
+    uint64_t now = buffer_pool_time_us();
+    buffer_pool_segment_t *seg = pool->segments;
+
+    pool->max_buffers = max_buffers;
+
+    /* Give idle segments back until the pool fits; buffers in use stay until released */
+    while (seg != NULL && pool->num_buffers > max_buffers)
+    {
+        buffer_pool_segment_t *next = seg->next;
+        if (seg->num_free == seg->num_buffers)
+            buffer_pool_release_segment(pool, seg, now);
+        seg = next;
+    }
+
+    buffer_pool_update_stats(pool);
+}
+
 void buffer_pool_try_shrink(void)
 {
     buffer_pool_try_shrink_pool(&zerocopy_state.pool, BUFFER_POOL_INITIAL_SIZE);
     buffer_pool_try_shrink_pool(&zerocopy_state.control_pool, CONTROL_POOL_INITIAL_SIZE);
+    buffer_pool_try_shrink_pool(&zerocopy_state.small_pool, SMALL_POOL_INITIAL_SIZE);
+    buffer_pool_try_shrink_pool(&zerocopy_state.jumbo_pool, JUMBO_POOL_INITIAL_SIZE);
 }
@@ -15,6 +15,29 @@
 #define BUFFER_POOL_LOW_WATERMARK 256
 #define BUFFER_POOL_HIGH_WATERMARK (BUFFER_POOL_INITIAL_SIZE * 3)
 
+/* Size classes: small buffers for headers and short control output, jumbo
+ * buffers for datagrams and interleaved frames above BUFFER_POOL_BUFFER_SIZE */
+#define BUFFER_POOL_SMALL_SIZE 512
+#define BUFFER_POOL_JUMBO_SIZE 9216
+
+#define SMALL_POOL_INITIAL_SIZE 128
+#define SMALL_POOL_EXPAND_SIZE 128
+#define SMALL_POOL_MAX_BUFFERS 4096
+#define SMALL_POOL_LOW_WATERMARK 32
+#define SMALL_POOL_HIGH_WATERMARK 256
+
+#define JUMBO_POOL_INITIAL_SIZE 0 /* Allocated on first use */
+#define JUMBO_POOL_EXPAND_SIZE 32
+#define JUMBO_POOL_MAX_BUFFERS 512
+#define JUMBO_POOL_LOW_WATERMARK 0
+#define JUMBO_POOL_HIGH_WATERMARK 16
+
+/* Half-life of the decayed in-use peak that keeps segments from being freed */
+#define BUFFER_POOL_DEMAND_HALF_LIFE_US (10 * 1000000ULL)
+
+/* Huge page size assumed for huge-page-backed segments */
+#define BUFFER_POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 /* Control/API buffer pool configuration */
 #define CONTROL_POOL_INITIAL_SIZE 256
 #define CONTROL_POOL_EXPAND_SIZE 128
@@ -25,12 +48,15 @@
 typedef enum
 {
     BUFFER_TYPE_MEMORY = 0, /* Normal memory buffer from pool */
-    BUFFER_TYPE_FILE = 1    /* File descriptor for sendfile() */
+    BUFFER_TYPE_FILE = 1,   /* File descriptor for sendfile() */
+    BUFFER_TYPE_PIPE = 2    /* Bytes waiting in a pipe, moved with splice() */
 } buffer_type_t;
 
 /**
  * Buffer reference counting for zero-copy lifecycle management
- * Supports both memory buffers (pool-managed) and file descriptors (for sendfile)
+ * Supports both memory buffers (pool-managed) and file descriptors (for sendfile
+ * or splice). Pipe entries reuse the file fields: file_fd is a private dup of
+ * the pipe read end, file_size/file_sent count bytes queued/sent from it.
  *
  * This structure serves dual purpose:
  * 1. When buffer is free: linked via free_next in pool's free list
@@ -77,16 +103,23 @@ typedef struct buffer_ref_s
 
 /**
  * Buffer pool segment for dynamic expansion
+ * Each segment keeps its own free list, so a fully free segment can be
+ * released without touching buffers of other segments.
  */
 typedef struct buffer_pool_segment_s
 {
     uint8_t *buffers;
+    size_t map_size; /* mmap'd length if huge-page backed, 0 if heap allocated */
     buffer_ref_t *refs;
+    buffer_ref_t *free_list; /* Free buffers of this segment */
     size_t num_buffers;
     size_t num_free;
     uint64_t create_time_us;
     struct buffer_pool_s *parent;
+    struct buffer_pool_segment_s *prev; /* All segments of the pool */
     struct buffer_pool_segment_s *next;
+    struct buffer_pool_segment_s *avail_prev; /* Segments with free buffers (num_free > 0) */
+    struct buffer_pool_segment_s *avail_next;
 } buffer_pool_segment_t;
 
 /**
@@ -95,7 +128,8 @@ typedef struct buffer_pool_segment_s
 typedef struct buffer_pool_s
 {
     buffer_pool_segment_t *segments;
-    buffer_ref_t *free_list;
+    buffer_pool_segment_t *avail;      /* Allocation order: recently full segments first, new ones last */
+    buffer_pool_segment_t *avail_tail;
     size_t buffer_size;
     size_t num_buffers;
     size_t num_free;
@@ -103,11 +137,14 @@ typedef struct buffer_pool_s
     size_t expand_size;
     size_t low_watermark;
     size_t high_watermark;
+    int huge_pages; /* Back segments with huge pages (rounded up to whole pages) */
+    size_t demand;           /* Peak buffers in use, halved every BUFFER_POOL_DEMAND_HALF_LIFE_US */
+    uint64_t demand_time_us; /* Time demand was last decayed to */
 } buffer_pool_t;
 
 int buffer_pool_init(buffer_pool_t *pool, size_t buffer_size, size_t initial_buffers,
                      size_t max_buffers, size_t expand_size, size_t low_watermark,
-                     size_t high_watermark);
+                     size_t high_watermark, int huge_pages);
 void buffer_pool_cleanup(buffer_pool_t *pool);
 void buffer_pool_update_stats(buffer_pool_t *pool);
 void buffer_ref_get(buffer_ref_t *ref);
@@ -115,6 +152,25 @@ void buffer_ref_put(buffer_ref_t *ref);
 buffer_ref_t *buffer_pool_alloc_from(buffer_pool_t *pool);
 buffer_ref_t *buffer_pool_alloc(void);
 buffer_ref_t *buffer_pool_alloc_control(void);
+
+/**
+ * Allocate a buffer from the smallest size class that holds size bytes
+ * Small requests fall back to the media pool when the small pool is exhausted.
+ * @return Buffer, or NULL if exhausted or size exceeds BUFFER_POOL_JUMBO_SIZE
+ */
+buffer_ref_t *buffer_pool_alloc_size(size_t size);
+
+/**
+ * @return Capacity of a pool buffer in bytes, 0 for file and pipe entries
+ */
+size_t buffer_ref_capacity(const buffer_ref_t *ref);
 void buffer_pool_try_shrink(void);
 
+/**
+ * Change the maximum size of a pool
+ * Idle segments are freed at once while the pool is above the new maximum;
+ * segments with buffers in use are freed by later shrinks.
+ */
+void buffer_pool_set_max(buffer_pool_t *pool, size_t max_buffers);
+
 #endif /* BUFFER_POOL_H */
@@ -22,6 +22,8 @@
 #include "service.h"
 #include "m3u.h"
 #include "http_fetch.h"
+#include "snapshot_decoder.h"
+#include "thumbnail.h"
 #include "epg.h"
 
 #define MAX_LINE 1024
@@ -463,9 +465,13 @@ void parse_global_sec(char *line)
     if (set_if_not_cmd_override(cmd_buffer_pool_max_size_set, "buffer-pool-max-size"))
     {
       int val = atoi(value);
-      if (val < 1)
+      if (strcasecmp(value, "auto") == 0)
       {
-        logger(LOG_ERROR, "Invalid buffer-pool-max-size! Must be >= 1. Ignoring.");
+        config.buffer_pool_max_size = 0;
+      }
+      else if (val < 1)
+      {
+        logger(LOG_ERROR, "Invalid buffer-pool-max-size! Must be >= 1 or auto. Ignoring.");
       }
       else
       {
@@ -475,6 +481,12 @@ void parse_global_sec(char *line)
     return;
   }
 
+  if (strcasecmp("buffer-pool-hugepages", param) == 0)
+  {
+    config.buffer_pool_hugepages = parse_bool(value);
+    return;
+  }
+
   /* Boolean parameters with command line override */
   if (strcasecmp("udpxy", param) == 0)
   {
@@ -549,6 +561,62 @@ void parse_global_sec(char *line)
     return;
   }
 
+  if (strcasecmp("snapshot-concurrency", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 1)
+    {
+      logger(LOG_ERROR, "Invalid snapshot-concurrency value: %s (must be >= 1)", value);
+    }
+    else
+    {
+      config.snapshot_concurrency = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("snapshot-cache-ttl", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 0)
+    {
+      logger(LOG_ERROR, "Invalid snapshot-cache-ttl value: %s (must be >= 0)", value);
+    }
+    else
+    {
+      config.snapshot_cache_ttl = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("snapshot-decoders", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 0 || val > SNAPSHOT_DECODER_MAX)
+    {
+      logger(LOG_ERROR, "Invalid snapshot-decoders value: %s (must be 0-%d)", value, SNAPSHOT_DECODER_MAX);
+    }
+    else
+    {
+      config.snapshot_decoders = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("thumbnail-concurrency", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 1 || val > THUMBNAIL_CONCURRENCY_MAX)
+    {
+      logger(LOG_ERROR, "Invalid thumbnail-concurrency value: %s (must be 1-%d)", value, THUMBNAIL_CONCURRENCY_MAX);
+    }
+    else
+    {
+      config.thumbnail_concurrency = val;
+    }
+    return;
+  }
+
   if (strcasecmp("ffmpeg-args", param) == 0)
   {
     if (set_if_not_cmd_override(cmd_ffmpeg_args_set, "ffmpeg-args"))
@@ -621,6 +689,118 @@ void parse_global_sec(char *line)
     return;
   }
 
+  if (strcasecmp("keepalive-timeout", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 0)
+    {
+      logger(LOG_ERROR, "Invalid keepalive-timeout value: %s (must be >= 0)", value);
+    }
+    else
+    {
+      config.http_keepalive_timeout = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("loop-stall-threshold", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 0)
+    {
+      logger(LOG_ERROR, "Invalid loop-stall-threshold value: %s (must be >= 0)", value);
+    }
+    else
+    {
+      config.loop_stall_threshold = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("keepalive-max-requests", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 1)
+    {
+      logger(LOG_ERROR, "Invalid keepalive-max-requests value: %s (must be >= 1)", value);
+    }
+    else
+    {
+      config.http_keepalive_max = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("channel-affinity", param) == 0)
+  {
+    config.channel_affinity = parse_bool(value);
+    return;
+  }
+
+  if (strcasecmp("mcast-shared-ring", param) == 0)
+  {
+    config.mcast_shared_ring = parse_bool(value);
+    return;
+  }
+
+  if (strcasecmp("cpu-affinity", param) == 0)
+  {
+    safe_free_string(&config.cpu_affinity);
+    if (value[0] != '\0' && strcasecmp(value, "no") != 0)
+      config.cpu_affinity = strdup(value);
+    return;
+  }
+
+  if (strcasecmp("rtsp-warm-pool", param) == 0)
+  {
+    int val = atoi(value);
+    if (val < 0)
+    {
+      logger(LOG_ERROR, "Invalid rtsp-warm-pool value: %s (must be >= 0)", value);
+    }
+    else
+    {
+      config.rtsp_warm_pool = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("timeshift-dir", param) == 0)
+  {
+    safe_free_string(&config.timeshift_dir);
+    if (value[0] != '\0')
+      config.timeshift_dir = strdup(value);
+    return;
+  }
+
+  if (strcasecmp("timeshift-duration", param) == 0)
+  {
+    int val = atoi(value);
+    if (val <= 0)
+    {
+      logger(LOG_ERROR, "Invalid timeshift-duration value: %s (must be > 0)", value);
+    }
+    else
+    {
+      config.timeshift_duration = val;
+    }
+    return;
+  }
+
+  if (strcasecmp("timeshift-size", param) == 0)
+  {
+    int val = atoi(value);
+    if (val <= 0)
+    {
+      logger(LOG_ERROR, "Invalid timeshift-size value: %s (must be > 0)", value);
+    }
+    else
+    {
+      config.timeshift_size_mb = val;
+    }
+    return;
+  }
+
   /* External M3U configuration */
   if (strcasecmp("external-m3u", param) == 0)
   {
@@ -835,6 +1015,7 @@ void restore_conf_defaults(void)
 
   config.buffer_pool_max_size = 16384;
   cmd_buffer_pool_max_size_set = 0;
+  config.buffer_pool_hugepages = 0;
 
   safe_free_string(&config.hostname);
   cmd_hostname_set = 0;
@@ -854,10 +1035,27 @@ void restore_conf_defaults(void)
 
   config.video_snapshot = 0;
   cmd_video_snapshot_set = 0;
+  config.snapshot_concurrency = 2;
+  config.snapshot_cache_ttl = 30;
+  config.snapshot_decoders = 0;
+  config.thumbnail_concurrency = 8;
 
   config.mcast_rejoin_interval = 0; /* default disabled */
   cmd_mcast_rejoin_interval_set = 0;
 
+  config.http_keepalive_timeout = 15;
+  config.http_keepalive_max = 100;
+  config.channel_affinity = 1;
+  config.mcast_shared_ring = 0;
+  safe_free_string(&config.cpu_affinity);
+  config.loop_stall_threshold = 50;
+
+  config.rtsp_warm_pool = 2;
+
+  safe_free_string(&config.timeshift_dir);
+  config.timeshift_duration = 1800;
+  config.timeshift_size_mb = 1024;
+
   config.zerocopy_on_send = 0; /* default: disabled for compatibility */
   cmd_zerocopy_on_send_set = 0;
 
@@ -894,6 +1092,7 @@ void restore_conf_defaults(void)
     services = services->next;
     free_config_service(service_tmp);
   }
+  service_index_reset();
 
   /* Free all bind addresses */
   free_bindaddr(bind_addresses);
@@ -923,7 +1122,7 @@ void usage(FILE *f, char *progname)
           "\t-U --noudpxy         Disable UDPxy compatibility\n"
           "\t-m --maxclients <n>  Serve max n requests simultaneously (default 5)\n"
           "\t-w --workers <n>     Number of worker processes with SO_REUSEPORT (default 1)\n"
-          "\t-b --buffer-pool-max-size <n> Maximum number of buffers in zero-copy pool (default 16384)\n"
+          "\t-b --buffer-pool-max-size <n> Maximum number of buffers in zero-copy pool, or auto (default 16384)\n"
           "\t-l --listen [addr:]port  Address/port to bind (default ANY:5140)\n"
           "\t-c --config <file>   Read this file for configuration, instead of the default one\n"
           "\t-C --noconfig        Do not read the default config\n"
@@ -1071,7 +1270,12 @@ void parse_cmd_line(int argc, char *argv[])
       }
       break;
     case 'b':
-      if (atoi(optarg) < 1)
+      if (strcasecmp(optarg, "auto") == 0)
+      {
+        config.buffer_pool_max_size = 0;
+        cmd_buffer_pool_max_size_set = 1;
+      }
+      else if (atoi(optarg) < 1)
       {
         logger(LOG_ERROR, "Invalid buffer-pool-max-size! Ignoring.");
       }
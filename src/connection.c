@@ -8,10 +8,15 @@
 #include "http.h"
 #include "service.h"
 #include "snapshot.h"
+#include "snapshot_cache.h"
+#include "thumbnail.h"
 #include "status.h"
 #include "zerocopy.h"
 #include "m3u.h"
 #include "epg.h"
+#include "timeshift.h"
+#include "slab.h"
+#include "handoff.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -28,6 +33,7 @@
 #include <netdb.h>
 
 #define CONNECTION_TCP_USER_TIMEOUT_MS 10000
+#define CONNECTION_REQUEST_TIMEOUT_MS 30000
 #define CONN_QUEUE_MIN_BUFFERS 64
 #define CONN_QUEUE_BURST_FACTOR 3.0
 #define CONN_QUEUE_BURST_FACTOR_CONGESTED 1.5
@@ -46,10 +52,28 @@
 static void handle_playlist_request(connection_t *c);
 static void handle_epg_request(connection_t *c);
 
-static inline buffer_ref_t *connection_alloc_output_buffer(connection_t *c)
+/* Request buffers, returned as soon as a connection starts streaming */
+static slab_t inbuf_slab = SLAB_INITIALIZER("inbuf", INBUF_SIZE, 16);
+
+/* Per-worker HTTP request counters (requests per connection = requests / connections) */
+#define CONNECTION_STATS_INC(field)                                          \
+  do                                                                       \
+  {                                                                        \
+    if (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS) \
+      status_shared->worker_stats[worker_id].field++;                      \
+  } while (0)
+
+static inline buffer_ref_t *connection_alloc_output_buffer(connection_t *c, size_t len)
 {
   buffer_ref_t *buf_ref = NULL;
 
+  /* Short writes (headers, small API replies) use the small size class */
+  if (len <= BUFFER_POOL_SMALL_SIZE)
+    buf_ref = buffer_pool_alloc_from(&zerocopy_state.small_pool);
+
+  if (buf_ref)
+    return buf_ref;
+
   if (c->buffer_class == CONNECTION_BUFFER_CONTROL)
   {
     buf_ref = buffer_pool_alloc_control();
@@ -224,6 +248,12 @@ connection_t *connection_create(int fd, int epfd,
   connection_t *c = calloc(1, sizeof(*c));
   if (!c)
     return NULL;
+  c->inbuf = slab_alloc(&inbuf_slab);
+  if (!c->inbuf)
+  {
+    free(c);
+    return NULL;
+  }
   c->fd = fd;
   c->epfd = epfd;
   c->state = CONN_READ_REQ_LINE;
@@ -247,8 +277,6 @@ connection_t *connection_create(int fd, int epfd,
   zerocopy_queue_init(&c->zc_queue);
   c->zerocopy_enabled = 0;
   c->buffer_class = CONNECTION_BUFFER_CONTROL;
-  c->write_queue_next = NULL;
-  c->write_queue_pending = 0;
   c->queue_limit_bytes = 0;
   c->queue_bytes_highwater = 0;
   c->queue_buffers_highwater = 0;
@@ -259,6 +287,10 @@ connection_t *connection_create(int fd, int epfd,
   c->queue_avg_bytes = 0.0;
   c->slow_active = 0;
   c->slow_candidate_since = 0;
+  c->keepalive = 0;
+  c->requests_served = 0;
+  c->last_activity_ms = get_time_ms();
+  CONNECTION_STATS_INC(http_connections);
 
   /* Enforce TCP user timeout so unacknowledged data fails quickly */
   int tcp_user_timeout = CONNECTION_TCP_USER_TIMEOUT_MS;
@@ -282,6 +314,22 @@ connection_t *connection_create(int fd, int epfd,
   return c;
 }
 
+/* Media connections never read another request */
+static void connection_release_inbuf(connection_t *c)
+{
+  slab_free(&inbuf_slab, c->inbuf);
+  c->inbuf = NULL;
+  c->in_len = 0;
+}
+
+size_t connection_memory_footprint(const connection_t *c)
+{
+  size_t bytes = sizeof(*c) + stream_context_memory(&c->stream);
+  if (c->inbuf)
+    bytes += slab_object_size(&inbuf_slab);
+  return bytes;
+}
+
 void connection_free(connection_t *c)
 {
   if (!c)
@@ -301,6 +349,8 @@ void connection_free(connection_t *c)
     logger(LOG_WARN, "connection_free: streaming flag still set, cleaning up stream");
     stream_context_cleanup(&c->stream);
   }
+  stream_context_release(&c->stream);
+  connection_release_inbuf(c);
 
   /* Cleanup zero-copy queue - this releases all buffer references */
   zerocopy_queue_cleanup(&c->zc_queue);
@@ -348,7 +398,7 @@ int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
   while (remaining > 0)
   {
     /* Allocate a buffer from the pool */
-    buffer_ref_t *buf_ref = connection_alloc_output_buffer(c);
+    buffer_ref_t *buf_ref = connection_alloc_output_buffer(c, remaining);
     if (!buf_ref)
     {
       /* Pool exhausted */
@@ -358,8 +408,8 @@ int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
 
     /* Calculate how much data to copy into this buffer */
     size_t chunk_size = remaining;
-    if (chunk_size > BUFFER_POOL_BUFFER_SIZE)
-      chunk_size = BUFFER_POOL_BUFFER_SIZE;
+    if (chunk_size > buffer_ref_capacity(buf_ref))
+      chunk_size = buffer_ref_capacity(buf_ref);
 
     /* Copy data into the buffer */
     memcpy(buf_ref->data, src, chunk_size);
@@ -399,6 +449,10 @@ connection_write_status_t connection_handle_write(connection_t *c)
   if (!c)
     return CONNECTION_WRITE_IDLE;
 
+  /* Catch-up from the time-shift ring is queued one chunk at a time */
+  if (!c->zc_queue.head && c->timeshift_reader)
+    timeshift_continue(c);
+
   if (!c->zc_queue.head)
   {
     connection_report_queue(c);
@@ -423,7 +477,7 @@ connection_write_status_t connection_handle_write(connection_t *c)
     return CONNECTION_WRITE_BLOCKED;
   }
 
-  if (c->zc_queue.head)
+  if (c->zc_queue.head || (c->timeshift_reader && timeshift_continue(c) > 0))
   {
     connection_report_queue(c);
     return CONNECTION_WRITE_PENDING;
@@ -443,6 +497,16 @@ void connection_handle_read(connection_t *c)
   if (!c)
     return;
 
+  /* Request buffer already released: discard anything the client sends */
+  if (!c->inbuf)
+  {
+    char discard[512];
+    ssize_t r = recv(c->fd, discard, sizeof(discard), 0);
+    if (r == 0 || (r < 0 && errno != EAGAIN))
+      c->state = CONN_CLOSING;
+    return;
+  }
+
   /* Read into input buffer */
   if (c->in_len < INBUF_SIZE)
   {
@@ -467,8 +531,11 @@ void connection_handle_read(connection_t *c)
     }
   }
 
-  /* Parse HTTP request using http.c parser */
-  if (c->state == CONN_READ_REQ_LINE || c->state == CONN_READ_HEADERS)
+  c->last_activity_ms = get_time_ms();
+
+  /* Parse HTTP requests using http.c parser; loop to serve pipelined
+   * requests on a persistent connection */
+  while (c->state == CONN_READ_REQ_LINE || c->state == CONN_READ_HEADERS)
   {
     int parse_result = http_parse_request(c->inbuf, &c->in_len, &c->http_req);
     if (parse_result == 1)
@@ -476,7 +543,9 @@ void connection_handle_read(connection_t *c)
       /* Request complete, route it */
       c->state = CONN_ROUTE;
       connection_route_and_start(c);
-      return;
+      if (c->in_len == 0)
+        return;
+      continue;
     }
     else if (parse_result < 0)
     {
@@ -484,10 +553,46 @@ void connection_handle_read(connection_t *c)
       c->state = CONN_CLOSING;
       return;
     }
+    else if (c->in_len >= INBUF_SIZE)
+    {
+      /* Buffer full without a complete request - no more data can be read */
+      logger(LOG_WARN, "HTTP request exceeds %d bytes, closing connection", INBUF_SIZE);
+      c->state = CONN_CLOSING;
+      return;
+    }
     /* else parse_result == 0: need more data, continue reading */
+    return;
   }
 }
 
+int connection_keepalive_expired(connection_t *c, int64_t now_ms)
+{
+  if (!c || c->streaming || (c->state != CONN_READ_REQ_LINE && c->state != CONN_READ_HEADERS))
+    return 0;
+  if (c->zc_queue.head)
+    return 0; /* Still sending the previous response */
+
+  int64_t timeout_ms = c->requests_served > 0 ? (int64_t)config.http_keepalive_timeout * 1000
+                                              : CONNECTION_REQUEST_TIMEOUT_MS;
+  return now_ms - c->last_activity_ms >= timeout_ms;
+}
+
+/* Response for a control route is queued: close, or wait for the next request */
+static void connection_finish_request(connection_t *c)
+{
+  if (!c->keepalive || c->state == CONN_CLOSING)
+  {
+    c->state = CONN_CLOSING;
+    return;
+  }
+
+  c->requests_served++;
+  c->keepalive = 0;
+  c->last_activity_ms = get_time_ms();
+  http_request_init(&c->http_req);
+  c->state = CONN_READ_REQ_LINE;
+}
+
 int connection_route_and_start(connection_t *c)
 {
   /* Ensure URL begins with '/' */
@@ -495,6 +600,12 @@ int connection_route_and_start(connection_t *c)
 
   logger(LOG_INFO, "New client requested URL: %s (method: %s)", url, c->http_req.method);
 
+  CONNECTION_STATS_INC(http_requests);
+  if (c->requests_served > 0)
+    CONNECTION_STATS_INC(http_keepalive_reuses);
+  c->keepalive = c->http_req.keepalive && config.http_keepalive_timeout > 0 &&
+                 c->requests_served + 1 < (uint32_t)config.http_keepalive_max;
+
   if (url[0] != '/')
   {
     http_send_400(c);
@@ -611,7 +722,7 @@ int connection_route_and_start(connection_t *c)
   if (status_route_len == path_len && strncmp(service_path, status_route, path_len) == 0)
   {
     handle_status_page(c);
-    c->state = CONN_CLOSING;
+    connection_finish_request(c);
     return 0;
   }
 
@@ -621,7 +732,7 @@ int connection_route_and_start(connection_t *c)
   if (player_route_len == path_len && strncmp(service_path, player_route, path_len) == 0)
   {
     handle_player_page(c);
-    c->state = CONN_CLOSING;
+    connection_finish_request(c);
     return 0;
   }
 
@@ -631,7 +742,7 @@ int connection_route_and_start(connection_t *c)
   if (playlist_route_len == path_len && strncmp(service_path, playlist_route, path_len) == 0)
   {
     handle_playlist_request(c);
-    c->state = CONN_CLOSING;
+    connection_finish_request(c);
     return 0;
   }
 
@@ -644,7 +755,7 @@ int connection_route_and_start(connection_t *c)
       (epg_xml_gz_route_len == path_len && strncmp(service_path, epg_xml_gz_route, path_len) == 0))
   {
     handle_epg_request(c);
-    c->state = CONN_CLOSING;
+    connection_finish_request(c);
     return 0;
   }
   size_t status_sse_len = strlen(status_sse_route);
@@ -663,13 +774,13 @@ int connection_route_and_start(connection_t *c)
     if (api_name_len == strlen("disconnect") && strncmp(api_name, "disconnect", api_name_len) == 0)
     {
       handle_disconnect_client(c);
-      c->state = CONN_CLOSING;
+      connection_finish_request(c);
       return 0;
     }
     if (api_name_len == strlen("log-level") && strncmp(api_name, "log-level", api_name_len) == 0)
     {
       handle_set_log_level(c);
-      c->state = CONN_CLOSING;
+      connection_finish_request(c);
       return 0;
     }
 
@@ -678,6 +789,26 @@ int connection_route_and_start(connection_t *c)
     return 0;
   }
 
+  /* Handle /thumbnails batch request */
+  const char *thumbnails_route = "thumbnails";
+  size_t thumbnails_route_len = strlen(thumbnails_route);
+  if (thumbnails_route_len == path_len && strncmp(service_path, thumbnails_route, path_len) == 0)
+  {
+    c->keepalive = 0;
+    if (!config.video_snapshot)
+    {
+      http_send_404(c);
+      c->state = CONN_CLOSING;
+      return 0;
+    }
+    if (thumbnail_handle_request(c, query_start ? query_start + 1 : NULL) < 0)
+      c->state = CONN_CLOSING;
+    return 0;
+  }
+
+  /* Media responses end at connection close */
+  c->keepalive = 0;
+
   /* Find configured service (with URL decoding support) */
   service_t *service = NULL;
   char decoded_path[HTTP_URL_BUFFER_SIZE];
@@ -702,11 +833,7 @@ int connection_route_and_start(connection_t *c)
   }
 
   /* Match against configured services */
-  for (service = services; service; service = service->next)
-  {
-    if (strcmp(decoded_path, service->url) == 0)
-      break;
-  }
+  service = service_find(decoded_path);
 
   /* Dynamic parsing for RTSP and UDPxy if needed */
   if (service == NULL)
@@ -755,6 +882,19 @@ int connection_route_and_start(connection_t *c)
     return 0;
   }
 
+  /* Multicast channels are served by one worker, so each group is received once */
+  if (!c->handed_off)
+  {
+    int target = handoff_target_worker(service);
+    if (target >= 0 && target != worker_id && handoff_send(c, target) == 0)
+    {
+      /* Target owns the socket now; closing our copy does not end the connection */
+      service_free(service);
+      c->state = CONN_CLOSING;
+      return 0;
+    }
+  }
+
   if (c->http_req.user_agent[0])
   {
     service->user_agent = strdup(c->http_req.user_agent);
@@ -805,6 +945,25 @@ int connection_route_and_start(connection_t *c)
     }
   }
 
+  /* Catch-up inside the local time-shift ring - serve it without the headend */
+  if (!is_snapshot_request && service->service_type == SERVICE_RTSP &&
+      timeshift_serve(c, service, decoded_path) == 0)
+  {
+    service_free(service);
+    connection_release_inbuf(c);
+    c->state = CONN_CLOSING;
+    return 0;
+  }
+
+  /* Serve snapshots from the channel's cached JPEG or a capture already running */
+  snapshot_cache_entry_t *snapshot_entry = NULL;
+  if (is_snapshot_request &&
+      snapshot_cache_request(c, service, is_snapshot_request == 1, &snapshot_entry) != SNAPSHOT_CACHE_MISS)
+  {
+    service_free(service);
+    return 0;
+  }
+
   /* Register streaming client in status tracking with service URL (skip for snapshots) */
   if (c->client_addr_len > 0)
   {
@@ -896,15 +1055,19 @@ int connection_route_and_start(connection_t *c)
       zerocopy_register_stream_client();
       c->stream_registered = 1;
     }
+    if (snapshot_entry)
+      snapshot_cache_attach(snapshot_entry, c->stream.snapshot);
 
     c->streaming = 1;
     c->service = service;
+    connection_release_inbuf(c);
     c->state = CONN_STREAMING;
     c->buffer_class = CONNECTION_BUFFER_MEDIA;
     return 0;
   }
   else
   {
+    snapshot_cache_abandon(snapshot_entry);
     service_free(service);
     c->state = CONN_CLOSING;
     return -1;
@@ -981,6 +1144,32 @@ int connection_queue_file(connection_t *c, int file_fd, off_t file_offset, size_
   return 0;
 }
 
+int connection_queue_pipe(connection_t *c, int pipe_fd, size_t len)
+{
+  if (!c || pipe_fd < 0 || len == 0)
+    return -1;
+
+  if (zerocopy_queue_add_pipe(&c->zc_queue, pipe_fd, len) < 0)
+    return -1;
+
+  /* Same batching as pool buffers: the pipe itself bounds the backlog */
+  if (zerocopy_should_flush(&c->zc_queue))
+  {
+    connection_epoll_update_events(c->epfd, c->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+  }
+
+  return 0;
+}
+
+void connection_record_upstream_drop(connection_t *c, size_t len)
+{
+  if (!c || len == 0)
+    return;
+
+  connection_record_drop(c, len);
+  connection_report_queue(c);
+}
+
 /* Handle /playlist.m3u request - serve transformed M3U playlist */
 static void handle_playlist_request(connection_t *c)
 {
@@ -1056,6 +1245,7 @@ static void handle_epg_request(connection_t *c)
   if (dup_fd < 0)
   {
     logger(LOG_ERROR, "Failed to dup EPG fd for zero-copy transmission: %s", strerror(errno));
+    c->state = CONN_CLOSING; /* Headers already promised a body */
     return;
   }
 
@@ -1064,6 +1254,7 @@ static void handle_epg_request(connection_t *c)
   {
     logger(LOG_ERROR, "Failed to queue EPG file for zero-copy transmission");
     close(dup_fd);
+    c->state = CONN_CLOSING;
     return;
   }
 }
@@ -16,6 +16,8 @@ typedef enum
   CONN_ROUTE,
   CONN_SSE,
   CONN_STREAMING,
+  CONN_SNAPSHOT_WAIT, /* Waiting for another client's snapshot capture */
+  CONN_THUMBNAILS,    /* Batch thumbnail request running */
   CONN_CLOSING
 } conn_state_t;
 
@@ -34,8 +36,8 @@ typedef struct connection_s
   int fd;
   int epfd;
   conn_state_t state;
-  /* input parsing */
-  char inbuf[INBUF_SIZE];
+  /* input parsing (slab allocated, released once the connection streams) */
+  char *inbuf;
   int in_len;
   /* zero-copy send queue - all output goes through this */
   zerocopy_queue_t zc_queue;
@@ -43,10 +45,22 @@ typedef struct connection_s
   connection_buffer_class_t buffer_class;
   /* HTTP request parser */
   http_request_t http_req;
+  /* persistent connection (control routes only) */
+  int keepalive;             /* Current response keeps the connection open */
+  uint32_t requests_served;  /* Requests completed on this connection */
+  int64_t last_activity_ms;  /* Last request or input, for the idle timeout */
+  int handed_off;            /* Adopted from another worker (never passed on again) */
   /* service/stream */
   service_t *service;
   stream_context_t stream;
   int streaming;
+  /* snapshot cache: capture this connection waits for */
+  struct snapshot_cache_entry_s *snapshot_wait;
+  struct connection_s *snapshot_wait_next;
+  /* batch thumbnails: batch this connection receives */
+  struct thumbnail_batch_s *thumbnail_batch;
+  /* catch-up served from a local time-shift ring */
+  struct timeshift_reader_s *timeshift_reader;
   /* SSE */
   int sse_active;
   int64_t next_sse_ts; /* Next SSE heartbeat time in milliseconds */
@@ -58,10 +72,9 @@ typedef struct connection_s
   /* client address for status tracking (only used for streaming clients) */
   struct sockaddr_storage client_addr;
   socklen_t client_addr_len;
-  /* linkage */
+  /* linkage (worker connection list) */
   struct connection_s *next;
-  struct connection_s *write_queue_next;
-  int write_queue_pending;
+  struct connection_s *prev;
 
   /* Backpressure and monitoring */
   size_t queue_limit_bytes;
@@ -113,6 +126,22 @@ void connection_handle_read(connection_t *c);
  */
 connection_write_status_t connection_handle_write(connection_t *c);
 
+/**
+ * Memory held by a connection: the structure itself plus its request
+ * buffer and lazily allocated stream sessions (queued media excluded)
+ * @param c Connection
+ * @return Bytes
+ */
+size_t connection_memory_footprint(const connection_t *c);
+
+/**
+ * Close a persistent connection that has been idle for too long
+ * @param c Connection
+ * @param now_ms Current time in milliseconds
+ * @return 1 if the connection should be closed, 0 otherwise
+ */
+int connection_keepalive_expired(connection_t *c, int64_t now_ms);
+
 /**
  * Route HTTP request and start appropriate handler
  * @param c Connection
@@ -182,4 +211,22 @@ int connection_queue_zerocopy(connection_t *c, buffer_ref_t *buf_ref);
  */
 int connection_queue_file(connection_t *c, int file_fd, off_t file_offset, size_t file_size);
 
+/**
+ * Queue bytes already written into a pipe for send using splice()
+ * The caller keeps ownership of the pipe (the queue holds its own duplicate)
+ * @param c Connection
+ * @param pipe_fd Read end of the pipe
+ * @param len Number of bytes written into the pipe
+ * @return 0 on success, -1 on error
+ */
+int connection_queue_pipe(connection_t *c, int pipe_fd, size_t len);
+
+/**
+ * Account media dropped for this client before it reached the send queue
+ * (e.g. passthrough pipe full), reported like queue backpressure drops
+ * @param c Connection
+ * @param len Number of bytes dropped
+ */
+void connection_record_upstream_drop(connection_t *c, size_t len);
+
 #endif /* CONNECTION_H */
@@ -293,7 +293,7 @@ int fcc_session_set_state(fcc_session_t *fcc, fcc_state_t new_state, const char
  */
 int fcc_initialize_and_request(stream_context_t *ctx)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
     service_t *service = ctx->service;
     struct sockaddr_in sin;
     socklen_t slen;
@@ -305,7 +305,7 @@ int fcc_initialize_and_request(stream_context_t *ctx)
     if (!fcc->fcc_sock)
     {
         /* Create and configure FCC socket */
-        fcc->fcc_sock = socket(AF_INET, service->fcc_addr->ai_socktype, service->fcc_addr->ai_protocol);
+        fcc->fcc_sock = socket(AF_INET, service->fcc_addr->ai_socktype | SOCK_CLOEXEC, service->fcc_addr->ai_protocol);
         if (fcc->fcc_sock < 0)
         {
             logger(LOG_ERROR, "FCC: Failed to create socket: %s", strerror(errno));
@@ -385,7 +385,7 @@ int fcc_initialize_and_request(stream_context_t *ctx)
 int fcc_handle_server_response(stream_context_t *ctx, uint8_t *buf, int buf_len,
                                struct sockaddr_in *peer_addr)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
 
     if (fcc->state != FCC_STATE_REQUESTED)
         return 0;
@@ -413,7 +413,7 @@ int fcc_handle_server_response(stream_context_t *ctx, uint8_t *buf, int buf_len,
         {
             logger(LOG_DEBUG, "FCC: Server response error code: %u, falling back to multicast", result_code);
             fcc_session_set_state(fcc, FCC_STATE_MCAST_ACTIVE, "Fallback to multicast join");
-            ctx->mcast_sock = stream_join_mcast_group(ctx);
+            stream_join_mcast_group(ctx);
             return 0;
         }
 
@@ -451,7 +451,7 @@ int fcc_handle_server_response(stream_context_t *ctx, uint8_t *buf, int buf_len,
             {
                 logger(LOG_WARN, "FCC: Too many redirects (%d), falling back to multicast", fcc->redirect_count);
                 fcc_session_set_state(fcc, FCC_STATE_MCAST_ACTIVE, "Too many redirects");
-                ctx->mcast_sock = stream_join_mcast_group(ctx);
+                stream_join_mcast_group(ctx);
                 return 0;
             }
             logger(LOG_INFO, "FCC: Server requests redirection to new server %s:%u (redirect #%d)",
@@ -464,7 +464,7 @@ int fcc_handle_server_response(stream_context_t *ctx, uint8_t *buf, int buf_len,
             /* Join multicast immediately */
             logger(LOG_DEBUG, "FCC: Server requests immediate multicast join, code: %u", action_code);
             fcc_session_set_state(fcc, FCC_STATE_MCAST_ACTIVE, "Immediate multicast join");
-            ctx->mcast_sock = stream_join_mcast_group(ctx);
+            stream_join_mcast_group(ctx);
             return 0;
         }
         else
@@ -496,7 +496,7 @@ int fcc_handle_server_response(stream_context_t *ctx, uint8_t *buf, int buf_len,
  */
 int fcc_handle_sync_notification(stream_context_t *ctx, int timeout_ms)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
 
     // Ignore if already using mcast stream
     if (fcc->state == FCC_STATE_MCAST_REQUESTED || fcc->state == FCC_STATE_MCAST_ACTIVE)
@@ -512,7 +512,7 @@ int fcc_handle_sync_notification(stream_context_t *ctx, int timeout_ms)
     }
     fcc_session_set_state(fcc, FCC_STATE_MCAST_REQUESTED, timeout_ms ? "Sync notification timeout" : "Sync notification received");
 
-    ctx->mcast_sock = stream_join_mcast_group(ctx);
+    stream_join_mcast_group(ctx);
 
     return 0; /* Signal to join multicast */
 }
@@ -522,7 +522,7 @@ int fcc_handle_sync_notification(stream_context_t *ctx, int timeout_ms)
  */
 int fcc_handle_unicast_media(stream_context_t *ctx, buffer_ref_t *buf_ref)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
 
     /* Drop unicast packets if we've already switched to multicast */
     if (fcc->state == FCC_STATE_MCAST_ACTIVE)
@@ -585,7 +585,7 @@ static int fcc_send_term_packet(fcc_session_t *fcc, service_t *service,
  */
 static int fcc_send_termination_message(stream_context_t *ctx, uint16_t mcast_seqn)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
 
     if (!fcc->fcc_term_sent)
     {
@@ -609,7 +609,7 @@ static int fcc_send_termination_message(stream_context_t *ctx, uint16_t mcast_se
  */
 int fcc_handle_mcast_transition(stream_context_t *ctx, buffer_ref_t *buf_ref)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
     int payloadlength;
     uint8_t *payload;
     uint16_t seqn = 0;
@@ -652,7 +652,7 @@ int fcc_handle_mcast_transition(stream_context_t *ctx, buffer_ref_t *buf_ref)
  */
 int fcc_handle_mcast_active(stream_context_t *ctx, buffer_ref_t *buf_ref)
 {
-    fcc_session_t *fcc = &ctx->fcc;
+    fcc_session_t *fcc = ctx->fcc;
 
     /* Flush pending buffer chain first if available - TRUE ZERO-COPY */
     if (unlikely(fcc->pending_list_head != NULL))
@@ -0,0 +1,73 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include "fdmap.h"
+#include "rtp2httpd.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* fd -> connection map, indexed directly by fd (fds are small and dense) */
+static connection_t **fd_map = NULL;
+static int fd_map_capacity = 0;
+
+void fdmap_init(void)
+{
+  free(fd_map);
+  fd_map_capacity = FD_MAP_INITIAL_SIZE;
+  fd_map = calloc((size_t)fd_map_capacity, sizeof(*fd_map));
+  if (!fd_map)
+  {
+    logger(LOG_ERROR, "fdmap: failed to allocate %d entries", fd_map_capacity);
+    fd_map_capacity = 0;
+  }
+}
+
+/* Grow the table to cover fd, doubling so growth is amortized O(1) */
+static int fdmap_grow(int fd)
+{
+  int capacity = fd_map_capacity > 0 ? fd_map_capacity : FD_MAP_INITIAL_SIZE;
+  while (capacity <= fd)
+    capacity *= 2;
+
+  connection_t **map = realloc(fd_map, (size_t)capacity * sizeof(*map));
+  if (!map)
+  {
+    logger(LOG_ERROR, "fdmap: failed to grow to %d entries", capacity);
+    return -1;
+  }
+  memset(map + fd_map_capacity, 0, (size_t)(capacity - fd_map_capacity) * sizeof(*map));
+  fd_map = map;
+  fd_map_capacity = capacity;
+  return 0;
+}
+
+void fdmap_set(int fd, connection_t *c)
+{
+  if (fd < 0)
+    return;
+  if (fd >= fd_map_capacity && fdmap_grow(fd) < 0)
+    return;
+  fd_map[fd] = c;
+}
+
+connection_t *fdmap_get(int fd)
+{
+  if (fd < 0 || fd >= fd_map_capacity)
+    return NULL;
+  return fd_map[fd];
+}
+
+void fdmap_del(int fd)
+{
+  if (fd < 0 || fd >= fd_map_capacity)
+    return;
+  fd_map[fd] = NULL;
+}
+
+void fdmap_free(void)
+{
+  free(fd_map);
+  fd_map = NULL;
+  fd_map_capacity = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef FDMAP_H
+#define FDMAP_H
+
+#include "connection.h"
+
+/**
+ * fd -> connection map to avoid O(N) scans
+ * Directly indexed by fd and grown on demand
+ */
+#define FD_MAP_INITIAL_SIZE 1024
+
+/**
+ * Initialize the fd map
+ */
+void fdmap_init(void);
+
+/**
+ * Set fd -> connection mapping
+ * @param fd File descriptor
+ * @param c Connection pointer
+ */
+void fdmap_set(int fd, connection_t *c);
+
+/**
+ * Get connection by fd
+ * @param fd File descriptor
+ * @return Connection pointer or NULL
+ */
+connection_t *fdmap_get(int fd);
+
+/**
+ * Delete fd from map
+ * @param fd File descriptor
+ */
+void fdmap_del(int fd);
+
+/**
+ * Free the fd map
+ */
+void fdmap_free(void);
+
+#endif /* FDMAP_H */
@@ -0,0 +1,254 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "handoff.h"
+#include "rtp2httpd.h"
+#include "status.h"
+#include "mcast_ring.h"
+
+/* Everything the adopting worker needs to route the request again */
+typedef struct
+{
+    struct sockaddr_storage client_addr;
+    socklen_t client_addr_len;
+    uint32_t requests_served;
+    http_request_t http_req;
+} handoff_msg_t;
+
+/* Per-worker socketpair: [0] is read by the worker, [1] is written by its peers */
+static int handoff_fds[STATUS_MAX_WORKERS][2];
+static int handoff_workers = 0;
+
+#define HANDOFF_STATS_INC(field)                                             \
+    do                                                                       \
+    {                                                                        \
+        if (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS) \
+            status_shared->worker_stats[worker_id].field++;                  \
+    } while (0)
+
+int handoff_init(int num_workers)
+{
+    int i;
+
+    handoff_workers = 0;
+    if (num_workers < 2)
+        return 0;
+    if (num_workers > STATUS_MAX_WORKERS)
+        num_workers = STATUS_MAX_WORKERS;
+
+    for (i = 0; i < num_workers; i++)
+    {
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, handoff_fds[i]) < 0)
+        {
+            logger(LOG_ERROR, "Handoff: socketpair failed: %s", strerror(errno));
+            while (i-- > 0)
+            {
+                close(handoff_fds[i][0]);
+                close(handoff_fds[i][1]);
+            }
+            return -1;
+        }
+        /* A busy target must not stall the sender; it serves the client itself instead */
+        fcntl(handoff_fds[i][0], F_SETFL, fcntl(handoff_fds[i][0], F_GETFL, 0) | O_NONBLOCK);
+        fcntl(handoff_fds[i][1], F_SETFL, fcntl(handoff_fds[i][1], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    handoff_workers = num_workers;
+    return 0;
+}
+
+int handoff_worker_get_fd(void)
+{
+    int i;
+
+    if (handoff_workers == 0 || worker_id < 0 || worker_id >= handoff_workers)
+        return -1;
+
+    /* Close receive ends of other workers (we only send to them) */
+    for (i = 0; i < handoff_workers; i++)
+    {
+        if (i != worker_id && handoff_fds[i][0] >= 0)
+        {
+            close(handoff_fds[i][0]);
+            handoff_fds[i][0] = -1;
+        }
+    }
+
+    return handoff_fds[worker_id][0];
+}
+
+/* 32-bit finalizer (murmur3 fmix) to spread hash ^ worker into a score */
+static uint32_t handoff_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+int handoff_target_worker(const service_t *service)
+{
+    int i, best = -1;
+    uint32_t best_score = 0;
+
+    /* Shared rings already receive each group once with clients left in place */
+    if (handoff_workers == 0 || !config.channel_affinity || !service ||
+        service->service_type != SERVICE_MRTP || mcast_ring_enabled())
+        return -1;
+
+    uint32_t hash = service_mcast_group_hash(service);
+    if (hash == 0)
+        return -1;
+
+    /* Rendezvous hashing: the highest score wins, so a channel only moves
+     * when its own winner goes away */
+    for (i = 0; i < handoff_workers; i++)
+    {
+        uint32_t score = handoff_mix(hash ^ ((uint32_t)i * 0x9e3779b9u));
+        if (best < 0 || score > best_score)
+        {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
+
+int handoff_send(connection_t *c, int target)
+{
+    handoff_msg_t msg;
+    struct msghdr mh;
+    struct iovec iov;
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr *cmsg;
+
+    if (target < 0 || target >= handoff_workers || target == worker_id || handoff_fds[target][1] < 0)
+        return -1;
+
+    memset(&msg, 0, sizeof(msg));
+    memcpy(&msg.client_addr, &c->client_addr, sizeof(msg.client_addr));
+    msg.client_addr_len = c->client_addr_len;
+    msg.requests_served = c->requests_served;
+    msg.http_req = c->http_req;
+
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+
+    memset(&mh, 0, sizeof(mh));
+    memset(&control, 0, sizeof(control));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &c->fd, sizeof(int));
+
+    if (sendmsg(handoff_fds[target][1], &mh, MSG_NOSIGNAL) < 0)
+    {
+        logger(LOG_DEBUG, "Handoff: Worker %d unavailable (%s), serving locally", target, strerror(errno));
+        return -1;
+    }
+
+    HANDOFF_STATS_INC(handoff_sent);
+    logger(LOG_DEBUG, "Handoff: Passed client to worker %d", target);
+    return 0;
+}
+
+int handoff_receive(int fd, int epfd, connection_t **out)
+{
+    handoff_msg_t msg;
+    struct msghdr mh;
+    struct iovec iov;
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct cmsghdr *cmsg;
+    int cfd = -1;
+
+    *out = NULL;
+
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = control.buf;
+    mh.msg_controllen = sizeof(control.buf);
+
+    ssize_t n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+    if (n < 0)
+    {
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
+        logger(LOG_ERROR, "Handoff: recvmsg failed: %s", strerror(errno));
+        return -1;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&mh); cmsg; cmsg = CMSG_NXTHDR(&mh, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            memcpy(&cfd, CMSG_DATA(cmsg), sizeof(int));
+    }
+
+    if (cfd < 0)
+        return 0;
+
+    if ((size_t)n != sizeof(msg) || (mh.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+        logger(LOG_ERROR, "Handoff: Malformed message (%zd bytes), dropping client", n);
+        close(cfd);
+        return 0;
+    }
+
+    connection_t *c = connection_create(cfd, epfd, &msg.client_addr, msg.client_addr_len);
+    if (!c)
+    {
+        close(cfd);
+        return 0;
+    }
+
+    c->http_req = msg.http_req;
+    c->requests_served = msg.requests_served;
+    c->handed_off = 1;
+    c->state = CONN_ROUTE;
+
+    HANDOFF_STATS_INC(handoff_received);
+    *out = c;
+    return 1;
+}
+
+void handoff_cleanup(void)
+{
+    int i;
+
+    for (i = 0; i < handoff_workers; i++)
+    {
+        if (handoff_fds[i][0] >= 0)
+            close(handoff_fds[i][0]);
+        if (handoff_fds[i][1] >= 0)
+            close(handoff_fds[i][1]);
+        handoff_fds[i][0] = handoff_fds[i][1] = -1;
+    }
+    handoff_workers = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include "connection.h"
+#include "service.h"
+
+/**
+ * Channel affinity between workers.
+ *
+ * SO_REUSEPORT spreads clients over workers at random, so viewers of one
+ * multicast channel end up in several processes that each receive the
+ * group. Once a request is parsed, the accepting worker passes the client
+ * socket (SCM_RIGHTS over a per-worker AF_UNIX socketpair) together with
+ * the parsed request to the worker that owns the channel, chosen by
+ * rendezvous hashing of the multicast group over the worker ids.
+ */
+
+/**
+ * Create one socketpair per worker. Must be called before forking.
+ * @param num_workers Number of worker processes
+ * @return 0 on success, -1 on error (handoff stays disabled)
+ */
+int handoff_init(int num_workers);
+
+/**
+ * Keep only this worker's receive end (closes the others).
+ * Must be called after forking, once worker_id is set.
+ * @return Receive fd to add to the worker's epoll, -1 if disabled
+ */
+int handoff_worker_get_fd(void);
+
+/**
+ * Pick the worker that should serve a service
+ * @param service Resolved service for the request
+ * @return Target worker id, or -1 if the request should stay local
+ */
+int handoff_target_worker(const service_t *service);
+
+/**
+ * Pass a parsed connection to another worker
+ * The caller keeps its copy of the socket and must close it on success.
+ * @param c Connection with a completely parsed request
+ * @param target Target worker id
+ * @return 0 if the target accepted the socket, -1 to serve it locally
+ */
+int handoff_send(connection_t *c, int target);
+
+/**
+ * Receive one handed-off connection
+ * @param fd Receive fd from handoff_worker_get_fd()
+ * @param epfd Worker epoll fd for the new connection
+ * @param out Set to the new connection (not yet linked or registered)
+ * @return 1 if a connection was received, 0 if none is pending, -1 on error
+ */
+int handoff_receive(int fd, int epfd, connection_t **out);
+
+/**
+ * Close the remaining socketpair ends
+ */
+void handoff_cleanup(void);
+
+#endif /* HANDOFF_H */
@@ -34,7 +34,9 @@ static const char *content_types[] = {
     "Content-Type: audio/mpeg\r\n",               /* 3 */
     "Content-Type: video/mp2t\r\n",               /* 4 */
     "Content-Type: text/event-stream\r\n",        /* 5 */
-    "Content-Type: image/jpeg\r\n"                /* 6 */
+    "Content-Type: image/jpeg\r\n",               /* 6 */
+    "Content-Type: application/json\r\n",         /* 7 */
+    "Content-Type: multipart/mixed; boundary=" HTTP_MULTIPART_BOUNDARY "\r\n" /* 8 */
 };
 
 void send_http_headers(connection_t *c, http_status_t status, content_type_t type, const char *extra_headers)
@@ -60,9 +62,19 @@ void send_http_headers(connection_t *c, http_status_t status, content_type_t typ
                         "Cache-Control: no-cache\r\n"
                         "Connection: keep-alive\r\n");
     }
+    else if (c->keepalive && extra_headers && strstr(extra_headers, "Content-Length:"))
+    {
+        /* Body is delimited, the connection can carry the next request */
+        len += snprintf(headers + len, sizeof(headers) - len,
+                        "Connection: keep-alive\r\n"
+                        "Keep-Alive: timeout=%d, max=%u\r\n",
+                        config.http_keepalive_timeout,
+                        (unsigned int)(config.http_keepalive_max - c->requests_served - 1));
+    }
     else
     {
-        /* For non-SSE responses, always close the connection (no keep-alive support) */
+        /* Body ends at connection close */
+        c->keepalive = 0;
         len += snprintf(headers + len, sizeof(headers) - len, "Connection: close\r\n");
     }
 
@@ -185,8 +197,113 @@ void http_request_init(http_request_t *req)
     req->body_len = 0;
 }
 
+/* Copy a header value into a fixed-size request field */
+static void http_copy_field(char *dst, size_t dst_size, const char *value, size_t len)
+{
+    if (len >= dst_size)
+        len = dst_size - 1;
+    memcpy(dst, value, len);
+    dst[len] = '\0';
+}
+
+/* Parse "METHOD URL HTTP/1.x" (line is NUL-terminated at line_end) */
+static void http_parse_request_line(http_request_t *req, char *line, char *line_end)
+{
+    char *sp1 = memchr(line, ' ', (size_t)(line_end - line));
+    if (!sp1)
+        return;
+    http_copy_field(req->method, sizeof(req->method), line, (size_t)(sp1 - line));
+
+    char *url = sp1 + 1;
+    char *sp2 = memchr(url, ' ', (size_t)(line_end - url));
+    if (!sp2)
+        return;
+    http_copy_field(req->url, sizeof(req->url), url, (size_t)(sp2 - url));
+
+    /* HTTP/1.1 and later default to persistent connections */
+    const char *version = sp2 + 1;
+    req->keepalive = (strncmp(version, "HTTP/1.", 7) == 0 && version[7] >= '1' && version[7] <= '9') ||
+                     (strncmp(version, "HTTP/", 5) == 0 && version[5] >= '2' && version[5] <= '9');
+}
+
+/* Parse "Name: Value" and extract the headers we care about */
+static void http_parse_header_line(http_request_t *req, char *line, char *line_end)
+{
+    char *colon = memchr(line, ':', (size_t)(line_end - line));
+    if (!colon)
+        return;
+    *colon = '\0';
+
+    /* Skip leading and trailing whitespace */
+    char *value = colon + 1;
+    while (value < line_end && (*value == ' ' || *value == '\t'))
+        value++;
+    char *value_end = line_end;
+    while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+        value_end--;
+    *value_end = '\0';
+    size_t value_len = (size_t)(value_end - value);
+
+    if (strcasecmp(line, "Host") == 0)
+    {
+        http_copy_field(req->hostname, sizeof(req->hostname), value, value_len);
+    }
+    else if (strcasecmp(line, "User-Agent") == 0)
+    {
+        http_copy_field(req->user_agent, sizeof(req->user_agent), value, value_len);
+    }
+    else if (strcasecmp(line, "Accept") == 0)
+    {
+        http_copy_field(req->accept, sizeof(req->accept), value, value_len);
+    }
+    else if (strcasecmp(line, "If-None-Match") == 0)
+    {
+        http_copy_field(req->if_none_match, sizeof(req->if_none_match), value, value_len);
+    }
+    else if (strcasecmp(line, "X-Request-Snapshot") == 0)
+    {
+        req->x_request_snapshot = (value[0] == '1');
+    }
+    else if (strcasecmp(line, "X-Forwarded-For") == 0)
+    {
+        /* Extract first IP from X-Forwarded-For (format: "ip1, ip2, ip3") */
+        const char *comma = memchr(value, ',', value_len);
+        size_t ip_len = comma ? (size_t)(comma - value) : value_len;
+
+        /* Trim trailing whitespace */
+        while (ip_len > 0 && (value[ip_len - 1] == ' ' || value[ip_len - 1] == '\t'))
+            ip_len--;
+        http_copy_field(req->x_forwarded_for, sizeof(req->x_forwarded_for), value, ip_len);
+    }
+    else if (strcasecmp(line, "Content-Length") == 0)
+    {
+        req->content_length = atoi(value);
+    }
+    else if (strcasecmp(line, "Connection") == 0)
+    {
+        if (strcasestr(value, "close"))
+            req->keepalive = 0;
+        else if (strcasestr(value, "keep-alive"))
+            req->keepalive = 1;
+    }
+}
+
+/* Drop the parsed request from inbuf, keeping any pipelined bytes */
+static void http_request_consume(char *inbuf, int *in_len, http_request_t *req)
+{
+    int rest = *in_len - req->parse_offset;
+    if (rest > 0)
+        memmove(inbuf, inbuf + req->parse_offset, (size_t)rest);
+    *in_len = rest > 0 ? rest : 0;
+    req->parse_offset = 0;
+    req->scan_offset = 0;
+}
+
 /**
  * Parse HTTP request from buffer (incremental parsing)
+ * Lines are located with memchr() (vectorized in libc) starting where the
+ * previous call stopped, so every byte is scanned once and nothing is
+ * shifted until the request is complete.
  * Returns: 0 = need more data, 1 = request complete, -1 = parse error
  */
 int http_parse_request(char *inbuf, int *in_len, http_request_t *req)
@@ -194,154 +311,51 @@ int http_parse_request(char *inbuf, int *in_len, http_request_t *req)
     if (!inbuf || !in_len || !req)
         return -1;
 
-    /* Parse HTTP request line */
-    if (req->parse_state == HTTP_PARSE_REQ_LINE)
+    if (req->parse_offset > *in_len || req->scan_offset > *in_len)
+        return -1;
+
+    while (req->parse_state == HTTP_PARSE_REQ_LINE || req->parse_state == HTTP_PARSE_HEADERS)
     {
-        char *line_end = strstr(inbuf, "\r\n");
-        if (!line_end)
+        char *nl = memchr(inbuf + req->scan_offset, '\n', (size_t)(*in_len - req->scan_offset));
+        if (!nl)
+        {
+            req->scan_offset = *in_len;
             return 0; /* Need more data */
+        }
 
-        size_t line_len = (size_t)(line_end - inbuf) + 2;
+        /* Line is [line, line_end), accept CRLF and bare LF */
+        char *line = inbuf + req->parse_offset;
+        char *line_end = nl;
+        if (line_end > line && line_end[-1] == '\r')
+            line_end--;
         *line_end = '\0';
+        req->parse_offset = req->scan_offset = (int)(nl - inbuf) + 1;
 
-        /* Parse: METHOD URL HTTP/1.x */
-        char *sp1 = strchr(inbuf, ' ');
-        if (sp1)
+        if (req->parse_state == HTTP_PARSE_REQ_LINE)
         {
-            *sp1 = '\0';
-            strncpy(req->method, inbuf, sizeof(req->method) - 1);
-            req->method[sizeof(req->method) - 1] = '\0';
-
-            char *sp2 = strchr(sp1 + 1, ' ');
-            if (sp2)
-            {
-                *sp2 = '\0';
-                strncpy(req->url, sp1 + 1, sizeof(req->url) - 1);
-                req->url[sizeof(req->url) - 1] = '\0';
-            }
+            /* Tolerate empty lines before the request line (RFC 9112 section 2.2) */
+            if (line_end == line)
+                continue;
+            http_parse_request_line(req, line, line_end);
+            req->parse_state = HTTP_PARSE_HEADERS;
+            continue;
         }
 
-        /* Shift buffer */
-        memmove(inbuf, inbuf + line_len, *in_len - (int)line_len);
-        *in_len -= (int)line_len;
-        req->parse_state = HTTP_PARSE_HEADERS;
-    }
-
-    /* Parse headers */
-    if (req->parse_state == HTTP_PARSE_HEADERS)
-    {
-        for (;;)
+        /* Empty line = end of headers */
+        if (line_end == line)
         {
-            char *line_end = strstr(inbuf, "\r\n");
-            if (!line_end)
-                return 0; /* Need more data */
-
-            size_t line_len = (size_t)(line_end - inbuf) + 2;
-
-            /* Empty line = end of headers */
-            if (line_len == 2)
-            {
-                memmove(inbuf, inbuf + 2, *in_len - 2);
-                *in_len -= 2;
-
-                /* Check if we need to read body */
-                if (req->content_length > 0)
-                {
-                    req->parse_state = HTTP_PARSE_BODY;
-                    break; /* Exit header parsing loop to read body */
-                }
-                else
-                {
-                    req->parse_state = HTTP_PARSE_COMPLETE;
-                    return 1; /* Request complete */
-                }
-            }
-
-            *line_end = '\0';
-
-            /* Parse header: Name: Value */
-            char *colon = strchr(inbuf, ':');
-            if (colon)
+            /* Check if we need to read body */
+            if (req->content_length > 0)
             {
-                *colon = '\0';
-                char *value = colon + 1;
-                /* Skip leading whitespace */
-                while (*value == ' ' || *value == '\t')
-                    value++;
-
-                /* Trim trailing whitespace */
-                char *value_end = value + strlen(value);
-                while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
-                {
-                    value_end--;
-                    *value_end = '\0';
-                }
-
-                /* Extract interesting headers */
-                if (strcasecmp(inbuf, "Host") == 0)
-                {
-                    strncpy(req->hostname, value, sizeof(req->hostname) - 1);
-                    req->hostname[sizeof(req->hostname) - 1] = '\0';
-                }
-                else if (strcasecmp(inbuf, "User-Agent") == 0)
-                {
-                    strncpy(req->user_agent, value, sizeof(req->user_agent) - 1);
-                    req->user_agent[sizeof(req->user_agent) - 1] = '\0';
-                }
-                else if (strcasecmp(inbuf, "Accept") == 0)
-                {
-                    strncpy(req->accept, value, sizeof(req->accept) - 1);
-                    req->accept[sizeof(req->accept) - 1] = '\0';
-                }
-                else if (strcasecmp(inbuf, "If-None-Match") == 0)
-                {
-                    strncpy(req->if_none_match, value, sizeof(req->if_none_match) - 1);
-                    req->if_none_match[sizeof(req->if_none_match) - 1] = '\0';
-                }
-                else if (strcasecmp(inbuf, "X-Request-Snapshot") == 0)
-                {
-                    req->x_request_snapshot = (value[0] == '1');
-                }
-                else if (strcasecmp(inbuf, "X-Forwarded-For") == 0)
-                {
-                    /* Extract first IP from X-Forwarded-For (format: "ip1, ip2, ip3") */
-                    const char *comma = strchr(value, ',');
-                    size_t ip_len;
-                    if (comma)
-                    {
-                        ip_len = (size_t)(comma - value);
-                    }
-                    else
-                    {
-                        ip_len = strlen(value);
-                    }
-
-                    /* Copy first IP, limiting to buffer size */
-                    if (ip_len >= sizeof(req->x_forwarded_for))
-                    {
-                        ip_len = sizeof(req->x_forwarded_for) - 1;
-                    }
-                    strncpy(req->x_forwarded_for, value, ip_len);
-                    req->x_forwarded_for[ip_len] = '\0';
-
-                    /* Trim trailing whitespace */
-                    char *end = req->x_forwarded_for + ip_len;
-                    while (end > req->x_forwarded_for && (end[-1] == ' ' || end[-1] == '\t'))
-                    {
-                        end--;
-                        *end = '\0';
-                    }
-                }
-                else if (strcasecmp(inbuf, "Content-Length") == 0)
-                {
-                    req->content_length = atoi(value);
-                }
+                req->parse_state = HTTP_PARSE_BODY;
+                break;
             }
-
-            /* Shift buffer */
-            memmove(inbuf, inbuf + line_len, *in_len - (int)line_len);
-            *in_len -= (int)line_len;
+            req->parse_state = HTTP_PARSE_COMPLETE;
+            http_request_consume(inbuf, in_len, req);
+            return 1; /* Request complete */
         }
+
+        http_parse_header_line(req, line, line_end);
     }
 
     /* Parse body if needed */
@@ -349,26 +363,22 @@ int http_parse_request(char *inbuf, int *in_len, http_request_t *req)
     {
         int body_size = req->content_length;
         if (body_size > (int)sizeof(req->body) - 1)
+        {
             body_size = (int)sizeof(req->body) - 1; /* Truncate if too large */
+            req->keepalive = 0;                      /* Unread body would be taken as the next request */
+        }
 
-        if (*in_len >= body_size)
-        {
-            /* We have the full body */
-            memcpy(req->body, inbuf, body_size);
-            req->body[body_size] = '\0';
-            req->body_len = body_size;
+        if (*in_len - req->parse_offset < body_size)
+            return 0; /* Need more data */
 
-            /* Shift buffer */
-            memmove(inbuf, inbuf + body_size, *in_len - body_size);
-            *in_len -= body_size;
+        memcpy(req->body, inbuf + req->parse_offset, (size_t)body_size);
+        req->body[body_size] = '\0';
+        req->body_len = body_size;
+        req->parse_offset += body_size;
 
-            req->parse_state = HTTP_PARSE_COMPLETE;
-            return 1; /* Request complete */
-        }
-        else
-        {
-            return 0; /* Need more data */
-        }
+        req->parse_state = HTTP_PARSE_COMPLETE;
+        http_request_consume(inbuf, in_len, req);
+        return 1; /* Request complete */
     }
 
     return 0;
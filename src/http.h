@@ -30,9 +30,14 @@ typedef enum
   CONTENT_MPEGA = 3,
   CONTENT_MP2T = 4,
   CONTENT_SSE = 5,
-  CONTENT_JPEG = 6
+  CONTENT_JPEG = 6,
+  CONTENT_JSON = 7,
+  CONTENT_MULTIPART = 8
 } content_type_t;
 
+/* Part boundary of CONTENT_MULTIPART responses */
+#define HTTP_MULTIPART_BOUNDARY "rtp2httpd-thumbnail"
+
 /* HTTP request parsing state */
 typedef enum
 {
@@ -53,7 +58,10 @@ typedef struct
   char if_none_match[256];
   char x_forwarded_for[64];
   int x_request_snapshot;
+  int keepalive; /* Client allows a persistent connection (HTTP/1.1 default or Connection: keep-alive) */
   http_parse_state_t parse_state;
+  int parse_offset; /* Start of the first unparsed line in the input buffer */
+  int scan_offset;  /* Where the search for the next line end resumes */
   int content_length;
   char body[1024];
   int body_len;
@@ -67,7 +75,9 @@ void http_request_init(http_request_t *req);
 
 /**
  * Parse HTTP request from buffer (incremental parsing)
- * Modifies inbuf and in_len as data is consumed.
+ * The buffer is scanned once across calls (progress is kept in req) and
+ * header lines are NUL-terminated in place. Once the request is complete
+ * it is removed from inbuf and in_len is updated.
  *
  * @param inbuf Input buffer containing HTTP request data
  * @param in_len Pointer to current buffer length (updated as data is consumed)
@@ -917,44 +917,21 @@ static int append_to_transformed_m3u(const char *str, service_source_t source)
  */
 static char *find_unique_service_name(const char *service_name)
 {
-    service_t *existing;
     int max_suffix = 0;
     char test_name[MAX_SERVICE_NAME];
     char *result = NULL;
     int base_exists = 0;
 
-    /* Check if base name exists and find max numbered suffix */
-    for (existing = services; existing != NULL; existing = existing->next)
-    {
-        if (!existing->url)
-            continue;
-
-        /* Check for exact base name match */
-        if (strcmp(existing->url, service_name) == 0)
-        {
-            base_exists = 1;
-            /* Don't modify existing service, just note that base name is taken */
-        }
-
-        /* Check for numbered variants (name/2, name/3, etc.) */
-        size_t base_len = strlen(service_name);
-        if (strncmp(existing->url, service_name, base_len) == 0 &&
-            existing->url[base_len] == '/')
-        {
-            /* Extract the suffix number */
-            const char *suffix_str = existing->url + base_len + 1;
-            char *endptr;
-            long suffix_num = strtol(suffix_str, &endptr, 10);
+    /* Check if base name exists */
+    base_exists = service_find(service_name) != NULL;
 
-            /* Valid if entire remaining string is a number */
-            if (*suffix_str != '\0' && *endptr == '\0' && suffix_num > 0 && suffix_num < 1000)
-            {
-                if (suffix_num > max_suffix)
-                {
-                    max_suffix = (int)suffix_num;
-                }
-            }
-        }
+    /* Find the numbered variants (name/2, name/3, etc.), which are assigned in sequence */
+    for (int suffix_num = 2; suffix_num < 1000; suffix_num++)
+    {
+        snprintf(test_name, sizeof(test_name), "%s/%d", service_name, suffix_num);
+        if (!service_find(test_name))
+            break;
+        max_suffix = suffix_num;
     }
 
     /* If no conflicts, use base name as-is */
@@ -981,7 +958,6 @@ static char *create_service_from_url(const char *service_name, const char *url,
     char normalized_url[MAX_URL_LENGTH];
     char extracted_url[MAX_URL_LENGTH];
     service_t *new_service = NULL;
-    service_t **services_tail;
     char *unique_name = NULL;
 
     strncpy(normalized_url, url, sizeof(normalized_url) - 1);
@@ -1046,14 +1022,8 @@ static char *create_service_from_url(const char *service_name, const char *url,
     /* Set service source */
     new_service->source = source;
 
-    /* Add to global services list */
-    services_tail = &services;
-    while (*services_tail != NULL)
-    {
-        services_tail = &(*services_tail)->next;
-    }
-    *services_tail = new_service;
-    new_service->next = NULL;
+    /* Add to global services list (and its name index) */
+    service_register(new_service);
 
     logger(LOG_INFO, "Service created: %s (%s) [%s]", unique_name,
            new_service->service_type == SERVICE_MRTP ? "RTP" : "RTSP",
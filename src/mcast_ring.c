@@ -0,0 +1,392 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include "mcast_ring.h"
+#include "rtp2httpd.h"
+#include "status.h"
+
+typedef struct
+{
+    uint64_t seq; /* Sequence stored here, UINT64_MAX while being rewritten */
+    uint32_t len;
+    uint32_t reserved;
+    uint8_t data[MCAST_RING_PACKET_SIZE];
+} mcast_ring_packet_t;
+
+typedef struct
+{
+    /* Directory entry, protected by the region lock */
+    int in_use;
+    int owner;             /* Ingest worker id, -1 if none */
+    pid_t owner_pid;
+    uint32_t readers_mask; /* Workers reading this ring */
+    uint32_t key_len;
+    uint8_t key[MCAST_RING_KEY_SIZE];
+
+    /* Data path, lock-free */
+    uint64_t head __attribute__((aligned(64))); /* Next sequence to write */
+    uint32_t wakeup_mask;                       /* Readers waiting for the next packet */
+    mcast_ring_packet_t packets[MCAST_RING_PACKETS] __attribute__((aligned(64)));
+} mcast_ring_slot_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    mcast_ring_slot_t slots[MCAST_RING_SLOTS];
+} mcast_ring_region_t;
+
+static mcast_ring_region_t *ring_region = NULL;
+static int ring_wakeup_fds[STATUS_MAX_WORKERS];
+static int ring_workers = 0;
+
+int mcast_ring_init(int num_workers)
+{
+    int fd = -1;
+    int i;
+
+    if (num_workers < 2)
+        return 0;
+    if (num_workers > STATUS_MAX_WORKERS)
+        num_workers = STATUS_MAX_WORKERS;
+
+#ifdef HAVE_MEMFD_CREATE
+    fd = memfd_create("rtp2httpd-mcast-ring", MFD_CLOEXEC);
+    if (fd < 0 || ftruncate(fd, sizeof(mcast_ring_region_t)) < 0)
+    {
+        logger(LOG_ERROR, "Multicast ring: memfd setup failed: %s", strerror(errno));
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    ring_region = mmap(NULL, sizeof(mcast_ring_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+#else
+    ring_region = mmap(NULL, sizeof(mcast_ring_region_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+#endif
+    if (ring_region == MAP_FAILED)
+    {
+        logger(LOG_ERROR, "Multicast ring: mmap failed: %s", strerror(errno));
+        ring_region = NULL;
+        return -1;
+    }
+
+    /* Pages are zero-filled on first touch, so idle rings cost no memory */
+    for (i = 0; i < MCAST_RING_SLOTS; i++)
+        ring_region->slots[i].owner = -1;
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&ring_region->lock, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    for (i = 0; i < num_workers; i++)
+    {
+        ring_wakeup_fds[i] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (ring_wakeup_fds[i] < 0)
+        {
+            logger(LOG_ERROR, "Multicast ring: eventfd failed: %s", strerror(errno));
+            while (i-- > 0)
+                close(ring_wakeup_fds[i]);
+            munmap(ring_region, sizeof(mcast_ring_region_t));
+            ring_region = NULL;
+            return -1;
+        }
+    }
+
+    ring_workers = num_workers;
+    logger(LOG_INFO, "Multicast ring: %d shared rings of %d packets", MCAST_RING_SLOTS, MCAST_RING_PACKETS);
+    return 0;
+}
+
+int mcast_ring_enabled(void)
+{
+    return ring_region != NULL && worker_id >= 0 && worker_id < ring_workers;
+}
+
+int mcast_ring_wakeup_fd(void)
+{
+    return mcast_ring_enabled() ? ring_wakeup_fds[worker_id] : -1;
+}
+
+void mcast_ring_ack_wakeup(void)
+{
+    eventfd_t value;
+
+    if (mcast_ring_enabled())
+        (void)eventfd_read(ring_wakeup_fds[worker_id], &value);
+}
+
+/* The directory lock survives a worker dying while holding it */
+static void mcast_ring_lock(void)
+{
+    if (pthread_mutex_lock(&ring_region->lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&ring_region->lock);
+}
+
+static int mcast_ring_make_key(const service_t *service, uint8_t *key, uint32_t *key_len)
+{
+    size_t len = service->addr->ai_addrlen;
+    size_t src_len = service->msrc_addr ? service->msrc_addr->ai_addrlen : 0;
+
+    if (len + src_len > MCAST_RING_KEY_SIZE)
+        return -1;
+
+    memset(key, 0, MCAST_RING_KEY_SIZE);
+    memcpy(key, service->addr->ai_addr, len);
+    if (src_len)
+        memcpy(key + len, service->msrc_addr->ai_addr, src_len);
+    *key_len = (uint32_t)(len + src_len);
+    return 0;
+}
+
+static int mcast_ring_owner_alive(const mcast_ring_slot_t *slot)
+{
+    if (slot->owner < 0 || slot->owner_pid <= 0)
+        return 0;
+    return kill(slot->owner_pid, 0) == 0 || errno == EPERM;
+}
+
+static void mcast_ring_set_owner(mcast_ring_slot_t *slot)
+{
+    slot->owner = worker_id;
+    slot->owner_pid = getpid();
+    slot->readers_mask &= ~(1u << worker_id);
+}
+
+int mcast_ring_attach(const service_t *service, int *is_owner)
+{
+    uint8_t key[MCAST_RING_KEY_SIZE];
+    uint32_t key_len;
+    int i, slot = -1, free_slot = -1;
+
+    *is_owner = 1;
+    if (!mcast_ring_enabled() || !service || !service->addr ||
+        mcast_ring_make_key(service, key, &key_len) != 0)
+        return -1;
+
+    mcast_ring_lock();
+    for (i = 0; i < MCAST_RING_SLOTS; i++)
+    {
+        mcast_ring_slot_t *s = &ring_region->slots[i];
+        if (!s->in_use)
+        {
+            if (free_slot < 0)
+                free_slot = i;
+            continue;
+        }
+        if (s->key_len == key_len && memcmp(s->key, key, key_len) == 0)
+        {
+            slot = i;
+            break;
+        }
+    }
+
+    if (slot >= 0)
+    {
+        mcast_ring_slot_t *s = &ring_region->slots[slot];
+        if (mcast_ring_owner_alive(s) && s->owner != worker_id)
+        {
+            s->readers_mask |= 1u << worker_id;
+            *is_owner = 0;
+        }
+        else
+        {
+            mcast_ring_set_owner(s);
+        }
+    }
+    else if (free_slot >= 0)
+    {
+        /* The head keeps counting across reuse so stale packets never match */
+        mcast_ring_slot_t *s = &ring_region->slots[free_slot];
+        s->in_use = 1;
+        s->readers_mask = 0;
+        s->key_len = key_len;
+        memcpy(s->key, key, sizeof(key));
+        mcast_ring_set_owner(s);
+        slot = free_slot;
+    }
+    pthread_mutex_unlock(&ring_region->lock);
+
+    if (slot < 0)
+        logger(LOG_WARN, "Multicast ring: All %d rings in use, receiving group locally", MCAST_RING_SLOTS);
+    return slot;
+}
+
+void mcast_ring_detach(int slot, int is_owner)
+{
+    if (!mcast_ring_enabled() || slot < 0 || slot >= MCAST_RING_SLOTS)
+        return;
+
+    mcast_ring_slot_t *s = &ring_region->slots[slot];
+    mcast_ring_lock();
+    if (is_owner)
+    {
+        if (s->owner == worker_id)
+        {
+            s->owner = -1;
+            s->owner_pid = 0;
+        }
+    }
+    else
+    {
+        s->readers_mask &= ~(1u << worker_id);
+        __atomic_and_fetch(&s->wakeup_mask, ~(1u << worker_id), __ATOMIC_SEQ_CST);
+    }
+    if (s->owner < 0 && s->readers_mask == 0)
+        s->in_use = 0;
+    pthread_mutex_unlock(&ring_region->lock);
+}
+
+int mcast_ring_claim(int slot)
+{
+    int claimed = 0;
+
+    if (!mcast_ring_enabled() || slot < 0 || slot >= MCAST_RING_SLOTS)
+        return 0;
+
+    mcast_ring_slot_t *s = &ring_region->slots[slot];
+    mcast_ring_lock();
+    if (s->in_use && !mcast_ring_owner_alive(s))
+    {
+        mcast_ring_set_owner(s);
+        claimed = 1;
+    }
+    pthread_mutex_unlock(&ring_region->lock);
+    return claimed;
+}
+
+int mcast_ring_has_readers(int slot)
+{
+    int readers;
+
+    if (!mcast_ring_enabled() || slot < 0 || slot >= MCAST_RING_SLOTS)
+        return 0;
+
+    mcast_ring_lock();
+    readers = ring_region->slots[slot].readers_mask != 0;
+    pthread_mutex_unlock(&ring_region->lock);
+    return readers;
+}
+
+void mcast_ring_reset_worker(int worker)
+{
+    int i;
+
+    if (ring_region == NULL || worker < 0 || worker >= ring_workers)
+        return;
+
+    mcast_ring_lock();
+    for (i = 0; i < MCAST_RING_SLOTS; i++)
+    {
+        mcast_ring_slot_t *s = &ring_region->slots[i];
+        if (!s->in_use)
+            continue;
+
+        /* Readers of an orphaned ring take over ingest on their next tick */
+        if (s->owner == worker)
+        {
+            s->owner = -1;
+            s->owner_pid = 0;
+        }
+        s->readers_mask &= ~(1u << worker);
+        __atomic_and_fetch(&s->wakeup_mask, ~(1u << worker), __ATOMIC_SEQ_CST);
+        if (s->owner < 0 && s->readers_mask == 0)
+            s->in_use = 0;
+    }
+    pthread_mutex_unlock(&ring_region->lock);
+}
+
+void mcast_ring_write(int slot, const void *data, size_t len)
+{
+    mcast_ring_slot_t *s = &ring_region->slots[slot];
+    uint64_t seq = __atomic_load_n(&s->head, __ATOMIC_RELAXED);
+    mcast_ring_packet_t *pkt = &s->packets[seq & (MCAST_RING_PACKETS - 1)];
+
+    if (len > MCAST_RING_PACKET_SIZE)
+        len = MCAST_RING_PACKET_SIZE;
+
+    /* Seqlock-style publish: readers copying the old packet see the marker change */
+    __atomic_store_n(&pkt->seq, UINT64_MAX, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(pkt->data, data, len);
+    pkt->len = (uint32_t)len;
+    __atomic_store_n(&pkt->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&s->head, seq + 1, __ATOMIC_SEQ_CST);
+
+    uint32_t waiting = __atomic_exchange_n(&s->wakeup_mask, 0, __ATOMIC_SEQ_CST);
+    while (waiting)
+    {
+        int w = __builtin_ctz(waiting);
+        waiting &= waiting - 1;
+        if (w < ring_workers)
+            (void)eventfd_write(ring_wakeup_fds[w], 1);
+    }
+}
+
+uint64_t mcast_ring_head(int slot)
+{
+    return __atomic_load_n(&ring_region->slots[slot].head, __ATOMIC_ACQUIRE);
+}
+
+int mcast_ring_read(int slot, uint64_t *pos, void *dst, size_t *len, uint64_t *lost)
+{
+    mcast_ring_slot_t *s = &ring_region->slots[slot];
+
+    for (;;)
+    {
+        uint64_t head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+        if (*pos >= head)
+            return 0;
+
+        if (head - *pos > MCAST_RING_PACKETS)
+        {
+            /* Overrun: skip to half a ring behind the writer */
+            uint64_t resume = head - MCAST_RING_PACKETS / 2;
+            *lost += resume - *pos;
+            *pos = resume;
+        }
+
+        mcast_ring_packet_t *pkt = &s->packets[*pos & (MCAST_RING_PACKETS - 1)];
+        if (__atomic_load_n(&pkt->seq, __ATOMIC_ACQUIRE) == *pos)
+        {
+            uint32_t n = pkt->len;
+            if (n > MCAST_RING_PACKET_SIZE)
+                n = MCAST_RING_PACKET_SIZE;
+            memcpy(dst, pkt->data, n);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&pkt->seq, __ATOMIC_RELAXED) == *pos)
+            {
+                (*pos)++;
+                *len = n;
+                return 1;
+            }
+        }
+
+        /* Overwritten while we looked at it */
+        (*pos)++;
+        (*lost)++;
+    }
+}
+
+int mcast_ring_wait(int slot, uint64_t pos)
+{
+    mcast_ring_slot_t *s = &ring_region->slots[slot];
+
+    __atomic_or_fetch(&s->wakeup_mask, 1u << worker_id, __ATOMIC_SEQ_CST);
+    /* Re-check after arming so a packet written in between is not missed */
+    return __atomic_load_n(&s->head, __ATOMIC_SEQ_CST) > pos;
+}
@@ -0,0 +1,111 @@
+#ifndef MCAST_RING_H
+#define MCAST_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "service.h"
+#include "buffer_pool.h"
+
+/**
+ * Cross-worker multicast packet rings.
+ *
+ * With mcast-shared-ring enabled, the first worker that needs a multicast
+ * group becomes its ingest worker: it owns the only group socket on the
+ * host and appends every received packet to the group's ring in a shared
+ * memfd mapped by all workers before fork. Other workers with clients on
+ * that group read the ring instead of joining, so client sockets stay
+ * spread over workers while the group is received once.
+ *
+ * Each ring has a single writer (the ingest worker) and any number of
+ * readers. Readers that fall a full ring behind skip ahead. Sleeping
+ * readers are woken through a per-worker eventfd.
+ */
+
+#define MCAST_RING_SLOTS 16                          /* Groups published at once */
+#define MCAST_RING_PACKETS 1024                      /* Packets per ring (power of two) */
+#define MCAST_RING_PACKET_SIZE BUFFER_POOL_BUFFER_SIZE /* Largest packet kept */
+#define MCAST_RING_KEY_SIZE 64                       /* Group + source sockaddr bytes */
+
+/**
+ * Map the shared rings and create the wakeup eventfds. Call before fork.
+ * @param num_workers Number of worker processes
+ * @return 0 on success, -1 on error (rings stay disabled)
+ */
+int mcast_ring_init(int num_workers);
+
+/**
+ * @return 1 if shared rings are in use in this process
+ */
+int mcast_ring_enabled(void);
+
+/**
+ * This worker's wakeup eventfd, readable when a ring it waits on has data
+ * @return eventfd, -1 if rings are disabled
+ */
+int mcast_ring_wakeup_fd(void);
+
+/**
+ * Clear the wakeup eventfd after it fired
+ */
+void mcast_ring_ack_wakeup(void);
+
+/**
+ * Find or publish the ring for a multicast group
+ * @param service Multicast service
+ * @param is_owner Set to 1 if this worker must ingest the group, 0 to read
+ * @return Ring slot, or -1 if no slot is free (ingest locally without a ring)
+ */
+int mcast_ring_attach(const service_t *service, int *is_owner);
+
+/**
+ * Stop writing or reading a ring; the slot is freed with its last user
+ * @param slot Ring slot
+ * @param is_owner 1 if this worker was the ingest worker
+ */
+void mcast_ring_detach(int slot, int is_owner);
+
+/**
+ * Take over ingest of a ring whose ingest worker went away
+ * @param slot Ring slot this worker reads
+ * @return 1 if this worker is now the ingest worker, 0 otherwise
+ */
+int mcast_ring_claim(int slot);
+
+/**
+ * @return 1 if other workers still read this ring
+ */
+int mcast_ring_has_readers(int slot);
+
+/**
+ * Drop the ownership and reader marks of a worker that exited
+ * Called by the supervisor before the worker is respawned
+ * @param worker Worker id of the dead process
+ */
+void mcast_ring_reset_worker(int worker);
+
+/**
+ * Append a packet and wake sleeping readers (ingest worker only)
+ */
+void mcast_ring_write(int slot, const void *data, size_t len);
+
+/**
+ * Sequence number of the next packet to be written
+ */
+uint64_t mcast_ring_head(int slot);
+
+/**
+ * Copy the packet at *pos out of the ring and advance *pos
+ * @param dst Destination, at least MCAST_RING_PACKET_SIZE bytes
+ * @param len Set to the packet length
+ * @param lost Incremented by packets overwritten before they were read
+ * @return 1 if a packet was copied, 0 if the reader is caught up
+ */
+int mcast_ring_read(int slot, uint64_t *pos, void *dst, size_t *len, uint64_t *lost);
+
+/**
+ * Ask to be woken when packets after pos are written
+ * @return 1 if packets already arrived (keep reading), 0 if armed
+ */
+int mcast_ring_wait(int slot, uint64_t pos);
+
+#endif /* MCAST_RING_H */
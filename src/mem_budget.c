@@ -0,0 +1,252 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include "mem_budget.h"
+
+#define MEM_BUDGET_CGROUP_ROOT "/sys/fs/cgroup"
+#define MEM_BUDGET_CGROUP_V1_ROOT "/sys/fs/cgroup/memory"
+
+/* cgroup v1 reports "no limit" as a page-rounded LLONG_MAX */
+#define MEM_BUDGET_V1_UNLIMITED (1ULL << 60)
+
+typedef struct
+{
+    int version; /* 0 = no memory cgroup, 1 or 2 */
+    char root[PATH_MAX]; /* Mount point of the memory hierarchy */
+    char dir[PATH_MAX];  /* Group of this process */
+} mem_budget_cgroup_t;
+
+static int mem_budget_read_u64(const char *dir, const char *name, uint64_t *value)
+{
+    char path[PATH_MAX + 64];
+    char buf[64];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    f = fopen(path, "r");
+    if (!f)
+        return -1;
+    if (!fgets(buf, sizeof(buf), f))
+    {
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+
+    if (strncmp(buf, "max", 3) == 0)
+        *value = UINT64_MAX;
+    else
+        *value = strtoull(buf, NULL, 10);
+    return 0;
+}
+
+/* Value of a "key value" line in a stat file such as /proc/meminfo */
+static int mem_budget_read_key(const char *path, const char *key, uint64_t *value)
+{
+    char line[256];
+    size_t key_len = strlen(key);
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (strncmp(line, key, key_len) == 0 && (line[key_len] == ' ' || line[key_len] == ':'))
+        {
+            *value = strtoull(line + key_len + 1, NULL, 10);
+            fclose(f);
+            return 0;
+        }
+    }
+    fclose(f);
+    return -1;
+}
+
+/**
+ * Find the memory cgroup of this process
+ * Inside a cgroup namespace /proc/self/cgroup can name a path that does
+ * not exist under the mount; the mount root is then the process's own group.
+ */
+static void mem_budget_probe_cgroup(const char *prefix, mem_budget_cgroup_t *cg)
+{
+    char line[PATH_MAX + 64];
+    char v1_path[PATH_MAX] = "";
+    char v2_path[PATH_MAX] = "";
+    char probe[3 * PATH_MAX];
+    int have_v1 = 0, have_v2 = 0;
+    FILE *f;
+
+    cg->version = 0;
+    snprintf(probe, sizeof(probe), "%s/proc/self/cgroup", prefix);
+    f = fopen(probe, "r");
+    if (!f)
+        return;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        char *controllers = strchr(line, ':');
+        char *path = controllers ? strchr(controllers + 1, ':') : NULL;
+        if (!path)
+            continue;
+        *path++ = '\0';
+        controllers++;
+        path[strcspn(path, "\n")] = '\0';
+
+        if (controllers[0] == '\0')
+        {
+            snprintf(v2_path, sizeof(v2_path), "%s", path);
+            have_v2 = 1;
+        }
+        else
+        {
+            char *tok, *save = NULL;
+            for (tok = strtok_r(controllers, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+            {
+                if (strcmp(tok, "memory") == 0)
+                {
+                    snprintf(v1_path, sizeof(v1_path), "%s", path);
+                    have_v1 = 1;
+                }
+            }
+        }
+    }
+    fclose(f);
+
+    /* Hybrid hierarchies keep the memory controller on v1 */
+    snprintf(probe, sizeof(probe), "%s" MEM_BUDGET_CGROUP_V1_ROOT "/memory.limit_in_bytes", prefix);
+    if (have_v1 && access(probe, R_OK) == 0)
+    {
+        cg->version = 1;
+        snprintf(cg->root, sizeof(cg->root), "%s" MEM_BUDGET_CGROUP_V1_ROOT, prefix);
+        snprintf(probe, sizeof(probe), "%s%s/memory.limit_in_bytes", cg->root, v1_path);
+        if (strcmp(v1_path, "/") != 0 && access(probe, R_OK) == 0)
+            snprintf(cg->dir, sizeof(cg->dir), "%s%s", cg->root, v1_path);
+        else
+            snprintf(cg->dir, sizeof(cg->dir), "%s", cg->root);
+        return;
+    }
+
+    snprintf(probe, sizeof(probe), "%s" MEM_BUDGET_CGROUP_ROOT "/cgroup.controllers", prefix);
+    if (have_v2 && access(probe, R_OK) == 0)
+    {
+        cg->version = 2;
+        snprintf(cg->root, sizeof(cg->root), "%s" MEM_BUDGET_CGROUP_ROOT, prefix);
+        snprintf(probe, sizeof(probe), "%s%s/memory.max", cg->root, v2_path);
+        if (strcmp(v2_path, "/") != 0 && access(probe, R_OK) == 0)
+            snprintf(cg->dir, sizeof(cg->dir), "%s%s", cg->root, v2_path);
+        else
+            snprintf(cg->dir, sizeof(cg->dir), "%s", cg->root);
+    }
+}
+
+/* Smallest limit headroom of the cgroup and its ancestors, UINT64_MAX if unlimited */
+static uint64_t mem_budget_cgroup_headroom(const mem_budget_cgroup_t *cg)
+{
+    const char *limit_file = cg->version == 2 ? "memory.max" : "memory.limit_in_bytes";
+    const char *usage_file = cg->version == 2 ? "memory.current" : "memory.usage_in_bytes";
+    const char *inactive_key = cg->version == 2 ? "inactive_file" : "total_inactive_file";
+    uint64_t headroom = UINT64_MAX;
+    char dir[PATH_MAX];
+    size_t root_len = strlen(cg->root);
+
+    snprintf(dir, sizeof(dir), "%s", cg->dir);
+    for (;;)
+    {
+        uint64_t limit, usage, inactive;
+        if (mem_budget_read_u64(dir, limit_file, &limit) == 0 &&
+            limit != UINT64_MAX && limit < MEM_BUDGET_V1_UNLIMITED &&
+            mem_budget_read_u64(dir, usage_file, &usage) == 0)
+        {
+            /* Inactive page cache is reclaimed before the limit is hit */
+            char stat_path[PATH_MAX + 16];
+            snprintf(stat_path, sizeof(stat_path), "%s/memory.stat", dir);
+            if (mem_budget_read_key(stat_path, inactive_key, &inactive) == 0)
+                usage = usage > inactive ? usage - inactive : 0;
+
+            uint64_t room = limit > usage ? limit - usage : 0;
+            if (room < headroom)
+                headroom = room;
+        }
+
+        char *slash = strrchr(dir, '/');
+        if (strlen(dir) <= root_len || !slash || (size_t)(slash - dir) < root_len)
+            break;
+        *slash = '\0';
+    }
+
+    return headroom;
+}
+
+int mem_budget_available(const char *prefix, size_t *bytes)
+{
+    mem_budget_cgroup_t cg;
+    char path[PATH_MAX + 32];
+    uint64_t available = UINT64_MAX;
+    uint64_t kb;
+
+    if (!prefix)
+        prefix = "";
+
+    snprintf(path, sizeof(path), "%s/proc/meminfo", prefix);
+    if (mem_budget_read_key(path, "MemAvailable", &kb) == 0)
+        available = kb * 1024;
+
+    mem_budget_probe_cgroup(prefix, &cg);
+    if (cg.version)
+    {
+        uint64_t headroom = mem_budget_cgroup_headroom(&cg);
+        if (headroom < available)
+            available = headroom;
+    }
+
+    /* Neither MemAvailable nor a cgroup limit: unknown (a full cgroup is 0) */
+    if (available == UINT64_MAX)
+        return -1;
+
+    *bytes = available > SIZE_MAX ? SIZE_MAX : (size_t)available;
+    return 0;
+}
+
+int mem_budget_pressure(const char *prefix)
+{
+    mem_budget_cgroup_t cg;
+    char path[PATH_MAX + 32];
+    char line[256];
+    FILE *f = NULL;
+    int whole, frac;
+
+    if (!prefix)
+        prefix = "";
+
+    mem_budget_probe_cgroup(prefix, &cg);
+    if (cg.version == 2)
+    {
+        snprintf(path, sizeof(path), "%s/memory.pressure", cg.dir);
+        f = fopen(path, "r");
+    }
+    if (!f)
+    {
+        snprintf(path, sizeof(path), "%s/proc/pressure/memory", prefix);
+        f = fopen(path, "r");
+    }
+    if (!f)
+        return -1;
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "some avg10=%d.%d", &whole, &frac) == 2)
+        {
+            fclose(f);
+            return whole * 100 + frac;
+        }
+    }
+    fclose(f);
+    return -1;
+}
@@ -0,0 +1,34 @@
+#ifndef MEM_BUDGET_H
+#define MEM_BUDGET_H
+
+#include <stddef.h>
+
+/**
+ * System memory probes for automatic buffer pool sizing.
+ *
+ * Available memory is MemAvailable from /proc/meminfo, capped by the
+ * headroom (limit minus usage) of the process's memory cgroup and its
+ * ancestors (cgroup v2 memory.max, or v1 memory.limit_in_bytes).
+ * Pressure is the PSI "some avg10" of the cgroup (memory.pressure) or of
+ * the whole system (/proc/pressure/memory).
+ *
+ * Every path is read below prefix (NULL or "" for the live system), so the
+ * parsers can run against a copy of /proc and /sys/fs/cgroup.
+ */
+
+/**
+ * Memory the process can still allocate without reclaim or OOM
+ * @param prefix Root the /proc and /sys paths are read under (NULL = /)
+ * @param bytes Set to the available bytes; 0 when a cgroup is at its limit
+ * @return 0 on success, -1 if it cannot be determined
+ */
+int mem_budget_available(const char *prefix, size_t *bytes);
+
+/**
+ * Share of the last 10 seconds in which some task stalled on memory
+ * @param prefix Root the /proc and /sys paths are read under (NULL = /)
+ * @return Hundredths of a percent (0-10000), -1 if PSI is unavailable
+ */
+int mem_budget_pressure(const char *prefix);
+
+#endif /* MEM_BUDGET_H */
@@ -214,7 +214,7 @@ int join_mcast_group(service_t *service)
   int on = 1;
   const struct ifreq *upstream_if;
 
-  sock = socket(service->addr->ai_family, service->addr->ai_socktype,
+  sock = socket(service->addr->ai_family, service->addr->ai_socktype | SOCK_CLOEXEC,
                 service->addr->ai_protocol);
 
   /* Set socket to non-blocking mode for epoll */
@@ -332,7 +332,7 @@ int rejoin_mcast_group(int sock, service_t *service)
   }
 
   /* Create raw socket for IGMP */
-  raw_sock = socket(AF_INET, SOCK_RAW, IPPROTO_IGMP);
+  raw_sock = socket(AF_INET, SOCK_RAW | SOCK_CLOEXEC, IPPROTO_IGMP);
   if (raw_sock < 0)
   {
     logger(LOG_ERROR, "Failed to create raw IGMP socket: %s (need root?)", strerror(errno));
@@ -0,0 +1,301 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "rtcp.h"
+#include "rtp2httpd.h"
+
+/* MPEG-TS over RTP (PT 33) uses a 90 kHz clock */
+#define RTCP_CLOCK_RATE 90000
+
+/* Sequence number handling thresholds (RFC 3550 appendix A.1) */
+#define RTCP_MAX_DROPOUT 3000
+#define RTCP_MAX_MISORDER 100
+
+/* Seconds between 1900-01-01 (NTP epoch) and 1970-01-01 */
+#define RTCP_NTP_OFFSET 2208988800u
+
+#define RTCP_CNAME "rtp2httpd"
+
+static inline void put_be16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static inline void put_be32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* Current wall clock as a 64-bit NTP timestamp */
+static void rtcp_ntp_now(uint32_t *sec, uint32_t *frac)
+{
+  int64_t ms = get_realtime_ms();
+  *sec = (uint32_t)(ms / 1000) + RTCP_NTP_OFFSET;
+  *frac = (uint32_t)(((uint64_t)(ms % 1000) << 32) / 1000);
+}
+
+/* Middle 32 bits of the current NTP timestamp (1/65536 s units) */
+static uint32_t rtcp_ntp_mid_now(void)
+{
+  uint32_t sec, frac;
+  rtcp_ntp_now(&sec, &frac);
+  return (sec << 16) | (frac >> 16);
+}
+
+static void rtcp_update_rtt(rtcp_stats_t *stats, uint32_t lsr, uint32_t dlsr)
+{
+  if (lsr == 0)
+    return;
+
+  uint32_t rtt = rtcp_ntp_mid_now() - lsr - dlsr;
+  if (rtt & 0x80000000u)
+    return; /* Clock skew or bogus report */
+  stats->rtt_ms = (int32_t)(((uint64_t)rtt * 1000) >> 16);
+}
+
+void rtcp_stats_init(rtcp_stats_t *stats)
+{
+  struct timespec ts;
+
+  memset(stats, 0, sizeof(*stats));
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  stats->own_ssrc = (uint32_t)ts.tv_nsec ^ ((uint32_t)getpid() << 16) ^ (uint32_t)(uintptr_t)stats;
+  stats->rtt_ms = -1;
+}
+
+static void rtcp_reset_source(rtcp_stats_t *stats, uint32_t ssrc, uint16_t seq)
+{
+  stats->have_source = 1;
+  stats->ssrc = ssrc;
+  stats->base_seq = seq;
+  stats->max_seq = seq;
+  stats->cycles = 0;
+  stats->received = 0;
+  stats->expected_prior = 0;
+  stats->received_prior = 0;
+  stats->jitter = 0;
+  stats->have_transit = 0;
+}
+
+void rtcp_stats_on_rtp(rtcp_stats_t *stats, const uint8_t *buf, size_t len)
+{
+  struct timespec ts;
+
+  if (unlikely(len < 12) || unlikely((buf[0] & 0xC0) != 0x80))
+    return;
+
+  uint16_t seq = (uint16_t)((buf[2] << 8) | buf[3]);
+  uint32_t rtp_ts = get_be32(buf + 4);
+  uint32_t ssrc = get_be32(buf + 8);
+
+  if (unlikely(!stats->have_source || ssrc != stats->ssrc))
+  {
+    /* New source (e.g. FCC unicast -> multicast) */
+    rtcp_reset_source(stats, ssrc, seq);
+  }
+  else
+  {
+    uint16_t delta = (uint16_t)(seq - stats->max_seq);
+    if (delta < RTCP_MAX_DROPOUT)
+    {
+      if (seq < stats->max_seq)
+        stats->cycles += 65536;
+      stats->max_seq = seq;
+    }
+    else if (delta <= 65536 - RTCP_MAX_MISORDER)
+    {
+      /* Very large jump - the sender restarted, start over */
+      rtcp_reset_source(stats, ssrc, seq);
+    }
+    /* else duplicate or reordered packet */
+  }
+  stats->received++;
+
+  /* Interarrival jitter: J += (|D| - J) / 16 */
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  int64_t arrival = (int64_t)ts.tv_sec * RTCP_CLOCK_RATE + (int64_t)ts.tv_nsec * RTCP_CLOCK_RATE / 1000000000;
+  int64_t transit = arrival - rtp_ts;
+  if (stats->have_transit)
+  {
+    int64_t d = transit - stats->last_transit;
+    if (d < 0)
+      d = -d;
+    if (d < (int64_t)RTCP_CLOCK_RATE * 10) /* Ignore timestamp discontinuities */
+      stats->jitter += (uint32_t)d - ((stats->jitter + 8) >> 4);
+  }
+  stats->last_transit = transit;
+  stats->have_transit = 1;
+}
+
+int rtcp_stats_on_rtcp(rtcp_stats_t *stats, const uint8_t *buf, size_t len)
+{
+  int parsed = 0;
+
+  while (len >= 4)
+  {
+    if ((buf[0] & 0xC0) != 0x80)
+      break;
+
+    uint8_t count = buf[0] & 0x1F;
+    uint8_t pt = buf[1];
+    size_t plen = ((size_t)((buf[2] << 8) | buf[3]) + 1) * 4;
+    if (plen > len)
+      break;
+
+    const uint8_t *blocks = NULL;
+    if (pt == RTCP_PT_SR && plen >= 28)
+    {
+      stats->last_sr = (get_be32(buf + 8) << 16) | (get_be32(buf + 12) >> 16);
+      stats->last_sr_time_ms = get_time_ms();
+      stats->sender_packets = get_be32(buf + 20);
+      stats->sender_reports++;
+      blocks = buf + 28;
+    }
+    else if (pt == RTCP_PT_RR && plen >= 8)
+    {
+      blocks = buf + 8;
+    }
+    else if (pt == RTCP_PT_XR && plen >= 8)
+    {
+      /* Look for a DLRR block (BT=5) answering our RRTR */
+      const uint8_t *p = buf + 8;
+      while (p + 4 <= buf + plen)
+      {
+        size_t blen = ((size_t)((p[2] << 8) | p[3]) + 1) * 4;
+        if (p + blen > buf + plen)
+          break;
+        if (p[0] == 5)
+        {
+          for (const uint8_t *sub = p + 4; sub + 12 <= p + blen; sub += 12)
+          {
+            if (get_be32(sub) == stats->own_ssrc)
+              rtcp_update_rtt(stats, get_be32(sub + 4), get_be32(sub + 8));
+          }
+        }
+        p += blen;
+      }
+    }
+
+    /* Report blocks about us (only if the server also receives from us) */
+    if (blocks)
+    {
+      for (uint8_t i = 0; i < count && blocks + 24 <= buf + plen; i++, blocks += 24)
+      {
+        if (get_be32(blocks) == stats->own_ssrc)
+          rtcp_update_rtt(stats, get_be32(blocks + 16), get_be32(blocks + 20));
+      }
+    }
+
+    buf += plen;
+    len -= plen;
+    parsed++;
+  }
+
+  return parsed > 0 ? parsed : -1;
+}
+
+void rtcp_stats_summary(const rtcp_stats_t *stats, uint32_t *jitter_us, uint32_t *lost, uint32_t *expected)
+{
+  uint32_t exp = 0;
+
+  if (stats->have_source)
+    exp = stats->cycles + stats->max_seq - stats->base_seq + 1;
+
+  *expected = exp;
+  *lost = exp > stats->received ? exp - stats->received : 0;
+  *jitter_us = (uint32_t)((uint64_t)(stats->jitter >> 4) * 1000000 / RTCP_CLOCK_RATE);
+}
+
+int rtcp_build_receiver_report(rtcp_stats_t *stats, uint8_t *buf, size_t size)
+{
+  size_t pos = 0;
+  uint8_t report_count = stats->have_source ? 1 : 0;
+  size_t cname_len = strlen(RTCP_CNAME);
+  size_t sdes_len = (8 + 2 + cname_len + 1 + 3) & ~(size_t)3; /* header, item, END, padding */
+  size_t total = 8 + 24 * report_count + sdes_len + 20;
+
+  if (size < total)
+    return -1;
+  memset(buf, 0, total);
+
+  /* RR */
+  buf[0] = (uint8_t)(0x80 | report_count);
+  buf[1] = RTCP_PT_RR;
+  put_be16(buf + 2, (uint16_t)((8 + 24 * report_count) / 4 - 1));
+  put_be32(buf + 4, stats->own_ssrc);
+  pos = 8;
+
+  if (report_count)
+  {
+    uint32_t extended_max = stats->cycles + stats->max_seq;
+    uint32_t expected = extended_max - stats->base_seq + 1;
+    int64_t lost = (int64_t)expected - stats->received;
+    uint32_t expected_interval = expected - stats->expected_prior;
+    uint32_t received_interval = stats->received - stats->received_prior;
+    int64_t lost_interval = (int64_t)expected_interval - received_interval;
+
+    stats->expected_prior = expected;
+    stats->received_prior = stats->received;
+    stats->fraction_lost = (expected_interval == 0 || lost_interval <= 0)
+                               ? 0
+                               : (uint8_t)min((lost_interval << 8) / expected_interval, 255);
+
+    /* Cumulative loss is a signed 24-bit field */
+    if (lost > 0x7FFFFF)
+      lost = 0x7FFFFF;
+    else if (lost < -0x800000)
+      lost = -0x800000;
+
+    uint32_t dlsr = 0;
+    if (stats->last_sr_time_ms > 0)
+      dlsr = (uint32_t)(((uint64_t)(get_time_ms() - stats->last_sr_time_ms) << 16) / 1000);
+
+    put_be32(buf + pos, stats->ssrc);
+    put_be32(buf + pos + 4, ((uint32_t)stats->fraction_lost << 24) | ((uint32_t)lost & 0xFFFFFF));
+    put_be32(buf + pos + 8, extended_max);
+    put_be32(buf + pos + 12, stats->jitter >> 4);
+    put_be32(buf + pos + 16, stats->last_sr);
+    put_be32(buf + pos + 20, stats->last_sr ? dlsr : 0);
+    pos += 24;
+  }
+
+  /* SDES with CNAME (required in every compound packet) */
+  buf[pos] = 0x81;
+  buf[pos + 1] = RTCP_PT_SDES;
+  put_be16(buf + pos + 2, (uint16_t)(sdes_len / 4 - 1));
+  put_be32(buf + pos + 4, stats->own_ssrc);
+  buf[pos + 8] = 1; /* CNAME */
+  buf[pos + 9] = (uint8_t)cname_len;
+  memcpy(buf + pos + 10, RTCP_CNAME, cname_len);
+  pos += sdes_len; /* END item and padding are already zero */
+
+  /* XR with a Receiver Reference Time block, so the server can answer with DLRR */
+  uint32_t ntp_sec, ntp_frac;
+  rtcp_ntp_now(&ntp_sec, &ntp_frac);
+  buf[pos] = 0x80;
+  buf[pos + 1] = RTCP_PT_XR;
+  put_be16(buf + pos + 2, 4);
+  put_be32(buf + pos + 4, stats->own_ssrc);
+  buf[pos + 8] = 4; /* BT=4 RRTR */
+  put_be16(buf + pos + 10, 2);
+  put_be32(buf + pos + 12, ntp_sec);
+  put_be32(buf + pos + 16, ntp_frac);
+  pos += 20;
+
+  return (int)pos;
+}
@@ -0,0 +1,96 @@
+#ifndef __RTCP_H__
+#define __RTCP_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* RTCP packet types (RFC 3550, RFC 3611) */
+#define RTCP_PT_SR 200
+#define RTCP_PT_RR 201
+#define RTCP_PT_SDES 202
+#define RTCP_PT_BYE 203
+#define RTCP_PT_XR 207
+
+/* Interval between our receiver reports */
+#define RTCP_RR_INTERVAL_MS 5000
+
+/* Buffer large enough for one RR + SDES + XR compound packet */
+#define RTCP_RR_BUFFER_SIZE 128
+
+/**
+ * Receiver-side RTP/RTCP statistics for one upstream source (RFC 3550)
+ * Fed with every received RTP packet and every RTCP packet of a stream.
+ */
+typedef struct
+{
+  uint32_t own_ssrc; /* Our SSRC used in receiver reports */
+
+  /* RTP source state (appendix A.1) */
+  int have_source;
+  uint32_t ssrc;
+  uint16_t max_seq;
+  uint32_t cycles;
+  uint32_t base_seq;
+  uint32_t received;
+  uint32_t expected_prior;
+  uint32_t received_prior;
+  uint8_t fraction_lost; /* Fraction lost in the last report interval (1/256) */
+
+  /* Interarrival jitter (appendix A.8), in timestamp units scaled by 16 */
+  uint32_t jitter;
+  int64_t last_transit;
+  int have_transit;
+
+  /* Sender reports */
+  uint32_t last_sr;         /* Middle 32 bits of the NTP timestamp of the last SR */
+  int64_t last_sr_time_ms;  /* Local arrival time of the last SR */
+  uint32_t sender_reports;  /* SRs received */
+  uint32_t sender_packets;  /* Sender packet count from the last SR */
+
+  int32_t rtt_ms;          /* Round-trip time, -1 until known */
+  int64_t last_rr_time_ms; /* When we sent our last RR */
+} rtcp_stats_t;
+
+/**
+ * Initialize statistics with a fresh random SSRC
+ * @param stats Statistics to initialize
+ */
+void rtcp_stats_init(rtcp_stats_t *stats);
+
+/**
+ * Account a received RTP packet (non-RTP packets are ignored)
+ * @param stats Statistics
+ * @param buf Packet data (RTP header first)
+ * @param len Packet length
+ */
+void rtcp_stats_on_rtp(rtcp_stats_t *stats, const uint8_t *buf, size_t len);
+
+/**
+ * Parse a (compound) RTCP packet: sender reports and report blocks / XR
+ * DLRR addressed to us (for RTT)
+ * @param stats Statistics
+ * @param buf RTCP packet data
+ * @param len Packet length
+ * @return Number of RTCP packets parsed, -1 if not RTCP
+ */
+int rtcp_stats_on_rtcp(rtcp_stats_t *stats, const uint8_t *buf, size_t len);
+
+/**
+ * Build a compound receiver report (RR + SDES CNAME + XR RRTR)
+ * @param stats Statistics (report interval counters are advanced)
+ * @param buf Output buffer, at least RTCP_RR_BUFFER_SIZE bytes
+ * @param size Output buffer size
+ * @return Packet length, or -1 if the buffer is too small
+ */
+int rtcp_build_receiver_report(rtcp_stats_t *stats, uint8_t *buf, size_t size);
+
+/**
+ * Upstream quality summary
+ * @param stats Statistics
+ * @param jitter_us Output: interarrival jitter in microseconds (90 kHz clock)
+ * @param lost Output: cumulative packets lost
+ * @param expected Output: cumulative packets expected
+ */
+void rtcp_stats_summary(const rtcp_stats_t *stats, uint32_t *jitter_us, uint32_t *lost, uint32_t *expected);
+
+#endif /* __RTCP_H__ */
@@ -9,7 +9,6 @@
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
-#include <sys/prctl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -21,14 +20,18 @@
 #include "status.h"
 #include "worker.h"
 #include "zerocopy.h"
+#include "handoff.h"
+#include "mcast_ring.h"
+#include "affinity.h"
+#include "supervisor.h"
 
-#define MAX_S 10
+#define MAX_S SUPERVISOR_MAX_LISTENERS
 
 /* GLOBALS */
 service_t *services = NULL;
 struct bindaddr_s *bind_addresses = NULL;
 int client_count = 0;
-int worker_id = 0; /* Worker ID for this process (0-based) */
+int worker_id = -1; /* Worker ID for this process (0-based), -1 in the supervisor */
 
 /**
  * Get current monotonic time in milliseconds.
@@ -95,7 +98,10 @@ int logger(enum loglevel level, const char *format, ...)
     /* Add worker_id prefix only if multiple workers */
     if (config.workers > 1)
     {
-      prefix_len = snprintf(message, sizeof(message), "[Worker %d] ", worker_id);
+      if (worker_id < 0)
+        prefix_len = snprintf(message, sizeof(message), "[Supervisor] ");
+      else
+        prefix_len = snprintf(message, sizeof(message), "[Worker %d] ", worker_id);
     }
 
     /* Format the actual message after the prefix (if any) */
@@ -118,78 +124,20 @@ int logger(enum loglevel level, const char *format, ...)
   return r;
 }
 
-int main(int argc, char *argv[])
+/* Bind one listening socket per configured address (SO_REUSEPORT allows a set per worker) */
+static int open_listeners(int *s, int announce)
 {
   struct addrinfo hints, *res, *ai;
   struct bindaddr_s *bind_addr;
   int r;
-  int s[MAX_S];
-  int maxs, nfds;
+  int maxs;
   char hbuf[NI_MAXHOST], sbuf[NI_MAXSERV];
   const int on = 1;
-  int notif_fd = -1;
 
-  parse_cmd_line(argc, argv);
-
-  /* Initialize status tracking system (before fork, shared memory) */
-  if (status_init() != 0)
-  {
-    logger(LOG_ERROR, "Failed to initialize status tracking");
-    /* Continue anyway - status page won't work but streaming will */
-  }
-
-  /* Prefork N-1 additional workers for SO_REUSEPORT sharding (the original process is also a worker) */
-  if (config.workers > 1)
-  {
-    int k;
-    logger(LOG_INFO, "Starting %d worker threads with SO_REUSEPORT", config.workers);
-    for (k = 1; k < config.workers; k++)
-    {
-      pid_t w = fork();
-      if (w < 0)
-      {
-        logger(LOG_ERROR, "Failed to fork worker: %s", strerror(errno));
-        continue;
-      }
-      if (w == 0)
-      {
-        /* Child becomes a worker: ensure it dies when parent exits */
-        prctl(PR_SET_PDEATHSIG, SIGTERM);
-        worker_id = k; /* Assign worker ID to child */
-        break;
-      }
-    }
-    logger(LOG_INFO, "Worker started: pid=%d", (int)getpid());
-  }
-
-  /* Get notification pipe read fd for this worker (after fork)
-   * This also closes read fds for other workers to avoid fd leaks */
-  if (status_shared)
-  {
-    notif_fd = status_worker_get_notif_fd();
-    if (notif_fd < 0)
-    {
-      logger(LOG_ERROR, "Failed to get worker notification pipe");
-    }
-    if (worker_id >= 0 && worker_id < STATUS_MAX_WORKERS)
-      status_shared->worker_stats[worker_id].worker_pid = getpid();
-  }
-  else
-  {
-    logger(LOG_INFO, "Starting single worker (pid=%d)", (int)getpid());
-  }
-
-  /* Per-worker listener setup (SO_REUSEPORT allows multiple binds) */
   memset(&hints, 0, sizeof(hints));
   hints.ai_socktype = SOCK_STREAM;
   hints.ai_flags = AI_PASSIVE;
   maxs = 0;
-  nfds = -1;
-
-  if (bind_addresses == NULL)
-  {
-    bind_addresses = new_empty_bindaddr();
-  }
 
   for (bind_addr = bind_addresses; bind_addr; bind_addr = bind_addr->next)
   {
@@ -203,7 +151,7 @@ int main(int argc, char *argv[])
 
     for (ai = res; ai && maxs < MAX_S; ai = ai->ai_next)
     {
-      s[maxs] = socket(ai->ai_family, ai->ai_socktype,
+      s[maxs] = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
                        ai->ai_protocol);
       if (s[maxs] < 0)
         continue;
@@ -261,25 +209,116 @@ int main(int argc, char *argv[])
         logger(LOG_ERROR, "getnameinfo failed: %s",
                gai_strerror(r));
       }
-      else
+      else if (announce)
       {
         logger(LOG_INFO, "Listening on %s port %s",
                hbuf, sbuf);
       }
 
-      if (s[maxs] > nfds)
-        nfds = s[maxs];
       maxs++;
     }
     freeaddrinfo(res);
   }
 
-  if (maxs == 0)
+  return maxs;
+}
+
+int main(int argc, char *argv[])
+{
+  static supervisor_listeners_t listeners[STATUS_MAX_WORKERS];
+  int *s;
+  int maxs, k, i, inherited;
+  int notif_fd = -1;
+  int handoff_fd = -1;
+
+  parse_cmd_line(argc, argv);
+  if (config.workers > STATUS_MAX_WORKERS)
+    config.workers = STATUS_MAX_WORKERS;
+
+  /* Initialize status tracking system (before fork, shared memory) */
+  if (status_init() != 0)
+  {
+    logger(LOG_ERROR, "Failed to initialize status tracking");
+    /* Continue anyway - status page won't work but streaming will */
+  }
+
+  /* Channel affinity socketpairs must exist before fork so every worker can reach every other */
+  if (config.workers > 1 && config.channel_affinity && handoff_init(config.workers) != 0)
   {
-    logger(LOG_FATAL, "No socket to listen!");
-    exit(EXIT_FAILURE);
+    logger(LOG_ERROR, "Failed to set up worker handoff, channel affinity disabled");
+  }
+
+  /* Shared multicast rings are mapped before fork so every worker sees them */
+  if (config.workers > 1 && config.mcast_shared_ring && mcast_ring_init(config.workers) != 0)
+  {
+    logger(LOG_ERROR, "Failed to set up shared multicast rings, each worker receives its own groups");
   }
 
+  /* Listeners for every worker are bound here, in worker order, so that
+   * worker N owns socket N of each SO_REUSEPORT group (needed for CPU steering).
+   * After a SIGUSR2 upgrade the previous instance's sockets are reused instead. */
+  if (bind_addresses == NULL)
+  {
+    bind_addresses = new_empty_bindaddr();
+  }
+  inherited = supervisor_inherit_listeners(listeners, config.workers);
+  for (k = 0; k < config.workers; k++)
+  {
+    if (k >= inherited)
+      listeners[k].count = open_listeners(listeners[k].fds, k == 0);
+    if (listeners[k].count == 0)
+    {
+      logger(LOG_FATAL, "No socket to listen!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* Pin workers to CPUs and steer each connection to the worker on the CPU that received it */
+  if (affinity_init(config.cpu_affinity, config.workers) > 0 && config.workers > 1)
+  {
+    for (i = 0; i < listeners[0].count; i++)
+      affinity_attach_reuseport_cbpf(listeners[0].fds[i], config.workers);
+  }
+
+  /* The original process stays a supervisor; it only returns here as a worker */
+  if (supervisor_run(listeners, config.workers, argv) < 0)
+  {
+    handoff_cleanup();
+    free_bindaddr(bind_addresses);
+    status_cleanup();
+    return 0;
+  }
+  logger(LOG_INFO, "Worker started: pid=%d", (int)getpid());
+
+  /* Get notification pipe read fd for this worker (after fork)
+   * This also closes read fds for other workers to avoid fd leaks */
+  if (status_shared)
+  {
+    notif_fd = status_worker_get_notif_fd();
+    if (notif_fd < 0)
+    {
+      logger(LOG_ERROR, "Failed to get worker notification pipe");
+    }
+    if (worker_id >= 0 && worker_id < STATUS_MAX_WORKERS)
+      status_shared->worker_stats[worker_id].worker_pid = getpid();
+  }
+
+  handoff_fd = handoff_worker_get_fd();
+
+  /* Keep only this worker's listeners; the supervisor keeps all of them */
+  for (k = 0; k < config.workers; k++)
+  {
+    if (k == worker_id)
+      continue;
+    for (i = 0; i < listeners[k].count; i++)
+      close(listeners[k].fds[i]);
+  }
+  s = listeners[worker_id].fds;
+  maxs = listeners[worker_id].count;
+
+  /* Before the buffer pools are allocated, so their pages are node-local */
+  affinity_pin_worker(worker_id);
+
   /* Initialize zero-copy infrastructure for this worker (mandatory) */
   if (zerocopy_init() != 0)
   {
@@ -291,7 +330,9 @@ int main(int argc, char *argv[])
   logger(LOG_INFO, "Server initialization complete, ready to accept connections");
 
   /* Run worker event loop */
-  int result = worker_run_event_loop(s, maxs, notif_fd);
+  int result = worker_run_event_loop(s, maxs, notif_fd, handoff_fd);
+
+  handoff_cleanup();
 
   free_bindaddr(bind_addresses);
   status_cleanup();
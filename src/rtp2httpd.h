@@ -72,7 +72,14 @@ typedef struct
 
   /* Worker and performance settings */
   int workers;              /* Number of worker threads (SO_REUSEPORT sharded), default 1 */
-  int buffer_pool_max_size; /* Maximum number of buffers in zero-copy buffer pool, default 16384 */
+  int buffer_pool_max_size; /* Maximum number of buffers in zero-copy buffer pool (0=auto from memory budget), default 16384 */
+  int buffer_pool_hugepages; /* Back buffer pool segments with huge pages (0=no, 1=yes, default 0) */
+  int http_keepalive_timeout; /* Idle seconds before closing a persistent HTTP connection (0=disabled, default 15) */
+  int http_keepalive_max;     /* Max requests served on one persistent HTTP connection, default 100 */
+  int channel_affinity;       /* Hand multicast clients to the worker owning their channel (0=no, 1=yes, default 1) */
+  int mcast_shared_ring;      /* Share received multicast between workers through memfd rings (0=no, 1=yes, default 0) */
+  char *cpu_affinity;         /* CPUs to pin workers to ("auto" or list like "0,2,4-7", NULL=no pinning) */
+  int loop_stall_threshold;   /* Log event loop handlers slower than this many ms (0=disabled, default 50) */
 
   /* FCC (Fast Channel Change) settings */
   int fcc_listen_port_min; /* Minimum UDP port for FCC sockets (0=any) */
@@ -84,12 +91,24 @@ typedef struct
   struct ifreq upstream_interface_rtsp;      /* Interface for RTSP unicast media requests (overrides upstream_interface) */
   struct ifreq upstream_interface_multicast; /* Interface for upstream multicast media requests (overrides upstream_interface) */
 
+  /* RTSP settings */
+  int rtsp_warm_pool; /* Max idle pre-connected sockets per RTSP server (0=disabled, default 2) */
+
+  /* Time-shift settings */
+  char *timeshift_dir;     /* Directory for per-channel time-shift rings (NULL=disabled) */
+  int timeshift_duration;  /* Seconds of history kept per channel, default 1800 */
+  int timeshift_size_mb;   /* Ring file size per channel in MB, default 1024 */
+
   /* Multicast settings */
   int mcast_rejoin_interval; /* Periodic multicast rejoin interval in seconds (0=disabled, default 0) */
 
   /* FFmpeg settings */
   char *ffmpeg_path; /* Path to ffmpeg executable (NULL=use system default "ffmpeg") */
   char *ffmpeg_args; /* Additional ffmpeg arguments (default: "-hwaccel none") */
+  int snapshot_concurrency; /* ffmpeg conversions running at once per worker (default 2) */
+  int snapshot_cache_ttl;   /* Seconds a channel's snapshot is served from cache (0=off, default 30) */
+  int snapshot_decoders;    /* Persistent ffmpeg decoder helpers per worker (0=spawn per snapshot, default 0) */
+  int thumbnail_concurrency; /* /thumbnails captures at once per upstream interface per worker (default 8) */
 
   /* Video snapshot settings */
   int video_snapshot; /* Enable video snapshot feature (0=off, 1=on) */
@@ -6,9 +6,12 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <netdb.h>
@@ -27,6 +30,10 @@
 #include "status.h"
 #include "worker.h"
 #include "md5.h"
+#include "rtsp_pool.h"
+#include "rtsp_health.h"
+#include "rtsp_endpoint.h"
+#include "rtcp.h"
 
 /*
  * RTSP Client Implementation
@@ -37,10 +44,17 @@
 #define USER_AGENT "rtp2httpd/" VERSION
 #define RTSP_MAX_REDIRECTS 5
 #define RTSP_KEEPALIVE_INTERVAL_MS 30000
+#define RTSP_HANDSHAKE_STALL_MS 5000   /* Fail over when a handshake makes no progress for this long */
 
 #define RTSP_RESPONSE_ADVANCE 1
 #define RTSP_RESPONSE_KEEPALIVE 2
 
+#define RTSP_TS_PACKET_SIZE 188
+#define RTSP_TS_SYNC_BYTE 0x47
+
+/* rtsp_passthrough_unit(): hand the session back to the interleaved parser */
+#define RTSP_PASSTHROUGH_FALLBACK -3
+
 /* Helper function prototypes */
 static int rtsp_prepare_request(rtsp_session_t *session, const char *method, const char *extra_headers);
 static int rtsp_try_send_pending(rtsp_session_t *session);
@@ -56,10 +70,15 @@ static int rtsp_state_machine_advance(rtsp_session_t *session);
 static int rtsp_initiate_teardown(rtsp_session_t *session);
 static int rtsp_reconnect_for_teardown(rtsp_session_t *session);
 static void rtsp_force_cleanup(rtsp_session_t *session);
+static void rtsp_passthrough_close(rtsp_session_t *session);
+static int rtsp_passthrough_start(rtsp_session_t *session, connection_t *conn);
 static int rtsp_base64_encode(const uint8_t *input, size_t input_len, char *output, size_t output_size);
 static int rtsp_parse_www_authenticate(rtsp_session_t *session, const char *www_auth_header);
 static void rtsp_build_digest_response(rtsp_session_t *session, const char *method, const char *uri, char *response_out, size_t response_size);
 static int rtsp_build_basic_auth_header(rtsp_session_t *session, char *output, size_t output_size);
+static int rtsp_process_socket_event(rtsp_session_t *session, uint32_t events);
+static void rtsp_switch_endpoint(rtsp_session_t *session, int index);
+static int rtsp_failover(rtsp_session_t *session, const char *reason);
 
 static int rtsp_base64_encode(const uint8_t *input, size_t input_len, char *output, size_t output_size)
 {
@@ -291,6 +310,8 @@ void rtsp_session_init(rtsp_session_t *session)
     session->status_index = -1;
     session->rtp_socket = -1;
     session->rtcp_socket = -1;
+    session->splice_pipe[0] = -1;
+    session->splice_pipe[1] = -1;
     session->cseq = 1;
     session->server_port = 554; /* Default RTSP port */
     session->redirect_count = 0;
@@ -362,7 +383,9 @@ static void rtsp_session_set_state(rtsp_session_t *session, rtsp_state_t new_sta
         [RTSP_STATE_PAUSED] = CLIENT_STATE_RTSP_PAUSED,
         [RTSP_STATE_ERROR] = CLIENT_STATE_ERROR};
 
-    if (session->state == new_state)
+    rtsp_state_t prev_state = session->state;
+
+    if (prev_state == new_state)
     {
         return; /* No change */
     }
@@ -375,6 +398,28 @@ static void rtsp_session_set_state(rtsp_session_t *session, rtsp_state_t new_sta
         status_update_client_state(session->status_index, rtsp_to_client_state[new_state]);
     }
 
+    /* Feed endpoint health scoring with handshake outcomes */
+    if (!session->teardown_requested &&
+        prev_state >= RTSP_STATE_CONNECTING && prev_state < RTSP_STATE_PLAYING)
+    {
+        if (new_state == RTSP_STATE_PLAYING)
+        {
+            rtsp_health_record(session->server_host, session->server_port, RTSP_HEALTH_SUCCESS,
+                               get_time_ms() - session->handshake_start_ms);
+        }
+        else if (new_state == RTSP_STATE_ERROR)
+        {
+            rtsp_health_record(session->server_host, session->server_port, RTSP_HEALTH_FAILURE, 0);
+
+            /* Another endpoint is available - defer cleanup, rtsp_handle_socket_event() fails over */
+            if (rtsp_pick_endpoint(session) >= 0)
+            {
+                session->failover_pending = 1;
+                return;
+            }
+        }
+    }
+
     /* Auto-cleanup on ERROR state transition (if not already done) */
     if (new_state == RTSP_STATE_ERROR && !session->cleanup_done)
     {
@@ -383,6 +428,41 @@ static void rtsp_session_set_state(rtsp_session_t *session, rtsp_state_t new_sta
     }
 }
 
+/**
+ * Make endpoint the current server: updates server_host/server_port and
+ * the host part of server_url (path and query are kept)
+ */
+static void rtsp_switch_endpoint(rtsp_session_t *session, int index)
+{
+    char url_tail[RTSP_SERVER_URL_SIZE];
+    const char *path;
+    int len;
+
+    if (index < 0 || index >= session->endpoint_count)
+        return;
+
+    session->endpoint_index = index;
+    session->endpoints_tried |= 1u << index;
+    strncpy(session->server_host, session->endpoints[index].host, sizeof(session->server_host) - 1);
+    session->server_host[sizeof(session->server_host) - 1] = '\0';
+    session->server_port = session->endpoints[index].port;
+
+    /* server_url is rebuilt by rtsp_parse_server_url on first use */
+    if (strncmp(session->server_url, "rtsp://", 7) != 0)
+        return;
+
+    path = strchr(session->server_url + 7, '/');
+    snprintf(url_tail, sizeof(url_tail), "%s", path ? path : "/");
+    if (session->server_port == 554)
+        len = snprintf(session->server_url, sizeof(session->server_url),
+                       "rtsp://%s%s", session->server_host, url_tail);
+    else
+        len = snprintf(session->server_url, sizeof(session->server_url),
+                       "rtsp://%s:%d%s", session->server_host, session->server_port, url_tail);
+    if (len < 0 || (size_t)len >= sizeof(session->server_url))
+        logger(LOG_WARN, "RTSP: Server URL truncated after switching endpoint");
+}
+
 int rtsp_parse_server_url(rtsp_session_t *session, const char *rtsp_url,
                           const char *seek_param_name, const char *seek_param_value,
                           int seek_offset_seconds,
@@ -390,14 +470,12 @@ int rtsp_parse_server_url(rtsp_session_t *session, const char *rtsp_url,
                           const char *fallback_username, const char *fallback_password)
 {
     char url_copy[RTSP_URL_COPY_SIZE];
-    char host_buffer[RTSP_SERVER_HOST_SIZE];
     char decoded_user[RTSP_CREDENTIAL_SIZE];
     char decoded_pass[RTSP_CREDENTIAL_SIZE];
     char *authority;
     char *path_start;
     char *hostport;
     char *userinfo;
-    char *port_str = NULL;
     char fallback_user_copy[RTSP_CREDENTIAL_SIZE];
     char fallback_pass_copy[RTSP_CREDENTIAL_SIZE];
     const char *fallback_user_source = NULL;
@@ -501,55 +579,15 @@ int rtsp_parse_server_url(rtsp_session_t *session, const char *rtsp_url,
         return -1;
     }
 
-    if (hostport[0] == '[')
+    /* Parse comma-separated endpoint list (failover order) */
+    session->endpoints_tried = 0;
+    if (rtsp_parse_endpoints(hostport, session->endpoints, &session->endpoint_count) < 0)
     {
-        char *closing = strchr(hostport, ']');
-        if (!closing)
-        {
-            logger(LOG_ERROR, "RTSP: Invalid IPv6 literal in URL");
-            return -1;
-        }
-        size_t host_len = (size_t)(closing - hostport - 1);
-        if (host_len >= sizeof(host_buffer))
-        {
-            logger(LOG_ERROR, "RTSP: Hostname too long");
-            return -1;
-        }
-        memcpy(host_buffer, hostport + 1, host_len);
-        host_buffer[host_len] = '\0';
-
-        if (*(closing + 1) == ':')
-        {
-            port_str = closing + 2;
-        }
-        hostport = host_buffer;
-    }
-    else
-    {
-        char *colon = strrchr(hostport, ':');
-        if (colon)
-        {
-            *colon = '\0';
-            port_str = colon + 1;
-        }
-    }
-
-    if (strlen(hostport) >= sizeof(session->server_host))
-    {
-        logger(LOG_ERROR, "RTSP: Hostname too long");
         return -1;
     }
-    strncpy(session->server_host, hostport, sizeof(session->server_host) - 1);
-    session->server_host[sizeof(session->server_host) - 1] = '\0';
 
-    if (port_str && *port_str)
-    {
-        session->server_port = atoi(port_str);
-    }
-    else
-    {
-        session->server_port = 554;
-    }
+    /* Start with the healthiest endpoint (list order wins on ties) */
+    rtsp_switch_endpoint(session, rtsp_pick_endpoint(session));
 
     if (userinfo)
     {
@@ -751,12 +789,60 @@ int rtsp_parse_server_url(rtsp_session_t *session, const char *rtsp_url,
     return 0;
 }
 
-int rtsp_connect(rtsp_session_t *session)
+/**
+ * Register a socket whose TCP connect is still in progress (or a warm pooled
+ * socket) with epoll; EPOLLOUT reports completion to the CONNECTING handler
+ */
+static int rtsp_register_connecting_socket(rtsp_session_t *session)
+{
+    if (session->epoll_fd >= 0)
+    {
+        struct epoll_event ev;
+        ev.events = EPOLLOUT | EPOLLIN | EPOLLERR | EPOLLHUP; /* Wait for writable (connected) or error */
+        ev.data.fd = session->socket;
+        if (epoll_ctl(session->epoll_fd, EPOLL_CTL_ADD, session->socket, &ev) < 0)
+        {
+            logger(LOG_ERROR, "RTSP: Failed to add socket to epoll: %s", strerror(errno));
+            close(session->socket);
+            session->socket = -1;
+            return -1;
+        }
+        fdmap_set(session->socket, session->conn);
+        logger(LOG_DEBUG, "RTSP: Socket registered with epoll for connection completion");
+    }
+
+    /* Set state to CONNECTING - connection will complete asynchronously */
+    rtsp_session_set_state(session, RTSP_STATE_CONNECTING);
+    return 0;
+}
+
+static int rtsp_connect_current_endpoint(rtsp_session_t *session)
 {
     struct sockaddr_in server_addr;
     struct hostent *he;
     int connect_result;
     const struct ifreq *upstream_if;
+    uint32_t pooled_cseq = 0;
+
+    /* Handshake timing and attempts feed the endpoint health score (TEARDOWN reconnects don't count) */
+    if (!session->teardown_requested)
+    {
+        session->handshake_start_ms = get_time_ms();
+        session->handshake_stalled = 0;
+        rtsp_health_record(session->server_host, session->server_port, RTSP_HEALTH_ATTEMPT, 0);
+    }
+
+    /* Take a warm connection from the pool if one is available (saves the TCP handshake) */
+    session->socket = rtsp_pool_acquire(session->server_host, session->server_port, &pooled_cseq);
+    if (session->socket >= 0)
+    {
+        /* Keep CSeq increasing on the reused connection */
+        if (pooled_cseq > session->cseq)
+            session->cseq = pooled_cseq;
+        logger(LOG_DEBUG, "RTSP: Using warm connection to %s:%d",
+               session->server_host, session->server_port);
+        return rtsp_register_connecting_socket(session);
+    }
 
     /* Resolve hostname */
     he = gethostbyname(session->server_host);
@@ -774,8 +860,12 @@ int rtsp_connect(rtsp_session_t *session)
         return -1;
     }
 
+    /* Warm pool sockets to this server connect to the same address */
+    rtsp_pool_set_address(session->server_host, session->server_port,
+                          (const struct in_addr *)he->h_addr_list[0]);
+
     /* Create TCP socket */
-    session->socket = socket(AF_INET, SOCK_STREAM, 0);
+    session->socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (session->socket < 0)
     {
         logger(LOG_ERROR, "RTSP: Failed to create socket: %s", strerror(errno));
@@ -812,25 +902,7 @@ int rtsp_connect(rtsp_session_t *session)
                    session->server_host, session->server_port);
 
             /* Register socket with epoll for EPOLLOUT to detect connection completion */
-            if (session->epoll_fd >= 0)
-            {
-                struct epoll_event ev;
-                ev.events = EPOLLOUT | EPOLLIN | EPOLLERR | EPOLLHUP; /* Wait for writable (connected) or error */
-                ev.data.fd = session->socket;
-                if (epoll_ctl(session->epoll_fd, EPOLL_CTL_ADD, session->socket, &ev) < 0)
-                {
-                    logger(LOG_ERROR, "RTSP: Failed to add socket to epoll: %s", strerror(errno));
-                    close(session->socket);
-                    session->socket = -1;
-                    return -1;
-                }
-                fdmap_set(session->socket, session->conn);
-                logger(LOG_DEBUG, "RTSP: Socket registered with epoll for connection completion");
-            }
-
-            /* Set state to CONNECTING - connection will complete asynchronously */
-            rtsp_session_set_state(session, RTSP_STATE_CONNECTING);
-            return 0; /* Success - connection in progress */
+            return rtsp_register_connecting_socket(session);
         }
         else
         {
@@ -867,12 +939,124 @@ int rtsp_connect(rtsp_session_t *session)
     return 0;
 }
 
+int rtsp_connect(rtsp_session_t *session)
+{
+    while (rtsp_connect_current_endpoint(session) < 0)
+    {
+        /* TEARDOWN must reach the server that owns the session - never fail over */
+        if (session->teardown_requested)
+            return -1;
+
+        rtsp_health_record(session->server_host, session->server_port, RTSP_HEALTH_FAILURE, 0);
+
+        int next = rtsp_pick_endpoint(session);
+        if (next < 0)
+            return -1;
+
+        logger(LOG_WARN, "RTSP: Cannot connect to %s:%d, trying %s:%d",
+               session->server_host, session->server_port,
+               session->endpoints[next].host, session->endpoints[next].port);
+        rtsp_switch_endpoint(session, next);
+    }
+    return 0;
+}
+
+/**
+ * Fail over to the next endpoint after the handshake with the current one failed
+ * Drops everything negotiated with the failed server and starts over
+ * Returns: 0 if a new connection is in progress, -1 if no endpoint is left
+ */
+static int rtsp_failover(rtsp_session_t *session, const char *reason)
+{
+    int next = rtsp_pick_endpoint(session);
+    if (next < 0)
+        return -1;
+
+    logger(LOG_WARN, "RTSP: %s:%d %s, failing over to %s:%d",
+           session->server_host, session->server_port, reason,
+           session->endpoints[next].host, session->endpoints[next].port);
+
+    if (session->socket >= 0)
+    {
+        worker_cleanup_socket_from_epoll(session->epoll_fd, session->socket);
+        session->socket = -1;
+    }
+    rtsp_close_udp_sockets(session, "failover");
+
+    session->failover_pending = 0;
+    session->response_buffer_pos = 0;
+    session->pending_request_len = 0;
+    session->pending_request_sent = 0;
+    session->awaiting_response = 0;
+    session->session_id[0] = '\0';
+    session->auth_type = RTSP_AUTH_NONE;
+    session->auth_retry_count = 0;
+    session->auth_realm[0] = '\0';
+    session->auth_nonce[0] = '\0';
+    session->auth_opaque[0] = '\0';
+    session->transport_mode = RTSP_TRANSPORT_TCP;
+    session->transport_protocol = RTSP_PROTOCOL_RTP;
+    session->keepalive_interval_ms = 0;
+    session->last_keepalive_ms = 0;
+    session->keepalive_pending = 0;
+    session->awaiting_keepalive_response = 0;
+    session->use_get_parameter = 1;
+    session->state = RTSP_STATE_INIT;
+
+    rtsp_switch_endpoint(session, next);
+    return rtsp_connect(session);
+}
+
+int rtsp_session_tick(rtsp_session_t *session, int64_t now)
+{
+    if (session->teardown_requested || session->handshake_stalled ||
+        session->state < RTSP_STATE_CONNECTING || session->state >= RTSP_STATE_PLAYING)
+        return 0;
+
+    if (now - session->handshake_start_ms < RTSP_HANDSHAKE_STALL_MS)
+        return 0;
+
+    session->handshake_stalled = 1;
+    rtsp_health_record(session->server_host, session->server_port, RTSP_HEALTH_STALL, 0);
+
+    if (rtsp_pick_endpoint(session) < 0)
+    {
+        /* Nothing better to try - keep waiting on the current server */
+        logger(LOG_WARN, "RTSP: Handshake with %s:%d stalled for %d ms",
+               session->server_host, session->server_port, RTSP_HANDSHAKE_STALL_MS);
+        return 0;
+    }
+
+    if (rtsp_failover(session, "stalled during handshake") < 0)
+    {
+        rtsp_force_cleanup(session);
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * Main event handler for RTSP socket - handles all async I/O
  * Called by worker when socket has EPOLLIN or EPOLLOUT events
  * @return Number of bytes forwarded to client (>0), 0 if no data forwarded, -1 on error
  */
 int rtsp_handle_socket_event(rtsp_session_t *session, uint32_t events)
+{
+    int result = rtsp_process_socket_event(session, events);
+
+    /* Handshake failed but another endpoint is available (see rtsp_session_set_state) */
+    if (session->failover_pending)
+    {
+        if (rtsp_failover(session, "failed during handshake") == 0)
+            return 0;
+        rtsp_force_cleanup(session);
+        return -1;
+    }
+
+    return result;
+}
+
+static int rtsp_process_socket_event(rtsp_session_t *session, uint32_t events)
 {
     int result;
 
@@ -1055,7 +1239,10 @@ int rtsp_handle_socket_event(rtsp_session_t *session, uint32_t events)
 
         if (session->state == RTSP_STATE_PLAYING)
         {
-            result = rtsp_handle_tcp_interleaved_data(session, session->conn);
+            if (rtsp_passthrough_start(session, session->conn))
+                result = rtsp_handle_tcp_passthrough(session, session->conn);
+            else
+                result = rtsp_handle_tcp_interleaved_data(session, session->conn);
             if (result < 0)
             {
                 rtsp_session_set_state(session, RTSP_STATE_ERROR);
@@ -1398,7 +1585,10 @@ static int rtsp_try_receive_response(rtsp_session_t *session)
             session->response_buffer_pos = extra_data_len;
             logger(LOG_DEBUG, "RTSP: Preserved %zu bytes of RTP data after PLAY response", extra_data_len);
         }
-        session->response_buffer_pos = 0;
+        else
+        {
+            session->response_buffer_pos = 0;
+        }
     }
     else if (session->state == RTSP_STATE_AWAITING_TEARDOWN)
     {
@@ -1649,6 +1839,36 @@ int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, connection_t *conn
                 logger(LOG_DEBUG, "RTSP: Incomplete server request, waiting for more data");
                 break;
             }
+            else if (session->transport_protocol == RTSP_PROTOCOL_MP2T &&
+                     session->response_buffer[0] == RTSP_TS_SYNC_BYTE)
+            {
+                /* Raw MPEG-TS without interleaved framing - forward whole TS packets */
+                size_t ts_len = session->response_buffer_pos - session->response_buffer_pos % RTSP_TS_PACKET_SIZE;
+                size_t chunk_max = (BUFFER_POOL_BUFFER_SIZE / RTSP_TS_PACKET_SIZE) * RTSP_TS_PACKET_SIZE;
+                for (size_t off = 0; off < ts_len;)
+                {
+                    size_t chunk = min(ts_len - off, chunk_max);
+                    buffer_ref_t *packet_buf = buffer_pool_alloc();
+                    if (packet_buf)
+                    {
+                        memcpy(packet_buf->data, session->response_buffer + off, chunk);
+                        packet_buf->data_size = chunk;
+                        int pb = stream_process_rtp_payload(&conn->stream, packet_buf, &session->current_seqn, &session->not_first_packet);
+                        if (pb > 0)
+                            bytes_forwarded += pb;
+                        buffer_ref_put(packet_buf);
+                    }
+                    else
+                    {
+                        session->packets_dropped++;
+                    }
+                    off += chunk;
+                }
+                memmove(session->response_buffer, session->response_buffer + ts_len,
+                        session->response_buffer_pos - ts_len);
+                session->response_buffer_pos -= ts_len;
+                break; /* Wait for the rest of the partial TS packet */
+            }
             else
             {
                 /* Unknown non-interleaved data */
@@ -1693,7 +1913,8 @@ int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, connection_t *conn
         /* Process RTP/RTCP packet based on channel */
         if (channel == session->rtp_channel)
         {
-            buffer_ref_t *packet_buf = buffer_pool_alloc();
+            /* Interleaved packets may exceed a media buffer; take the size class that fits */
+            buffer_ref_t *packet_buf = buffer_pool_alloc_size(packet_length);
             if (packet_buf)
             {
                 memcpy(packet_buf->data, &session->response_buffer[4], packet_length);
@@ -1713,7 +1934,7 @@ int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, connection_t *conn
         }
         else if (channel == session->rtcp_channel)
         {
-            /* RTCP data - could be processed for statistics but currently ignored */
+            rtcp_stats_on_rtcp(&conn->stream.rtcp, &session->response_buffer[4], packet_length);
         }
 
         /* Remove processed packet from buffer */
@@ -1726,6 +1947,374 @@ int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, connection_t *conn
     return bytes_forwarded;
 }
 
+static void rtsp_passthrough_close(rtsp_session_t *session)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (session->splice_pipe[i] >= 0)
+        {
+            close(session->splice_pipe[i]);
+            session->splice_pipe[i] = -1;
+        }
+    }
+    session->passthrough = RTSP_PASSTHROUGH_OFF;
+    session->splice_pipe_size = 0;
+    session->splice_remaining = 0;
+    session->splice_ts_offset = 0;
+    session->splice_discard = 0;
+    session->splice_started = 0;
+    session->splice_spill = 0;
+}
+
+/**
+ * Switch a PLAYING MP2T-over-TCP session to splice passthrough
+ * Returns: 1 if passthrough is active, 0 to use the interleaved parser
+ */
+static int rtsp_passthrough_start(rtsp_session_t *session, connection_t *conn)
+{
+    if (session->passthrough != RTSP_PASSTHROUGH_OFF)
+        return 1;
+
+    /* Snapshots, its own or tapping this stream, need the packets in userspace */
+    if (session->passthrough_disabled ||
+        session->transport_mode != RTSP_TRANSPORT_TCP ||
+        session->transport_protocol != RTSP_PROTOCOL_MP2T ||
+        !conn || (conn->stream.snapshot && conn->stream.snapshot->enabled) || conn->stream.taps)
+        return 0;
+
+    if (pipe2(session->splice_pipe, O_NONBLOCK | O_CLOEXEC) < 0)
+    {
+        logger(LOG_WARN, "RTSP: Cannot create passthrough pipe: %s", strerror(errno));
+        session->splice_pipe[0] = session->splice_pipe[1] = -1;
+        session->passthrough_disabled = 1;
+        return 0;
+    }
+
+    /* Best effort - the default 64 KiB pipe works, it just drops sooner */
+    if (fcntl(session->splice_pipe[1], F_SETPIPE_SZ, RTSP_SPLICE_PIPE_SIZE) < 0)
+        logger(LOG_DEBUG, "RTSP: Cannot resize passthrough pipe: %s", strerror(errno));
+    int pipe_size = fcntl(session->splice_pipe[1], F_GETPIPE_SZ);
+    session->splice_pipe_size = pipe_size > 0 ? (size_t)pipe_size : 65536;
+
+    session->passthrough = RTSP_PASSTHROUGH_FRAMED;
+    logger(LOG_INFO, "RTSP: MP2T passthrough enabled");
+    return 1;
+}
+
+/* Free bytes in the passthrough pipe: drops are decided against this at unit boundaries */
+static size_t rtsp_passthrough_room(rtsp_session_t *session)
+{
+    int queued = 0;
+    if (ioctl(session->splice_pipe[0], FIONREAD, &queued) < 0 || queued < 0)
+        return 0;
+    return (size_t)queued < session->splice_pipe_size ? session->splice_pipe_size - (size_t)queued : 0;
+}
+
+/* Push committed payload that is already in userspace through the passthrough pipe */
+static int rtsp_passthrough_write(rtsp_session_t *session, connection_t *conn, const uint8_t *data, size_t len)
+{
+    ssize_t written = write(session->splice_pipe[1], data, len);
+    if (written < 0)
+    {
+        if (errno != EAGAIN)
+        {
+            logger(LOG_ERROR, "RTSP: Passthrough pipe write failed: %s", strerror(errno));
+            return -1;
+        }
+        written = 0;
+    }
+
+    if (written > 0 && connection_queue_pipe(conn, session->splice_pipe[0], (size_t)written) < 0)
+        return -1;
+
+    /* Pipe out of slots despite the byte room - the tail still has to follow */
+    if ((size_t)written < len && connection_queue_output(conn, data + written, len - (size_t)written) < 0)
+    {
+        logger(LOG_ERROR, "RTSP: Cannot queue passthrough data, client is too far behind");
+        return -1;
+    }
+
+    return (int)len;
+}
+
+/**
+ * Move the next part of a committed unit through a pool buffer instead of the pipe
+ * Spliced skbs can use up the pipe's slots well before its byte capacity, and a
+ * frame or TS packet that has been started must be completed, not cut.
+ * Returns: bytes queued, 0 on EOF, -1 with errno set (EAGAIN to retry later)
+ */
+static ssize_t rtsp_passthrough_spill(rtsp_session_t *session, connection_t *conn, size_t want)
+{
+    buffer_ref_t *buf = buffer_pool_alloc();
+    if (!buf)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    ssize_t n = recv(session->socket, buf->data, min(want, (size_t)BUFFER_POOL_BUFFER_SIZE), 0);
+    int saved_errno = errno;
+    if (n > 0)
+    {
+        buf->data_size = (size_t)n;
+        if (connection_queue_zerocopy(conn, buf) < 0)
+        {
+            logger(LOG_ERROR, "RTSP: Cannot queue passthrough data, client is too far behind");
+            n = -1;
+            saved_errno = ENOBUFS;
+        }
+    }
+    buffer_ref_put(buf);
+    errno = saved_errno;
+    return n;
+}
+
+static void rtsp_response_buffer_consume(rtsp_session_t *session, size_t len)
+{
+    memmove(session->response_buffer, session->response_buffer + len, session->response_buffer_pos - len);
+    session->response_buffer_pos -= len;
+}
+
+/**
+ * Handle the complete unit at the start of response_buffer (frame boundary)
+ * Returns: bytes forwarded, -1 on error, RTSP_PASSTHROUGH_FALLBACK for in-band RTSP messages
+ */
+static int rtsp_passthrough_unit(rtsp_session_t *session, connection_t *conn)
+{
+    uint8_t *buf = session->response_buffer;
+    size_t pos = session->response_buffer_pos;
+
+    if (buf[0] == '$')
+    {
+        size_t len = ((size_t)buf[2] << 8) | buf[3];
+
+        if (buf[1] == session->rtp_channel)
+        {
+            /* Payload read along with the header goes through the pipe, the rest is spliced */
+            size_t avail = min(pos - 4, len);
+            int written = 0;
+            if (rtsp_passthrough_room(session) < len)
+            {
+                /* Client is not keeping up - drop this whole frame, never part of one */
+                session->packets_dropped++;
+                connection_record_upstream_drop(conn, avail);
+                session->splice_discard = 1;
+            }
+            else if (avail > 0)
+            {
+                written = rtsp_passthrough_write(session, conn, buf + 4, avail);
+                if (written < 0)
+                    return -1;
+            }
+            rtsp_response_buffer_consume(session, 4 + avail);
+            session->splice_remaining = len - avail;
+            session->splice_started = written > 0;
+            if (session->splice_remaining == 0)
+                session->splice_discard = 0;
+            return written;
+        }
+
+        if (buf[1] == session->rtcp_channel)
+            rtcp_stats_on_rtcp(&conn->stream.rtcp, buf + 4, len);
+        rtsp_response_buffer_consume(session, 4 + len);
+        return 0;
+    }
+
+    if (buf[0] == RTSP_TS_SYNC_BYTE)
+    {
+        /* No interleaved framing at all - splice the byte stream as is */
+        session->passthrough = RTSP_PASSTHROUGH_RAW;
+        logger(LOG_INFO, "RTSP: Server sends raw MPEG-TS over TCP");
+        int written = 0;
+        session->splice_ts_offset = pos % RTSP_TS_PACKET_SIZE;
+        if (rtsp_passthrough_room(session) < pos)
+        {
+            /* Drop through the end of the partial packet as well */
+            session->packets_dropped++;
+            connection_record_upstream_drop(conn, pos);
+            session->splice_discard = session->splice_ts_offset != 0;
+        }
+        else
+        {
+            written = rtsp_passthrough_write(session, conn, buf, pos);
+        }
+        session->response_buffer_pos = 0;
+        return written;
+    }
+
+    /* In-band RTSP message (ANNOUNCE, OPTIONS, ...) - parse the rest of the session in userspace */
+    logger(LOG_INFO, "RTSP: In-band RTSP message, leaving passthrough mode");
+    rtsp_passthrough_close(session);
+    session->passthrough_disabled = 1;
+    return RTSP_PASSTHROUGH_FALLBACK;
+}
+
+int rtsp_handle_tcp_passthrough(rtsp_session_t *session, connection_t *conn)
+{
+    /* Raw mode drops in chunks of whole TS packets */
+    const size_t raw_drop_max = (RTSP_RESPONSE_BUFFER_SIZE / RTSP_TS_PACKET_SIZE) * RTSP_TS_PACKET_SIZE;
+    int forwarded = 0;
+
+    while (forwarded < RTSP_SPLICE_BUDGET)
+    {
+        if (session->passthrough == RTSP_PASSTHROUGH_RAW || session->splice_remaining > 0)
+        {
+            int framed = session->passthrough == RTSP_PASSTHROUGH_FRAMED;
+            size_t want = RTSP_SPLICE_BUDGET - (size_t)forwarded;
+
+            if (framed)
+            {
+                want = min(want, session->splice_remaining);
+                if (session->splice_discard)
+                    want = min(want, (size_t)RTSP_RESPONSE_BUFFER_SIZE);
+            }
+            else if (session->splice_spill)
+            {
+                want = RTSP_TS_PACKET_SIZE - session->splice_ts_offset;
+            }
+            else if (session->splice_discard)
+            {
+                want = min(want, raw_drop_max - session->splice_ts_offset);
+            }
+            else
+            {
+                /* Finish the started packet, then commit only whole packets the pipe has room for */
+                size_t head = session->splice_ts_offset ? RTSP_TS_PACKET_SIZE - session->splice_ts_offset : 0;
+                size_t room = rtsp_passthrough_room(session);
+                room = room > head ? room - (room - head) % RTSP_TS_PACKET_SIZE : head;
+                want = min(want, room);
+            }
+
+            ssize_t n;
+            if (want == 0)
+            {
+                n = -1;
+                errno = EAGAIN;
+            }
+            else if (session->splice_discard)
+                n = recv(session->socket, session->response_buffer, want, 0);
+            else if (session->splice_spill)
+                n = rtsp_passthrough_spill(session, conn, want);
+            else
+                n = splice(session->socket, NULL, session->splice_pipe[1], NULL, want,
+                           SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+
+            if (n == 0)
+            {
+                logger(LOG_INFO, "RTSP: Server closed connection (EOF received)");
+                return -1;
+            }
+            if (n < 0)
+            {
+                if (errno != EAGAIN)
+                {
+                    logger(LOG_ERROR, "RTSP: Passthrough failed: %s", strerror(errno));
+                    return -1;
+                }
+
+                /* EAGAIN means either no upstream data or a full pipe */
+                uint8_t probe;
+                if (session->splice_discard || session->splice_spill ||
+                    recv(session->socket, &probe, 1, MSG_PEEK | MSG_DONTWAIT) <= 0)
+                    return forwarded;
+
+                if (session->splice_started)
+                {
+                    /* Inside a started frame or packet: finish it through pool buffers */
+                    session->splice_spill = 1;
+                }
+                else
+                {
+                    /* Client is not keeping up - drop whole frames or TS packets rather than stall the upstream */
+                    session->packets_dropped++;
+                    session->splice_discard = 1;
+                }
+                continue;
+            }
+
+            if (session->splice_discard)
+            {
+                connection_record_upstream_drop(conn, (size_t)n);
+            }
+            else
+            {
+                if (!session->splice_spill &&
+                    connection_queue_pipe(conn, session->splice_pipe[0], (size_t)n) < 0)
+                    return -1;
+                session->splice_started = 1;
+                forwarded += (int)n;
+            }
+
+            /* Drop and spill decisions only hold until the end of the unit */
+            int unit_done;
+            if (framed)
+            {
+                session->splice_remaining -= (size_t)n;
+                unit_done = session->splice_remaining == 0;
+            }
+            else
+            {
+                session->splice_ts_offset = (session->splice_ts_offset + (size_t)n) % RTSP_TS_PACKET_SIZE;
+                unit_done = session->splice_ts_offset == 0;
+            }
+            if (unit_done)
+            {
+                session->splice_discard = 0;
+                session->splice_started = 0;
+                session->splice_spill = 0;
+            }
+            continue;
+        }
+
+        /* Frame boundary: read just enough to classify the next unit */
+        size_t need = 4;
+        if (session->response_buffer_pos >= 4 && session->response_buffer[0] == '$' &&
+            session->response_buffer[1] != session->rtp_channel)
+            need += ((size_t)session->response_buffer[2] << 8) | session->response_buffer[3];
+
+        if (need > RTSP_RESPONSE_BUFFER_SIZE)
+        {
+            /* Oversized non-media frame - skip it */
+            session->splice_remaining = need - session->response_buffer_pos;
+            session->splice_discard = 1;
+            session->response_buffer_pos = 0;
+            continue;
+        }
+
+        if (session->response_buffer_pos < need)
+        {
+            ssize_t n = recv(session->socket, session->response_buffer + session->response_buffer_pos,
+                             need - session->response_buffer_pos, 0);
+            if (n < 0)
+            {
+                if (errno == EAGAIN)
+                    return forwarded;
+                logger(LOG_ERROR, "RTSP: TCP receive failed: %s", strerror(errno));
+                return -1;
+            }
+            if (n == 0)
+            {
+                logger(LOG_INFO, "RTSP: Server closed connection (EOF received)");
+                return -1;
+            }
+            session->response_buffer_pos += (size_t)n;
+            continue;
+        }
+
+        int result = rtsp_passthrough_unit(session, conn);
+        if (result == RTSP_PASSTHROUGH_FALLBACK)
+        {
+            result = rtsp_handle_tcp_interleaved_data(session, conn);
+            return result < 0 ? result : forwarded + result;
+        }
+        if (result < 0)
+            return -1;
+        forwarded += result;
+    }
+
+    return forwarded;
+}
+
 int rtsp_handle_udp_rtp_data(rtsp_session_t *session, connection_t *conn)
 {
     int bytes_received;
@@ -1798,6 +2387,92 @@ int rtsp_handle_udp_rtp_data(rtsp_session_t *session, connection_t *conn)
     return 0;
 }
 
+int rtsp_handle_udp_rtcp_data(rtsp_session_t *session, connection_t *conn)
+{
+    uint8_t rtcp_buffer[RTCP_BUFFER_SIZE];
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+
+    ssize_t n = recvfrom(session->rtcp_socket, rtcp_buffer, sizeof(rtcp_buffer), 0,
+                         (struct sockaddr *)&peer, &peer_len);
+    if (n < 0)
+    {
+        if (errno == EAGAIN)
+            return 0;
+        logger(LOG_DEBUG, "RTSP: RTCP receive failed: %s", strerror(errno));
+        return 0;
+    }
+
+    if (rtcp_stats_on_rtcp(&conn->stream.rtcp, rtcp_buffer, (size_t)n) > 0)
+    {
+        /* Answer where the server actually sends its reports from */
+        memcpy(&session->rtcp_peer, &peer, peer_len);
+        session->rtcp_peer_len = peer_len;
+    }
+    return 0;
+}
+
+int rtsp_send_receiver_report(rtsp_session_t *session, connection_t *conn)
+{
+    uint8_t packet[4 + RTCP_RR_BUFFER_SIZE];
+    int len;
+
+    if (session->state != RTSP_STATE_PLAYING || session->socket < 0)
+        return 1;
+
+    len = rtcp_build_receiver_report(&conn->stream.rtcp, packet + 4, sizeof(packet) - 4);
+    if (len < 0)
+        return -1;
+
+    if (session->transport_mode == RTSP_TRANSPORT_UDP)
+    {
+        if (session->rtcp_socket < 0)
+            return 1;
+
+        if (session->rtcp_peer_len == 0)
+        {
+            /* No RTCP from the server yet - use the RTSP server address */
+            struct sockaddr_storage addr;
+            socklen_t addr_len = sizeof(addr);
+            if (session->server_rtcp_port <= 0 ||
+                getpeername(session->socket, (struct sockaddr *)&addr, &addr_len) < 0 ||
+                addr.ss_family != AF_INET)
+                return 1;
+            ((struct sockaddr_in *)&addr)->sin_port = htons((uint16_t)session->server_rtcp_port);
+            memcpy(&session->rtcp_peer, &addr, addr_len);
+            session->rtcp_peer_len = addr_len;
+        }
+
+        if (sendto(session->rtcp_socket, packet + 4, (size_t)len, MSG_DONTWAIT,
+                   (struct sockaddr *)&session->rtcp_peer, session->rtcp_peer_len) < 0)
+        {
+            logger(LOG_DEBUG, "RTSP: Failed to send RTCP RR: %s", strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    /* TCP interleaved: only when no request is in flight and the socket
+     * send queue is empty, so the frame can never be split */
+    int outq = 0;
+    if (session->pending_request_len > 0 ||
+        ioctl(session->socket, SIOCOUTQ, &outq) < 0 || outq > 0)
+        return 1;
+
+    packet[0] = '$';
+    packet[1] = (uint8_t)session->rtcp_channel;
+    packet[2] = (uint8_t)(len >> 8);
+    packet[3] = (uint8_t)len;
+    ssize_t sent = send(session->socket, packet, (size_t)len + 4, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent != len + 4)
+    {
+        logger(LOG_DEBUG, "RTSP: Failed to send interleaved RTCP RR: %s",
+               sent < 0 ? strerror(errno) : "short write");
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * Force cleanup - immediately close all sockets and reset session
  * Used when TEARDOWN cannot be sent or after TEARDOWN completes
@@ -1815,6 +2490,10 @@ static void rtsp_force_cleanup(rtsp_session_t *session)
     /* Close and remove UDP sockets from epoll */
     rtsp_close_udp_sockets(session, "cleanup");
 
+    /* Queued passthrough data keeps its own pipe descriptor */
+    rtsp_passthrough_close(session);
+    session->passthrough_disabled = 0;
+
     /* Reset response buffer position */
     session->response_buffer_pos = 0;
 
@@ -1828,6 +2507,8 @@ static void rtsp_force_cleanup(rtsp_session_t *session)
     session->awaiting_keepalive_response = 0;
     session->use_get_parameter = 1;
 
+    session->failover_pending = 0;
+
     /* Reset teardown state */
     session->teardown_requested = 0;
     session->teardown_reconnect_done = 0;
@@ -2260,7 +2941,7 @@ static int rtsp_setup_udp_sockets(rtsp_session_t *session)
         int candidate_rtp_port = port_base + pair_index * 2;
         int bind_errno = 0;
 
-        rtp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        rtp_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
         if (rtp_socket < 0)
         {
             logger(LOG_ERROR, "RTSP: Failed to create RTP socket: %s", strerror(errno));
@@ -2297,7 +2978,7 @@ static int rtsp_setup_udp_sockets(rtsp_session_t *session)
             return -1;
         }
 
-        rtcp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+        rtcp_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
         if (rtcp_socket < 0)
         {
             logger(LOG_ERROR, "RTSP: Failed to create RTCP socket: %s", strerror(errno));
@@ -2418,6 +3099,7 @@ static void rtsp_close_udp_sockets(rtsp_session_t *session, const char *reason)
         session->rtcp_socket = -1;
         logger(LOG_DEBUG, "RTSP: Closed UDP RTCP socket %s", reason);
     }
+    session->rtcp_peer_len = 0;
 }
 
 static char *rtsp_find_header(const char *response, const char *header_name)
@@ -36,6 +36,9 @@
 
 #define RTSP_CREDENTIAL_SIZE 128
 
+/* Failover endpoints - rtsp://host1:port1,host2:port2/path */
+#define RTSP_MAX_ENDPOINTS 4
+
 /* RTSP playseek range - for Range header in PLAY command */
 #define RTSP_PLAYSEEK_RANGE_SIZE 256
 
@@ -109,6 +112,27 @@ typedef enum
     RTSP_PROTOCOL_MP2T,    /* MP2T - Direct MPEG-2 TS (no RTP unwrapping) */
 } rtsp_transport_protocol_t;
 
+/* MP2T over TCP passthrough (media spliced socket -> pipe -> client) */
+typedef enum
+{
+    RTSP_PASSTHROUGH_OFF = 0, /* Interleaved data parsed in userspace */
+    RTSP_PASSTHROUGH_FRAMED,  /* Interleaved frames: headers parsed, payload spliced */
+    RTSP_PASSTHROUGH_RAW      /* Raw TS byte stream, spliced as is */
+} rtsp_passthrough_mode_t;
+
+/* Capacity requested for the passthrough pipe (capped by fs.pipe-max-size) */
+#define RTSP_SPLICE_PIPE_SIZE (1024 * 1024)
+
+/* Media bytes moved per socket event before yielding to other connections */
+#define RTSP_SPLICE_BUDGET (256 * 1024)
+
+/* RTSP server endpoint (one entry of a failover list) */
+typedef struct
+{
+    char host[RTSP_SERVER_HOST_SIZE];
+    int port;
+} rtsp_endpoint_t;
+
 /* RTSP session structure */
 typedef struct
 {
@@ -125,6 +149,15 @@ typedef struct
     char server_path[RTSP_SERVER_PATH_SIZE]; /* RTSP path with query string */
     int redirect_count;                      /* Number of redirects followed */
 
+    /* Failover endpoints (server_host/server_port mirror the one in use) */
+    rtsp_endpoint_t endpoints[RTSP_MAX_ENDPOINTS]; /* Ordered endpoint list from URL */
+    int endpoint_count;                            /* Number of endpoints in list */
+    int endpoint_index;                            /* Endpoint currently in use */
+    uint32_t endpoints_tried;                      /* Bitmask of endpoints already attempted */
+    int64_t handshake_start_ms;                    /* When handshake with current endpoint began */
+    int handshake_stalled;                         /* Stall already recorded for current endpoint */
+    int failover_pending;                          /* Handshake failed, try next endpoint */
+
     /* Authentication state */
     char username[RTSP_CREDENTIAL_SIZE];    /* RTSP username for authentication */
     char password[RTSP_CREDENTIAL_SIZE];    /* RTSP password for authentication */
@@ -150,6 +183,21 @@ typedef struct
     int server_rtp_port;  /* Server RTP port */
     int server_rtcp_port; /* Server RTCP port */
 
+    /* Where our RTCP receiver reports go in UDP mode (learned from incoming RTCP) */
+    struct sockaddr_storage rtcp_peer;
+    socklen_t rtcp_peer_len;
+
+    /* MP2T passthrough state */
+    rtsp_passthrough_mode_t passthrough;
+    int passthrough_disabled; /* Splice unavailable, or in-band RTSP messages seen */
+    int splice_pipe[2];       /* Pipe between upstream and client socket */
+    size_t splice_pipe_size;  /* Pipe capacity (F_GETPIPE_SZ) */
+    size_t splice_remaining;  /* Payload bytes left in the current interleaved frame */
+    size_t splice_ts_offset;  /* Position inside the current TS packet (raw mode) */
+    int splice_discard;       /* Drop the current frame or TS packets (pipe full) */
+    int splice_started;       /* Part of the current frame or TS packet is queued to the client */
+    int splice_spill;         /* Pipe out of slots mid-unit: queue the rest via pool buffers */
+
     /* RTP packet tracking for loss detection */
     uint16_t current_seqn;     /* Last received RTP sequence number */
     uint16_t not_first_packet; /* Flag indicating first packet received */
@@ -226,6 +274,15 @@ int rtsp_connect(rtsp_session_t *session);
  */
 int rtsp_handle_socket_event(rtsp_session_t *session, uint32_t events);
 
+/**
+ * Periodic check for stalled handshakes; fails over to the next endpoint
+ * when the current one makes no progress
+ * @param session RTSP session
+ * @param now Current time in milliseconds
+ * @return 0 on success, -1 if the session failed and should be closed
+ */
+int rtsp_session_tick(rtsp_session_t *session, int64_t now);
+
 /**
  * Send RTSP DESCRIBE request
  * @param session RTSP session
@@ -255,6 +312,17 @@ int rtsp_play(rtsp_session_t *session);
  */
 int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, struct connection_s *conn);
 
+/**
+ * Forward MP2T-over-TCP media without per-packet copies
+ * Only interleaved frame headers are read into userspace; payload (or a raw
+ * TS stream) is moved upstream socket -> pipe -> client socket with splice().
+ * Falls back to rtsp_handle_tcp_interleaved_data() on in-band RTSP messages.
+ * @param session RTSP session in PLAYING state
+ * @param conn Connection object for output
+ * @return Number of bytes forwarded, -1 on error, -2 on ANNOUNCE (stream end)
+ */
+int rtsp_handle_tcp_passthrough(rtsp_session_t *session, struct connection_s *conn);
+
 /**
  * Handle UDP RTP data and forward to HTTP client via connection output buffer
  * @param session RTSP session
@@ -263,6 +331,22 @@ int rtsp_handle_tcp_interleaved_data(rtsp_session_t *session, struct connection_
  */
 int rtsp_handle_udp_rtp_data(rtsp_session_t *session, struct connection_s *conn);
 
+/**
+ * Receive and parse UDP RTCP data (sender reports) into the stream statistics
+ * @param session RTSP session
+ * @param conn Connection owning the stream statistics
+ * @return 0 on success, -1 on error
+ */
+int rtsp_handle_udp_rtcp_data(rtsp_session_t *session, struct connection_s *conn);
+
+/**
+ * Send an RTCP receiver report to the server (UDP or TCP interleaved)
+ * @param session RTSP session in PLAYING state
+ * @param conn Connection owning the stream statistics
+ * @return 0 if sent, 1 if skipped (not possible right now), -1 on error
+ */
+int rtsp_send_receiver_report(rtsp_session_t *session, struct connection_s *conn);
+
 /**
  * Send RTSP TEARDOWN and cleanup session
  * @param session RTSP session
@@ -0,0 +1,121 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include "rtsp_endpoint.h"
+#include "rtsp_health.h"
+#include "rtp2httpd.h"
+
+int rtsp_parse_endpoint(char *hostport, rtsp_endpoint_t *endpoint)
+{
+    char host_buffer[RTSP_SERVER_HOST_SIZE];
+    char *port_str = NULL;
+
+    if (hostport[0] == '\0')
+    {
+        logger(LOG_ERROR, "RTSP: Missing host in URL");
+        return -1;
+    }
+
+    if (hostport[0] == '[')
+    {
+        char *closing = strchr(hostport, ']');
+        if (!closing)
+        {
+            logger(LOG_ERROR, "RTSP: Invalid IPv6 literal in URL");
+            return -1;
+        }
+        size_t host_len = (size_t)(closing - hostport - 1);
+        if (host_len >= sizeof(host_buffer))
+        {
+            logger(LOG_ERROR, "RTSP: Hostname too long");
+            return -1;
+        }
+        memcpy(host_buffer, hostport + 1, host_len);
+        host_buffer[host_len] = '\0';
+
+        if (*(closing + 1) == ':')
+        {
+            port_str = closing + 2;
+        }
+        hostport = host_buffer;
+    }
+    else
+    {
+        char *colon = strrchr(hostport, ':');
+        if (colon)
+        {
+            *colon = '\0';
+            port_str = colon + 1;
+        }
+    }
+
+    if (strlen(hostport) >= sizeof(endpoint->host))
+    {
+        logger(LOG_ERROR, "RTSP: Hostname too long");
+        return -1;
+    }
+    strncpy(endpoint->host, hostport, sizeof(endpoint->host) - 1);
+    endpoint->host[sizeof(endpoint->host) - 1] = '\0';
+
+    if (port_str && *port_str)
+    {
+        endpoint->port = atoi(port_str);
+    }
+    else
+    {
+        endpoint->port = 554;
+    }
+
+    return 0;
+}
+
+int rtsp_parse_endpoints(char *list, rtsp_endpoint_t *endpoints, int *count)
+{
+    *count = 0;
+    for (char *token = list, *next_token; token; token = next_token)
+    {
+        next_token = strchr(token, ',');
+        if (next_token)
+        {
+            *next_token++ = '\0';
+        }
+
+        if (*count >= RTSP_MAX_ENDPOINTS)
+        {
+            logger(LOG_WARN, "RTSP: Too many endpoints in URL, ignoring %s", token);
+            continue;
+        }
+
+        if (rtsp_parse_endpoint(token, &endpoints[*count]) < 0)
+        {
+            return -1;
+        }
+        (*count)++;
+    }
+
+    return 0;
+}
+
+int rtsp_pick_endpoint(const rtsp_session_t *session)
+{
+    int best = -1;
+    int best_score = 0;
+
+    for (int i = 0; i < session->endpoint_count; i++)
+    {
+        if (session->endpoints_tried & (1u << i))
+            continue;
+
+        int score = rtsp_health_score(session->endpoints[i].host, session->endpoints[i].port);
+        if (best < 0 || score > best_score + RTSP_ENDPOINT_SCORE_MARGIN)
+        {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    return best;
+}
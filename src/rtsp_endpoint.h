@@ -0,0 +1,39 @@
+#ifndef __RTSP_ENDPOINT_H__
+#define __RTSP_ENDPOINT_H__
+
+#include "rtsp.h"
+
+/**
+ * Failover endpoint lists of RTSP URLs (rtsp://host1:port1,host2:port2/path)
+ */
+
+/* Later endpoints must beat earlier ones by this many health points */
+#define RTSP_ENDPOINT_SCORE_MARGIN 10
+
+/**
+ * Parse one "host[:port]" or "[v6addr][:port]" entry of the URL authority
+ * @param hostport Entry (modified)
+ * @param endpoint Parsed host and port (554 if none is given)
+ * @return 0 on success, -1 on error
+ */
+int rtsp_parse_endpoint(char *hostport, rtsp_endpoint_t *endpoint);
+
+/**
+ * Parse the comma-separated endpoint list of the URL authority
+ * Entries beyond RTSP_MAX_ENDPOINTS are ignored.
+ * @param list Host part of the authority (modified)
+ * @param endpoints Array of RTSP_MAX_ENDPOINTS entries
+ * @param count Set to the number of endpoints parsed
+ * @return 0 on success, -1 if an entry is invalid
+ */
+int rtsp_parse_endpoints(char *list, rtsp_endpoint_t *endpoints, int *count);
+
+/**
+ * Pick the best endpoint not tried yet in this session
+ * Endpoints keep list order unless a later one scores clearly better.
+ * @param session RTSP session with its endpoint list
+ * @return Endpoint index, or -1 if all endpoints were tried
+ */
+int rtsp_pick_endpoint(const rtsp_session_t *session);
+
+#endif /* __RTSP_ENDPOINT_H__ */
@@ -0,0 +1,109 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "rtsp_health.h"
+#include "rtp2httpd.h"
+#include "status.h"
+
+/* Failure rate contributes up to 100 points, latency up to 50 (at 5s and above) */
+#define RTSP_HEALTH_LATENCY_CAP_MS 5000
+#define RTSP_HEALTH_LATENCY_PENALTY_MAX 50
+
+/* Fallback table when shared memory status is unavailable */
+static rtsp_endpoint_stats_t local_endpoints[STATUS_MAX_RTSP_ENDPOINTS];
+
+static rtsp_endpoint_stats_t *rtsp_health_table(void)
+{
+    if (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS)
+        return status_shared->worker_stats[worker_id].rtsp_endpoints;
+    return local_endpoints;
+}
+
+static rtsp_endpoint_stats_t *rtsp_health_find(const char *host, int port, int create)
+{
+    rtsp_endpoint_stats_t *table = rtsp_health_table();
+    rtsp_endpoint_stats_t *slot = NULL;
+
+    for (int i = 0; i < STATUS_MAX_RTSP_ENDPOINTS; i++)
+    {
+        rtsp_endpoint_stats_t *e = &table[i];
+        if (e->active && e->port == port && strcasecmp(e->host, host) == 0)
+            return e;
+
+        /* Remember a free slot, or the least recently updated one */
+        if (!slot || (slot->active && (!e->active || e->last_update < slot->last_update)))
+            slot = e;
+    }
+
+    if (!create)
+        return NULL;
+
+    memset(slot, 0, sizeof(*slot));
+    snprintf(slot->host, sizeof(slot->host), "%s", host);
+    slot->port = port;
+    slot->score = RTSP_HEALTH_SCORE_UNKNOWN;
+    slot->active = 1;
+    return slot;
+}
+
+static void rtsp_health_update_score(rtsp_endpoint_stats_t *e)
+{
+    uint32_t latency = min(e->latency_ms, (uint32_t)RTSP_HEALTH_LATENCY_CAP_MS);
+    int score = 100 - (int)(e->failure_permille / 10) -
+                (int)(latency * RTSP_HEALTH_LATENCY_PENALTY_MAX / RTSP_HEALTH_LATENCY_CAP_MS);
+    e->score = max(score, 0);
+}
+
+void rtsp_health_record(const char *host, int port, rtsp_health_event_t event, int64_t latency_ms)
+{
+    rtsp_endpoint_stats_t *e;
+
+    if (!host || !host[0])
+        return;
+
+    e = rtsp_health_find(host, port, 1);
+    e->last_update = get_time_ms();
+
+    switch (event)
+    {
+    case RTSP_HEALTH_ATTEMPT:
+        e->attempts++;
+        return;
+
+    case RTSP_HEALTH_SUCCESS:
+        if (latency_ms < 0)
+            latency_ms = 0;
+        /* EWMA with alpha = 1/4; first sample initializes */
+        if (e->latency_ms == 0)
+            e->latency_ms = (uint32_t)min(latency_ms, (int64_t)UINT32_MAX);
+        else
+            e->latency_ms = (uint32_t)((e->latency_ms * 3 + (uint64_t)min(latency_ms, (int64_t)UINT32_MAX)) / 4);
+        e->failure_permille = e->failure_permille * 3 / 4;
+        break;
+
+    case RTSP_HEALTH_STALL:
+        e->stalls++;
+        /* fall through - a stall counts as a failed handshake */
+    case RTSP_HEALTH_FAILURE:
+        e->failures++;
+        e->failure_permille = e->failure_permille * 3 / 4 + 250;
+        break;
+    }
+
+    rtsp_health_update_score(e);
+}
+
+int rtsp_health_score(const char *host, int port)
+{
+    rtsp_endpoint_stats_t *e;
+
+    if (!host || !host[0])
+        return RTSP_HEALTH_SCORE_UNKNOWN;
+
+    e = rtsp_health_find(host, port, 0);
+    return e ? e->score : RTSP_HEALTH_SCORE_UNKNOWN;
+}
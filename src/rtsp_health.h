@@ -0,0 +1,43 @@
+#ifndef __RTSP_HEALTH_H__
+#define __RTSP_HEALTH_H__
+
+#include <stdint.h>
+
+/**
+ * Per-worker RTSP endpoint health scoring
+ *
+ * Each worker keeps a small table of RTSP servers it talked to recently
+ * (in its worker_stats_t slot, so the status page can show it). The score
+ * is used to pick the best endpoint of a failover list
+ * (rtsp://host1:port1,host2:port2/path).
+ */
+
+/* Score given to endpoints without history */
+#define RTSP_HEALTH_SCORE_UNKNOWN 100
+
+typedef enum
+{
+    RTSP_HEALTH_ATTEMPT = 0, /* Handshake started */
+    RTSP_HEALTH_SUCCESS,     /* Handshake reached PLAYING */
+    RTSP_HEALTH_FAILURE,     /* Handshake failed (connect error, error status, server close) */
+    RTSP_HEALTH_STALL        /* Handshake made no progress within the stall threshold */
+} rtsp_health_event_t;
+
+/**
+ * Record a handshake event for an endpoint
+ * @param host RTSP server host
+ * @param port RTSP server port
+ * @param event Event type
+ * @param latency_ms Handshake latency (only used for RTSP_HEALTH_SUCCESS)
+ */
+void rtsp_health_record(const char *host, int port, rtsp_health_event_t event, int64_t latency_ms);
+
+/**
+ * Get current health score of an endpoint
+ * @param host RTSP server host
+ * @param port RTSP server port
+ * @return Score 0-100 (higher is better), RTSP_HEALTH_SCORE_UNKNOWN if no history
+ */
+int rtsp_health_score(const char *host, int port);
+
+#endif /* __RTSP_HEALTH_H__ */
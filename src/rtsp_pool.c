@@ -0,0 +1,491 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rtsp_pool.h"
+#include "rtsp.h"
+#include "rtp2httpd.h"
+#include "connection.h"
+#include "multicast.h"
+
+#define RTSP_POOL_USER_AGENT "rtp2httpd/" VERSION
+
+#define RTSP_POOL_DEMAND_WINDOW_MS 60000    /* Demand is counted per 60s window */
+#define RTSP_POOL_HEALTH_INTERVAL_MS 20000  /* OPTIONS health check interval for idle sockets */
+#define RTSP_POOL_CHECK_TIMEOUT_MS 5000     /* Timeout for connect and OPTIONS response */
+#define RTSP_POOL_MAX_AGE_MS 300000         /* Recycle idle sockets after 5 minutes */
+#define RTSP_POOL_RETRY_BACKOFF_MS 10000    /* Back off after a failed connect/check */
+#define RTSP_POOL_RESPONSE_BUFFER_SIZE 1024 /* OPTIONS response headers */
+
+typedef enum
+{
+    RTSP_POOL_SLOT_FREE = 0,
+    RTSP_POOL_SLOT_CONNECTING, /* Async TCP connect in progress */
+    RTSP_POOL_SLOT_CHECKING,   /* OPTIONS sent, waiting for response */
+    RTSP_POOL_SLOT_IDLE        /* Healthy and ready to be acquired */
+} rtsp_pool_slot_state_t;
+
+typedef struct
+{
+    int fd;
+    rtsp_pool_slot_state_t state;
+    uint32_t cseq;         /* Next CSeq to use on this connection */
+    int64_t created_ms;    /* When the TCP connection was initiated */
+    int64_t deadline_ms;   /* Timeout for CONNECTING/CHECKING */
+    int64_t last_check_ms; /* Last successful OPTIONS response */
+    size_t response_len;
+    char response[RTSP_POOL_RESPONSE_BUFFER_SIZE];
+} rtsp_pool_slot_t;
+
+typedef struct
+{
+    int in_use;
+    char host[RTSP_SERVER_HOST_SIZE];
+    int port;
+    struct in_addr addr;    /* Server address: numeric host, or as last resolved by a session */
+    int has_addr;           /* addr is known */
+    uint32_t demand;        /* Sessions started in current window */
+    uint32_t demand_prev;   /* Sessions started in previous window */
+    int64_t window_start_ms;
+    int64_t retry_after_ms; /* No new connects before this time */
+    rtsp_pool_slot_t slots[RTSP_POOL_MAX_PER_HOST];
+} rtsp_pool_host_t;
+
+static rtsp_pool_host_t pool_hosts[RTSP_POOL_MAX_HOSTS];
+static int pool_epfd = -1;
+static int pool_socket_count = 0;
+
+static int rtsp_pool_limit(void)
+{
+    if (config.rtsp_warm_pool <= 0)
+        return 0;
+    return min(config.rtsp_warm_pool, RTSP_POOL_MAX_PER_HOST);
+}
+
+static void rtsp_pool_slot_close(rtsp_pool_host_t *h, rtsp_pool_slot_t *slot, const char *reason)
+{
+    if (slot->fd >= 0)
+    {
+        if (pool_epfd >= 0)
+            epoll_ctl(pool_epfd, EPOLL_CTL_DEL, slot->fd, NULL);
+        close(slot->fd);
+        pool_socket_count--;
+        logger(LOG_DEBUG, "RTSP pool: Closed connection to %s:%d (%s)", h->host, h->port, reason);
+    }
+    slot->fd = -1;
+    slot->state = RTSP_POOL_SLOT_FREE;
+    slot->response_len = 0;
+}
+
+/* Close a slot because the server misbehaved, and back off before refilling */
+static void rtsp_pool_slot_fail(rtsp_pool_host_t *h, rtsp_pool_slot_t *slot, const char *reason, int64_t now)
+{
+    rtsp_pool_slot_close(h, slot, reason);
+    h->retry_after_ms = now + RTSP_POOL_RETRY_BACKOFF_MS;
+}
+
+static void rtsp_pool_host_release(rtsp_pool_host_t *h)
+{
+    for (int i = 0; i < RTSP_POOL_MAX_PER_HOST; i++)
+        rtsp_pool_slot_close(h, &h->slots[i], "host released");
+    h->in_use = 0;
+}
+
+static rtsp_pool_host_t *rtsp_pool_get_host(const char *host, int port, int64_t now)
+{
+    rtsp_pool_host_t *free_entry = NULL;
+    rtsp_pool_host_t *victim = NULL;
+
+    for (int i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        rtsp_pool_host_t *h = &pool_hosts[i];
+        if (!h->in_use)
+        {
+            if (!free_entry)
+                free_entry = h;
+            continue;
+        }
+        if (h->port == port && strcasecmp(h->host, host) == 0)
+            return h;
+        if (!victim || max(h->demand, h->demand_prev) < max(victim->demand, victim->demand_prev))
+            victim = h;
+    }
+
+    /* Table full: evict the least demanded host */
+    if (!free_entry)
+    {
+        rtsp_pool_host_release(victim);
+        free_entry = victim;
+    }
+
+    memset(free_entry, 0, sizeof(*free_entry));
+    free_entry->in_use = 1;
+    snprintf(free_entry->host, sizeof(free_entry->host), "%s", host);
+    free_entry->port = port;
+    free_entry->has_addr = inet_pton(AF_INET, host, &free_entry->addr) == 1;
+    free_entry->window_start_ms = now;
+    for (int i = 0; i < RTSP_POOL_MAX_PER_HOST; i++)
+        free_entry->slots[i].fd = -1;
+    return free_entry;
+}
+
+static int rtsp_pool_slot_set_events(rtsp_pool_slot_t *slot, uint32_t events, int op)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLHUP | EPOLLERR | EPOLLRDHUP;
+    ev.data.fd = slot->fd;
+    return epoll_ctl(pool_epfd, op, slot->fd, &ev);
+}
+
+static int rtsp_pool_slot_send_options(rtsp_pool_host_t *h, rtsp_pool_slot_t *slot, int64_t now)
+{
+    char request[RTSP_POOL_RESPONSE_BUFFER_SIZE];
+    int len = snprintf(request, sizeof(request),
+                       "OPTIONS rtsp://%s:%d/ RTSP/1.0\r\n"
+                       "CSeq: %u\r\n"
+                       "User-Agent: %s\r\n"
+                       "\r\n",
+                       h->host, h->port, slot->cseq++, RTSP_POOL_USER_AGENT);
+    if (len < 0 || (size_t)len >= sizeof(request))
+        return -1;
+
+    /* Request is tiny, so a partial send on an idle socket means something is wrong */
+    if (send(slot->fd, request, (size_t)len, MSG_NOSIGNAL | MSG_DONTWAIT) != len)
+        return -1;
+
+    if (rtsp_pool_slot_set_events(slot, EPOLLIN, EPOLL_CTL_MOD) < 0)
+        return -1;
+
+    slot->state = RTSP_POOL_SLOT_CHECKING;
+    slot->response_len = 0;
+    slot->deadline_ms = now + RTSP_POOL_CHECK_TIMEOUT_MS;
+    return 0;
+}
+
+static void rtsp_pool_slot_connect(rtsp_pool_host_t *h, rtsp_pool_slot_t *slot, int64_t now)
+{
+    struct sockaddr_in server_addr;
+    int fd;
+
+    /* Wait for a session to resolve the name (rtsp_pool_set_address()) */
+    if (!h->has_addr)
+        return;
+
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        h->retry_after_ms = now + RTSP_POOL_RETRY_BACKOFF_MS;
+        return;
+    }
+    if (connection_set_nonblocking(fd) < 0)
+    {
+        close(fd);
+        h->retry_after_ms = now + RTSP_POOL_RETRY_BACKOFF_MS;
+        return;
+    }
+    bind_to_upstream_interface(fd, get_upstream_interface_for_rtsp());
+
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(h->port);
+    server_addr.sin_addr = h->addr;
+
+    if (connect(fd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0 && errno != EINPROGRESS)
+    {
+        logger(LOG_DEBUG, "RTSP pool: Failed to connect to %s:%d: %s", h->host, h->port, strerror(errno));
+        close(fd);
+        h->retry_after_ms = now + RTSP_POOL_RETRY_BACKOFF_MS;
+        return;
+    }
+
+    slot->fd = fd;
+    slot->state = RTSP_POOL_SLOT_CONNECTING;
+    slot->cseq = 1;
+    slot->created_ms = now;
+    slot->deadline_ms = now + RTSP_POOL_CHECK_TIMEOUT_MS;
+    slot->last_check_ms = 0;
+    slot->response_len = 0;
+    pool_socket_count++;
+
+    /* Completion (or immediate success) is reported as EPOLLOUT */
+    if (rtsp_pool_slot_set_events(slot, EPOLLOUT, EPOLL_CTL_ADD) < 0)
+    {
+        rtsp_pool_slot_fail(h, slot, "epoll registration failed", now);
+        return;
+    }
+
+    logger(LOG_DEBUG, "RTSP pool: Warming connection to %s:%d", h->host, h->port);
+}
+
+/**
+ * Read OPTIONS response on a CHECKING slot
+ * Returns: 1 = complete and healthy, 0 = need more data, -1 = unhealthy
+ */
+static int rtsp_pool_slot_read_response(rtsp_pool_slot_t *slot)
+{
+    size_t space = sizeof(slot->response) - 1 - slot->response_len;
+    ssize_t n;
+
+    if (space == 0)
+        return -1;
+
+    n = recv(slot->fd, slot->response + slot->response_len, space, MSG_DONTWAIT);
+    if (n == 0)
+        return -1;
+    if (n < 0)
+        return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+    slot->response_len += (size_t)n;
+    slot->response[slot->response_len] = '\0';
+
+    if (!strstr(slot->response, "\r\n\r\n"))
+        return 0;
+
+    /* Any RTSP status line proves the server is alive (even 401 for protected servers) */
+    if (strncmp(slot->response, "RTSP/", 5) != 0)
+        return -1;
+
+    slot->response_len = 0;
+    return 1;
+}
+
+void rtsp_pool_init(int epfd)
+{
+    memset(pool_hosts, 0, sizeof(pool_hosts));
+    pool_epfd = epfd;
+    pool_socket_count = 0;
+}
+
+int rtsp_pool_acquire(const char *host, int port, uint32_t *next_cseq)
+{
+    rtsp_pool_host_t *h;
+    int64_t now;
+
+    if (!host || !host[0] || rtsp_pool_limit() == 0 || pool_epfd < 0)
+        return -1;
+
+    now = get_time_ms();
+    h = rtsp_pool_get_host(host, port, now);
+    h->demand++;
+
+    for (int i = 0; i < RTSP_POOL_MAX_PER_HOST; i++)
+    {
+        rtsp_pool_slot_t *slot = &h->slots[i];
+        char probe;
+        ssize_t n;
+        int fd;
+
+        if (slot->state != RTSP_POOL_SLOT_IDLE)
+            continue;
+
+        /* Make sure the server has not closed or written to the socket since the last check */
+        n = recv(slot->fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n >= 0 || errno != EAGAIN)
+        {
+            rtsp_pool_slot_close(h, slot, "stale on acquire");
+            continue;
+        }
+
+        fd = slot->fd;
+        epoll_ctl(pool_epfd, EPOLL_CTL_DEL, fd, NULL);
+        if (next_cseq)
+            *next_cseq = slot->cseq;
+
+        slot->fd = -1;
+        slot->state = RTSP_POOL_SLOT_FREE;
+        pool_socket_count--;
+
+        logger(LOG_DEBUG, "RTSP pool: Reusing warm connection to %s:%d", h->host, h->port);
+        return fd;
+    }
+
+    return -1;
+}
+
+void rtsp_pool_set_address(const char *host, int port, const struct in_addr *addr)
+{
+    for (int i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        rtsp_pool_host_t *h = &pool_hosts[i];
+        if (h->in_use && h->port == port && strcasecmp(h->host, host) == 0)
+        {
+            h->addr = *addr;
+            h->has_addr = 1;
+            return;
+        }
+    }
+}
+
+int rtsp_pool_handle_event(int fd, uint32_t events)
+{
+    if (pool_socket_count == 0 || fd < 0)
+        return 0;
+
+    for (int i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        rtsp_pool_host_t *h = &pool_hosts[i];
+        if (!h->in_use)
+            continue;
+
+        for (int j = 0; j < RTSP_POOL_MAX_PER_HOST; j++)
+        {
+            rtsp_pool_slot_t *slot = &h->slots[j];
+            int64_t now;
+
+            if (slot->fd != fd)
+                continue;
+
+            now = get_time_ms();
+            switch (slot->state)
+            {
+            case RTSP_POOL_SLOT_CONNECTING:
+            {
+                int sock_error = 0;
+                socklen_t error_len = sizeof(sock_error);
+
+                if ((events & (EPOLLERR | EPOLLHUP)) ||
+                    getsockopt(fd, SOL_SOCKET, SO_ERROR, &sock_error, &error_len) < 0 || sock_error != 0)
+                {
+                    rtsp_pool_slot_fail(h, slot, "connect failed", now);
+                }
+                else if ((events & EPOLLOUT) && rtsp_pool_slot_send_options(h, slot, now) < 0)
+                {
+                    rtsp_pool_slot_fail(h, slot, "OPTIONS send failed", now);
+                }
+                break;
+            }
+
+            case RTSP_POOL_SLOT_CHECKING:
+            {
+                int result = 0;
+
+                if (events & EPOLLIN)
+                    result = rtsp_pool_slot_read_response(slot);
+                if (result == 0 && (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)))
+                    result = -1;
+
+                if (result < 0)
+                {
+                    rtsp_pool_slot_fail(h, slot, "health check failed", now);
+                }
+                else if (result > 0)
+                {
+                    slot->state = RTSP_POOL_SLOT_IDLE;
+                    slot->last_check_ms = now;
+                }
+                break;
+            }
+
+            default:
+                /* Idle socket became readable: server closed it or sent unsolicited data */
+                rtsp_pool_slot_close(h, slot, "closed by server");
+                break;
+            }
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void rtsp_pool_tick(int64_t now)
+{
+    int limit = rtsp_pool_limit();
+
+    for (int i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        rtsp_pool_host_t *h = &pool_hosts[i];
+        int live = 0;
+        int target;
+
+        if (!h->in_use)
+            continue;
+
+        /* Rotate demand window; two idle windows make the host cold */
+        if (now - h->window_start_ms >= RTSP_POOL_DEMAND_WINDOW_MS)
+        {
+            h->demand_prev = (now - h->window_start_ms >= 2 * RTSP_POOL_DEMAND_WINDOW_MS) ? 0 : h->demand;
+            h->demand = 0;
+            h->window_start_ms = now;
+        }
+
+        target = min(limit, (int)max(h->demand, h->demand_prev));
+        if (target == 0)
+        {
+            rtsp_pool_host_release(h);
+            continue;
+        }
+
+        for (int j = 0; j < RTSP_POOL_MAX_PER_HOST; j++)
+        {
+            rtsp_pool_slot_t *slot = &h->slots[j];
+
+            switch (slot->state)
+            {
+            case RTSP_POOL_SLOT_CONNECTING:
+            case RTSP_POOL_SLOT_CHECKING:
+                if (now >= slot->deadline_ms)
+                    rtsp_pool_slot_fail(h, slot, "timeout", now);
+                break;
+
+            case RTSP_POOL_SLOT_IDLE:
+                if (now - slot->created_ms >= RTSP_POOL_MAX_AGE_MS)
+                    rtsp_pool_slot_close(h, slot, "max age reached");
+                else if (now - slot->last_check_ms >= RTSP_POOL_HEALTH_INTERVAL_MS &&
+                         rtsp_pool_slot_send_options(h, slot, now) < 0)
+                    rtsp_pool_slot_fail(h, slot, "OPTIONS send failed", now);
+                break;
+
+            default:
+                break;
+            }
+
+            if (slot->state != RTSP_POOL_SLOT_FREE)
+                live++;
+        }
+
+        /* Shrink idle sockets above target */
+        for (int j = 0; j < RTSP_POOL_MAX_PER_HOST && live > target; j++)
+        {
+            if (h->slots[j].state == RTSP_POOL_SLOT_IDLE)
+            {
+                rtsp_pool_slot_close(h, &h->slots[j], "demand dropped");
+                live--;
+            }
+        }
+
+        /* Grow by at most one socket per tick to spread connects */
+        if (live < target && now >= h->retry_after_ms)
+        {
+            for (int j = 0; j < RTSP_POOL_MAX_PER_HOST; j++)
+            {
+                if (h->slots[j].state == RTSP_POOL_SLOT_FREE)
+                {
+                    rtsp_pool_slot_connect(h, &h->slots[j], now);
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void rtsp_pool_cleanup(void)
+{
+    for (int i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        if (pool_hosts[i].in_use)
+            rtsp_pool_host_release(&pool_hosts[i]);
+    }
+    pool_socket_count = 0;
+}
@@ -0,0 +1,76 @@
+#ifndef __RTSP_POOL_H__
+#define __RTSP_POOL_H__
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+ * Warm RTSP connection pool (per worker)
+ *
+ * Keeps a small number of idle, already-connected TCP sockets to the RTSP
+ * servers that were used recently. New sessions and TEARDOWN reconnects take
+ * a socket from the pool instead of paying a fresh TCP handshake.
+ *
+ * - Pool size per host follows recent demand (sessions started per window)
+ *   and is capped by config.rtsp_warm_pool
+ * - Idle sockets are health-checked with OPTIONS and recycled periodically
+ * - Host names are not resolved here (the tick runs on the event loop):
+ *   sockets go to numeric hosts, or to the address a session resolved
+ * - Pool sockets are registered with the worker epoll instance directly
+ *   (not in fdmap); the worker dispatches their events via
+ *   rtsp_pool_handle_event()
+ */
+
+/* Maximum number of distinct RTSP servers tracked per worker */
+#define RTSP_POOL_MAX_HOSTS 8
+
+/* Hard upper bound of idle sockets per server (config is clamped to this) */
+#define RTSP_POOL_MAX_PER_HOST 4
+
+/**
+ * Initialize the pool for this worker
+ * @param epfd Worker epoll file descriptor
+ */
+void rtsp_pool_init(int epfd);
+
+/**
+ * Take a healthy idle socket to host:port out of the pool
+ * Also records demand for the host so the pool can warm up for next time.
+ * The returned socket is connected, non-blocking and no longer registered
+ * with epoll; the caller owns it.
+ * @param host RTSP server hostname (as in the URL)
+ * @param port RTSP server port
+ * @param next_cseq Output: next CSeq value to use on this connection
+ * @return Socket fd on success, -1 if no warm socket is available
+ */
+int rtsp_pool_acquire(const char *host, int port, uint32_t *next_cseq);
+
+/**
+ * Remember the address a session resolved for host:port
+ * Warm sockets to a named host are only opened once its address is known.
+ * @param host RTSP server hostname (as in the URL)
+ * @param port RTSP server port
+ * @param addr Resolved IPv4 address
+ */
+void rtsp_pool_set_address(const char *host, int port, const struct in_addr *addr);
+
+/**
+ * Handle epoll event for a pool socket
+ * @param fd File descriptor from epoll event
+ * @param events Epoll events
+ * @return 1 if fd belongs to the pool (event consumed), 0 otherwise
+ */
+int rtsp_pool_handle_event(int fd, uint32_t events);
+
+/**
+ * Periodic maintenance: demand decay, refill, health checks and timeouts
+ * @param now Current time in milliseconds
+ */
+void rtsp_pool_tick(int64_t now);
+
+/**
+ * Close all pool sockets
+ */
+void rtsp_pool_cleanup(void);
+
+#endif /* __RTSP_POOL_H__ */
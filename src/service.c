@@ -8,6 +8,7 @@
 #include <strings.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
@@ -1451,6 +1452,153 @@ void service_free(service_t *service)
     free(service);
 }
 
+/*
+ * Name index over the global services list
+ * Open addressing with linear probing; the table is at most half full.
+ * Removal only happens in bulk (external M3U reload), so instead of
+ * tombstones the index is rebuilt from the remaining list.
+ */
+#define SERVICE_INDEX_MIN_SLOTS 64
+
+typedef struct
+{
+    uint32_t hash;
+    service_t *service; /* NULL = empty slot */
+} service_index_slot_t;
+
+static service_index_slot_t *service_index;
+static size_t service_index_slots; /* Power of two */
+static size_t service_index_count;
+static int service_index_degraded; /* A service could not be indexed - walk the list */
+static service_t **services_tail = &services; /* Append point of the global list */
+
+/* FNV-1a */
+static uint32_t service_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while (*name)
+    {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void service_index_insert(service_t *service, uint32_t hash)
+{
+    size_t mask = service_index_slots - 1;
+    size_t i = hash & mask;
+
+    while (service_index[i].service)
+    {
+        /* Keep the first service of a name, as a list walk would find it */
+        if (service_index[i].hash == hash && strcmp(service_index[i].service->url, service->url) == 0)
+            return;
+        i = (i + 1) & mask;
+    }
+    service_index[i].hash = hash;
+    service_index[i].service = service;
+    service_index_count++;
+}
+
+static int service_index_resize(size_t slots)
+{
+    service_index_slot_t *old = service_index;
+    size_t old_slots = service_index_slots;
+
+    service_index_slot_t *table = calloc(slots, sizeof(*table));
+    if (!table)
+    {
+        logger(LOG_ERROR, "Failed to allocate service index (%zu slots)", slots);
+        return -1;
+    }
+
+    service_index = table;
+    service_index_slots = slots;
+    service_index_count = 0;
+    for (size_t i = 0; i < old_slots; i++)
+    {
+        if (old[i].service)
+            service_index_insert(old[i].service, old[i].hash);
+    }
+    free(old);
+    return 0;
+}
+
+static void service_index_add(service_t *service)
+{
+    if (!service->url)
+        return;
+
+    if ((service_index_count + 1) * 2 > service_index_slots)
+    {
+        size_t slots = service_index_slots ? service_index_slots * 2 : SERVICE_INDEX_MIN_SLOTS;
+        if (service_index_resize(slots) < 0)
+        {
+            service_index_degraded = 1; /* service_find() falls back to the list */
+            return;
+        }
+    }
+    service_index_insert(service, service_name_hash(service->url));
+}
+
+void service_index_reset(void)
+{
+    free(service_index);
+    service_index = NULL;
+    service_index_slots = 0;
+    service_index_count = 0;
+    service_index_degraded = 0;
+
+    services_tail = &services;
+    while (*services_tail)
+        services_tail = &(*services_tail)->next;
+}
+
+static void service_index_rebuild(void)
+{
+    service_index_reset();
+    for (service_t *s = services; s; s = s->next)
+        service_index_add(s);
+}
+
+void service_register(service_t *service)
+{
+    service->next = NULL;
+    *services_tail = service;
+    services_tail = &service->next;
+    service_index_add(service);
+}
+
+service_t *service_find(const char *name)
+{
+    service_t *service;
+
+    if (!name)
+        return NULL;
+
+    if (unlikely(service_index_degraded))
+    {
+        for (service = services; service; service = service->next)
+        {
+            if (service->url && strcmp(name, service->url) == 0)
+                return service;
+        }
+        return NULL;
+    }
+    if (!service_index)
+        return NULL;
+
+    uint32_t hash = service_name_hash(name);
+    size_t mask = service_index_slots - 1;
+    for (size_t i = hash & mask; (service = service_index[i].service) != NULL; i = (i + 1) & mask)
+    {
+        if (service_index[i].hash == hash && strcmp(service->url, name) == 0)
+            return service;
+    }
+    return NULL;
+}
+
 void service_free_external(void)
 {
     service_t **current_ptr = &services;
@@ -1475,5 +1623,79 @@ void service_free_external(void)
         }
     }
 
+    service_index_rebuild();
+
     logger(LOG_INFO, "Freed %d external M3U services", freed_count);
 }
+
+static int service_addr_equal(const struct addrinfo *a, const struct addrinfo *b)
+{
+    if (!a || !b)
+        return a == b;
+    return a->ai_addrlen == b->ai_addrlen && memcmp(a->ai_addr, b->ai_addr, a->ai_addrlen) == 0;
+}
+
+int service_same_mcast_group(const service_t *a, const service_t *b)
+{
+    if (!a || !b || a->service_type != SERVICE_MRTP || b->service_type != SERVICE_MRTP)
+        return 0;
+    return service_addr_equal(a->addr, b->addr) && service_addr_equal(a->msrc_addr, b->msrc_addr);
+}
+
+static uint32_t service_hash_bytes(uint32_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    while (len--)
+    {
+        hash ^= *p++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t service_mcast_group_hash(const service_t *service)
+{
+    if (!service || service->service_type != SERVICE_MRTP || !service->addr)
+        return 0;
+
+    uint32_t hash = service_hash_bytes(2166136261u, service->addr->ai_addr, service->addr->ai_addrlen);
+    if (service->msrc_addr)
+        hash = service_hash_bytes(hash, service->msrc_addr->ai_addr, service->msrc_addr->ai_addrlen);
+    return hash;
+}
+
+int service_upstream_key(const service_t *service, char *key, size_t key_size)
+{
+    const char *url = service->rtsp_url ? service->rtsp_url : service->rtp_url ? service->rtp_url : service->url;
+    size_t len = 0;
+
+    if (!url)
+        return -1;
+
+    const char *query = strchr(url, '?');
+    size_t base_len = query ? (size_t)(query - url) : strlen(url);
+    if (base_len >= key_size)
+        return -1;
+    memcpy(key, url, base_len);
+    len = base_len;
+
+    while (query && *query)
+    {
+        const char *param = query + 1;
+        const char *end = strchr(param, '&');
+        size_t param_len = end ? (size_t)(end - param) : strlen(param);
+        query = end;
+
+        if (param_len == 0 || strncmp(param, "snapshot=", 9) == 0 || strncmp(param, "r2h-token=", 10) == 0)
+            continue;
+        if (len + 1 + param_len >= key_size)
+            return -1;
+        key[len] = len == base_len ? '?' : '&';
+        len++;
+        memcpy(key + len, param, param_len);
+        len += param_len;
+    }
+
+    key[len] = '\0';
+    return 0;
+}
@@ -151,4 +151,56 @@ void service_free(service_t *service);
  */
 void service_free_external(void);
 
+/**
+ * Append a service to the global services list and the name index
+ * The list takes ownership of the service.
+ *
+ * @param service Service with url (name) set
+ */
+void service_register(service_t *service);
+
+/**
+ * Find a configured service by name (service->url) in O(1)
+ * Returns the first registered service with that name, like a list walk.
+ *
+ * @param name Service name (decoded request path)
+ * @return Service from the global list, or NULL if none matches
+ */
+service_t *service_find(const char *name);
+
+/**
+ * Forget all indexed services, to be called after the global list has
+ * been freed by other means (e.g. configuration reload)
+ */
+void service_index_reset(void);
+
+/**
+ * Check whether two multicast services receive the same channel
+ * (same group address and port, same source filter)
+ *
+ * @return 1 if both services map to the same multicast group, 0 otherwise
+ */
+int service_same_mcast_group(const service_t *a, const service_t *b);
+
+/**
+ * Hash of the multicast group (and source) a service receives
+ * Services that are service_same_mcast_group() hash equally.
+ *
+ * @param service Multicast service
+ * @return Channel hash, 0 if the service has no multicast address
+ */
+uint32_t service_mcast_group_hash(const service_t *service);
+
+/**
+ * Upstream URL of a service without the query parameters that only
+ * concern this server (snapshot=, r2h-token=)
+ * Services with equal keys receive the same content.
+ *
+ * @param service Service
+ * @param key Output buffer
+ * @param key_size Size of key
+ * @return 0 on success, -1 if the service has no URL or it does not fit
+ */
+int service_upstream_key(const service_t *service, char *key, size_t key_size);
+
 #endif /* SERVICE_H */
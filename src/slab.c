@@ -0,0 +1,72 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include "slab.h"
+#include "rtp2httpd.h"
+
+typedef struct slab_chunk_s
+{
+    struct slab_chunk_s *next;
+} slab_chunk_t;
+
+/* Chunk header is padded so the first object stays cache aligned */
+#define SLAB_CHUNK_HEADER ((sizeof(slab_chunk_t) + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1))
+
+size_t slab_object_size(const slab_t *slab)
+{
+    size_t size = slab->obj_size < sizeof(void *) ? sizeof(void *) : slab->obj_size;
+    return (size + SLAB_ALIGNMENT - 1) & ~(size_t)(SLAB_ALIGNMENT - 1);
+}
+
+static int slab_grow(slab_t *slab)
+{
+    size_t stride = slab_object_size(slab);
+    size_t count = slab->objs_per_chunk > 0 ? slab->objs_per_chunk : 1;
+    void *mem = NULL;
+
+    if (posix_memalign(&mem, SLAB_ALIGNMENT, SLAB_CHUNK_HEADER + stride * count) != 0)
+    {
+        logger(LOG_ERROR, "Slab %s: failed to allocate %zu objects", slab->name, count);
+        return -1;
+    }
+
+    slab_chunk_t *chunk = mem;
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+
+    /* Push in reverse so objects are handed out in address order */
+    char *base = (char *)mem + SLAB_CHUNK_HEADER;
+    for (size_t i = count; i-- > 0;)
+    {
+        void *obj = base + i * stride;
+        *(void **)obj = slab->free_list;
+        slab->free_list = obj;
+    }
+    slab->total_objs += count;
+    return 0;
+}
+
+void *slab_alloc(slab_t *slab)
+{
+    if (!slab->free_list && slab_grow(slab) < 0)
+        return NULL;
+
+    void *obj = slab->free_list;
+    slab->free_list = *(void **)obj;
+    slab->used_objs++;
+    memset(obj, 0, slab->obj_size);
+    return obj;
+}
+
+void slab_free(slab_t *slab, void *obj)
+{
+    if (!obj)
+        return;
+
+    *(void **)obj = slab->free_list;
+    slab->free_list = obj;
+    slab->used_objs--;
+}
@@ -0,0 +1,49 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+#define SLAB_ALIGNMENT 64
+
+/**
+ * Fixed-size object cache for per-connection state that only some
+ * connections need (request buffer, RTSP/FCC/snapshot sessions).
+ * Objects are carved from cache-aligned chunks and recycled through a
+ * free list; chunks stay with the worker for reuse. Each worker process
+ * owns its slabs, so no locking is done.
+ */
+typedef struct slab_s
+{
+    const char *name;
+    size_t obj_size;       /* Requested object size */
+    size_t objs_per_chunk; /* Objects carved from each chunk */
+    void *free_list;       /* Free objects, linked through their first word */
+    struct slab_chunk_s *chunks;
+    size_t total_objs; /* Objects carved so far */
+    size_t used_objs;  /* Objects currently handed out */
+} slab_t;
+
+#define SLAB_INITIALIZER(name, size, per_chunk) {(name), (size), (per_chunk), NULL, NULL, 0, 0}
+
+/**
+ * Allocate a zeroed object, adding a chunk when the free list is empty
+ * @param slab Slab to allocate from
+ * @return Object pointer, or NULL if out of memory
+ */
+void *slab_alloc(slab_t *slab);
+
+/**
+ * Return an object to its slab
+ * @param slab Slab the object was allocated from
+ * @param obj Object pointer (NULL is ignored)
+ */
+void slab_free(slab_t *slab, void *obj);
+
+/**
+ * Bytes one object occupies, including alignment padding
+ * @param slab Slab
+ * @return Stride of objects in a chunk
+ */
+size_t slab_object_size(const slab_t *slab);
+
+#endif /* SLAB_H */
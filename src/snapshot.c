@@ -12,17 +12,25 @@
 #include <sys/sendfile.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <spawn.h>
 
 #include "snapshot.h"
 #include "rtp2httpd.h"
 #include "rtp.h"
 #include "connection.h"
 #include "http.h"
+#include "worker.h"
+#include "snapshot_cache.h"
+#include "snapshot_decoder.h"
+#include "ts_scan.h"
 
-/* MPEG2-TS constants */
-#define TS_PACKET_SIZE 188
-#define TS_SYNC_BYTE 0x47
-#define TS_PAT_PID 0x0000
+/* PMT stream types */
+#define TS_STREAM_TYPE_H264 0x1B
+#define TS_STREAM_TYPE_HEVC 0x24
 
 /* Reserve space for PAT + PMT at the beginning of idr_frame_mmap */
 #define TS_HEADER_RESERVE (2 * TS_PACKET_SIZE) /* 376 bytes */
@@ -30,6 +38,23 @@
 /* Default snapshot buffer capacity (1MB) */
 #define SNAPSHOT_BUFFER_CAPACITY (1 * 1024 * 1024)
 
+/* Conversion scheduling limits */
+#define SNAPSHOT_QUEUE_MAX 32              /* Captured frames waiting for a conversion slot */
+#define SNAPSHOT_CONVERT_TIMEOUT_MS 10000  /* Queue wait plus ffmpeg run time */
+#define SNAPSHOT_ORPHANS_MAX 16            /* Killed ffmpeg processes not yet reaped */
+
+/* Per-worker conversion state: at most snapshot-concurrency ffmpeg processes
+ * run at once, further captured frames wait in FIFO order */
+static snapshot_context_t *convert_queue_head = NULL;
+static snapshot_context_t *convert_queue_tail = NULL;
+static int convert_queue_len = 0;
+static int convert_running = 0;
+static pid_t convert_orphans[SNAPSHOT_ORPHANS_MAX];
+static int convert_orphan_count = 0;
+
+static void snapshot_cancel_conversion(snapshot_context_t *ctx);
+static int snapshot_send_jpeg(snapshot_context_t *ctx, connection_t *conn, int jpeg_fd, size_t jpeg_size);
+
 /**
  * Initialize snapshot context and allocate resources
  */
@@ -39,10 +64,13 @@ int snapshot_init(snapshot_context_t *ctx)
         return -1;
 
     memset(ctx, 0, sizeof(snapshot_context_t));
+    ctx->ffmpeg_pidfd = -1;
+    ctx->ffmpeg_out_fd = -1;
+    ctx->jpeg_fd = -1;
 
     /* Create tmpfs mmap file for IDR frame accumulation */
     char tmpfs_path[] = "/dev/shm/rtp2httpd_idr_frame_XXXXXX";
-    ctx->idr_frame_fd = mkstemp(tmpfs_path);
+    ctx->idr_frame_fd = mkostemp(tmpfs_path, O_CLOEXEC);
     if (ctx->idr_frame_fd < 0)
     {
         logger(LOG_ERROR, "Snapshot: Failed to create tmpfs file: %s", strerror(errno));
@@ -85,7 +113,10 @@ int snapshot_init(snapshot_context_t *ctx)
     ctx->has_pat = 0;
     ctx->has_pmt = 0;
     ctx->pmt_pid = 0;
+    ctx->pmt_video_pid = 0;
+    ctx->pmt_video_codec = SNAPSHOT_CODEC_UNKNOWN;
     ctx->ts_header_size = 0;
+    ctx->probe_pid = 0;
 
     logger(LOG_DEBUG, "Snapshot: Initialized (%zu bytes buffer)", ctx->idr_frame_capacity);
     return 0;
@@ -99,6 +130,15 @@ void snapshot_free(snapshot_context_t *ctx)
     if (!ctx)
         return;
 
+    snapshot_cancel_conversion(ctx);
+
+    /* Clients waiting on this capture need a new one */
+    if (ctx->cache_entry)
+    {
+        snapshot_cache_abandon(ctx->cache_entry);
+        ctx->cache_entry = NULL;
+    }
+
     if (ctx->idr_frame_mmap && ctx->idr_frame_mmap != MAP_FAILED)
     {
         munmap(ctx->idr_frame_mmap, ctx->idr_frame_capacity);
@@ -191,6 +231,96 @@ static uint16_t extract_pmt_pid_from_pat(const uint8_t *pat_packet)
     return 0;
 }
 
+/**
+ * Find the first H.264 or HEVC stream of a PMT packet
+ * @param pmt_packet Pointer to PMT TS packet (188 bytes)
+ * @param video_pid Set to the stream's PID
+ * @return SNAPSHOT_CODEC_* of the stream, SNAPSHOT_CODEC_UNKNOWN if none
+ */
+static int extract_video_from_pmt(const uint8_t *pmt_packet, uint16_t *video_pid)
+{
+    ts_scan_packet_t pkt;
+
+    if (!pmt_packet || pmt_packet[0] != TS_SYNC_BYTE)
+        return SNAPSHOT_CODEC_UNKNOWN;
+
+    ts_scan_packet(pmt_packet, &pkt);
+    if ((pkt.flags & (TS_SCAN_PUSI | TS_SCAN_PAYLOAD)) != (TS_SCAN_PUSI | TS_SCAN_PAYLOAD))
+        return SNAPSHOT_CODEC_UNKNOWN;
+
+    /* Skip pointer field */
+    int payload_start = pkt.payload + 1 + pmt_packet[pkt.payload];
+    if (payload_start + 12 > TS_PACKET_SIZE)
+        return SNAPSHOT_CODEC_UNKNOWN;
+
+    const uint8_t *section = pmt_packet + payload_start;
+    if (section[0] != 0x02) /* PMT table_id */
+        return SNAPSHOT_CODEC_UNKNOWN;
+
+    /* Stream loop runs from after program_info to the CRC, within this packet */
+    int section_end = 3 + (((section[1] & 0x0F) << 8) | section[2]) - 4;
+    int available = TS_PACKET_SIZE - payload_start;
+    if (section_end > available)
+        section_end = available;
+
+    int pos = 12 + (((section[10] & 0x0F) << 8) | section[11]);
+    while (pos + 5 <= section_end)
+    {
+        uint16_t pid = ((section[pos + 1] & 0x1F) << 8) | section[pos + 2];
+        if (section[pos] == TS_STREAM_TYPE_H264 || section[pos] == TS_STREAM_TYPE_HEVC)
+        {
+            *video_pid = pid;
+            return section[pos] == TS_STREAM_TYPE_H264 ? SNAPSHOT_CODEC_H264 : SNAPSHOT_CODEC_HEVC;
+        }
+        pos += 5 + (((section[pos + 3] & 0x0F) << 8) | section[pos + 4]);
+    }
+
+    return SNAPSHOT_CODEC_UNKNOWN;
+}
+
+/**
+ * Copy the captured frame's video elementary stream out of its TS packets
+ * @param ctx Snapshot context with a complete frame
+ * @param es_len Set to the length of the returned data
+ * @return malloc'd Annex B data, NULL on error
+ */
+static uint8_t *snapshot_extract_es(const snapshot_context_t *ctx, size_t *es_len)
+{
+    size_t offset;
+    size_t len = 0;
+    uint8_t *es = malloc(ctx->idr_frame_size - ctx->ts_header_size);
+
+    if (!es)
+        return NULL;
+
+    for (offset = ctx->ts_header_size; offset + TS_PACKET_SIZE <= ctx->idr_frame_size; offset += TS_PACKET_SIZE)
+    {
+        const uint8_t *ts_packet = ctx->idr_frame_mmap + offset;
+        ts_scan_packet_t pkt;
+        int start;
+
+        ts_scan_packet(ts_packet, &pkt);
+        if (!(pkt.flags & TS_SCAN_PAYLOAD))
+            continue;
+
+        /* PES header in front of the first payload */
+        start = (pkt.flags & TS_SCAN_VIDEO_PES) ? pkt.es : pkt.payload;
+        if (start >= TS_PACKET_SIZE)
+            continue;
+        memcpy(es + len, ts_packet + start, TS_PACKET_SIZE - start);
+        len += TS_PACKET_SIZE - start;
+    }
+
+    if (len == 0)
+    {
+        free(es);
+        return NULL;
+    }
+
+    *es_len = len;
+    return es;
+}
+
 /**
  * Cache PAT or PMT packet in idr_frame_mmap header area
  * @param ctx Snapshot context
@@ -219,7 +349,14 @@ static void cache_ts_header_packet(snapshot_context_t *ctx, const uint8_t *ts_pa
         memcpy(ctx->idr_frame_mmap + TS_PACKET_SIZE, ts_packet, TS_PACKET_SIZE);
         ctx->has_pmt = 1;
 
-        logger(LOG_DEBUG, "Snapshot: Cached PMT packet (PID: 0x%04x)", pid);
+        /* From now on only the announced video stream is searched */
+        ctx->pmt_video_codec = extract_video_from_pmt(ts_packet, &ctx->pmt_video_pid);
+
+        logger(LOG_DEBUG, "Snapshot: Cached PMT packet (PID: 0x%04x, video PID: 0x%04x, %s)", pid,
+               ctx->pmt_video_pid,
+               ctx->pmt_video_codec == SNAPSHOT_CODEC_H264   ? "H.264"
+               : ctx->pmt_video_codec == SNAPSHOT_CODEC_HEVC ? "HEVC"
+                                                             : "no H.264/HEVC stream");
     }
 
     /* Update header size */
@@ -230,102 +367,527 @@ static void cache_ts_header_packet(snapshot_context_t *ctx, const uint8_t *ts_pa
         ctx->ts_header_size += TS_PACKET_SIZE;
 }
 
-/**
- * Convert IDR frame to JPEG using external ffmpeg
- * Uses existing tmpfs mmap fd for input (MPEG2-TS format) and returns new fd for JPEG output
- * @param idr_frame_fd File descriptor containing MPEG2-TS data with IDR frame (already in tmpfs)
- * @param idr_frame_size MPEG2-TS data size
- * @param jpeg_fd Output: file descriptor for JPEG file (caller must close)
- * @param jpeg_size Output: JPEG file size
- * @return 0 on success, -1 on error
- */
-static int snapshot_convert_to_jpeg(int idr_frame_fd, size_t idr_frame_size,
-                                    int *jpeg_fd, size_t *jpeg_size)
+/* Reap killed ffmpeg processes that did not exit right away */
+static void snapshot_reap_orphans(void)
 {
-    if (idr_frame_fd < 0 || idr_frame_size == 0 || !jpeg_fd || !jpeg_size)
+    int i = 0;
+
+    while (i < convert_orphan_count)
+    {
+        if (waitpid(convert_orphans[i], NULL, WNOHANG) != 0)
+            convert_orphans[i] = convert_orphans[--convert_orphan_count];
+        else
+            i++;
+    }
+}
+
+static int snapshot_watch_fd(snapshot_context_t *ctx, int fd)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(ctx->conn->epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: Failed to add ffmpeg fd to epoll: %s", strerror(errno));
         return -1;
+    }
+    fdmap_set(fd, ctx->conn);
+    return 0;
+}
+
+/* Remove the ffmpeg pipe and pidfd from epoll and close them */
+static void snapshot_release_fds(snapshot_context_t *ctx)
+{
+    if (ctx->ffmpeg_out_fd >= 0)
+    {
+        worker_cleanup_socket_from_epoll(ctx->conn->epfd, ctx->ffmpeg_out_fd);
+        ctx->ffmpeg_out_fd = -1;
+    }
+    if (ctx->ffmpeg_pidfd >= 0)
+    {
+        worker_cleanup_socket_from_epoll(ctx->conn->epfd, ctx->ffmpeg_pidfd);
+        ctx->ffmpeg_pidfd = -1;
+    }
+}
 
-    *jpeg_fd = -1;
-    *jpeg_size = 0;
+/* Descriptor numbers of the frame and JPEG files in ffmpeg */
+#define SNAPSHOT_FFMPEG_INPUT_FD 3
+#define SNAPSHOT_FFMPEG_OUTPUT_FD 4
 
-    /* Create output file in tmpfs */
-    char output_path[] = "/dev/shm/rtp2httpd_jpeg_XXXXXX";
-    int output_fd = mkstemp(output_path);
-    if (output_fd < 0)
+/* A CLOEXEC copy above the fixed child numbers if fd is one of them, so the
+ * spawn's dup2()s cannot overwrite each other's source */
+static int snapshot_spawn_source_fd(int fd)
+{
+    if (fd > SNAPSHOT_FFMPEG_OUTPUT_FD)
+        return fd;
+    return fcntl(fd, F_DUPFD_CLOEXEC, SNAPSHOT_FFMPEG_OUTPUT_FD + 1);
+}
+
+/**
+ * Start ffmpeg converting the captured IDR frame to JPEG
+ * Input is the tmpfs frame file (MPEG2-TS), output a new tmpfs file. Both
+ * are CLOEXEC, so no other child keeps them; only ffmpeg gets them, as
+ * fds 3 and 4 opened through /proc/self/fd/. ffmpeg's stdout/stderr go to a
+ * pipe and its exit is signalled by a pidfd, both watched by the worker epoll.
+ * @return 0 if ffmpeg is running, -1 on error
+ */
+static int snapshot_spawn_ffmpeg(snapshot_context_t *ctx)
+{
+    /* Output memfd, passed to ffmpeg and kept by the snapshot cache */
+    ctx->jpeg_fd = memfd_create("rtp2httpd-jpeg", MFD_CLOEXEC);
+    if (ctx->jpeg_fd < 0)
     {
         logger(LOG_ERROR, "Snapshot: Failed to create JPEG output file: %s", strerror(errno));
         return -1;
     }
 
-    /* Unlink immediately - file will be deleted when fd is closed */
-    unlink(output_path);
-
-    /* Build ffmpeg command using /proc/self/fd/ to access unlinked files
-     * Input is always MPEG2-TS format (RTP-encapsulated or raw)
-     * ffmpeg will demux the TS and extract the first video frame
-     */
     const char *ffmpeg_path = config.ffmpeg_path ? config.ffmpeg_path : "ffmpeg";
     const char *ffmpeg_args = config.ffmpeg_args ? config.ffmpeg_args : "-hwaccel none";
 
+    /* The shell splits ffmpeg-args and execs ffmpeg, so the child pid is ffmpeg's */
     char command[1024];
     snprintf(command, sizeof(command),
-             "%s %s -loglevel error -f mpegts -i /proc/self/fd/%d -frames:v 1 -q:v 8 -f image2 -y /proc/self/fd/%d 2>&1",
-             ffmpeg_path, ffmpeg_args, idr_frame_fd, output_fd);
+             "exec %s %s -loglevel error -f mpegts -i /proc/self/fd/%d -frames:v 1 -q:v 8 -f image2 -y /proc/self/fd/%d",
+             ffmpeg_path, ffmpeg_args, SNAPSHOT_FFMPEG_INPUT_FD, SNAPSHOT_FFMPEG_OUTPUT_FD);
 
     logger(LOG_DEBUG, "Snapshot: Executing ffmpeg: %s", command);
 
-    /* Execute ffmpeg */
-    FILE *fp = popen(command, "r");
-    if (!fp)
+    int out_pipe[2];
+    if (pipe2(out_pipe, O_CLOEXEC) < 0)
     {
-        logger(LOG_ERROR, "Snapshot: Failed to execute ffmpeg: %s", strerror(errno));
+        logger(LOG_ERROR, "Snapshot: Failed to create ffmpeg pipe: %s", strerror(errno));
+        return -1;
+    }
+
+    int input_fd = snapshot_spawn_source_fd(ctx->idr_frame_fd);
+    int output_fd = snapshot_spawn_source_fd(ctx->jpeg_fd);
+    if (input_fd < 0 || output_fd < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: Failed to duplicate ffmpeg files: %s", strerror(errno));
+        if (input_fd >= 0 && input_fd != ctx->idr_frame_fd)
+            close(input_fd);
+        if (output_fd >= 0 && output_fd != ctx->jpeg_fd)
+            close(output_fd);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return -1;
+    }
+
+    /* dup2() in the child clears CLOEXEC on the copies */
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDERR_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, input_fd, SNAPSHOT_FFMPEG_INPUT_FD);
+    posix_spawn_file_actions_adddup2(&actions, output_fd, SNAPSHOT_FFMPEG_OUTPUT_FD);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+    posix_spawn_file_actions_addclosefrom_np(&actions, SNAPSHOT_FFMPEG_OUTPUT_FD + 1);
+#endif
+
+    char sh_name[] = "sh";
+    char sh_flag[] = "-c";
+    char *argv[] = {sh_name, sh_flag, command, NULL};
+    pid_t pid;
+    int err = posix_spawn(&pid, "/bin/sh", &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out_pipe[1]);
+    if (input_fd != ctx->idr_frame_fd)
+        close(input_fd);
+    if (output_fd != ctx->jpeg_fd)
         close(output_fd);
+
+    if (err != 0)
+    {
+        logger(LOG_ERROR, "Snapshot: Failed to execute ffmpeg: %s", strerror(err));
+        close(out_pipe[0]);
         return -1;
     }
 
-    /* Read ffmpeg output (errors) */
-    char error_buf[1024];
-    size_t error_len = fread(error_buf, 1, sizeof(error_buf) - 1, fp);
-    error_buf[error_len] = '\0';
+    ctx->ffmpeg_pid = pid;
+    ctx->ffmpeg_exited = 0;
+    ctx->ffmpeg_output_len = 0;
 
-    int status = pclose(fp);
+    fcntl(out_pipe[0], F_SETFL, fcntl(out_pipe[0], F_GETFL, 0) | O_NONBLOCK);
+    if (snapshot_watch_fd(ctx, out_pipe[0]) < 0)
+    {
+        close(out_pipe[0]);
+        return -1;
+    }
+    ctx->ffmpeg_out_fd = out_pipe[0];
 
-    /* Always log ffmpeg output if there's any */
-    if (error_len > 0)
+#ifdef SYS_pidfd_open
+    int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (pidfd >= 0)
     {
-        logger(LOG_DEBUG, "Snapshot: ffmpeg output: %s", error_buf);
+        if (snapshot_watch_fd(ctx, pidfd) < 0)
+            close(pidfd);
+        else
+            ctx->ffmpeg_pidfd = pidfd;
     }
+#endif
+    /* Without a pidfd, snapshot_tick() polls for the exit */
 
-    if (status != 0)
+    return 0;
+}
+
+/* Kill a running ffmpeg, reaping it now or later */
+static void snapshot_kill_ffmpeg(snapshot_context_t *ctx)
+{
+    snapshot_release_fds(ctx);
+
+    if (ctx->ffmpeg_pid > 0 && !ctx->ffmpeg_exited)
     {
-        logger(LOG_ERROR, "Snapshot: ffmpeg failed (exit code %d)", status);
-        close(output_fd);
+        kill(ctx->ffmpeg_pid, SIGKILL);
+        if (waitpid(ctx->ffmpeg_pid, NULL, WNOHANG) == 0)
+        {
+            if (convert_orphan_count < SNAPSHOT_ORPHANS_MAX)
+                convert_orphans[convert_orphan_count++] = ctx->ffmpeg_pid;
+            else
+                waitpid(ctx->ffmpeg_pid, NULL, 0);
+        }
+    }
+    ctx->ffmpeg_pid = 0;
+
+    if (ctx->jpeg_fd >= 0)
+    {
+        close(ctx->jpeg_fd);
+        ctx->jpeg_fd = -1;
+    }
+}
+
+static void snapshot_queue_remove(snapshot_context_t *ctx)
+{
+    snapshot_context_t **pp = &convert_queue_head;
+    snapshot_context_t *prev = NULL;
+
+    while (*pp && *pp != ctx)
+    {
+        prev = *pp;
+        pp = &(*pp)->queue_next;
+    }
+    if (!*pp)
+        return;
+
+    *pp = ctx->queue_next;
+    if (convert_queue_tail == ctx)
+        convert_queue_tail = prev;
+    ctx->queue_next = NULL;
+    convert_queue_len--;
+}
+
+/* Start queued conversions while slots are free */
+static void snapshot_start_queued(void)
+{
+    int limit = config.snapshot_concurrency > 0 ? config.snapshot_concurrency : 1;
+
+    snapshot_reap_orphans();
+
+    while (convert_running < limit && convert_queue_head)
+    {
+        snapshot_context_t *ctx = convert_queue_head;
+        snapshot_queue_remove(ctx);
+
+        if (snapshot_spawn_ffmpeg(ctx) < 0)
+        {
+            snapshot_kill_ffmpeg(ctx);
+            ctx->convert_state = SNAPSHOT_CONVERT_DONE;
+            logger(LOG_ERROR, "Snapshot: JPEG conversion failed");
+            snapshot_fallback_to_streaming(ctx, ctx->conn);
+            continue;
+        }
+
+        ctx->convert_state = SNAPSHOT_CONVERT_RUNNING;
+        convert_running++;
+    }
+}
+
+/* Queue the captured frame for conversion */
+static int snapshot_submit_conversion(snapshot_context_t *ctx, connection_t *conn)
+{
+    /* Persistent decoders take the elementary stream; ffmpeg is only
+     * started for this frame if the pool cannot take it */
+    if (snapshot_decoder_enabled() && ctx->video_codec != SNAPSHOT_CODEC_UNKNOWN)
+    {
+        size_t es_len = 0;
+        uint8_t *es = snapshot_extract_es(ctx, &es_len);
+
+        ctx->conn = conn;
+        ctx->convert_state = SNAPSHOT_CONVERT_DECODING;
+        ctx->convert_start_time = get_time_ms();
+        if (es && snapshot_decoder_submit(ctx, ctx->video_codec, es, es_len) == 0)
+            return 0;
+
+        ctx->convert_state = SNAPSHOT_CONVERT_NONE;
+        logger(LOG_DEBUG, "Snapshot: Decoder pool cannot take the frame, starting ffmpeg");
+    }
+
+    if (convert_queue_len >= SNAPSHOT_QUEUE_MAX)
+    {
+        logger(LOG_WARN, "Snapshot: Conversion queue full (%d waiting)", convert_queue_len);
         return -1;
     }
 
-    /* Get JPEG file size */
+    ctx->conn = conn;
+    ctx->convert_state = SNAPSHOT_CONVERT_QUEUED;
+    ctx->convert_start_time = get_time_ms();
+    ctx->queue_next = NULL;
+    if (convert_queue_tail)
+        convert_queue_tail->queue_next = ctx;
+    else
+        convert_queue_head = ctx;
+    convert_queue_tail = ctx;
+    convert_queue_len++;
+
+    if (convert_queue_len > 1 || convert_running >= config.snapshot_concurrency)
+        logger(LOG_DEBUG, "Snapshot: Conversion queued (%d running, %d waiting)",
+               convert_running, convert_queue_len);
+
+    snapshot_start_queued();
+    return 0;
+}
+
+/* Drop a queued or running conversion, e.g. when the client went away */
+static void snapshot_cancel_conversion(snapshot_context_t *ctx)
+{
+    if (ctx->convert_state == SNAPSHOT_CONVERT_QUEUED)
+    {
+        snapshot_queue_remove(ctx);
+    }
+    else if (ctx->convert_state == SNAPSHOT_CONVERT_DECODING)
+    {
+        snapshot_decoder_cancel(ctx);
+    }
+    else if (ctx->convert_state == SNAPSHOT_CONVERT_RUNNING)
+    {
+        snapshot_kill_ffmpeg(ctx);
+        convert_running--;
+        ctx->convert_state = SNAPSHOT_CONVERT_DONE;
+        snapshot_start_queued();
+    }
+    else if (ctx->jpeg_fd >= 0)
+    {
+        close(ctx->jpeg_fd);
+        ctx->jpeg_fd = -1;
+    }
+    ctx->convert_state = SNAPSHOT_CONVERT_DONE;
+}
+
+/**
+ * ffmpeg exited and its output pipe is drained: send the JPEG or fall back
+ * @return 0 to keep the connection, -1 to close it
+ */
+static int snapshot_finish_conversion(snapshot_context_t *ctx)
+{
+    connection_t *conn = ctx->conn;
+    int status = ctx->ffmpeg_status;
+    int jpeg_fd = ctx->jpeg_fd;
+    size_t jpeg_size = 0;
     struct stat st;
-    if (fstat(output_fd, &st) < 0)
+
+    snapshot_release_fds(ctx);
+    ctx->ffmpeg_pid = 0;
+    ctx->jpeg_fd = -1;
+    ctx->convert_state = SNAPSHOT_CONVERT_DONE;
+    convert_running--;
+
+    /* Always log ffmpeg output if there's any */
+    if (ctx->ffmpeg_output_len > 0)
     {
-        logger(LOG_ERROR, "Snapshot: Failed to stat output file: %s", strerror(errno));
-        close(output_fd);
-        return -1;
+        ctx->ffmpeg_output[ctx->ffmpeg_output_len] = '\0';
+        logger(LOG_DEBUG, "Snapshot: ffmpeg output: %s", ctx->ffmpeg_output);
     }
 
-    if (st.st_size == 0)
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        if (WIFSIGNALED(status))
+            logger(LOG_ERROR, "Snapshot: ffmpeg killed by signal %d", WTERMSIG(status));
+        else
+            logger(LOG_ERROR, "Snapshot: ffmpeg failed (exit code %d)", WEXITSTATUS(status));
+    }
+    else if (fstat(jpeg_fd, &st) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: Failed to stat output file: %s", strerror(errno));
+    }
+    else if (st.st_size == 0)
     {
         logger(LOG_ERROR, "Snapshot: ffmpeg produced empty JPEG file");
-        close(output_fd);
+    }
+    else
+    {
+        jpeg_size = st.st_size;
+        logger(LOG_DEBUG, "Snapshot: JPEG conversion successful (%zu bytes)", jpeg_size);
+    }
+
+    /* Hand the freed slot to the next waiting snapshot */
+    snapshot_start_queued();
+
+    if (jpeg_size == 0)
+    {
+        close(jpeg_fd);
+        logger(LOG_ERROR, "Snapshot: JPEG conversion failed");
+        snapshot_fallback_to_streaming(ctx, conn);
+        return 0;
+    }
+
+    return snapshot_send_jpeg(ctx, conn, jpeg_fd, jpeg_size);
+}
+
+void snapshot_decoder_result(snapshot_context_t *ctx, int jpeg_fd, size_t jpeg_size)
+{
+    connection_t *conn = ctx->conn;
+
+    ctx->convert_state = SNAPSHOT_CONVERT_DONE;
+
+    if (jpeg_fd < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: JPEG conversion failed");
+        snapshot_fallback_to_streaming(ctx, conn);
+        return;
+    }
+
+    logger(LOG_DEBUG, "Snapshot: JPEG conversion successful (%zu bytes, %lld ms)", jpeg_size,
+           (long long)(get_time_ms() - ctx->convert_start_time));
+
+    if (snapshot_send_jpeg(ctx, conn, jpeg_fd, jpeg_size) < 0)
+    {
+        /* Not within this connection's events: let its write handler close it */
+        conn->state = CONN_CLOSING;
+        connection_epoll_update_events(conn->epfd, conn->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+    }
+}
+
+/**
+ * Cache and send a converted JPEG
+ * @return 0 on success, -1 to close the connection
+ */
+static int snapshot_send_jpeg(snapshot_context_t *ctx, connection_t *conn, int jpeg_fd, size_t jpeg_size)
+{
+    /* Cache the JPEG and answer clients waiting for the same channel */
+    if (ctx->cache_entry)
+    {
+        snapshot_cache_complete(ctx->cache_entry, jpeg_fd, jpeg_size);
+        ctx->cache_entry = NULL;
+    }
+
+    /* Send HTTP headers with Content-Length */
+    char content_length_header[64];
+    snprintf(content_length_header, sizeof(content_length_header),
+             "Content-Length: %zu\r\n", jpeg_size);
+
+    send_http_headers(conn, STATUS_200, CONTENT_JPEG, content_length_header);
+
+    /* Queue JPEG file for non-blocking sendfile() */
+    if (connection_queue_file(conn, jpeg_fd, 0, jpeg_size) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: Failed to queue JPEG file");
+        close(jpeg_fd);
         return -1;
     }
 
-    *jpeg_size = st.st_size;
-    *jpeg_fd = output_fd;
+    /* File descriptor ownership transferred to queue, don't close it here */
+    logger(LOG_INFO, "Snapshot: Sent JPEG response (%zu bytes)", jpeg_size);
+    conn->state = CONN_CLOSING;
+    return 0;
+}
+
+/* Collect the ffmpeg exit status if it has exited */
+static void snapshot_poll_exit(snapshot_context_t *ctx)
+{
+    if (ctx->ffmpeg_exited || ctx->ffmpeg_pid <= 0)
+        return;
+
+    pid_t r = waitpid(ctx->ffmpeg_pid, &ctx->ffmpeg_status, WNOHANG);
+    if (r == ctx->ffmpeg_pid || (r < 0 && errno == ECHILD))
+    {
+        if (r < 0)
+            ctx->ffmpeg_status = 0; /* Reaped elsewhere; judge by the output file */
+        ctx->ffmpeg_exited = 1;
+        if (ctx->ffmpeg_pidfd >= 0)
+        {
+            worker_cleanup_socket_from_epoll(ctx->conn->epfd, ctx->ffmpeg_pidfd);
+            ctx->ffmpeg_pidfd = -1;
+        }
+    }
+}
+
+int snapshot_owns_fd(const snapshot_context_t *ctx, int fd)
+{
+    return ctx && ctx->convert_state == SNAPSHOT_CONVERT_RUNNING && fd >= 0 &&
+           (fd == ctx->ffmpeg_out_fd || fd == ctx->ffmpeg_pidfd);
+}
+
+int snapshot_handle_fd_event(snapshot_context_t *ctx, int fd)
+{
+    if (!snapshot_owns_fd(ctx, fd))
+        return 0;
+
+    if (fd == ctx->ffmpeg_out_fd)
+    {
+        /* Keep the start of ffmpeg's messages for the log, discard the rest */
+        char buf[1024];
+        for (;;)
+        {
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                size_t room = sizeof(ctx->ffmpeg_output) - 1 - ctx->ffmpeg_output_len;
+                size_t take = (size_t)n < room ? (size_t)n : room;
+                memcpy(ctx->ffmpeg_output + ctx->ffmpeg_output_len, buf, take);
+                ctx->ffmpeg_output_len += take;
+                continue;
+            }
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0 && errno == EAGAIN)
+                return 0;
+
+            /* EOF: ffmpeg closed its output, normally by exiting */
+            worker_cleanup_socket_from_epoll(ctx->conn->epfd, fd);
+            ctx->ffmpeg_out_fd = -1;
+            break;
+        }
+    }
+
+    snapshot_poll_exit(ctx);
 
-    /* Reset file position for sendfile */
-    lseek(output_fd, 0, SEEK_SET);
+    if (ctx->ffmpeg_out_fd < 0 && ctx->ffmpeg_exited)
+        return snapshot_finish_conversion(ctx);
+
+    return 0;
+}
+
+int snapshot_tick(snapshot_context_t *ctx, int64_t now)
+{
+    if (!ctx || !ctx->enabled)
+        return 0;
+
+    if (ctx->convert_state == SNAPSHOT_CONVERT_RUNNING)
+    {
+        /* Without pidfd the exit is only noticed here */
+        if (ctx->ffmpeg_pidfd < 0)
+        {
+            snapshot_poll_exit(ctx);
+            if (ctx->ffmpeg_out_fd < 0 && ctx->ffmpeg_exited)
+                return snapshot_finish_conversion(ctx);
+        }
+    }
+    else if (ctx->convert_state != SNAPSHOT_CONVERT_QUEUED && ctx->convert_state != SNAPSHOT_CONVERT_DECODING)
+    {
+        return 0;
+    }
+
+    int64_t elapsed = now - ctx->convert_start_time;
+    if (elapsed > SNAPSHOT_CONVERT_TIMEOUT_MS)
+    {
+        logger(LOG_WARN, "Snapshot: Timeout converting to JPEG (%lld ms, %s)", (long long)elapsed,
+               ctx->convert_state == SNAPSHOT_CONVERT_RUNNING    ? "ffmpeg running"
+               : ctx->convert_state == SNAPSHOT_CONVERT_DECODING ? "decoder pool"
+                                                                 : "still queued");
+        snapshot_cancel_conversion(ctx);
+        snapshot_fallback_to_streaming(ctx, ctx->conn);
+    }
 
-    logger(LOG_DEBUG, "Snapshot: JPEG conversion successful (%zu bytes)", *jpeg_size);
     return 0;
 }
 
@@ -333,6 +895,247 @@ static int snapshot_convert_to_jpeg(int idr_frame_fd, size_t idr_frame_size,
  * Process RTP payload for snapshot mode
  * Detects and accumulates IDR frame TS packets, then converts to JPEG and sends to client
  */
+/* A complete IDR frame is in the buffer: convert it, unless only kept */
+static int snapshot_frame_captured(snapshot_context_t *ctx, connection_t *conn)
+{
+    ctx->idr_frame_complete = 1;
+
+    size_t video_size = ctx->idr_frame_size - ctx->ts_header_size;
+    logger(LOG_DEBUG, "Snapshot: Complete IDR frame captured (%zu bytes total, %zu header + %zu video, %zu video packets)",
+           ctx->idr_frame_size, ctx->ts_header_size, video_size, video_size / TS_PACKET_SIZE);
+
+    /* Snapshots of the stream copy the frame from here */
+    if (ctx->capture_only)
+        return 0;
+
+    /* Warn if PAT/PMT not captured (ffmpeg may fail) */
+    if (!ctx->has_pat || !ctx->has_pmt)
+    {
+        logger(LOG_WARN, "Snapshot: Missing TS headers (PAT: %d, PMT: %d) - ffmpeg may fail",
+               ctx->has_pat, ctx->has_pmt);
+    }
+
+    /* Truncate to actual size */
+    if (ftruncate(ctx->idr_frame_fd, ctx->idr_frame_size) < 0)
+    {
+        logger(LOG_WARN, "Snapshot: Failed to truncate mmap file: %s", strerror(errno));
+    }
+
+    /* Reset file position for ffmpeg to read from beginning */
+    lseek(ctx->idr_frame_fd, 0, SEEK_SET);
+
+    /* Convert to JPEG off the event loop; the response is sent
+     * from snapshot_handle_fd_event() once ffmpeg exits */
+    if (snapshot_submit_conversion(ctx, conn) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot: JPEG conversion failed");
+        snapshot_fallback_to_streaming(ctx, conn);
+    }
+
+    return 0; /* IDR frame captured, conversion pending */
+}
+
+/* The cached PAT/PMT stay valid for the next frame */
+void snapshot_restart_capture(snapshot_context_t *ctx)
+{
+    if (!ctx || !ctx->enabled)
+        return;
+
+    ctx->idr_frame_size = 0;
+    ctx->idr_frame_complete = 0;
+    ctx->idr_frame_started = 0;
+    ctx->video_pid = 0;
+    ctx->video_codec = SNAPSHOT_CODEC_UNKNOWN;
+    ctx->probe_pid = 0;
+    ctx->start_time = get_time_ms();
+}
+
+int snapshot_capture_copy(snapshot_context_t *ctx, const snapshot_context_t *frame, connection_t *conn)
+{
+    if (!ctx || !ctx->enabled || ctx->idr_frame_started || !frame || !frame->idr_frame_complete)
+        return -1;
+    if (frame->idr_frame_size > ctx->idr_frame_capacity)
+        return -1;
+
+    /* PAT/PMT header area and video packets keep their layout */
+    memcpy(ctx->idr_frame_mmap, frame->idr_frame_mmap, frame->idr_frame_size);
+    ctx->idr_frame_size = frame->idr_frame_size;
+    ctx->has_pat = frame->has_pat;
+    ctx->has_pmt = frame->has_pmt;
+    ctx->pmt_pid = frame->pmt_pid;
+    ctx->pmt_video_pid = frame->pmt_video_pid;
+    ctx->pmt_video_codec = frame->pmt_video_codec;
+    ctx->ts_header_size = frame->ts_header_size;
+    ctx->video_pid = frame->video_pid;
+    ctx->video_codec = frame->video_codec;
+    ctx->idr_frame_started = 1;
+
+    return snapshot_frame_captured(ctx, conn);
+}
+
+/**
+ * Check whether two bytes form a plausible HEVC NAL unit header
+ * (forbidden_zero_bit and nuh_layer_id 0, nuh_temporal_id_plus1 non-zero).
+ * Tells HEVC apart from H.264 while the PMT is not known yet.
+ */
+static int snapshot_hevc_header(const uint8_t *nal)
+{
+    return (nal[0] & 0x81) == 0 && (nal[1] & 0xF8) == 0 && (nal[1] & 0x07) != 0;
+}
+
+/* What the NAL units of a piece of a video PES tell about its picture */
+#define SNAPSHOT_SLICE_NONE 0  /* No slice yet */
+#define SNAPSHOT_SLICE_RAP 1   /* Random access slice: H.264 IDR, HEVC BLA/IDR/CRA */
+#define SNAPSHOT_SLICE_OTHER 2 /* Any other slice of the stream's codec */
+
+/**
+ * Scan elementary stream bytes for the first slice NAL unit
+ * Other slices are only recognised once the PMT gives the codec; before
+ * that an HEVC parameter set can look like an H.264 slice.
+ * @param ctx Snapshot context (probe_sps_codec is updated)
+ * @param es Elementary stream data
+ * @param len Length of es
+ * @param codec Set to the codec of a random access slice
+ * @param kind Set to its name for the log
+ * @return SNAPSHOT_SLICE_*
+ */
+static int snapshot_scan_nals(snapshot_context_t *ctx, const uint8_t *es, size_t len, int *codec, const char **kind)
+{
+    size_t pos = 0;
+
+    for (;;)
+    {
+        int start_code = ts_scan_start_code(es + pos, len - pos);
+        if (start_code < 0)
+            return SNAPSHOT_SLICE_NONE;
+
+        size_t nal_start = pos + (size_t)start_code + 3;
+        if (nal_start + 1 >= len)
+            return SNAPSHOT_SLICE_NONE; /* Header continues in the next packet */
+
+        const uint8_t *nal = es + nal_start;
+        uint8_t h264_type = nal[0] & 0x1F;
+        uint8_t hevc_type = (nal[0] >> 1) & 0x3F;
+        int maybe_h264 = ctx->pmt_video_codec != SNAPSHOT_CODEC_HEVC && !(nal[0] & 0x80);
+        int maybe_hevc = ctx->pmt_video_codec != SNAPSHOT_CODEC_H264 && snapshot_hevc_header(nal);
+
+        if (maybe_h264 && h264_type == 5)
+        {
+            *codec = SNAPSHOT_CODEC_H264;
+            *kind = "IDR";
+            return SNAPSHOT_SLICE_RAP;
+        }
+        if (maybe_hevc && hevc_type >= 16 && hevc_type <= 21)
+        {
+            *codec = SNAPSHOT_CODEC_HEVC;
+            *kind = hevc_type <= 18 ? "BLA" : hevc_type <= 20 ? "IDR" : "CRA";
+            return SNAPSHOT_SLICE_RAP;
+        }
+
+        if ((ctx->pmt_video_codec == SNAPSHOT_CODEC_H264 && h264_type >= 1 && h264_type <= 4) ||
+            (ctx->pmt_video_codec == SNAPSHOT_CODEC_HEVC && hevc_type < 32))
+            return SNAPSHOT_SLICE_OTHER;
+
+        if (maybe_h264 && h264_type == 7)
+            ctx->probe_sps_codec = SNAPSHOT_CODEC_H264;
+        else if (maybe_hevc && hevc_type == 33)
+            ctx->probe_sps_codec = SNAPSHOT_CODEC_HEVC;
+
+        pos = nal_start;
+    }
+}
+
+/**
+ * Look for a random access point in the packets of a video PES, and start
+ * capturing the frame from the PES start
+ * Accepted are H.264 IDR slices, HEVC IRAP pictures (BLA, IDR and CRA),
+ * and access units that carry an SPS in a PES flagged with the adaptation
+ * field random_access_indicator (intra pictures of streams without IDR).
+ * The packets of the PES are kept until its first slice NAL shows up, so
+ * parameter sets and SEI may fill any number of packets before it. The
+ * codec comes from the PMT once it is known, otherwise from the NAL units.
+ * @param ctx Snapshot context (no frame started yet)
+ * @param ts_packet TS packet
+ * @param pkt Its scan result
+ * @return 1 if the frame started (ts_packet still has to be stored), 0 otherwise
+ */
+static int snapshot_find_idr(snapshot_context_t *ctx, const uint8_t *ts_packet, const ts_scan_packet_t *pkt)
+{
+    uint8_t joined[sizeof(ctx->probe_tail) + TS_PACKET_SIZE];
+    const uint8_t *es;
+    size_t es_len;
+    int codec = SNAPSHOT_CODEC_UNKNOWN;
+    const char *kind = NULL;
+
+    if ((pkt->flags & TS_SCAN_VIDEO_PES) && (!ctx->pmt_video_pid || pkt->pid == ctx->pmt_video_pid))
+    {
+        /* A new PES: drop whatever the previous one left unresolved */
+        ctx->probe_pid = pkt->pid;
+        ctx->probe_sps_codec = SNAPSHOT_CODEC_UNKNOWN;
+        ctx->probe_rai = (pkt->flags & TS_SCAN_RAI) != 0;
+        ctx->probe_tail_len = 0;
+        ctx->idr_frame_size = ctx->ts_header_size;
+        es = ts_packet + pkt->es;
+        es_len = TS_PACKET_SIZE - pkt->es;
+    }
+    else if (ctx->probe_pid && pkt->pid == ctx->probe_pid && (pkt->flags & TS_SCAN_PAYLOAD))
+    {
+        memcpy(joined, ctx->probe_tail, ctx->probe_tail_len);
+        memcpy(joined + ctx->probe_tail_len, ts_packet + pkt->payload, TS_PACKET_SIZE - pkt->payload);
+        es = joined;
+        es_len = ctx->probe_tail_len + TS_PACKET_SIZE - pkt->payload;
+    }
+    else
+    {
+        return 0;
+    }
+
+    int slice = snapshot_scan_nals(ctx, es, es_len, &codec, &kind);
+
+    /* Intra picture announced by the multiplexer */
+    if (slice != SNAPSHOT_SLICE_RAP && ctx->probe_rai && ctx->probe_sps_codec != SNAPSHOT_CODEC_UNKNOWN)
+    {
+        slice = SNAPSHOT_SLICE_RAP;
+        codec = ctx->probe_sps_codec;
+        kind = "random access";
+    }
+
+    if (slice == SNAPSHOT_SLICE_OTHER)
+    {
+        ctx->probe_pid = 0;
+        ctx->idr_frame_size = ctx->ts_header_size;
+        return 0;
+    }
+
+    if (slice == SNAPSHOT_SLICE_NONE)
+    {
+        /* Keep the packet with the PES and carry the tail over for start codes */
+        if (ctx->idr_frame_size + TS_PACKET_SIZE > ctx->idr_frame_capacity)
+        {
+            ctx->probe_pid = 0;
+            ctx->idr_frame_size = ctx->ts_header_size;
+            return 0;
+        }
+        memcpy(ctx->idr_frame_mmap + ctx->idr_frame_size, ts_packet, TS_PACKET_SIZE);
+        ctx->idr_frame_size += TS_PACKET_SIZE;
+
+        ctx->probe_tail_len = min(es_len, sizeof(ctx->probe_tail));
+        memcpy(ctx->probe_tail, es + es_len - ctx->probe_tail_len, ctx->probe_tail_len);
+        return 0;
+    }
+
+    /* Capture from the PES start; the packets probed so far are already stored */
+    ctx->idr_frame_started = 1;
+    ctx->video_pid = ctx->probe_pid;
+    ctx->video_codec = codec;
+    ctx->probe_pid = 0;
+
+    logger(LOG_DEBUG, "Snapshot: %s %s frame start detected (PID: 0x%04x, header size: %zu, %zu packets before the slice)",
+           codec == SNAPSHOT_CODEC_H264 ? "H.264" : "HEVC", kind, ctx->video_pid, ctx->ts_header_size,
+           (ctx->idr_frame_size - ctx->ts_header_size) / TS_PACKET_SIZE);
+    return 1;
+}
+
 int snapshot_process_packet(snapshot_context_t *ctx, int recv_len, uint8_t *buf, connection_t *conn)
 {
     if (!ctx || !ctx->enabled)
@@ -361,192 +1164,56 @@ int snapshot_process_packet(snapshot_context_t *ctx, int recv_len, uint8_t *buf,
         return 0;
     }
 
-    /* Process each TS packet in the payload */
+    /* Process the TS packets of the payload, a scanned batch at a time */
+    ts_scan_packet_t pkts[TS_SCAN_BATCH];
     size_t offset = 0;
-    while (offset + TS_PACKET_SIZE <= (size_t)payload_size)
+    while (offset < (size_t)payload_size)
     {
-        const uint8_t *ts_packet = payload + offset;
-
-        /* Verify sync byte */
-        if (ts_packet[0] != TS_SYNC_BYTE)
-        {
-            offset++;
-            continue;
-        }
+        size_t consumed;
+        int count = ts_scan_packets(payload + offset, (size_t)payload_size - offset, pkts, TS_SCAN_BATCH, &consumed);
 
-        /* Parse TS header */
-        uint16_t pid = ((ts_packet[1] & 0x1F) << 8) | ts_packet[2];
-        int payload_unit_start = (ts_packet[1] & 0x40) != 0;
-        int has_adaptation = (ts_packet[3] & 0x20) != 0;
-        int has_payload = (ts_packet[3] & 0x10) != 0;
-
-        /* Cache PAT/PMT packets before IDR frame starts (stored in mmap header area) */
-        if (!ctx->idr_frame_started)
+        for (int i = 0; i < count; i++)
         {
-            cache_ts_header_packet(ctx, ts_packet, pid);
-        }
+            const ts_scan_packet_t *pkt = &pkts[i];
+            const uint8_t *ts_packet = payload + offset + pkt->offset;
 
-        /* If we haven't found IDR frame yet, check if this packet contains it */
-        if (!ctx->idr_frame_started)
-        {
-            if (has_payload && payload_unit_start)
-            {
-                /* Calculate payload start */
-                int ts_payload_start = 4;
-                if (has_adaptation)
-                {
-                    int adaptation_length = ts_packet[4];
-                    ts_payload_start += 1 + adaptation_length;
-                }
-
-                if (ts_payload_start < TS_PACKET_SIZE)
-                {
-                    const uint8_t *ts_payload = ts_packet + ts_payload_start;
-                    int ts_payload_len = TS_PACKET_SIZE - ts_payload_start;
-
-                    /* Check for PES header with video stream */
-                    if (ts_payload_len >= 6 &&
-                        ts_payload[0] == 0x00 && ts_payload[1] == 0x00 && ts_payload[2] == 0x01)
-                    {
-                        uint8_t stream_id = ts_payload[3];
-                        if (stream_id >= 0xE0 && stream_id <= 0xEF) /* Video stream */
-                        {
-                            /* Check for I-frame NAL in PES payload */
-                            int pes_header_len = 9 + ts_payload[8];
-                            if (pes_header_len < ts_payload_len)
-                            {
-                                const uint8_t *es_data = ts_payload + pes_header_len;
-                                int es_len = ts_payload_len - pes_header_len;
-
-                                /* Scan for NAL start code */
-                                for (int i = 0; i < es_len - 4; i++)
-                                {
-                                    if (es_data[i] == 0 && es_data[i + 1] == 0 &&
-                                        (es_data[i + 2] == 1 || (es_data[i + 2] == 0 && es_data[i + 3] == 1)))
-                                    {
-                                        int nal_start = (es_data[i + 2] == 1) ? i + 3 : i + 4;
-                                        if (nal_start < es_len)
-                                        {
-                                            uint8_t nal_header = es_data[nal_start];
-                                            uint8_t h264_type = nal_header & 0x1F;
-                                            uint8_t hevc_type = (nal_header >> 1) & 0x3F;
-
-                                            /* Check if this is an IDR frame */
-                                            if (h264_type == 5 ||                                      /* H.264 IDR */
-                                                hevc_type == 19 || hevc_type == 20 || hevc_type == 21) /* HEVC IDR */
-                                            {
-                                                /* Found IDR frame! Start capturing from this packet */
-                                                ctx->idr_frame_started = 1;
-                                                ctx->video_pid = pid;
-
-                                                /* Initialize idr_frame_size to skip PAT/PMT header area */
-                                                ctx->idr_frame_size = ctx->ts_header_size;
-
-                                                logger(LOG_DEBUG, "Snapshot: IDR frame start detected (PID: 0x%04x, header size: %zu)",
-                                                       pid, ctx->ts_header_size);
-                                                break;
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-
-            /* If still not started, skip this packet */
             if (!ctx->idr_frame_started)
             {
-                offset += TS_PACKET_SIZE;
-                continue;
+                /* Cache PAT/PMT packets before IDR frame starts (stored in mmap header area) */
+                size_t header_size = ctx->ts_header_size;
+                cache_ts_header_packet(ctx, ts_packet, pkt->pid);
+                if (ctx->probe_pid && ctx->ts_header_size != header_size)
+                    ctx->probe_pid = 0; /* The header area grew over the probed packets */
+
+                /* Skip packets until a video PES, on the PMT's video stream once
+                 * that is known, turns out to start a random access point */
+                if (!snapshot_find_idr(ctx, ts_packet, pkt))
+                    continue;
+
+                /* IDR frame just started - fall through to save this packet */
             }
 
-            /* IDR frame just started - fall through to save this packet */
-        }
+            /* Only accumulate packets from the video PID */
+            if (pkt->pid != ctx->video_pid)
+                continue;
 
-        /* If IDR frame started, check if this packet belongs to the IDR frame */
-        if (ctx->idr_frame_started)
-        {
             /* Check if this is the end of IDR frame (next PES start on same PID) */
-            if (pid == ctx->video_pid && payload_unit_start && ctx->idr_frame_size > ctx->ts_header_size)
-            {
-                /* IDR frame complete */
-                ctx->idr_frame_complete = 1;
-
-                size_t video_size = ctx->idr_frame_size - ctx->ts_header_size;
-                logger(LOG_DEBUG, "Snapshot: Complete IDR frame captured (%zu bytes total, %zu header + %zu video, %zu video packets)",
-                       ctx->idr_frame_size, ctx->ts_header_size, video_size, video_size / TS_PACKET_SIZE);
-
-                /* Warn if PAT/PMT not captured (ffmpeg may fail) */
-                if (!ctx->has_pat || !ctx->has_pmt)
-                {
-                    logger(LOG_WARN, "Snapshot: Missing TS headers (PAT: %d, PMT: %d) - ffmpeg may fail",
-                           ctx->has_pat, ctx->has_pmt);
-                }
-
-                /* Truncate to actual size */
-                if (ftruncate(ctx->idr_frame_fd, ctx->idr_frame_size) < 0)
-                {
-                    logger(LOG_WARN, "Snapshot: Failed to truncate mmap file: %s", strerror(errno));
-                }
-
-                /* Reset file position for ffmpeg to read from beginning */
-                lseek(ctx->idr_frame_fd, 0, SEEK_SET);
-
-                /* Convert to JPEG and send immediately */
-                int jpeg_fd = -1;
-                size_t jpeg_size = 0;
-
-                if (snapshot_convert_to_jpeg(ctx->idr_frame_fd, ctx->idr_frame_size,
-                                             &jpeg_fd, &jpeg_size) == 0)
-                {
-                    /* Send HTTP headers with Content-Length */
-                    char content_length_header[64];
-                    snprintf(content_length_header, sizeof(content_length_header),
-                             "Content-Length: %zu\r\n", jpeg_size);
-
-                    send_http_headers(conn, STATUS_200, CONTENT_JPEG, content_length_header);
-
-                    /* Queue JPEG file for non-blocking sendfile() */
-                    if (connection_queue_file(conn, jpeg_fd, 0, jpeg_size) < 0)
-                    {
-                        logger(LOG_ERROR, "Snapshot: Failed to queue JPEG file");
-                        close(jpeg_fd);
-                        return -1;
-                    }
-
-                    /* File descriptor ownership transferred to queue, don't close it here */
-                    logger(LOG_INFO, "Snapshot: Sent JPEG response (%zu bytes)", jpeg_size);
-                    conn->state = CONN_CLOSING;
-                }
-                else
-                {
-                    /* Conversion failed */
-                    logger(LOG_ERROR, "Snapshot: JPEG conversion failed");
-                    snapshot_fallback_to_streaming(ctx, conn);
-                }
-
-                return 0; /* IDR frame captured and sent */
-            }
+            if ((pkt->flags & TS_SCAN_PUSI) && ctx->idr_frame_size > ctx->ts_header_size)
+                return snapshot_frame_captured(ctx, conn);
 
-            /* Only accumulate packets from the video PID */
-            if (pid == ctx->video_pid)
+            /* Check buffer capacity */
+            if (ctx->idr_frame_size + TS_PACKET_SIZE > ctx->idr_frame_capacity)
             {
-                /* Check buffer capacity */
-                if (ctx->idr_frame_size + TS_PACKET_SIZE > ctx->idr_frame_capacity)
-                {
-                    logger(LOG_WARN, "Snapshot: IDR frame too large, buffer full");
-                    return -1;
-                }
-
-                /* Copy this TS packet */
-                memcpy(ctx->idr_frame_mmap + ctx->idr_frame_size, ts_packet, TS_PACKET_SIZE);
-                ctx->idr_frame_size += TS_PACKET_SIZE;
+                logger(LOG_WARN, "Snapshot: IDR frame too large, buffer full");
+                return -1;
             }
+
+            /* Copy this TS packet */
+            memcpy(ctx->idr_frame_mmap + ctx->idr_frame_size, ts_packet, TS_PACKET_SIZE);
+            ctx->idr_frame_size += TS_PACKET_SIZE;
         }
 
-        offset += TS_PACKET_SIZE;
+        offset += consumed;
     }
 
     return 0; /* Continue accumulating */
@@ -557,6 +1224,13 @@ void snapshot_fallback_to_streaming(snapshot_context_t *ctx, connection_t *conn)
     if (!ctx || !ctx->enabled || !conn)
         return;
 
+    /* Clients waiting on this capture share its failure */
+    if (ctx->cache_entry)
+    {
+        snapshot_cache_fail(ctx->cache_entry);
+        ctx->cache_entry = NULL;
+    }
+
     if (!ctx->fallback_to_streaming)
     {
         http_send_500(conn);
@@ -1,6 +1,7 @@
 #ifndef SNAPSHOT_H
 #define SNAPSHOT_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -13,6 +14,7 @@ typedef struct connection_s connection_t;
 typedef struct snapshot_context_s
 {
     int enabled;               /* 1 if this is a snapshot request, 0 for normal streaming */
+    int capture_only;          /* Keep the frame without converting (a live stream's latest IDR) */
     int fallback_to_streaming; /* 1 if snapshot failed and we should fallback to normal streaming */
     int idr_frame_fd;          /* tmpfs mmap file descriptor for IDR frame data */
     uint8_t *idr_frame_mmap;   /* mmap'd region for IDR frame accumulation */
@@ -21,15 +23,48 @@ typedef struct snapshot_context_s
     int idr_frame_complete;    /* 1 if complete IDR frame captured, 0 otherwise */
     int idr_frame_started;     /* 1 if IDR frame detection confirmed, 0 if still probing */
     uint16_t video_pid;        /* PID of the video stream containing IDR frame */
+    int video_codec;           /* SNAPSHOT_CODEC_* of the video stream */
     int64_t start_time;        /* Snapshot request start time for timeout */
 
     /* PAT/PMT caching - stored in first 376 bytes of idr_frame_mmap */
     int has_pat;           /* 1 if PAT packet cached in mmap[0..187] */
     int has_pmt;           /* 1 if PMT packet cached in mmap[188..375] */
     uint16_t pmt_pid;      /* PID of PMT (extracted from PAT) */
+    uint16_t pmt_video_pid; /* First H.264/HEVC stream of the PMT, 0 until known */
+    int pmt_video_codec;    /* SNAPSHOT_CODEC_* of pmt_video_pid */
     size_t ts_header_size; /* Size of PAT+PMT headers (0, 188, or 376 bytes) */
+
+    /* Video PES searched for its first slice; parameter sets and SEI can push
+     * the slice into later packets, which are kept until it is found */
+    uint16_t probe_pid;        /* PID of that PES, 0 if none */
+    int probe_sps_codec;       /* SNAPSHOT_CODEC_* of an SPS seen in it */
+    int probe_rai;             /* Its first packet had random_access_indicator set */
+    uint8_t probe_tail[4];     /* Last ES bytes of the previous packet (start codes straddle packets) */
+    size_t probe_tail_len;
+
+    /* Asynchronous JPEG conversion (ffmpeg runs beside the event loop) */
+    int convert_state;             /* SNAPSHOT_CONVERT_* */
+    connection_t *conn;            /* Client waiting for the JPEG */
+    pid_t ffmpeg_pid;              /* Running ffmpeg (through exec from sh), 0 if none */
+    int ffmpeg_pidfd;              /* pidfd of ffmpeg, -1 if unsupported (polled on tick) */
+    int ffmpeg_out_fd;             /* Read end of ffmpeg stdout/stderr, -1 after EOF */
+    int ffmpeg_exited;             /* 1 once ffmpeg was reaped */
+    int ffmpeg_status;             /* waitpid() status */
+    int jpeg_fd;                   /* tmpfs JPEG output, -1 once handed to the send queue */
+    int64_t convert_start_time;    /* When the conversion was queued */
+    char ffmpeg_output[256];       /* Start of ffmpeg messages, for the log */
+    size_t ffmpeg_output_len;
+    struct snapshot_context_s *queue_next; /* Worker conversion queue linkage */
+    struct snapshot_cache_entry_s *cache_entry; /* Cache entry waiting for this capture */
 } snapshot_context_t;
 
+/* Conversion states */
+#define SNAPSHOT_CONVERT_NONE 0    /* Still capturing */
+#define SNAPSHOT_CONVERT_QUEUED 1  /* Waiting for a free conversion slot */
+#define SNAPSHOT_CONVERT_RUNNING 2 /* ffmpeg running */
+#define SNAPSHOT_CONVERT_DONE 3    /* Response sent or fallen back */
+#define SNAPSHOT_CONVERT_DECODING 4 /* Frame handed to the persistent decoder pool */
+
 /**
  * Initialize snapshot context and allocate resources
  * @param ctx Snapshot context to initialize
@@ -54,6 +89,54 @@ void snapshot_free(snapshot_context_t *ctx);
  */
 int snapshot_process_packet(snapshot_context_t *ctx, int recv_len, uint8_t *buf, connection_t *conn);
 
+/**
+ * Drop the captured or partial frame and wait for the next IDR
+ * @param ctx Snapshot context (not converting)
+ */
+void snapshot_restart_capture(snapshot_context_t *ctx);
+
+/**
+ * Take a complete frame captured by another context and convert it
+ * @param ctx Snapshot context still waiting for its frame
+ * @param frame Context holding a complete IDR frame
+ * @param conn Connection
+ * @return 0 on success, -1 on error
+ */
+int snapshot_capture_copy(snapshot_context_t *ctx, const snapshot_context_t *frame, connection_t *conn);
+
+/**
+ * Check whether fd is one of the snapshot's ffmpeg descriptors
+ * @param ctx Snapshot context
+ * @param fd File descriptor from epoll
+ * @return 1 if the fd belongs to this snapshot's conversion
+ */
+int snapshot_owns_fd(const snapshot_context_t *ctx, int fd);
+
+/**
+ * Handle ffmpeg output or exit, sending the JPEG once conversion is done
+ * @param ctx Snapshot context
+ * @param fd ffmpeg output pipe or pidfd
+ * @return 0 to keep the connection, -1 to close it
+ */
+int snapshot_handle_fd_event(snapshot_context_t *ctx, int fd);
+
+/**
+ * Periodic check of a conversion: timeout, and exit polling without pidfd
+ * @param ctx Snapshot context (frame already captured)
+ * @param now Current time in milliseconds
+ * @return 0 to keep the connection, -1 to close it
+ */
+int snapshot_tick(snapshot_context_t *ctx, int64_t now);
+
+/**
+ * Conversion result from the persistent decoder pool: send the JPEG or fall back
+ * Called outside of the client connection's own events.
+ * @param ctx Snapshot context (SNAPSHOT_CONVERT_DECODING)
+ * @param jpeg_fd JPEG memfd (ownership passes to the snapshot), -1 on failure
+ * @param jpeg_size JPEG size in bytes
+ */
+void snapshot_decoder_result(snapshot_context_t *ctx, int jpeg_fd, size_t jpeg_size);
+
 /**
  * Fallback to normal streaming mode
  * Sends normal streaming headers and frees snapshot context
@@ -0,0 +1,334 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "snapshot_cache.h"
+#include "snapshot.h"
+#include "rtp2httpd.h"
+#include "connection.h"
+#include "service.h"
+#include "http.h"
+#include "status.h"
+#include "worker.h"
+
+#define SNAPSHOT_CACHE_MAX_ENTRIES 64 /* Channels cached per worker */
+
+struct snapshot_cache_entry_s
+{
+    char *key;             /* Upstream URL, NULL if the slot is free */
+    uint32_t hash;         /* FNV-1a of key */
+    int jpeg_fd;           /* Cached JPEG memfd, -1 if none */
+    size_t jpeg_size;      /* Cached JPEG size, 0 if none */
+    int64_t expires;       /* When the cached JPEG goes stale (ms) */
+    int64_t last_used;     /* For eviction when all slots are taken */
+    int capturing;         /* A snapshot capture will complete this entry */
+    connection_t *waiters; /* Clients waiting for that capture (FIFO) */
+};
+
+static snapshot_cache_entry_t cache_entries[SNAPSHOT_CACHE_MAX_ENTRIES];
+
+/* Waiters of abandoned captures, routed again on the next tick */
+static snapshot_cache_entry_t cache_reroute;
+
+#define SNAPSHOT_CACHE_STATS_INC(field)                                      \
+    do                                                                       \
+    {                                                                        \
+        if (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS) \
+            status_shared->worker_stats[worker_id].field++;                  \
+    } while (0)
+
+static uint32_t snapshot_cache_hash(const char *key)
+{
+    uint32_t h = 2166136261u;
+    while (*key)
+    {
+        h ^= (uint8_t)*key++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void snapshot_cache_release_jpeg(snapshot_cache_entry_t *e)
+{
+    if (e->jpeg_size > 0)
+        close(e->jpeg_fd);
+    e->jpeg_fd = -1;
+    e->jpeg_size = 0;
+}
+
+/* Free the slot once nothing refers to it any more */
+static void snapshot_cache_maybe_free(snapshot_cache_entry_t *e)
+{
+    if (e->capturing || e->waiters || e->jpeg_size > 0)
+        return;
+    free(e->key);
+    e->key = NULL;
+}
+
+static snapshot_cache_entry_t *snapshot_cache_find(const char *key, uint32_t hash)
+{
+    int i;
+
+    for (i = 0; i < SNAPSHOT_CACHE_MAX_ENTRIES; i++)
+    {
+        snapshot_cache_entry_t *e = &cache_entries[i];
+        if (e->key && e->hash == hash && strcmp(e->key, key) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+/* Take a free slot, or the least recently used one without a capture */
+static snapshot_cache_entry_t *snapshot_cache_claim(const char *key, uint32_t hash)
+{
+    snapshot_cache_entry_t *victim = NULL;
+    int i;
+
+    for (i = 0; i < SNAPSHOT_CACHE_MAX_ENTRIES; i++)
+    {
+        snapshot_cache_entry_t *e = &cache_entries[i];
+        if (!e->key)
+        {
+            victim = e;
+            break;
+        }
+        if (!e->capturing && !e->waiters && (!victim || e->last_used < victim->last_used))
+            victim = e;
+    }
+    if (!victim)
+        return NULL;
+
+    char *copy = strdup(key);
+    if (!copy)
+        return NULL;
+
+    if (victim->key)
+    {
+        snapshot_cache_release_jpeg(victim);
+        free(victim->key);
+    }
+    memset(victim, 0, sizeof(*victim));
+    victim->key = copy;
+    victim->hash = hash;
+    victim->jpeg_fd = -1;
+    return victim;
+}
+
+/* Queue a JPEG response from a cached or freshly converted memfd */
+static void snapshot_cache_send(connection_t *c, int jpeg_fd, size_t jpeg_size)
+{
+    int fd = fcntl(jpeg_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        logger(LOG_ERROR, "Snapshot cache: dup failed: %s", strerror(errno));
+        http_send_500(c);
+        return;
+    }
+
+    char content_length_header[64];
+    snprintf(content_length_header, sizeof(content_length_header),
+             "Content-Length: %zu\r\n", jpeg_size);
+    send_http_headers(c, STATUS_200, CONTENT_JPEG, content_length_header);
+
+    /* sendfile() uses its own offset, so the dup shares the memfd safely */
+    if (connection_queue_file(c, fd, 0, jpeg_size) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot cache: Failed to queue JPEG file");
+        close(fd);
+    }
+    c->state = CONN_CLOSING;
+}
+
+static void snapshot_cache_add_waiter(snapshot_cache_entry_t *e, connection_t *c)
+{
+    connection_t **pp = &e->waiters;
+
+    while (*pp)
+        pp = &(*pp)->snapshot_wait_next;
+    *pp = c;
+    c->snapshot_wait_next = NULL;
+    c->snapshot_wait = e;
+    c->state = CONN_SNAPSHOT_WAIT;
+}
+
+static connection_t *snapshot_cache_pop_waiter(snapshot_cache_entry_t *e)
+{
+    connection_t *c = e->waiters;
+
+    if (c)
+    {
+        e->waiters = c->snapshot_wait_next;
+        c->snapshot_wait_next = NULL;
+        c->snapshot_wait = NULL;
+    }
+    return c;
+}
+
+int snapshot_cache_request(connection_t *c, const service_t *service, int can_wait,
+                           snapshot_cache_entry_t **entry)
+{
+    char key[HTTP_URL_BUFFER_SIZE];
+    int64_t now = get_time_ms();
+
+    *entry = NULL;
+    if (service_upstream_key(service, key, sizeof(key)) < 0)
+        return SNAPSHOT_CACHE_MISS;
+
+    uint32_t hash = snapshot_cache_hash(key);
+    snapshot_cache_entry_t *e = snapshot_cache_find(key, hash);
+
+    if (e && e->jpeg_size > 0 && now < e->expires)
+    {
+        e->last_used = now;
+        SNAPSHOT_CACHE_STATS_INC(snapshot_cache_hits);
+        logger(LOG_DEBUG, "Snapshot cache: Hit for %s (%zu bytes)", key, e->jpeg_size);
+        snapshot_cache_send(c, e->jpeg_fd, e->jpeg_size);
+        return SNAPSHOT_CACHE_HIT;
+    }
+
+    if (e && e->capturing)
+    {
+        if (can_wait)
+        {
+            SNAPSHOT_CACHE_STATS_INC(snapshot_cache_coalesced);
+            logger(LOG_DEBUG, "Snapshot cache: Waiting for running capture of %s", key);
+            snapshot_cache_add_waiter(e, c);
+            return SNAPSHOT_CACHE_WAIT;
+        }
+
+        /* Streaming fallback needs a capture of its own */
+        SNAPSHOT_CACHE_STATS_INC(snapshot_cache_misses);
+        return SNAPSHOT_CACHE_MISS;
+    }
+
+    SNAPSHOT_CACHE_STATS_INC(snapshot_cache_misses);
+
+    if (e)
+        snapshot_cache_release_jpeg(e); /* Stale */
+    else
+        e = snapshot_cache_claim(key, hash);
+
+    if (e)
+    {
+        e->capturing = 1;
+        e->last_used = now;
+        *entry = e;
+    }
+    return SNAPSHOT_CACHE_MISS;
+}
+
+void snapshot_cache_attach(snapshot_cache_entry_t *entry, snapshot_context_t *ctx)
+{
+    if (entry && ctx)
+        ctx->cache_entry = entry;
+}
+
+void snapshot_cache_complete(snapshot_cache_entry_t *entry, int jpeg_fd, size_t jpeg_size)
+{
+    connection_t *c;
+
+    if (!entry)
+        return;
+
+    entry->capturing = 0;
+    snapshot_cache_release_jpeg(entry);
+
+    if (config.snapshot_cache_ttl > 0)
+    {
+        int fd = fcntl(jpeg_fd, F_DUPFD_CLOEXEC, 0);
+        if (fd >= 0)
+        {
+            entry->jpeg_fd = fd;
+            entry->jpeg_size = jpeg_size;
+            entry->expires = get_time_ms() + (int64_t)config.snapshot_cache_ttl * 1000;
+        }
+    }
+
+    while ((c = snapshot_cache_pop_waiter(entry)) != NULL)
+        snapshot_cache_send(c, jpeg_fd, jpeg_size);
+
+    snapshot_cache_maybe_free(entry);
+}
+
+void snapshot_cache_fail(snapshot_cache_entry_t *entry)
+{
+    connection_t *c;
+
+    if (!entry)
+        return;
+
+    entry->capturing = 0;
+    while ((c = snapshot_cache_pop_waiter(entry)) != NULL)
+        http_send_500(c);
+
+    snapshot_cache_maybe_free(entry);
+}
+
+void snapshot_cache_abandon(snapshot_cache_entry_t *entry)
+{
+    connection_t *c;
+
+    if (!entry)
+        return;
+
+    entry->capturing = 0;
+    while ((c = snapshot_cache_pop_waiter(entry)) != NULL)
+        snapshot_cache_add_waiter(&cache_reroute, c);
+
+    snapshot_cache_maybe_free(entry);
+}
+
+void snapshot_cache_cancel_wait(connection_t *c)
+{
+    snapshot_cache_entry_t *e = c->snapshot_wait;
+    connection_t **pp;
+
+    if (!e)
+        return;
+
+    for (pp = &e->waiters; *pp; pp = &(*pp)->snapshot_wait_next)
+    {
+        if (*pp == c)
+        {
+            *pp = c->snapshot_wait_next;
+            break;
+        }
+    }
+    c->snapshot_wait = NULL;
+    c->snapshot_wait_next = NULL;
+
+    if (e != &cache_reroute)
+        snapshot_cache_maybe_free(e);
+}
+
+void snapshot_cache_tick(int64_t now)
+{
+    connection_t *c;
+    int i;
+
+    /* The first rerouted client starts a new capture, the others wait on it */
+    while ((c = snapshot_cache_pop_waiter(&cache_reroute)) != NULL)
+    {
+        c->state = CONN_ROUTE;
+        connection_route_and_start(c);
+        if (!c->zc_queue.head && !c->streaming && c->state != CONN_SNAPSHOT_WAIT &&
+            c->state != CONN_READ_REQ_LINE && c->state != CONN_READ_HEADERS)
+            worker_close_and_free_connection(c);
+    }
+
+    /* Return memory of stale JPEGs without waiting for the slot to be reused */
+    for (i = 0; i < SNAPSHOT_CACHE_MAX_ENTRIES; i++)
+    {
+        snapshot_cache_entry_t *e = &cache_entries[i];
+        if (e->key && e->jpeg_size > 0 && now >= e->expires)
+        {
+            snapshot_cache_release_jpeg(e);
+            snapshot_cache_maybe_free(e);
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef SNAPSHOT_CACHE_H
+#define SNAPSHOT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Per-channel snapshot cache.
+ *
+ * Thumbnail grids ask for snapshots of many channels over and over. Each
+ * worker keeps the last JPEG of every channel (keyed by the service's
+ * upstream URL) in a memfd for snapshot-cache-ttl seconds and serves it
+ * with sendfile(). While a capture for a channel is running, further
+ * snapshot=1 requests for it wait for that capture instead of joining
+ * the stream and running ffmpeg themselves.
+ */
+
+typedef struct connection_s connection_t;
+typedef struct service_s service_t;
+typedef struct snapshot_context_s snapshot_context_t;
+typedef struct snapshot_cache_entry_s snapshot_cache_entry_t;
+
+/* snapshot_cache_request() results */
+#define SNAPSHOT_CACHE_HIT 0  /* Cached JPEG queued, connection is closing */
+#define SNAPSHOT_CACHE_WAIT 1 /* Connection waits for a running capture (CONN_SNAPSHOT_WAIT) */
+#define SNAPSHOT_CACHE_MISS 2 /* Caller captures the snapshot itself */
+
+/**
+ * Look up a snapshot request
+ * @param c Client connection
+ * @param service Requested service
+ * @param can_wait 1 if the client may wait for another capture (no streaming fallback)
+ * @param entry On MISS, set to the entry the capture should complete (may be NULL)
+ * @return SNAPSHOT_CACHE_HIT, SNAPSHOT_CACHE_WAIT or SNAPSHOT_CACHE_MISS
+ */
+int snapshot_cache_request(connection_t *c, const service_t *service, int can_wait,
+                           snapshot_cache_entry_t **entry);
+
+/**
+ * Bind a MISS entry to the snapshot capture that will complete it
+ */
+void snapshot_cache_attach(snapshot_cache_entry_t *entry, snapshot_context_t *ctx);
+
+/**
+ * Capture converted: store the JPEG and answer waiting clients
+ * @param jpeg_fd JPEG memfd (the caller keeps its descriptor)
+ * @param jpeg_size JPEG size in bytes
+ */
+void snapshot_cache_complete(snapshot_cache_entry_t *entry, int jpeg_fd, size_t jpeg_size);
+
+/**
+ * Capture failed: waiting clients get a 500
+ */
+void snapshot_cache_fail(snapshot_cache_entry_t *entry);
+
+/**
+ * Capturing client went away: a waiting client is routed again to take over
+ */
+void snapshot_cache_abandon(snapshot_cache_entry_t *entry);
+
+/**
+ * Remove a closing connection from the waiters
+ */
+void snapshot_cache_cancel_wait(connection_t *c);
+
+/**
+ * Route clients of abandoned captures and drop expired entries
+ * @param now Current time in milliseconds
+ */
+void snapshot_cache_tick(int64_t now);
+
+#endif /* SNAPSHOT_CACHE_H */
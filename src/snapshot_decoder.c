@@ -0,0 +1,1180 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include "snapshot_decoder.h"
+#include "snapshot.h"
+#include "rtp2httpd.h"
+
+#define SNAPSHOT_DECODER_INFLIGHT 8           /* Frames written to a helper, picture not yet received */
+#define SNAPSHOT_DECODER_QUEUE_MAX 32         /* Frames waiting for a helper */
+#define SNAPSHOT_DECODER_MAX_LAG 4            /* Fillers before a helper is considered stuck */
+#define SNAPSHOT_DECODER_FILLER_WAIT_MS 50    /* No picture for this long: try one more filler */
+#define SNAPSHOT_DECODER_STALL_MS 5000        /* No picture for this long with frames in flight */
+#define SNAPSHOT_DECODER_IDLE_MS 300000       /* Stop helpers unused for 5 minutes */
+#define SNAPSHOT_DECODER_BACKOFF_MS 1000      /* Restart delay after a failure, doubled per failure */
+#define SNAPSHOT_DECODER_BACKOFF_MAX_MS 30000
+#define SNAPSHOT_DECODER_JPEG_MAX (4 * 1024 * 1024)
+#define SNAPSHOT_DECODER_SPS_MAX 1024         /* SPS bytes looked at for the picture size */
+#define SNAPSHOT_DECODER_ORPHANS_MAX 16       /* Killed helpers not yet reaped */
+
+typedef struct snapshot_decoder_job_s
+{
+    snapshot_context_t *ctx;
+    int codec;
+    int width;
+    int height;
+    uint8_t *es;
+    size_t es_len;
+    struct snapshot_decoder_job_s *next;
+} snapshot_decoder_job_t;
+
+typedef struct
+{
+    pid_t pid;                /* Running ffmpeg, 0 if stopped */
+    int in_fd;                /* ffmpeg stdin: elementary stream */
+    int out_fd;               /* ffmpeg stdout: MJPEG */
+    int err_fd;               /* ffmpeg stderr, logged at debug level */
+    char err_line[256];       /* Incomplete stderr line */
+    size_t err_len;
+    int codec;                /* Stream parameters the helper was started for */
+    int width;
+    int height;
+    uint8_t *frame;           /* Last frame written, re-sent as filler */
+    size_t frame_len;
+    size_t write_off;         /* Bytes of frame + flush NAL written */
+    int writing;              /* Frame write in progress (EPOLLOUT armed) */
+    snapshot_context_t *inflight[SNAPSHOT_DECODER_INFLIGHT]; /* FIFO, NULL for fillers */
+    int inflight_head;
+    int inflight_count;
+    int pending;              /* Snapshots (non-NULL entries) in inflight */
+    int trailing_fillers;     /* Fillers written after the last snapshot frame */
+    int lag;                  /* Learned decoder delay in frames */
+    uint8_t *out;             /* JPEG being received */
+    size_t out_len;
+    size_t out_cap;
+    int64_t last_progress_ms; /* Last picture received, or first frame after idle */
+    int64_t last_used_ms;
+    int failures;             /* Consecutive failures, for the restart backoff */
+    int64_t restart_after_ms;
+    unsigned long pictures;
+} snapshot_decoder_t;
+
+static snapshot_decoder_t decoders[SNAPSHOT_DECODER_MAX];
+static int decoder_count = 0;
+static int decoder_epfd = -1;
+static pid_t decoder_orphans[SNAPSHOT_DECODER_ORPHANS_MAX];
+static int decoder_orphan_count = 0;
+
+static snapshot_decoder_job_t *job_head = NULL;
+static snapshot_decoder_job_t *job_tail = NULL;
+static int job_count = 0;
+
+/* Access unit delimiters: end the frame so the parser hands it to the decoder */
+static uint8_t flush_h264[] = {0x00, 0x00, 0x00, 0x01, 0x09, 0xF0};
+static uint8_t flush_hevc[] = {0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x50};
+
+static void snapshot_decoder_dispatch(int64_t now);
+
+/* --- SPS parsing (picture size) --- */
+
+typedef struct
+{
+    uint8_t buf[SNAPSHOT_DECODER_SPS_MAX];
+    size_t len;
+    size_t pos; /* In bits */
+    int overrun;
+} sps_reader_t;
+
+/* Copy the NAL payload without emulation prevention bytes */
+static void sps_reader_init(sps_reader_t *r, const uint8_t *data, size_t len)
+{
+    int zeros = 0;
+    size_t i;
+
+    r->len = 0;
+    r->pos = 0;
+    r->overrun = 0;
+    for (i = 0; i < len && r->len < sizeof(r->buf); i++)
+    {
+        if (zeros >= 2 && data[i] == 0x03)
+        {
+            zeros = 0;
+            continue;
+        }
+        r->buf[r->len++] = data[i];
+        zeros = data[i] == 0 ? zeros + 1 : 0;
+    }
+}
+
+static uint32_t sps_bits(sps_reader_t *r, int n)
+{
+    uint32_t v = 0;
+
+    while (n-- > 0)
+    {
+        if (r->pos >= r->len * 8)
+        {
+            r->overrun = 1;
+            return 0;
+        }
+        v = (v << 1) | ((r->buf[r->pos >> 3] >> (7 - (r->pos & 7))) & 1);
+        r->pos++;
+    }
+    return v;
+}
+
+static uint32_t sps_ue(sps_reader_t *r)
+{
+    int zeros = 0;
+
+    while (sps_bits(r, 1) == 0)
+    {
+        if (r->overrun || ++zeros > 31)
+        {
+            r->overrun = 1;
+            return 0;
+        }
+    }
+    return ((1u << zeros) - 1) + sps_bits(r, zeros);
+}
+
+static int32_t sps_se(sps_reader_t *r)
+{
+    uint32_t v = sps_ue(r);
+    return (v & 1) ? (int32_t)((v + 1) / 2) : -(int32_t)(v / 2);
+}
+
+static void sps_skip_scaling_list(sps_reader_t *r, int size)
+{
+    int last = 8, next = 8, i;
+
+    for (i = 0; i < size && !r->overrun; i++)
+    {
+        if (next != 0)
+            next = (last + sps_se(r) + 256) % 256;
+        last = next == 0 ? last : next;
+    }
+}
+
+/* H.264 seq_parameter_set_rbsp() up to the frame cropping */
+static int sps_parse_h264(const uint8_t *data, size_t len, int *width, int *height)
+{
+    sps_reader_t r;
+    uint32_t chroma = 1, separate = 0;
+    uint32_t crop_l = 0, crop_r = 0, crop_t = 0, crop_b = 0;
+    uint32_t i, n;
+
+    sps_reader_init(&r, data, len);
+    uint32_t profile = sps_bits(&r, 8);
+    sps_bits(&r, 16); /* Constraint flags, level */
+    sps_ue(&r);       /* seq_parameter_set_id */
+
+    if (profile == 100 || profile == 110 || profile == 122 || profile == 244 || profile == 44 ||
+        profile == 83 || profile == 86 || profile == 118 || profile == 128 || profile == 138 ||
+        profile == 139 || profile == 134 || profile == 135)
+    {
+        chroma = sps_ue(&r);
+        if (chroma == 3)
+            separate = sps_bits(&r, 1);
+        sps_ue(&r);      /* bit_depth_luma_minus8 */
+        sps_ue(&r);      /* bit_depth_chroma_minus8 */
+        sps_bits(&r, 1); /* qpprime_y_zero_transform_bypass_flag */
+        if (sps_bits(&r, 1))
+        {
+            for (i = 0; i < (chroma != 3 ? 8u : 12u); i++)
+                if (sps_bits(&r, 1))
+                    sps_skip_scaling_list(&r, i < 6 ? 16 : 64);
+        }
+    }
+
+    sps_ue(&r); /* log2_max_frame_num_minus4 */
+    uint32_t poc_type = sps_ue(&r);
+    if (poc_type == 0)
+    {
+        sps_ue(&r);
+    }
+    else if (poc_type == 1)
+    {
+        sps_bits(&r, 1);
+        sps_se(&r);
+        sps_se(&r);
+        n = sps_ue(&r);
+        if (n > 255)
+            return -1;
+        for (i = 0; i < n; i++)
+            sps_se(&r);
+    }
+
+    sps_ue(&r);      /* max_num_ref_frames */
+    sps_bits(&r, 1); /* gaps_in_frame_num_value_allowed_flag */
+    uint32_t mbs_w = sps_ue(&r) + 1;
+    uint32_t map_h = sps_ue(&r) + 1;
+    uint32_t frame_mbs_only = sps_bits(&r, 1);
+    if (!frame_mbs_only)
+        sps_bits(&r, 1);
+    sps_bits(&r, 1); /* direct_8x8_inference_flag */
+    if (sps_bits(&r, 1))
+    {
+        crop_l = sps_ue(&r);
+        crop_r = sps_ue(&r);
+        crop_t = sps_ue(&r);
+        crop_b = sps_ue(&r);
+    }
+
+    if (r.overrun || mbs_w > 1024 || map_h > 1024)
+        return -1;
+
+    uint32_t crop_x = (chroma == 0 || separate || chroma == 3) ? 1 : 2;
+    uint32_t crop_y = ((chroma == 1 && !separate) ? 2 : 1) * (2 - frame_mbs_only);
+    int64_t w = (int64_t)mbs_w * 16 - (int64_t)crop_x * (crop_l + crop_r);
+    int64_t h = (int64_t)(2 - frame_mbs_only) * map_h * 16 - (int64_t)crop_y * (crop_t + crop_b);
+    if (w <= 0 || h <= 0)
+        return -1;
+
+    *width = (int)w;
+    *height = (int)h;
+    return 0;
+}
+
+/* HEVC seq_parameter_set_rbsp() up to the conformance window */
+static int sps_parse_hevc(const uint8_t *data, size_t len, int *width, int *height)
+{
+    sps_reader_t r;
+    uint32_t sub_profile[8], sub_level[8];
+    uint32_t separate = 0;
+    uint32_t crop_l = 0, crop_r = 0, crop_t = 0, crop_b = 0;
+    uint32_t i;
+
+    sps_reader_init(&r, data, len);
+    sps_bits(&r, 4); /* sps_video_parameter_set_id */
+    uint32_t max_sub_layers = sps_bits(&r, 3);
+    sps_bits(&r, 1); /* sps_temporal_id_nesting_flag */
+
+    /* profile_tier_level(): 88 bits general profile, 8 bits general level */
+    sps_bits(&r, 32);
+    sps_bits(&r, 32);
+    sps_bits(&r, 32);
+    for (i = 0; i < max_sub_layers; i++)
+    {
+        sub_profile[i] = sps_bits(&r, 1);
+        sub_level[i] = sps_bits(&r, 1);
+    }
+    if (max_sub_layers > 0)
+        for (i = max_sub_layers; i < 8; i++)
+            sps_bits(&r, 2);
+    for (i = 0; i < max_sub_layers; i++)
+    {
+        if (sub_profile[i])
+        {
+            sps_bits(&r, 32);
+            sps_bits(&r, 32);
+            sps_bits(&r, 24);
+        }
+        if (sub_level[i])
+            sps_bits(&r, 8);
+    }
+
+    sps_ue(&r); /* sps_seq_parameter_set_id */
+    uint32_t chroma = sps_ue(&r);
+    if (chroma == 3)
+        separate = sps_bits(&r, 1);
+    uint32_t w = sps_ue(&r);
+    uint32_t h = sps_ue(&r);
+    if (sps_bits(&r, 1))
+    {
+        crop_l = sps_ue(&r);
+        crop_r = sps_ue(&r);
+        crop_t = sps_ue(&r);
+        crop_b = sps_ue(&r);
+    }
+
+    if (r.overrun || w == 0 || h == 0 || w > 16384 || h > 16384)
+        return -1;
+
+    uint32_t sub_w = ((chroma == 1 || chroma == 2) && !separate) ? 2 : 1;
+    uint32_t sub_h = (chroma == 1 && !separate) ? 2 : 1;
+    int64_t cw = (int64_t)w - (int64_t)sub_w * (crop_l + crop_r);
+    int64_t ch = (int64_t)h - (int64_t)sub_h * (crop_t + crop_b);
+    if (cw <= 0 || ch <= 0)
+        return -1;
+
+    *width = (int)cw;
+    *height = (int)ch;
+    return 0;
+}
+
+/* Picture size from the access unit's SPS */
+static int snapshot_decoder_probe(int codec, const uint8_t *es, size_t len, int *width, int *height)
+{
+    size_t i = 0;
+
+    while (i + 3 < len)
+    {
+        if (es[i] != 0 || es[i + 1] != 0 || es[i + 2] != 1)
+        {
+            i++;
+            continue;
+        }
+
+        const uint8_t *nal = es + i + 3;
+        size_t nal_len = len - i - 3;
+        if (codec == SNAPSHOT_CODEC_H264 && (nal[0] & 0x1F) == 7)
+            return sps_parse_h264(nal + 1, nal_len - 1, width, height);
+        if (codec == SNAPSHOT_CODEC_HEVC && ((nal[0] >> 1) & 0x3F) == 33 && nal_len > 2)
+            return sps_parse_hevc(nal + 2, nal_len - 2, width, height);
+        i += 3;
+    }
+    return -1;
+}
+
+/**
+ * Turn HEVC CRA slices into BLA_W_LP (same slice header syntax)
+ * A repeated CRA is dropped as a duplicate POC, while a BLA starts a new
+ * POC sequence each time and leaves earlier pictures to be output.
+ */
+static void snapshot_decoder_cra_to_bla(uint8_t *es, size_t len)
+{
+    size_t i = 0;
+
+    while (i + 3 < len)
+    {
+        if (es[i] == 0 && es[i + 1] == 0 && es[i + 2] == 1)
+        {
+            if (((es[i + 3] >> 1) & 0x3F) == 21)
+                es[i + 3] = (uint8_t)((es[i + 3] & 0x81) | (16 << 1));
+            i += 3;
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+/* --- JPEG framing on the helper's stdout --- */
+
+/**
+ * Find the end of the JPEG at the start of buf
+ * Walks the marker segments and the entropy-coded data after SOS, where
+ * 0xFF is always followed by 0x00 (stuffing) or a restart marker.
+ * @return JPEG length, 0 if incomplete, -1 if buf does not start a JPEG
+ */
+static ssize_t snapshot_decoder_jpeg_end(const uint8_t *buf, size_t len)
+{
+    size_t pos = 2;
+
+    if (len < 2)
+        return 0;
+    if (buf[0] != 0xFF || buf[1] != 0xD8)
+        return -1;
+
+    for (;;)
+    {
+        if (pos + 2 > len)
+            return 0;
+        if (buf[pos] != 0xFF)
+            return -1;
+        if (buf[pos + 1] == 0xFF) /* Fill byte */
+        {
+            pos++;
+            continue;
+        }
+
+        uint8_t marker = buf[pos + 1];
+        if (marker == 0xD9)
+            return (ssize_t)(pos + 2);
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            pos += 2;
+            continue;
+        }
+
+        if (pos + 4 > len)
+            return 0;
+        pos += 2 + (((size_t)buf[pos + 2] << 8) | buf[pos + 3]);
+        if (marker != 0xDA)
+            continue;
+
+        /* Entropy-coded segment up to the next real marker */
+        for (;;)
+        {
+            if (pos + 2 > len)
+                return 0;
+            if (buf[pos] == 0xFF && buf[pos + 1] != 0x00 && (buf[pos + 1] < 0xD0 || buf[pos + 1] > 0xD7))
+                break;
+            pos += buf[pos] == 0xFF ? 2 : 1;
+        }
+    }
+}
+
+static int snapshot_decoder_store_jpeg(const uint8_t *data, size_t len)
+{
+    int fd = memfd_create("rtp2httpd-jpeg", MFD_CLOEXEC);
+    size_t off = 0;
+
+    if (fd < 0)
+    {
+        logger(LOG_ERROR, "Snapshot decoder: Failed to create JPEG file: %s", strerror(errno));
+        return -1;
+    }
+    while (off < len)
+    {
+        ssize_t n = write(fd, data + off, len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            logger(LOG_ERROR, "Snapshot decoder: Failed to write JPEG file: %s", strerror(errno));
+            close(fd);
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    return fd;
+}
+
+/* --- Helper processes --- */
+
+static int snapshot_decoder_index(const snapshot_decoder_t *d)
+{
+    return (int)(d - decoders);
+}
+
+static void snapshot_decoder_close_fd(int *fd)
+{
+    if (*fd >= 0)
+    {
+        epoll_ctl(decoder_epfd, EPOLL_CTL_DEL, *fd, NULL);
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/* Keep a failing slot stopped for a while, longer after each failure */
+static void snapshot_decoder_backoff(snapshot_decoder_t *d, int64_t now)
+{
+    int64_t backoff = (int64_t)SNAPSHOT_DECODER_BACKOFF_MS << (d->failures < 5 ? d->failures : 5);
+
+    d->failures++;
+    d->restart_after_ms = now + (backoff < SNAPSHOT_DECODER_BACKOFF_MAX_MS ? backoff : SNAPSHOT_DECODER_BACKOFF_MAX_MS);
+}
+
+/* Reap killed helpers that did not exit right away (block only at worker exit) */
+static void snapshot_decoder_reap_orphans(int block)
+{
+    int i = 0;
+
+    while (i < decoder_orphan_count)
+    {
+        if (waitpid(decoder_orphans[i], NULL, block ? 0 : WNOHANG) != 0)
+            decoder_orphans[i] = decoder_orphans[--decoder_orphan_count];
+        else
+            i++;
+    }
+}
+
+/**
+ * Stop a helper; snapshots still in flight get a failed result
+ * @param failed 1 to delay the next start of this slot (backoff)
+ */
+static void snapshot_decoder_stop(snapshot_decoder_t *d, const char *reason, int failed, int64_t now)
+{
+    snapshot_context_t *lost[SNAPSHOT_DECODER_INFLIGHT];
+    int lost_count = 0;
+    int i;
+
+    if (d->pid <= 0)
+        return;
+
+    logger(failed ? LOG_WARN : LOG_DEBUG, "Snapshot decoder %d: Stopping helper (pid %d, %lu pictures): %s",
+           snapshot_decoder_index(d), (int)d->pid, d->pictures, reason);
+
+    snapshot_decoder_close_fd(&d->in_fd);
+    snapshot_decoder_close_fd(&d->out_fd);
+    snapshot_decoder_close_fd(&d->err_fd);
+
+    kill(d->pid, SIGKILL);
+    if (waitpid(d->pid, NULL, WNOHANG) == 0)
+    {
+        if (decoder_orphan_count < SNAPSHOT_DECODER_ORPHANS_MAX)
+            decoder_orphans[decoder_orphan_count++] = d->pid;
+        else
+            waitpid(d->pid, NULL, 0);
+    }
+    d->pid = 0;
+
+    for (i = 0; i < d->inflight_count; i++)
+    {
+        snapshot_context_t *ctx = d->inflight[(d->inflight_head + i) % SNAPSHOT_DECODER_INFLIGHT];
+        if (ctx)
+            lost[lost_count++] = ctx;
+    }
+    d->inflight_head = 0;
+    d->inflight_count = 0;
+    d->pending = 0;
+    d->writing = 0;
+
+    free(d->frame);
+    d->frame = NULL;
+    d->frame_len = 0;
+    free(d->out);
+    d->out = NULL;
+    d->out_len = 0;
+    d->out_cap = 0;
+
+    if (failed)
+        snapshot_decoder_backoff(d, now);
+
+    /* Results last: they may free snapshots and queue responses */
+    for (i = 0; i < lost_count; i++)
+        snapshot_decoder_result(lost[i], -1, 0);
+}
+
+static void snapshot_decoder_close_pipe(int p[2])
+{
+    if (p[0] >= 0)
+        close(p[0]);
+    if (p[1] >= 0)
+        close(p[1]);
+}
+
+static int snapshot_decoder_watch(int fd, uint32_t events)
+{
+    struct epoll_event ev;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(decoder_epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot decoder: Failed to add pipe to epoll: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Start ffmpeg reading an elementary stream on stdin and writing one MJPEG
+ * picture per frame to stdout
+ * @return 0 if the helper is running, -1 on error
+ */
+static int snapshot_decoder_start(snapshot_decoder_t *d, int codec, int width, int height, int64_t now)
+{
+    int in_pipe[2] = {-1, -1}, out_pipe[2] = {-1, -1}, err_pipe[2] = {-1, -1};
+
+    if (pipe2(in_pipe, O_CLOEXEC) < 0 || pipe2(out_pipe, O_CLOEXEC) < 0 || pipe2(err_pipe, O_CLOEXEC) < 0)
+    {
+        logger(LOG_ERROR, "Snapshot decoder: Failed to create pipes: %s", strerror(errno));
+        snapshot_decoder_close_pipe(in_pipe);
+        snapshot_decoder_close_pipe(out_pipe);
+        snapshot_decoder_close_pipe(err_pipe);
+        snapshot_decoder_backoff(d, now);
+        return -1;
+    }
+
+    const char *ffmpeg_path = config.ffmpeg_path ? config.ffmpeg_path : "ffmpeg";
+    const char *ffmpeg_args = config.ffmpeg_args ? config.ffmpeg_args : "-hwaccel none";
+
+    /* Minimal probing and no reordering of output: each frame written is
+     * decoded as soon as the decoder's delay allows */
+    char command[1024];
+    snprintf(command, sizeof(command),
+             "exec %s %s -nostdin -loglevel error -threads 1 -flags low_delay -probesize 32 -analyzeduration 0 "
+             "-f %s -i pipe:0 -vsync passthrough -q:v 8 -f image2pipe -c:v mjpeg -flush_packets 1 pipe:1",
+             ffmpeg_path, ffmpeg_args, codec == SNAPSHOT_CODEC_HEVC ? "hevc" : "h264");
+
+    logger(LOG_DEBUG, "Snapshot decoder %d: Executing ffmpeg: %s", snapshot_decoder_index(d), command);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+#ifdef HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP
+    /* The helper outlives many clients: it must not hold their sockets (or
+     * multicast memberships) open. Sockets are CLOEXEC too, for other libcs. */
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+#endif
+
+    /* The worker ignores SIGPIPE for the helper pipes; ffmpeg gets the default back */
+    posix_spawnattr_t attr;
+    sigset_t sigdefault;
+    posix_spawnattr_init(&attr);
+    sigemptyset(&sigdefault);
+    sigaddset(&sigdefault, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &sigdefault);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF);
+
+    char sh_name[] = "sh";
+    char sh_flag[] = "-c";
+    char *argv[] = {sh_name, sh_flag, command, NULL};
+    pid_t pid;
+    int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+
+    if (err != 0)
+    {
+        logger(LOG_ERROR, "Snapshot decoder: Failed to execute ffmpeg: %s", strerror(err));
+        close(in_pipe[1]);
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        snapshot_decoder_backoff(d, now);
+        return -1;
+    }
+
+    d->pid = pid;
+    d->in_fd = in_pipe[1];
+    d->out_fd = out_pipe[0];
+    d->err_fd = err_pipe[0];
+    if (snapshot_decoder_watch(d->in_fd, 0) < 0 || snapshot_decoder_watch(d->out_fd, EPOLLIN) < 0 ||
+        snapshot_decoder_watch(d->err_fd, EPOLLIN) < 0)
+    {
+        snapshot_decoder_stop(d, "epoll registration failed", 1, now);
+        return -1;
+    }
+
+    d->codec = codec;
+    d->width = width;
+    d->height = height;
+    d->lag = 0;
+    d->trailing_fillers = 0;
+    d->err_len = 0;
+    d->pictures = 0;
+    d->last_progress_ms = now;
+    d->last_used_ms = now;
+
+    logger(LOG_INFO, "Snapshot decoder %d: Started helper (pid %d) for %s %dx%d", snapshot_decoder_index(d),
+           (int)pid, codec == SNAPSHOT_CODEC_HEVC ? "HEVC" : "H.264", width, height);
+    return 0;
+}
+
+/**
+ * Write the rest of the current frame and its flush NAL
+ * @return 0 on success or would block, -1 if the helper is gone
+ */
+static int snapshot_decoder_write(snapshot_decoder_t *d)
+{
+    uint8_t *flush = d->codec == SNAPSHOT_CODEC_HEVC ? flush_hevc : flush_h264;
+    size_t flush_len = d->codec == SNAPSHOT_CODEC_HEVC ? sizeof(flush_hevc) : sizeof(flush_h264);
+    size_t total = d->frame_len + flush_len;
+    struct epoll_event ev;
+
+    while (d->write_off < total)
+    {
+        struct iovec iov[2];
+        int iovcnt = 0;
+
+        if (d->write_off < d->frame_len)
+        {
+            iov[iovcnt].iov_base = d->frame + d->write_off;
+            iov[iovcnt].iov_len = d->frame_len - d->write_off;
+            iovcnt++;
+            iov[iovcnt].iov_base = flush;
+            iov[iovcnt].iov_len = flush_len;
+            iovcnt++;
+        }
+        else
+        {
+            iov[iovcnt].iov_base = flush + (d->write_off - d->frame_len);
+            iov[iovcnt].iov_len = total - d->write_off;
+            iovcnt++;
+        }
+
+        ssize_t n = writev(d->in_fd, iov, iovcnt);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
+            {
+                if (!d->writing)
+                {
+                    memset(&ev, 0, sizeof(ev));
+                    ev.events = EPOLLOUT;
+                    ev.data.fd = d->in_fd;
+                    epoll_ctl(decoder_epfd, EPOLL_CTL_MOD, d->in_fd, &ev);
+                    d->writing = 1;
+                }
+                return 0;
+            }
+            logger(LOG_ERROR, "Snapshot decoder %d: Write failed: %s", snapshot_decoder_index(d), strerror(errno));
+            return -1;
+        }
+        d->write_off += (size_t)n;
+    }
+
+    if (d->writing)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.data.fd = d->in_fd;
+        epoll_ctl(decoder_epfd, EPOLL_CTL_MOD, d->in_fd, &ev);
+        d->writing = 0;
+    }
+    return 0;
+}
+
+/* Send d->frame again, for a snapshot (ctx) or as filler (NULL) */
+static int snapshot_decoder_send(snapshot_decoder_t *d, snapshot_context_t *ctx, int64_t now)
+{
+    d->inflight[(d->inflight_head + d->inflight_count) % SNAPSHOT_DECODER_INFLIGHT] = ctx;
+    d->inflight_count++;
+    if (ctx)
+    {
+        if (d->pending++ == 0)
+            d->last_progress_ms = now;
+        d->trailing_fillers = 0;
+        d->last_used_ms = now;
+    }
+    else
+    {
+        d->trailing_fillers++;
+    }
+
+    d->write_off = 0;
+    if (snapshot_decoder_write(d) < 0)
+    {
+        snapshot_decoder_stop(d, "helper input closed", 1, now);
+        return -1;
+    }
+    return 0;
+}
+
+static int snapshot_decoder_can_take(const snapshot_decoder_t *d)
+{
+    return d->pid > 0 && !d->writing && d->inflight_count < SNAPSHOT_DECODER_INFLIGHT;
+}
+
+/* Helper for a queued frame, started or restarted if needed; NULL to keep it queued */
+static snapshot_decoder_t *snapshot_decoder_pick(const snapshot_decoder_job_t *job, int64_t now)
+{
+    snapshot_decoder_t *busy = NULL, *spare = NULL;
+    int i;
+
+    for (i = 0; i < decoder_count; i++)
+    {
+        snapshot_decoder_t *d = &decoders[i];
+        int same = d->pid > 0 && d->codec == job->codec && d->width == job->width && d->height == job->height;
+
+        if (same && snapshot_decoder_can_take(d))
+        {
+            if (d->pending == 0)
+                return d;
+            if (!busy || d->pending < busy->pending)
+                busy = d;
+        }
+        else if (d->pid <= 0 && now >= d->restart_after_ms)
+        {
+            if (!spare || spare->pid > 0)
+                spare = d;
+        }
+        else if (!same && d->pid > 0 && d->pending == 0 && !d->writing)
+        {
+            if (!spare || (spare->pid > 0 && d->last_used_ms < spare->last_used_ms))
+                spare = d;
+        }
+    }
+
+    /* Another helper decodes in parallel rather than queueing behind a busy one */
+    if (spare)
+    {
+        if (spare->pid > 0)
+            snapshot_decoder_stop(spare, "restarting for another stream", 0, now);
+        if (snapshot_decoder_start(spare, job->codec, job->width, job->height, now) == 0)
+            return spare;
+    }
+    return busy;
+}
+
+static void snapshot_decoder_dispatch(int64_t now)
+{
+    snapshot_decoder_job_t **pp = &job_head;
+    snapshot_decoder_job_t *prev = NULL;
+    int i;
+
+    while (*pp)
+    {
+        snapshot_decoder_job_t *job = *pp;
+        snapshot_decoder_t *d = snapshot_decoder_pick(job, now);
+        if (!d)
+        {
+            prev = job;
+            pp = &job->next;
+            continue;
+        }
+
+        *pp = job->next;
+        if (job_tail == job)
+            job_tail = prev;
+        job_count--;
+
+        free(d->frame);
+        d->frame = job->es;
+        d->frame_len = job->es_len;
+        snapshot_context_t *ctx = job->ctx;
+        free(job);
+        snapshot_decoder_send(d, ctx, now);
+    }
+
+    /* Push the last frames out of the decoder's delay */
+    for (i = 0; i < decoder_count; i++)
+    {
+        snapshot_decoder_t *d = &decoders[i];
+        while (snapshot_decoder_can_take(d) && d->pending > 0 && d->trailing_fillers < d->lag)
+        {
+            if (snapshot_decoder_send(d, NULL, now) < 0)
+                break;
+        }
+    }
+}
+
+static void snapshot_decoder_picture(snapshot_decoder_t *d, const uint8_t *data, size_t len, int64_t now)
+{
+    if (d->inflight_count == 0)
+    {
+        logger(LOG_DEBUG, "Snapshot decoder %d: Unexpected picture, discarded", snapshot_decoder_index(d));
+        return;
+    }
+
+    snapshot_context_t *ctx = d->inflight[d->inflight_head];
+    d->inflight_head = (d->inflight_head + 1) % SNAPSHOT_DECODER_INFLIGHT;
+    d->inflight_count--;
+    d->pictures++;
+    d->failures = 0;
+    d->last_progress_ms = now;
+
+    if (!ctx)
+        return; /* Filler or cancelled snapshot */
+
+    d->pending--;
+    int fd = snapshot_decoder_store_jpeg(data, len);
+    snapshot_decoder_result(ctx, fd, fd >= 0 ? len : 0);
+}
+
+static void snapshot_decoder_read_output(snapshot_decoder_t *d, int64_t now)
+{
+    for (;;)
+    {
+        if (d->out_cap - d->out_len < 16384)
+        {
+            size_t cap = d->out_cap ? d->out_cap * 2 : 65536;
+            if (cap > SNAPSHOT_DECODER_JPEG_MAX)
+            {
+                snapshot_decoder_stop(d, "picture too large", 1, now);
+                return;
+            }
+            uint8_t *out = realloc(d->out, cap);
+            if (!out)
+            {
+                snapshot_decoder_stop(d, "out of memory", 1, now);
+                return;
+            }
+            d->out = out;
+            d->out_cap = cap;
+        }
+
+        ssize_t n = read(d->out_fd, d->out + d->out_len, d->out_cap - d->out_len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            break;
+        if (n <= 0)
+        {
+            snapshot_decoder_stop(d, "helper exited", 1, now);
+            return;
+        }
+        d->out_len += (size_t)n;
+
+        ssize_t end;
+        while ((end = snapshot_decoder_jpeg_end(d->out, d->out_len)) > 0)
+        {
+            snapshot_decoder_picture(d, d->out, (size_t)end, now);
+            if (d->pid <= 0)
+                return;
+            memmove(d->out, d->out + end, d->out_len - (size_t)end);
+            d->out_len -= (size_t)end;
+        }
+        if (end < 0)
+        {
+            snapshot_decoder_stop(d, "unexpected output", 1, now);
+            return;
+        }
+    }
+
+    snapshot_decoder_dispatch(now);
+}
+
+static void snapshot_decoder_read_errors(snapshot_decoder_t *d)
+{
+    char buf[512];
+
+    for (;;)
+    {
+        ssize_t n = read(d->err_fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            return;
+        if (n <= 0)
+        {
+            /* Exit is noticed on stdout */
+            snapshot_decoder_close_fd(&d->err_fd);
+            return;
+        }
+
+        /* ffmpeg writes lines in pieces; log whole lines */
+        for (ssize_t i = 0; i < n; i++)
+        {
+            int eol = buf[i] == '\n' || buf[i] == '\r';
+            if (!eol)
+                d->err_line[d->err_len++] = buf[i];
+            if ((eol && d->err_len > 0) || d->err_len == sizeof(d->err_line) - 1)
+            {
+                d->err_line[d->err_len] = '\0';
+                logger(LOG_DEBUG, "Snapshot decoder %d: ffmpeg: %s", snapshot_decoder_index(d), d->err_line);
+                d->err_len = 0;
+            }
+        }
+    }
+}
+
+/* --- Public API --- */
+
+void snapshot_decoder_init(int epfd)
+{
+    int i;
+
+    decoder_epfd = epfd;
+    decoder_count = config.video_snapshot ? config.snapshot_decoders : 0;
+    if (decoder_count > SNAPSHOT_DECODER_MAX)
+        decoder_count = SNAPSHOT_DECODER_MAX;
+
+    for (i = 0; i < SNAPSHOT_DECODER_MAX; i++)
+    {
+        memset(&decoders[i], 0, sizeof(decoders[i]));
+        decoders[i].in_fd = -1;
+        decoders[i].out_fd = -1;
+        decoders[i].err_fd = -1;
+    }
+
+    /* A helper that died must show up as EPIPE, not kill the worker */
+    if (decoder_count > 0)
+        signal(SIGPIPE, SIG_IGN);
+}
+
+int snapshot_decoder_enabled(void)
+{
+    return decoder_count > 0;
+}
+
+int snapshot_decoder_submit(snapshot_context_t *ctx, int codec, uint8_t *es, size_t es_len)
+{
+    int64_t now = get_time_ms();
+    int width, height, i;
+
+    if (job_count >= SNAPSHOT_DECODER_QUEUE_MAX)
+    {
+        logger(LOG_WARN, "Snapshot decoder: Queue full (%d waiting)", job_count);
+        free(es);
+        return -1;
+    }
+
+    if (snapshot_decoder_probe(codec, es, es_len, &width, &height) < 0)
+    {
+        logger(LOG_DEBUG, "Snapshot decoder: No usable SPS in captured frame");
+        free(es);
+        return -1;
+    }
+
+    /* All helpers failing: let the caller convert without the pool */
+    for (i = 0; i < decoder_count; i++)
+        if (decoders[i].pid > 0 || now >= decoders[i].restart_after_ms)
+            break;
+    if (i == decoder_count)
+    {
+        logger(LOG_DEBUG, "Snapshot decoder: All helpers backing off");
+        free(es);
+        return -1;
+    }
+
+    if (codec == SNAPSHOT_CODEC_HEVC)
+        snapshot_decoder_cra_to_bla(es, es_len);
+
+    snapshot_decoder_job_t *job = calloc(1, sizeof(*job));
+    if (!job)
+    {
+        free(es);
+        return -1;
+    }
+    job->ctx = ctx;
+    job->codec = codec;
+    job->width = width;
+    job->height = height;
+    job->es = es;
+    job->es_len = es_len;
+
+    if (job_tail)
+        job_tail->next = job;
+    else
+        job_head = job;
+    job_tail = job;
+    job_count++;
+
+    snapshot_decoder_dispatch(now);
+    return 0;
+}
+
+void snapshot_decoder_cancel(snapshot_context_t *ctx)
+{
+    snapshot_decoder_job_t **pp = &job_head;
+    snapshot_decoder_job_t *prev = NULL;
+    int i, j;
+
+    while (*pp)
+    {
+        snapshot_decoder_job_t *job = *pp;
+        if (job->ctx == ctx)
+        {
+            *pp = job->next;
+            if (job_tail == job)
+                job_tail = prev;
+            job_count--;
+            free(job->es);
+            free(job);
+            return;
+        }
+        prev = job;
+        pp = &job->next;
+    }
+
+    /* In flight: keep the slot so the picture is still matched, then discarded */
+    for (i = 0; i < decoder_count; i++)
+    {
+        snapshot_decoder_t *d = &decoders[i];
+        for (j = 0; j < d->inflight_count; j++)
+        {
+            int k = (d->inflight_head + j) % SNAPSHOT_DECODER_INFLIGHT;
+            if (d->inflight[k] == ctx)
+            {
+                d->inflight[k] = NULL;
+                d->pending--;
+                return;
+            }
+        }
+    }
+}
+
+int snapshot_decoder_handle_event(int fd, uint32_t events)
+{
+    int64_t now = get_time_ms();
+    int i;
+
+    for (i = 0; i < decoder_count; i++)
+    {
+        snapshot_decoder_t *d = &decoders[i];
+        if (d->pid <= 0)
+            continue;
+
+        if (fd == d->out_fd)
+        {
+            snapshot_decoder_read_output(d, now);
+            return 1;
+        }
+        if (fd == d->err_fd)
+        {
+            snapshot_decoder_read_errors(d);
+            return 1;
+        }
+        if (fd == d->in_fd)
+        {
+            if (events & (EPOLLERR | EPOLLHUP))
+                snapshot_decoder_stop(d, "helper input closed", 1, now);
+            else if (snapshot_decoder_write(d) < 0)
+                snapshot_decoder_stop(d, "helper input closed", 1, now);
+            else if (!d->writing)
+                snapshot_decoder_dispatch(now);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void snapshot_decoder_tick(int64_t now)
+{
+    int i;
+
+    if (decoder_count == 0)
+        return;
+
+    snapshot_decoder_reap_orphans(0);
+
+    for (i = 0; i < decoder_count; i++)
+    {
+        snapshot_decoder_t *d = &decoders[i];
+
+        if (d->pid <= 0)
+            continue;
+
+        if (d->pending > 0 && now - d->last_progress_ms > SNAPSHOT_DECODER_STALL_MS)
+        {
+            snapshot_decoder_stop(d, "no picture in time", 1, now);
+        }
+        else if (d->pending > 0 && !d->writing && d->trailing_fillers >= d->lag &&
+                 now - d->last_progress_ms > SNAPSHOT_DECODER_FILLER_WAIT_MS)
+        {
+            /* The decoder holds back more frames than assumed so far */
+            if (d->lag >= SNAPSHOT_DECODER_MAX_LAG)
+                snapshot_decoder_stop(d, "frames not coming out", 1, now);
+            else
+            {
+                d->lag++;
+                d->last_progress_ms = now;
+                logger(LOG_DEBUG, "Snapshot decoder %d: Decoder delay now %d frames", i, d->lag);
+            }
+        }
+        else if (d->pending == 0 && !d->writing && now - d->last_used_ms > SNAPSHOT_DECODER_IDLE_MS)
+        {
+            snapshot_decoder_stop(d, "idle", 0, now);
+        }
+    }
+
+    snapshot_decoder_dispatch(now);
+}
+
+void snapshot_decoder_cleanup(void)
+{
+    int64_t now = get_time_ms();
+    int i;
+
+    while (job_head)
+    {
+        snapshot_decoder_job_t *job = job_head;
+        job_head = job->next;
+        free(job->es);
+        free(job);
+    }
+    job_tail = NULL;
+    job_count = 0;
+
+    for (i = 0; i < decoder_count; i++)
+        snapshot_decoder_stop(&decoders[i], "worker exiting", 0, now);
+    snapshot_decoder_reap_orphans(1);
+}
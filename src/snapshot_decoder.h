@@ -0,0 +1,87 @@
+#ifndef SNAPSHOT_DECODER_H
+#define SNAPSHOT_DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Persistent snapshot decoder pool (per worker)
+ *
+ * Instead of starting ffmpeg for every snapshot, each worker keeps up to
+ * snapshot-decoders long-lived ffmpeg helpers reading an H.264/HEVC
+ * elementary stream on stdin and writing MJPEG frames to stdout
+ * (image2pipe). A captured IDR access unit is written as one frame and
+ * the next JPEG on stdout is its picture, so process start and stream
+ * probing are paid once per helper instead of once per snapshot.
+ *
+ * - Decoders hold back as many frames as the stream may reorder; after
+ *   the last queued frame the helper is fed copies of it ("fillers")
+ *   whose pictures are discarded, and the number needed is learned
+ *   per helper
+ * - ffmpeg scales every frame to the size of the first one, so a helper
+ *   only takes frames of the codec and resolution it was started with
+ *   and an idle helper is restarted for another one
+ * - Helpers that exit, stall or misbehave are restarted with backoff;
+ *   their frames fail over to the snapshot's fallback
+ * - Helper pipes are registered with the worker epoll instance directly
+ *   (not in fdmap); the worker dispatches their events via
+ *   snapshot_decoder_handle_event()
+ */
+
+/* Upper bound of helpers per worker (config is clamped to this) */
+#define SNAPSHOT_DECODER_MAX 8
+
+/* Video codecs of captured frames */
+#define SNAPSHOT_CODEC_UNKNOWN 0
+#define SNAPSHOT_CODEC_H264 1
+#define SNAPSHOT_CODEC_HEVC 2
+
+typedef struct snapshot_context_s snapshot_context_t;
+
+/**
+ * Initialize the pool for this worker (helpers start on demand)
+ * @param epfd Worker epoll file descriptor
+ */
+void snapshot_decoder_init(int epfd);
+
+/**
+ * @return 1 if snapshots are converted by the pool
+ */
+int snapshot_decoder_enabled(void);
+
+/**
+ * Queue a captured frame for conversion
+ * The JPEG (or the failure) is reported through snapshot_decoder_result().
+ * @param ctx Snapshot waiting for the JPEG
+ * @param codec SNAPSHOT_CODEC_H264 or SNAPSHOT_CODEC_HEVC
+ * @param es Annex B access unit including parameter sets (malloc'd, ownership passes to the pool)
+ * @param es_len Length of es
+ * @return 0 if queued, -1 if the pool cannot take the frame (es is freed)
+ */
+int snapshot_decoder_submit(snapshot_context_t *ctx, int codec, uint8_t *es, size_t es_len);
+
+/**
+ * Forget a queued or in-flight frame, e.g. when the client went away
+ */
+void snapshot_decoder_cancel(snapshot_context_t *ctx);
+
+/**
+ * Handle epoll event for a helper pipe
+ * @param fd File descriptor from epoll event
+ * @param events Epoll events
+ * @return 1 if fd belongs to the pool (event consumed), 0 otherwise
+ */
+int snapshot_decoder_handle_event(int fd, uint32_t events);
+
+/**
+ * Periodic maintenance: fillers, stalls, restarts and idle helpers
+ * @param now Current time in milliseconds
+ */
+void snapshot_decoder_tick(int64_t now);
+
+/**
+ * Stop all helpers
+ */
+void snapshot_decoder_cleanup(void);
+
+#endif /* SNAPSHOT_DECODER_H */
@@ -70,6 +70,11 @@ static void json_escape_string(const char *in, char *out, size_t out_sz)
   *dst = '\0';
 }
 
+/* JSON keys for loop_phase_t, in enum order */
+static const char *const loop_phase_names[LOOP_PHASE_COUNT] = {
+    "wait", "busy", "accept", "clientRead", "clientWrite",
+    "stream", "shared", "control", "fetch", "tick"};
+
 /* Global pointer to shared memory */
 status_shared_t *status_shared = NULL;
 
@@ -118,6 +123,11 @@ int status_init(void)
    * This is best practice and avoids fd management issues after fork() */
   close(fd);
 
+  /* Workers inherit the mapping, so the name is not needed any more.
+   * Unlinking now keeps a re-executed binary from reopening (and wiping)
+   * the segment the draining instance still uses. */
+  shm_unlink(SHM_NAME);
+
   /* Initialize shared memory structure */
   memset(status_shared, 0, sizeof(status_shared_t));
   status_shared->server_start_time = get_realtime_ms();
@@ -162,9 +172,11 @@ int status_init(void)
         return -1;
       }
 
-      /* Set read end to non-blocking mode */
+      /* Set both ends to non-blocking mode (a worker being respawned must not stall writers) */
       int flags = fcntl(pipe_fds[0], F_GETFL, 0);
       fcntl(pipe_fds[0], F_SETFL, flags | O_NONBLOCK);
+      flags = fcntl(pipe_fds[1], F_GETFL, 0);
+      fcntl(pipe_fds[1], F_SETFL, flags | O_NONBLOCK);
 
       /* Store both ends in shared memory
        * Read ends will be used by each worker after fork
@@ -174,10 +186,12 @@ int status_init(void)
     }
   }
 
-  /* Initialize mutexes for multi-process safety */
+  /* Initialize mutexes for multi-process safety
+   * Robust, so a worker that dies holding one does not block the others */
   pthread_mutexattr_t mutex_attr;
   pthread_mutexattr_init(&mutex_attr);
   pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
   pthread_mutex_init(&status_shared->log_mutex, &mutex_attr);
   pthread_mutex_init(&status_shared->clients_mutex, &mutex_attr);
   pthread_mutexattr_destroy(&mutex_attr);
@@ -189,16 +203,16 @@ int status_init(void)
 /**
  * Cleanup status tracking system
  * IMPORTANT: This function is called by each worker process on exit.
- * Some cleanup operations must only be performed by worker 0 to avoid
- * race conditions and undefined behavior in multi-worker environments.
+ * Shared resources are only released by the supervisor (worker_id -1),
+ * which outlives every worker it started.
  */
 void status_cleanup(void)
 {
   if (status_shared != NULL && status_shared != MAP_FAILED)
   {
     /* Close all pipe write ends (shared across all workers)
-     * Only worker 0 should do this to avoid closing pipes other workers might still use */
-    if (worker_id == 0)
+     * Only the supervisor does this to avoid closing pipes other workers might still use */
+    if (worker_id < 0)
     {
       for (int i = 0; i < STATUS_MAX_WORKERS; i++)
       {
@@ -207,46 +221,86 @@ void status_cleanup(void)
           close(status_shared->worker_notification_pipes[i]);
           status_shared->worker_notification_pipes[i] = -1;
         }
+        if (status_shared->worker_notification_pipe_read_fds[i] != -1)
+        {
+          close(status_shared->worker_notification_pipe_read_fds[i]);
+          status_shared->worker_notification_pipe_read_fds[i] = -1;
+        }
       }
     }
 
     /* Each worker closes its own notification pipe read end
-     * (Other workers' read ends were already closed in status_worker_get_notif_fd) */
+     * (Other workers' read ends were already closed in status_worker_get_notif_fd)
+     * The descriptor number stays in shared memory for a respawned worker */
     if (worker_id >= 0 && worker_id < STATUS_MAX_WORKERS &&
         status_shared->worker_notification_pipe_read_fds[worker_id] != -1)
     {
       close(status_shared->worker_notification_pipe_read_fds[worker_id]);
-      status_shared->worker_notification_pipe_read_fds[worker_id] = -1;
     }
 
-    /* Only worker 0 destroys shared mutexes
-     * Destroying a mutex that other workers might still be using causes undefined behavior.
-     * In the fork model, worker 0 is the main process and exits last. */
-    if (worker_id == 0)
+    /* Only the supervisor destroys shared mutexes
+     * Destroying a mutex that workers might still be using causes undefined behavior. */
+    if (worker_id < 0)
     {
       pthread_mutex_destroy(&status_shared->log_mutex);
       pthread_mutex_destroy(&status_shared->clients_mutex);
     }
 
-    /* Each worker unmaps its own view of shared memory
-     * This is safe - munmap() only affects the current process's address space */
+    /* Each process unmaps its own view of shared memory
+     * This is safe - munmap() only affects the current process's address space
+     * (the shared memory name was already unlinked in status_init) */
     munmap(status_shared, sizeof(status_shared_t));
     status_shared = NULL;
   }
 
-  /* Only worker 0 unlinks shared memory object
-   * shm_unlink() removes the shared memory object from the filesystem.
-   * If called by a non-last worker, other workers would lose access to shared memory.
-   * In the fork model, worker 0 is the main process and exits last. */
-  if (worker_id == 0)
-  {
-    shm_unlink(SHM_NAME);
-    logger(LOG_DEBUG, "Status tracking cleaned up (worker 0 - shared resources destroyed)");
-  }
+  if (worker_id < 0)
+    logger(LOG_DEBUG, "Status tracking cleaned up (supervisor - shared resources destroyed)");
   else
-  {
     logger(LOG_DEBUG, "Status tracking cleaned up (worker %d)", worker_id);
+}
+
+/**
+ * Lock a shared mutex, recovering it if its owner died while holding it
+ */
+static void status_mutex_lock(pthread_mutex_t *mutex)
+{
+  if (pthread_mutex_lock(mutex) == EOWNERDEAD)
+    pthread_mutex_consistent(mutex);
+}
+
+/**
+ * Release the shared state of a worker that exited
+ * Called by the supervisor before the worker is respawned
+ */
+void status_worker_reset(int worker)
+{
+  if (!status_shared || worker < 0 || worker >= STATUS_MAX_WORKERS)
+    return;
+
+  status_mutex_lock(&status_shared->clients_mutex);
+  for (int i = 0; i < STATUS_MAX_CLIENTS; i++)
+  {
+    client_stats_t *client = &status_shared->clients[i];
+    if (!client->active || client->worker_index != worker)
+      continue;
+
+    status_shared->total_bytes_sent_cumulative += client->bytes_sent;
+    status_shared->worker_stats[worker].client_bytes_cumulative += client->bytes_sent;
+    client->active = 0;
+    client->state = CLIENT_STATE_DISCONNECTED;
+    client->disconnect_requested = 0;
+    client->worker_index = -1;
+    status_shared->total_clients--;
   }
+  pthread_mutex_unlock(&status_shared->clients_mutex);
+
+  /* Keep cumulative traffic, everything else describes the dead process */
+  worker_stats_t *ws = &status_shared->worker_stats[worker];
+  uint64_t client_bytes_cumulative = ws->client_bytes_cumulative;
+  memset(ws, 0, sizeof(*ws));
+  ws->client_bytes_cumulative = client_bytes_cumulative;
+
+  status_trigger_event(STATUS_EVENT_SSE_UPDATE);
 }
 
 /**
@@ -262,7 +316,7 @@ int status_register_client(const char *client_addr_str, const char *service_url)
     return -1;
 
   /* Lock mutex to protect client slot allocation */
-  pthread_mutex_lock(&status_shared->clients_mutex);
+  status_mutex_lock(&status_shared->clients_mutex);
 
   /* Find free slot */
   for (int i = 0; i < STATUS_MAX_CLIENTS; i++)
@@ -276,6 +330,7 @@ int status_register_client(const char *client_addr_str, const char *service_url)
       status_shared->clients[i].worker_index = worker_id;
       status_shared->clients[i].connect_time = get_realtime_ms();
       status_shared->clients[i].disconnect_requested = 0;
+      status_shared->clients[i].upstream_rtt_ms = -1;
 
       /* Copy client address string (format: "IP:port" or "[IPv6]:port") */
       strncpy(status_shared->clients[i].client_addr, client_addr_str,
@@ -482,6 +537,38 @@ void status_update_client_queue(int status_index,
   status_shared->clients[status_index].slow_active = slow_active;
 }
 
+void status_update_client_upstream(int status_index, uint32_t jitter_us, uint32_t lost,
+                                   uint32_t expected, int32_t rtt_ms)
+{
+  if (!status_shared)
+    return;
+
+  if (status_index < 0 || status_index >= STATUS_MAX_CLIENTS)
+    return;
+
+  if (!status_shared->clients[status_index].active)
+    return;
+
+  status_shared->clients[status_index].upstream_jitter_us = jitter_us;
+  status_shared->clients[status_index].upstream_lost = lost;
+  status_shared->clients[status_index].upstream_expected = expected;
+  status_shared->clients[status_index].upstream_rtt_ms = rtt_ms;
+}
+
+void status_update_client_memory(int status_index, uint32_t memory_bytes)
+{
+  if (!status_shared)
+    return;
+
+  if (status_index < 0 || status_index >= STATUS_MAX_CLIENTS)
+    return;
+
+  if (!status_shared->clients[status_index].active)
+    return;
+
+  status_shared->clients[status_index].memory_bytes = memory_bytes;
+}
+
 /**
  * Add log entry to circular buffer
  */
@@ -493,7 +580,7 @@ void status_add_log_entry(enum loglevel level, const char *message)
     return;
 
   /* Lock mutex to prevent race conditions in multi-worker environment */
-  pthread_mutex_lock(&status_shared->log_mutex);
+  status_mutex_lock(&status_shared->log_mutex);
 
   /* Get next write index */
   index = status_shared->log_write_index;
@@ -606,7 +693,9 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
                       "\"serviceUrl\":\"%s\",\"state\":%d,\"bytesSent\":%llu,"
                       "\"currentBandwidth\":%u,\"queueBytes\":%zu,"
                       "\"queueLimitBytes\":%zu,\"queueBytesHighwater\":%zu,"
-                      "\"droppedBytes\":%llu,\"slow\":%d}",
+                      "\"droppedBytes\":%llu,\"slow\":%d,"
+                      "\"memoryBytes\":%u,"
+                      "\"upstream\":{\"jitterUs\":%u,\"lost\":%u,\"expected\":%u,\"rttMs\":%d}}",
                       i, /* client_id is the status_index */
                       status_shared->clients[i].worker_pid,
                       (long long)duration_ms,
@@ -619,7 +708,12 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
                       status_shared->clients[i].queue_limit_bytes,
                       status_shared->clients[i].queue_bytes_highwater,
                       (unsigned long long)status_shared->clients[i].dropped_bytes,
-                      status_shared->clients[i].slow_active);
+                      status_shared->clients[i].slow_active,
+                      status_shared->clients[i].memory_bytes,
+                      status_shared->clients[i].upstream_jitter_us,
+                      status_shared->clients[i].upstream_lost,
+                      status_shared->clients[i].upstream_expected,
+                      status_shared->clients[i].upstream_rtt_ms);
 
       streams_count++;
       total_bytes += status_shared->clients[i].bytes_sent;
@@ -667,8 +761,10 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
     len += snprintf(buffer + len, buffer_capacity - (size_t)len,
                     "{\"id\":%d,\"pid\":%d,\"activeClients\":%u,\"totalBandwidth\":%llu,\"totalBytes\":%llu,"
                     "\"send\":{\"total\":%llu,\"completions\":%llu,\"copied\":%llu,\"eagain\":%llu,\"enobufs\":%llu,\"batch\":%llu},"
-                    "\"pool\":{\"total\":%llu,\"free\":%llu,\"used\":%llu,\"max\":%llu,\"expansions\":%llu,\"exhaustions\":%llu,\"shrinks\":%llu,\"utilization\":%.1f},"
-                    "\"controlPool\":{\"total\":%llu,\"free\":%llu,\"used\":%llu,\"max\":%llu,\"expansions\":%llu,\"exhaustions\":%llu,\"shrinks\":%llu,\"utilization\":%.1f}}",
+                    "\"http\":{\"connections\":%llu,\"requests\":%llu,\"keepaliveReuses\":%llu,\"handoffSent\":%llu,\"handoffReceived\":%llu},"
+                    "\"pool\":{\"total\":%llu,\"free\":%llu,\"used\":%llu,\"max\":%llu,\"expansions\":%llu,\"exhaustions\":%llu,\"shrinks\":%llu,\"utilization\":%.1f,"
+                    "\"budget\":%llu,\"memoryPressure\":%.2f},"
+                    "\"controlPool\":{\"total\":%llu,\"free\":%llu,\"used\":%llu,\"max\":%llu,\"expansions\":%llu,\"exhaustions\":%llu,\"shrinks\":%llu,\"utilization\":%.1f}",
                     i,
                     (int)ws->worker_pid,
                     (unsigned int)w_active,
@@ -680,6 +776,11 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
                     (unsigned long long)ws->eagain_count,
                     (unsigned long long)ws->enobufs_count,
                     (unsigned long long)ws->batch_sends,
+                    (unsigned long long)ws->http_connections,
+                    (unsigned long long)ws->http_requests,
+                    (unsigned long long)ws->http_keepalive_reuses,
+                    (unsigned long long)ws->handoff_sent,
+                    (unsigned long long)ws->handoff_received,
                     (unsigned long long)w_pool_total,
                     (unsigned long long)w_pool_free,
                     (unsigned long long)w_pool_used,
@@ -688,6 +789,8 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
                     (unsigned long long)ws->pool_exhaustions,
                     (unsigned long long)ws->pool_shrinks,
                     w_pool_total > 0 ? (100.0 * w_pool_used / w_pool_total) : 0.0,
+                    (unsigned long long)ws->pool_budget_bytes,
+                    ws->mem_pressure < 0 ? -1.0 : ws->mem_pressure / 100.0,
                     (unsigned long long)w_ctrl_total,
                     (unsigned long long)w_ctrl_free,
                     (unsigned long long)w_ctrl_used,
@@ -696,6 +799,71 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
                     (unsigned long long)ws->control_pool_exhaustions,
                     (unsigned long long)ws->control_pool_shrinks,
                     w_ctrl_total > 0 ? (100.0 * w_ctrl_used / w_ctrl_total) : 0.0);
+
+    /* RTSP endpoint health scores */
+    len += snprintf(buffer + len, buffer_capacity - (size_t)len, ",\"rtspEndpoints\":[");
+    int first_endpoint = 1;
+    for (int j = 0; j < STATUS_MAX_RTSP_ENDPOINTS; j++)
+    {
+      rtsp_endpoint_stats_t *ep = &ws->rtsp_endpoints[j];
+      if (!ep->active)
+        continue;
+      if (!first_endpoint)
+        len += snprintf(buffer + len, buffer_capacity - (size_t)len, ",");
+      first_endpoint = 0;
+
+      char escaped_host[STATUS_RTSP_HOST_LEN * 2];
+      json_escape_string(ep->host, escaped_host, sizeof(escaped_host));
+      len += snprintf(buffer + len, buffer_capacity - (size_t)len,
+                      "{\"host\":\"%s\",\"port\":%d,\"score\":%d,\"latencyMs\":%u,"
+                      "\"attempts\":%llu,\"failures\":%llu,\"stalls\":%llu}",
+                      escaped_host,
+                      ep->port,
+                      ep->score,
+                      ep->latency_ms,
+                      (unsigned long long)ep->attempts,
+                      (unsigned long long)ep->failures,
+                      (unsigned long long)ep->stalls);
+    }
+    len += snprintf(buffer + len, buffer_capacity - (size_t)len, "]");
+
+    len += snprintf(buffer + len, buffer_capacity - (size_t)len,
+                    ",\"snapshotCache\":{\"hits\":%llu,\"misses\":%llu,\"coalesced\":%llu}",
+                    (unsigned long long)ws->snapshot_cache_hits,
+                    (unsigned long long)ws->snapshot_cache_misses,
+                    (unsigned long long)ws->snapshot_cache_coalesced);
+
+    /* Event loop timing histograms */
+    char escaped_site[STATUS_LOOP_SITE_LEN * 2];
+    json_escape_string(ws->loop_last_stall_site, escaped_site, sizeof(escaped_site));
+    len += snprintf(buffer + len, buffer_capacity - (size_t)len,
+                    ",\"loop\":{\"stalls\":%llu,\"lastStallUs\":%llu,\"lastStallTime\":%lld,\"lastStallSite\":\"%s\",\"phases\":{",
+                    (unsigned long long)ws->loop_stalls,
+                    (unsigned long long)ws->loop_last_stall_us,
+                    (long long)ws->loop_last_stall_time,
+                    escaped_site);
+    /* Unused phases are left out and histograms stop at the slowest bucket hit */
+    int first_phase = 1;
+    for (int j = 0; j < LOOP_PHASE_COUNT; j++)
+    {
+      loop_phase_stats_t *ps = &ws->loop_phases[j];
+      int buckets = STATUS_LOOP_HIST_BUCKETS;
+      if (ps->count == 0)
+        continue;
+      while (buckets > 1 && ps->hist[buckets - 1] == 0)
+        buckets--;
+      len += snprintf(buffer + len, buffer_capacity - (size_t)len,
+                      "%s\"%s\":{\"count\":%llu,\"totalUs\":%llu,\"maxUs\":%llu,\"hist\":[",
+                      first_phase ? "" : ",", loop_phase_names[j],
+                      (unsigned long long)ps->count,
+                      (unsigned long long)ps->total_us,
+                      (unsigned long long)ps->max_us);
+      first_phase = 0;
+      for (int b = 0; b < buckets; b++)
+        len += snprintf(buffer + len, buffer_capacity - (size_t)len, b ? ",%u" : "%u", ps->hist[b]);
+      len += snprintf(buffer + len, buffer_capacity - (size_t)len, "]}");
+    }
+    len += snprintf(buffer + len, buffer_capacity - (size_t)len, "}}}");
   }
   len += snprintf(buffer + len, buffer_capacity - (size_t)len, "]");
 
@@ -799,6 +967,17 @@ int status_build_sse_json(char *buffer, size_t buffer_capacity,
   return len;
 }
 
+/* Send a JSON API reply with Content-Length so the connection can be kept alive */
+static void status_send_api_response(connection_t *c, http_status_t status, const char *response)
+{
+  char extra_headers[64];
+  size_t len = strlen(response);
+
+  snprintf(extra_headers, sizeof(extra_headers), "Content-Length: %zu\r\n", len);
+  send_http_headers(c, status, CONTENT_HTML, extra_headers);
+  connection_queue_output_and_flush(c, (const uint8_t *)response, len);
+}
+
 /**
  * Handle API request to disconnect a client
  * RESTful: POST <status-path>/api/disconnect with form data body "client_id=123"
@@ -815,20 +994,18 @@ void handle_disconnect_client(connection_t *c)
 
   if (!status_shared)
   {
-    send_http_headers(c, STATUS_503, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Status system not initialized\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_503, response);
     return;
   }
 
   /* Check HTTP method */
   if (strcasecmp(c->http_req.method, "POST") != 0 && strcasecmp(c->http_req.method, "DELETE") != 0)
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Method not allowed. Use POST or DELETE\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -837,19 +1014,17 @@ void handle_disconnect_client(connection_t *c)
   {
     if (http_parse_query_param(c->http_req.body, "client_id", client_id_str, sizeof(client_id_str)) != 0)
     {
-      send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
       snprintf(response, sizeof(response),
                "{\"success\":false,\"error\":\"Missing 'client_id' parameter in request body\"}");
-      connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+      status_send_api_response(c, STATUS_400, response);
       return;
     }
   }
   else
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Missing request body\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -858,10 +1033,9 @@ void handle_disconnect_client(connection_t *c)
   /* Validate client_id range */
   if (client_id < 0 || client_id >= STATUS_MAX_CLIENTS)
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Invalid client_id\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -874,7 +1048,6 @@ void handle_disconnect_client(connection_t *c)
     /* Trigger disconnect request event to wake up workers */
     status_trigger_event(STATUS_EVENT_DISCONNECT_REQUEST);
   }
-  send_http_headers(c, STATUS_200, CONTENT_HTML, NULL);
 
   if (found)
   {
@@ -887,7 +1060,7 @@ void handle_disconnect_client(connection_t *c)
              "{\"success\":false,\"error\":\"Client not found or already disconnected\"}");
   }
 
-  connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+  status_send_api_response(c, STATUS_200, response);
 }
 
 /**
@@ -903,10 +1076,9 @@ void handle_set_log_level(connection_t *c)
   /* Check HTTP method */
   if (strcasecmp(c->http_req.method, "PUT") != 0 && strcasecmp(c->http_req.method, "PATCH") != 0)
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Method not allowed. Use PUT or PATCH\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -915,19 +1087,17 @@ void handle_set_log_level(connection_t *c)
   {
     if (http_parse_query_param(c->http_req.body, "level", level_str, sizeof(level_str)) != 0)
     {
-      send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
       snprintf(response, sizeof(response),
                "{\"success\":false,\"error\":\"Missing 'level' parameter in request body\"}");
-      connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+      status_send_api_response(c, STATUS_400, response);
       return;
     }
   }
   else
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Missing request body\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -935,10 +1105,9 @@ void handle_set_log_level(connection_t *c)
 
   if (new_level < LOG_FATAL || new_level > LOG_DEBUG)
   {
-    send_http_headers(c, STATUS_400, CONTENT_HTML, NULL);
     snprintf(response, sizeof(response),
              "{\"success\":false,\"error\":\"Invalid log level (must be 0-4)\"}");
-    connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+    status_send_api_response(c, STATUS_400, response);
     return;
   }
 
@@ -948,12 +1117,11 @@ void handle_set_log_level(connection_t *c)
     status_shared->current_log_level = new_level;
   }
   config.verbosity = new_level;
-  send_http_headers(c, STATUS_200, CONTENT_HTML, NULL);
 
   snprintf(response, sizeof(response),
            "{\"success\":true,\"message\":\"Log level changed to %s\"}",
            status_get_log_level_name(new_level));
-  connection_queue_output_and_flush(c, (const uint8_t *)response, strlen(response));
+  status_send_api_response(c, STATUS_200, response);
 }
 
 static int status_if_none_match_matches(const char *header)
@@ -23,6 +23,10 @@ typedef enum
 /* Maximum number of workers for per-worker statistics */
 #define STATUS_MAX_WORKERS 32
 
+/* Maximum number of RTSP endpoints with health scores tracked per worker */
+#define STATUS_MAX_RTSP_ENDPOINTS 8
+#define STATUS_RTSP_HOST_LEN 128
+
 /* Maximum number of log entries to keep in circular buffer */
 #define STATUS_MAX_LOG_ENTRIES 100
 #define STATUS_LOG_ENTRY_LEN 1024
@@ -84,6 +88,11 @@ typedef struct
   uint64_t dropped_bytes;            /* Total dropped bytes */
   uint32_t backpressure_events;      /* Times backpressure triggered */
   int slow_active;
+  uint32_t upstream_jitter_us;       /* Upstream RTP interarrival jitter in microseconds */
+  uint32_t upstream_lost;            /* Upstream RTP packets lost (sequence gaps) */
+  uint32_t upstream_expected;        /* Upstream RTP packets expected */
+  int32_t upstream_rtt_ms;           /* RTT from RTCP, -1 if unknown */
+  uint32_t memory_bytes;             /* Per-connection state footprint (excludes queued media) */
 } client_stats_t;
 
 /* Log entry structure for circular buffer */
@@ -94,6 +103,56 @@ typedef struct
   char message[STATUS_LOG_ENTRY_LEN];
 } log_entry_t;
 
+/**
+ * Per-worker RTSP endpoint health (see rtsp_health.c)
+ * Score is 0-100, derived from handshake error rate, stalls and latency
+ */
+typedef struct
+{
+  int active;                      /* 1 if slot is in use */
+  char host[STATUS_RTSP_HOST_LEN]; /* RTSP server host */
+  int port;                        /* RTSP server port */
+  int score;                       /* Health score (100 = best) */
+  uint32_t latency_ms;             /* Smoothed handshake latency (connect -> PLAY response) */
+  uint32_t failure_permille;       /* Smoothed handshake failure rate (0-1000) */
+  uint64_t attempts;               /* Handshakes started */
+  uint64_t failures;               /* Handshakes failed (errors, 5xx, connect failures) */
+  uint64_t stalls;                 /* Handshakes that stalled past the failover threshold */
+  int64_t last_update;             /* Last update (monotonic ms) for LRU replacement */
+} rtsp_endpoint_stats_t;
+
+/**
+ * Event loop phases timed by worker_run_event_loop
+ * WAIT is the time blocked in epoll_wait, BUSY the rest of each iteration
+ * (how long a ready event can wait for the loop). The others are handlers.
+ */
+typedef enum
+{
+  LOOP_PHASE_WAIT = 0,     /* Blocked in epoll_wait */
+  LOOP_PHASE_BUSY,         /* Whole iteration except the wait */
+  LOOP_PHASE_ACCEPT,       /* Accepting clients on the listeners */
+  LOOP_PHASE_CLIENT_READ,  /* Client requests and disconnects */
+  LOOP_PHASE_CLIENT_WRITE, /* Flushing client send queues (EPOLLOUT) */
+  LOOP_PHASE_STREAM,       /* Upstream sockets owned by a stream */
+  LOOP_PHASE_SHARED,       /* Shared multicast groups and warm RTSP sockets */
+  LOOP_PHASE_CONTROL,      /* Status notifications (SSE) and worker handoff */
+  LOOP_PHASE_FETCH,        /* Async HTTP fetches (M3U/EPG reloads) */
+  LOOP_PHASE_TICK,         /* Periodic tick */
+  LOOP_PHASE_COUNT
+} loop_phase_t;
+
+/* Bucket i counts durations below (4 << i) us, the last bucket everything slower */
+#define STATUS_LOOP_HIST_BUCKETS 16
+#define STATUS_LOOP_SITE_LEN 64
+
+typedef struct
+{
+  uint64_t count;    /* Samples recorded */
+  uint64_t total_us; /* Sum of durations */
+  uint64_t max_us;   /* Slowest sample */
+  uint32_t hist[STATUS_LOOP_HIST_BUCKETS];
+} loop_phase_stats_t;
+
 /**
  * Per-worker statistics
  * Each worker writes to its own slot to avoid contention
@@ -114,6 +173,18 @@ typedef struct
   uint64_t enobufs_count;     /* Number of ENOBUFS errors */
   uint64_t batch_sends;       /* Number of batched sends (size threshold) */
 
+  /* HTTP request statistics */
+  uint64_t http_connections;      /* Client connections accepted */
+  uint64_t http_requests;         /* Requests routed (all connections) */
+  uint64_t http_keepalive_reuses; /* Requests served on an already used connection */
+  uint64_t handoff_sent;          /* Connections passed to the worker owning their channel */
+  uint64_t handoff_received;      /* Connections adopted from other workers */
+
+  /* Snapshot cache statistics */
+  uint64_t snapshot_cache_hits;      /* Snapshots answered from a cached JPEG */
+  uint64_t snapshot_cache_misses;    /* Snapshots that captured the channel themselves */
+  uint64_t snapshot_cache_coalesced; /* Snapshots that waited for another client's capture */
+
   /* Buffer pool statistics */
   uint64_t pool_total_buffers; /* Total number of buffers in pool */
   uint64_t pool_free_buffers;  /* Number of free buffers */
@@ -121,6 +192,8 @@ typedef struct
   uint64_t pool_expansions;    /* Number of times pool expanded */
   uint64_t pool_exhaustions;   /* Number of times pool was exhausted */
   uint64_t pool_shrinks;       /* Number of times pool shrank */
+  uint64_t pool_budget_bytes;  /* Memory budget of the pool (buffer-pool-max-size = auto), 0 if fixed */
+  int32_t mem_pressure;        /* Memory PSI some avg10 in 1/100 %, -1 if unavailable */
 
   /* Control/API buffer pool statistics */
   uint64_t control_pool_total_buffers;
@@ -129,6 +202,16 @@ typedef struct
   uint64_t control_pool_expansions;
   uint64_t control_pool_exhaustions;
   uint64_t control_pool_shrinks;
+
+  /* RTSP endpoint health scores */
+  rtsp_endpoint_stats_t rtsp_endpoints[STATUS_MAX_RTSP_ENDPOINTS];
+
+  /* Event loop timing */
+  loop_phase_stats_t loop_phases[LOOP_PHASE_COUNT];
+  uint64_t loop_stalls;                           /* Handlers slower than loop-stall-threshold */
+  uint64_t loop_last_stall_us;                    /* Duration of the most recent stall */
+  int64_t loop_last_stall_time;                   /* Wall clock time of that stall (ms) */
+  char loop_last_stall_site[STATUS_LOOP_SITE_LEN]; /* Handler and call site of that stall */
 } worker_stats_t;
 
 /* Shared memory structure for status information */
@@ -183,6 +266,13 @@ int status_init(void);
  */
 void status_cleanup(void);
 
+/**
+ * Release the client slots and statistics of a worker that exited
+ * Called by the supervisor before the worker is respawned
+ * @param worker Worker index of the dead process
+ */
+void status_worker_reset(int worker);
+
 /**
  * Register a new streaming client connection in shared memory
  * Only called for media streaming clients, not for status/API requests
@@ -229,6 +319,24 @@ void status_update_client_queue(int status_index,
                                 uint32_t backpressure_events,
                                 int slow_active);
 
+/**
+ * Update upstream RTP quality (from RTCP receiver statistics) by status index
+ * @param status_index Client slot index returned by status_register_client()
+ * @param jitter_us Interarrival jitter in microseconds
+ * @param lost Cumulative packets lost
+ * @param expected Cumulative packets expected
+ * @param rtt_ms Round-trip time in milliseconds, -1 if unknown
+ */
+void status_update_client_upstream(int status_index, uint32_t jitter_us, uint32_t lost,
+                                   uint32_t expected, int32_t rtt_ms);
+
+/**
+ * Update per-connection memory footprint by status index
+ * @param status_index Client slot index returned by status_register_client()
+ * @param memory_bytes Bytes held by the connection and its session state
+ */
+void status_update_client_memory(int status_index, uint32_t memory_bytes);
+
 /**
  * Add log entry to circular buffer
  * Called by logger function to store logs for status page
@@ -23,8 +23,149 @@
 #include "service.h"
 #include "snapshot.h"
 #include "status.h"
+#include "timeshift.h"
 #include "worker.h"
 #include "zerocopy.h"
+#include "slab.h"
+#include "mcast_ring.h"
+
+/* Per-type slabs for session state only some streams need */
+static slab_t fcc_slab = SLAB_INITIALIZER("fcc", sizeof(fcc_session_t), 64);
+static slab_t rtsp_slab = SLAB_INITIALIZER("rtsp", sizeof(rtsp_session_t), 8);
+static slab_t snapshot_slab = SLAB_INITIALIZER("snapshot", sizeof(snapshot_context_t), 64);
+
+/*
+ * One receive path per multicast group in each worker, shared by every
+ * stream watching that group. With channel affinity all viewers of a channel
+ * are handed to the same worker; with shared rings one worker ingests the
+ * group and the others read its ring. Either way the host receives each
+ * group once. Group sockets and the ring wakeup fd are not owned by any
+ * connection: the worker passes their events to stream_mcast_handle_event().
+ */
+typedef struct mcast_channel_s
+{
+    int sock;            /* Group socket when this worker ingests, 0 when reading a ring */
+    int ring;            /* Shared ring slot, -1 if not published */
+    int ring_owner;      /* This worker writes the ring */
+    uint64_t ring_pos;   /* Next ring packet to read (ring readers) */
+    uint64_t ring_lost;  /* Packets the ring overwrote before we read them */
+    service_t *service;  /* Own copy: an ingesting channel can outlive its subscribers */
+    int epoll_fd;
+    stream_context_t *subscribers;
+    int subscriber_count;
+    int dispatching;     /* Fan-out in progress, defer release */
+    int orphaned;        /* No local subscribers, kept for other workers */
+    int64_t last_data_time;
+    int64_t last_rejoin_time;
+    struct mcast_channel_s *next;
+} mcast_channel_t;
+
+static mcast_channel_t *mcast_channels = NULL;
+
+/* Streaming (non-snapshot) contexts of this worker, searched for snapshot taps */
+static stream_context_t *live_streams = NULL;
+
+/* Ring silence before a reader checks whether the ingest worker is still alive */
+#define MCAST_RING_TAKEOVER_MS 500
+static int mcast_ring_fd_registered = 0;
+
+static mcast_channel_t *stream_mcast_channel_find(const service_t *service)
+{
+    mcast_channel_t *ch;
+
+    for (ch = mcast_channels; ch; ch = ch->next)
+    {
+        if (service_same_mcast_group(ch->service, service))
+            return ch;
+    }
+    return NULL;
+}
+
+static int stream_mcast_channel_open_socket(mcast_channel_t *ch)
+{
+    int sock = join_mcast_group(ch->service);
+    if (sock <= 0)
+        return -1;
+
+    /* Register socket with epoll immediately after creation */
+    struct epoll_event ev;
+    ev.events = EPOLLIN; /* Level-triggered mode for read events */
+    ev.data.fd = sock;
+    if (epoll_ctl(ch->epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+        logger(LOG_ERROR, "Multicast: Failed to add socket to epoll: %s", strerror(errno));
+        close(sock);
+        exit(RETVAL_SOCK_READ_FAILED);
+    }
+    logger(LOG_DEBUG, "Multicast: Socket registered with epoll");
+
+    ch->sock = sock;
+    ch->last_rejoin_time = get_time_ms();
+    return 0;
+}
+
+static void stream_mcast_channel_close(mcast_channel_t *ch)
+{
+    if (ch->sock > 0)
+    {
+        worker_cleanup_socket_from_epoll(ch->epoll_fd, ch->sock);
+        logger(LOG_DEBUG, "Multicast socket closed");
+    }
+    if (ch->ring >= 0)
+        mcast_ring_detach(ch->ring, ch->ring_owner);
+
+    mcast_channel_t **pp = &mcast_channels;
+    while (*pp && *pp != ch)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = ch->next;
+    service_free(ch->service);
+    free(ch);
+}
+
+/* Close a channel left without local subscribers, unless other workers read its ring */
+static void stream_mcast_channel_release(mcast_channel_t *ch)
+{
+    if (ch->subscribers || ch->dispatching)
+        return;
+    if (ch->ring_owner && mcast_ring_has_readers(ch->ring))
+    {
+        if (!ch->orphaned)
+            logger(LOG_DEBUG, "Multicast: Keeping group socket for other workers' clients");
+        ch->orphaned = 1;
+        return;
+    }
+    stream_mcast_channel_close(ch);
+}
+
+static void stream_mcast_subscribe(mcast_channel_t *ch, stream_context_t *ctx)
+{
+    ctx->mcast_channel = ch;
+    ctx->mcast_prev = NULL;
+    ctx->mcast_next = ch->subscribers;
+    if (ch->subscribers)
+        ch->subscribers->mcast_prev = ctx;
+    ch->subscribers = ctx;
+    ch->subscriber_count++;
+    ch->orphaned = 0;
+}
+
+static void stream_mcast_unsubscribe(stream_context_t *ctx)
+{
+    mcast_channel_t *ch = ctx->mcast_channel;
+
+    if (ctx->mcast_prev)
+        ctx->mcast_prev->mcast_next = ctx->mcast_next;
+    else
+        ch->subscribers = ctx->mcast_next;
+    if (ctx->mcast_next)
+        ctx->mcast_next->mcast_prev = ctx->mcast_prev;
+    ctx->mcast_channel = NULL;
+    ctx->mcast_next = ctx->mcast_prev = NULL;
+    ch->subscriber_count--;
+
+    stream_mcast_channel_release(ch);
+}
 
 /*
  * Wrapper for join_mcast_group that also resets the multicast data timeout timer.
@@ -35,28 +176,495 @@
  */
 int stream_join_mcast_group(stream_context_t *ctx)
 {
-    int sock = join_mcast_group(ctx->service);
-    if (sock > 0)
+    mcast_channel_t *ch = ctx->mcast_channel;
+
+    if (!ch)
+    {
+        ch = stream_mcast_channel_find(ctx->service);
+        if (ch)
+        {
+            logger(LOG_DEBUG, "Multicast: Sharing group with %d other stream(s)", ch->subscriber_count);
+        }
+        else
+        {
+            ch = calloc(1, sizeof(*ch));
+            if (!ch || !(ch->service = service_clone(ctx->service)))
+            {
+                logger(LOG_ERROR, "Multicast: Failed to allocate channel");
+                free(ch);
+                return -1;
+            }
+            ch->epoll_fd = ctx->epoll_fd;
+            ch->ring_owner = 1;
+            ch->ring = mcast_ring_attach(ch->service, &ch->ring_owner);
+
+            if (ch->ring_owner)
+            {
+                if (stream_mcast_channel_open_socket(ch) < 0)
+                {
+                    if (ch->ring >= 0)
+                        mcast_ring_detach(ch->ring, 1);
+                    service_free(ch->service);
+                    free(ch);
+                    return -1;
+                }
+            }
+            else
+            {
+                /* Another worker ingests this group - follow its ring from now on */
+                ch->ring_pos = mcast_ring_head(ch->ring);
+                ch->last_data_time = get_time_ms();
+                (void)mcast_ring_wait(ch->ring, ch->ring_pos);
+                if (!mcast_ring_fd_registered)
+                {
+                    struct epoll_event ev;
+                    ev.events = EPOLLIN;
+                    ev.data.fd = mcast_ring_wakeup_fd();
+                    if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, ev.data.fd, &ev) == 0)
+                        mcast_ring_fd_registered = 1;
+                    else
+                        logger(LOG_ERROR, "Multicast ring: Failed to add wakeup fd to epoll: %s", strerror(errno));
+                }
+                logger(LOG_DEBUG, "Multicast: Reading group from shared ring %d", ch->ring);
+            }
+
+            ch->next = mcast_channels;
+            mcast_channels = ch;
+        }
+        stream_mcast_subscribe(ch, ctx);
+    }
+
+    /* Reset timeout timer when joining multicast group */
+    ctx->last_mcast_data_time = get_time_ms();
+    return 0;
+}
+
+/* Handle one multicast packet according to the stream's FCC state */
+static int stream_handle_mcast_packet(stream_context_t *ctx, buffer_ref_t *buf_ref)
+{
+    switch (ctx->fcc->state)
+    {
+    case FCC_STATE_MCAST_ACTIVE:
+        return fcc_handle_mcast_active(ctx, buf_ref);
+
+    case FCC_STATE_MCAST_REQUESTED:
+        return fcc_handle_mcast_transition(ctx, buf_ref);
+
+    default:
+        /* Shouldn't receive multicast in other states */
+        logger(LOG_DEBUG, "Received multicast data in unexpected state: %d", ctx->fcc->state);
+        return 0;
+    }
+}
+
+/*
+ * Pass a received packet to every subscriber of the channel, consuming recv_buf.
+ * A buffer sits in one send queue at a time and the RTP handlers strip headers
+ * in place, so each subscriber but the last gets its own copy of the packet.
+ * Returns 0 if the channel was released (no subscribers left), 1 otherwise.
+ */
+static int stream_mcast_fanout(mcast_channel_t *ch, buffer_ref_t *recv_buf, int64_t now)
+{
+    size_t len = recv_buf->data_size;
+    stream_context_t *sub = ch->subscribers;
+
+    ch->last_data_time = now;
+    ch->dispatching = 1;
+    while (sub)
+    {
+        stream_context_t *next = sub->mcast_next;
+        buffer_ref_t *pkt = recv_buf;
+
+        if (next)
+        {
+            pkt = buffer_pool_alloc();
+            if (pkt)
+            {
+                memcpy(pkt->data, recv_buf->data, len);
+                pkt->data_size = len;
+            }
+        }
+
+        sub->last_mcast_data_time = now;
+        int res = pkt ? stream_handle_mcast_packet(sub, pkt) : 0;
+        if (pkt && pkt != recv_buf)
+            buffer_ref_put(pkt);
+        if (res < 0)
+            worker_close_and_free_connection(sub->conn);
+        sub = next;
+    }
+    ch->dispatching = 0;
+
+    /* Release our reference to the buffer */
+    buffer_ref_put(recv_buf);
+
+    if (!ch->subscribers)
+    {
+        stream_mcast_channel_release(ch);
+        return 0;
+    }
+    return 1;
+}
+
+static void stream_mcast_touch(mcast_channel_t *ch, int64_t now)
+{
+    for (stream_context_t *sub = ch->subscribers; sub; sub = sub->mcast_next)
+        sub->last_mcast_data_time = now;
+}
+
+static void stream_mcast_socket_event(mcast_channel_t *ch, int64_t now)
+{
+    /* Allocate a fresh buffer from pool for this receive operation */
+    buffer_ref_t *recv_buf = buffer_pool_alloc();
+    if (!recv_buf)
+    {
+        /* Buffer pool exhausted - drop this packet */
+        logger(LOG_DEBUG, "Multicast: Buffer pool exhausted, dropping packet");
+        stream_mcast_touch(ch, now);
+        /* Drain the socket to prevent event loop spinning */
+        uint8_t dummy[BUFFER_POOL_BUFFER_SIZE];
+        ssize_t drained = recv(ch->sock, dummy, sizeof(dummy), 0);
+        if (drained < 0 && errno != EAGAIN)
+        {
+            logger(LOG_DEBUG, "Multicast: Dummy recv failed while dropping packet: %s", strerror(errno));
+        }
+        else if (drained > 0 && ch->ring_owner && ch->ring >= 0)
+        {
+            mcast_ring_write(ch->ring, dummy, (size_t)drained);
+        }
+        return;
+    }
+
+    /* Receive directly into zero-copy buffer (true zero-copy receive) */
+    ssize_t actualr = recv(ch->sock, recv_buf->data, BUFFER_POOL_BUFFER_SIZE, 0);
+    if (actualr < 0)
+    {
+        if (errno != EAGAIN)
+            logger(LOG_DEBUG, "Multicast receive failed: %s", strerror(errno));
+        buffer_ref_put(recv_buf);
+        return;
+    }
+    recv_buf->data_size = (size_t)actualr;
+
+    /* Publish before local handlers rewrite the buffer */
+    if (ch->ring_owner && ch->ring >= 0)
+        mcast_ring_write(ch->ring, recv_buf->data, (size_t)actualr);
+
+    if (!ch->subscribers)
+    {
+        /* Ingesting only for other workers */
+        buffer_ref_put(recv_buf);
+        return;
+    }
+    (void)stream_mcast_fanout(ch, recv_buf, now);
+}
+
+/* Read everything new in a ring; returns 0 if the channel was released */
+static int stream_mcast_ring_drain(mcast_channel_t *ch, int64_t now)
+{
+    uint64_t lost_before = ch->ring_lost;
+
+    for (;;)
+    {
+        if (mcast_ring_head(ch->ring) <= ch->ring_pos)
+        {
+            if (!mcast_ring_wait(ch->ring, ch->ring_pos))
+                break;
+            continue;
+        }
+
+        buffer_ref_t *buf = buffer_pool_alloc();
+        if (!buf)
+        {
+            /* Buffer pool exhausted - skip what is queued in the ring */
+            logger(LOG_DEBUG, "Multicast ring: Buffer pool exhausted, dropping packets");
+            ch->ring_pos = mcast_ring_head(ch->ring);
+            stream_mcast_touch(ch, now);
+            continue;
+        }
+
+        size_t len = 0;
+        if (!mcast_ring_read(ch->ring, &ch->ring_pos, buf->data, &len, &ch->ring_lost))
+        {
+            buffer_ref_put(buf);
+            continue;
+        }
+        buf->data_size = len;
+        if (!stream_mcast_fanout(ch, buf, now))
+            return 0;
+    }
+
+    if (ch->ring_lost != lost_before)
+    {
+        logger(LOG_DEBUG, "Multicast ring: Reader fell behind, %llu packets lost so far",
+               (unsigned long long)ch->ring_lost);
+    }
+    return 1;
+}
+
+int stream_mcast_handle_event(int fd, int64_t now)
+{
+    mcast_channel_t *ch, *next;
+
+    if (mcast_ring_fd_registered && fd == mcast_ring_wakeup_fd())
+    {
+        mcast_ring_ack_wakeup();
+        for (ch = mcast_channels; ch; ch = next)
+        {
+            next = ch->next;
+            if (!ch->ring_owner && ch->ring >= 0)
+                (void)stream_mcast_ring_drain(ch, now);
+        }
+        return 1;
+    }
+
+    for (ch = mcast_channels; ch; ch = ch->next)
+    {
+        if (ch->sock > 0 && ch->sock == fd)
+        {
+            stream_mcast_socket_event(ch, now);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void stream_mcast_tick(int64_t now)
+{
+    mcast_channel_t *ch, *next;
+
+    for (ch = mcast_channels; ch; ch = next)
+    {
+        next = ch->next;
+
+        /* Take over ingest when the worker feeding our ring went away */
+        if (!ch->ring_owner && ch->ring >= 0 && now - ch->last_data_time >= MCAST_RING_TAKEOVER_MS &&
+            mcast_ring_claim(ch->ring))
+        {
+            logger(LOG_INFO, "Multicast ring: Ingest worker gone, receiving group in this worker");
+            ch->ring_owner = 1;
+            if (stream_mcast_channel_open_socket(ch) < 0)
+                logger(LOG_ERROR, "Multicast: Failed to join group after ingest takeover");
+        }
+
+        /* Stop ingesting once neither local clients nor other workers need the group */
+        if (!ch->subscribers)
+        {
+            stream_mcast_channel_release(ch);
+            continue;
+        }
+
+        /* Periodic multicast rejoin (if enabled), once per group socket */
+        if (config.mcast_rejoin_interval > 0 && ch->sock > 0 &&
+            now - ch->last_rejoin_time >= config.mcast_rejoin_interval * 1000)
+        {
+            logger(LOG_DEBUG, "Multicast: Periodic rejoin (interval: %d seconds)", config.mcast_rejoin_interval);
+
+            /* Rejoin multicast group on existing socket (LEAVE + JOIN to send IGMP Report) */
+            if (rejoin_mcast_group(ch->sock, ch->service) == 0)
+            {
+                ch->last_rejoin_time = now;
+            }
+            else
+            {
+                logger(LOG_ERROR, "Multicast: Failed to rejoin group, will retry next interval");
+            }
+        }
+    }
+}
+
+static snapshot_context_t *stream_tap_frame_alloc(void)
+{
+    snapshot_context_t *frame = slab_alloc(&snapshot_slab);
+
+    if (!frame)
+        return NULL;
+    if (snapshot_init(frame) < 0)
+    {
+        slab_free(&snapshot_slab, frame);
+        return NULL;
+    }
+    frame->capture_only = 1;
+    return frame;
+}
+
+static void stream_tap_frame_free(snapshot_context_t *frame)
+{
+    if (!frame)
+        return;
+    snapshot_free(frame);
+    slab_free(&snapshot_slab, frame);
+}
+
+/* Keep the latest IDR frame of a live stream so later snapshots need not wait for one */
+static void stream_tap_keep_start(stream_context_t *ctx)
+{
+    if (ctx->tap_keep)
+        return;
+    ctx->tap_keep = stream_tap_frame_alloc();
+    if (ctx->tap_keep)
+        logger(LOG_DEBUG, "Snapshot: Keeping latest IDR frame of tapped stream");
+}
+
+static void stream_tap_keep_stop(stream_context_t *ctx)
+{
+    stream_tap_frame_free(ctx->tap_keep);
+    stream_tap_frame_free(ctx->tap_latest);
+    ctx->tap_keep = NULL;
+    ctx->tap_latest = NULL;
+}
+
+static void stream_live_register(stream_context_t *ctx)
+{
+    ctx->live_prev = NULL;
+    ctx->live_next = live_streams;
+    if (live_streams)
+        live_streams->live_prev = ctx;
+    live_streams = ctx;
+    ctx->live_registered = 1;
+}
+
+/* Leave the live list; snapshots still tapping the stream reopen their own upstream */
+static void stream_live_unregister(stream_context_t *ctx)
+{
+    if (ctx->live_registered)
+    {
+        if (ctx->live_prev)
+            ctx->live_prev->live_next = ctx->live_next;
+        else
+            live_streams = ctx->live_next;
+        if (ctx->live_next)
+            ctx->live_next->live_prev = ctx->live_prev;
+        ctx->live_next = ctx->live_prev = NULL;
+        ctx->live_registered = 0;
+    }
+
+    while (ctx->taps)
+    {
+        stream_context_t *tap = ctx->taps;
+        ctx->taps = tap->tap_next;
+        tap->tap_next = NULL;
+        tap->tap_source = NULL;
+        tap->tap_lost = 1;
+
+        /* Drop a partial frame, capture starts over on the new upstream */
+        snapshot_restart_capture(tap->snapshot);
+    }
+    stream_tap_keep_stop(ctx);
+}
+
+/* Live streams of the same upstream carry the same packets */
+static int stream_same_upstream(const service_t *a, const service_t *b)
+{
+    char key_a[HTTP_URL_BUFFER_SIZE];
+    char key_b[HTTP_URL_BUFFER_SIZE];
+
+    if (a->service_type != b->service_type)
+        return 0;
+    if (a->service_type == SERVICE_MRTP)
+        return service_same_mcast_group(a, b);
+
+    /* Catch-up streams are at their viewer's position, not at the live edge */
+    if (a->seek_param_value || b->seek_param_value || a->seek_offset_seconds || b->seek_offset_seconds)
+        return 0;
+    if (service_upstream_key(a, key_a, sizeof(key_a)) < 0 || service_upstream_key(b, key_b, sizeof(key_b)) < 0)
+        return 0;
+    return strcmp(key_a, key_b) == 0;
+}
+
+static stream_context_t *stream_find_tap_source(const service_t *service)
+{
+    stream_context_t *src;
+
+    for (src = live_streams; src; src = src->live_next)
     {
-        /* Register socket with epoll immediately after creation */
-        struct epoll_event ev;
-        ev.events = EPOLLIN; /* Level-triggered mode for read events */
-        ev.data.fd = sock;
-        if (epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0)
+        /* Spliced RTSP passthrough never reaches userspace, so taps would see nothing */
+        if (src->rtsp && src->rtsp->passthrough != RTSP_PASSTHROUGH_OFF)
+            continue;
+        if (src->service && src->conn->streaming && stream_same_upstream(src->service, service))
+            return src;
+    }
+    return NULL;
+}
+
+static void stream_tap_detach(stream_context_t *tap)
+{
+    stream_context_t **pp;
+
+    if (!tap->tap_source)
+        return;
+    for (pp = &tap->tap_source->taps; *pp; pp = &(*pp)->tap_next)
+    {
+        if (*pp == tap)
         {
-            logger(LOG_ERROR, "Multicast: Failed to add socket to epoll: %s", strerror(errno));
-            close(sock);
-            exit(RETVAL_SOCK_READ_FAILED);
+            *pp = tap->tap_next;
+            break;
         }
-        fdmap_set(sock, ctx->conn);
-        logger(LOG_DEBUG, "Multicast: Socket registered with epoll");
+    }
+    tap->tap_next = NULL;
+    tap->tap_source = NULL;
+}
+
+/* Capture the stream's next IDR frame; once complete it becomes the latest */
+static void stream_tap_keep_packet(stream_context_t *ctx, buffer_ref_t *buf_ref)
+{
+    snapshot_context_t *keep = ctx->tap_keep;
+
+    if (snapshot_process_packet(keep, buf_ref->data_size,
+                                (uint8_t *)buf_ref->data + buf_ref->data_offset, NULL) < 0)
+    {
+        snapshot_restart_capture(keep); /* Frame too large */
+        return;
+    }
+    if (!keep->idr_frame_complete)
+        return;
 
-        /* Reset timeout and rejoin timers when joining multicast group */
-        int64_t now = get_time_ms();
-        ctx->last_mcast_data_time = now;
-        ctx->last_mcast_rejoin_time = now;
+    /* Recycle the previous frame's buffer for the next capture */
+    ctx->tap_keep = ctx->tap_latest;
+    ctx->tap_latest = keep;
+    ctx->tap_latest_time = get_time_ms();
+    if (ctx->tap_keep)
+        snapshot_restart_capture(ctx->tap_keep);
+    else
+        ctx->tap_keep = stream_tap_frame_alloc();
+}
+
+/*
+ * Offer a packet of a live stream to the snapshots tapping it. The capture
+ * only reads (and copies) the packet, so the buffer is shared as is. A tap
+ * that has not seen an IDR yet takes the stream's latest kept frame.
+ * Taps leave once their frame is captured or the capture failed.
+ */
+static void stream_feed_taps(stream_context_t *ctx, buffer_ref_t *buf_ref)
+{
+    stream_context_t **pp = &ctx->taps;
+
+    if (ctx->tap_keep)
+        stream_tap_keep_packet(ctx, buf_ref);
+
+    while (*pp)
+    {
+        stream_context_t *tap = *pp;
+        int res;
+
+        if (ctx->tap_latest && !tap->snapshot->idr_frame_started &&
+            tap->snapshot->start_time - ctx->tap_latest_time <= SNAPSHOT_TAP_FRAME_AGE_MS)
+            res = snapshot_capture_copy(tap->snapshot, ctx->tap_latest, tap->conn);
+        else
+            res = snapshot_process_packet(tap->snapshot, buf_ref->data_size,
+                                          (uint8_t *)buf_ref->data + buf_ref->data_offset, tap->conn);
+
+        if (res < 0 || !tap->snapshot->enabled || tap->snapshot->idr_frame_complete)
+        {
+            *pp = tap->tap_next;
+            tap->tap_next = NULL;
+            tap->tap_source = NULL;
+            if (res < 0)
+                worker_close_and_free_connection(tap->conn);
+            continue;
+        }
+        pp = &tap->tap_next;
     }
-    return sock;
 }
 
 /*
@@ -66,14 +674,24 @@ int stream_join_mcast_group(stream_context_t *ctx)
 int stream_process_rtp_payload(stream_context_t *ctx, buffer_ref_t *buf_ref, uint16_t *old_seqn, uint16_t *not_first)
 {
     /* In snapshot mode, delegate to snapshot module */
-    if (ctx->snapshot.enabled)
+    if (ctx->snapshot && ctx->snapshot->enabled)
     {
-        return snapshot_process_packet(&ctx->snapshot, buf_ref->data_size, (uint8_t *)buf_ref->data + buf_ref->data_offset, ctx->conn);
+        return snapshot_process_packet(ctx->snapshot, buf_ref->data_size, (uint8_t *)buf_ref->data + buf_ref->data_offset, ctx->conn);
     }
     else
     {
         /* Normal streaming mode - forward to client */
-        return rtp_queue_buf(ctx->conn, buf_ref, old_seqn, not_first);
+        if (ctx->taps || ctx->tap_keep)
+            stream_feed_taps(ctx, buf_ref);
+        rtcp_stats_on_rtp(&ctx->rtcp, (uint8_t *)buf_ref->data + buf_ref->data_offset, buf_ref->data_size);
+        int result = rtp_queue_buf(ctx->conn, buf_ref, old_seqn, not_first);
+
+        /* Record accepted payload (even if the client is backlogged) */
+        if (ctx->timeshift && result != 0)
+        {
+            timeshift_write(ctx->timeshift, ctx, (uint8_t *)buf_ref->data + buf_ref->data_offset, buf_ref->data_size);
+        }
+        return result;
     }
 }
 
@@ -88,8 +706,12 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
     struct sockaddr_in peer_addr;
     socklen_t slen = sizeof(peer_addr);
 
+    /* Snapshot conversion: ffmpeg output pipe or exit notification */
+    if (ctx->snapshot && snapshot_owns_fd(ctx->snapshot, fd))
+        return snapshot_handle_fd_event(ctx->snapshot, fd);
+
     /* Process FCC socket events */
-    if (ctx->fcc.fcc_sock > 0 && fd == ctx->fcc.fcc_sock)
+    if (ctx->fcc && ctx->fcc->fcc_sock > 0 && fd == ctx->fcc->fcc_sock)
     {
         /* Allocate a fresh buffer from pool for this receive operation */
         buffer_ref_t *recv_buf = buffer_pool_alloc();
@@ -100,7 +722,7 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
             ctx->last_fcc_data_time = now;
             /* Drain the socket to prevent event loop spinning */
             uint8_t dummy[BUFFER_POOL_BUFFER_SIZE];
-            ssize_t drained = recvfrom(ctx->fcc.fcc_sock, dummy, sizeof(dummy), 0, NULL, NULL);
+            ssize_t drained = recvfrom(ctx->fcc->fcc_sock, dummy, sizeof(dummy), 0, NULL, NULL);
             if (drained < 0 && errno != EAGAIN)
             {
                 logger(LOG_DEBUG, "FCC: Dummy recv failed while dropping packet: %s", strerror(errno));
@@ -109,7 +731,7 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
         }
 
         /* Receive directly into zero-copy buffer (true zero-copy receive) */
-        actualr = recvfrom(ctx->fcc.fcc_sock, recv_buf->data, BUFFER_POOL_BUFFER_SIZE,
+        actualr = recvfrom(ctx->fcc->fcc_sock, recv_buf->data, BUFFER_POOL_BUFFER_SIZE,
                            0, (struct sockaddr *)&peer_addr, &slen);
         if (actualr < 0 && errno != EAGAIN)
         {
@@ -119,7 +741,7 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
         }
 
         /* Verify packet comes from expected FCC server */
-        if (peer_addr.sin_addr.s_addr != ctx->fcc.fcc_server->sin_addr.s_addr)
+        if (peer_addr.sin_addr.s_addr != ctx->fcc->fcc_server->sin_addr.s_addr)
         {
             buffer_ref_put(recv_buf);
             return 0;
@@ -131,10 +753,15 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
         /* Handle different types of FCC packets */
         uint8_t *recv_data = (uint8_t *)recv_buf->data;
         int result = 0;
-        if (peer_addr.sin_port == ctx->fcc.fcc_server->sin_port)
+        if (peer_addr.sin_port == ctx->fcc->fcc_server->sin_port)
         {
             /* RTCP control message */
-            if (recv_data[0] == 0x83)
+            if (actualr >= 2 && recv_data[1] == RTCP_PT_SR)
+            {
+                /* Sender report for the unicast burst */
+                rtcp_stats_on_rtcp(&ctx->rtcp, recv_data, (size_t)actualr);
+            }
+            else if (recv_data[0] == 0x83)
             {
                 int res = fcc_handle_server_response(ctx, recv_data, actualr, &peer_addr);
                 if (res == 1)
@@ -156,8 +783,9 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
                 /* Sync notification (FMT 4) */
                 result = fcc_handle_sync_notification(ctx, 0);
             }
+
         }
-        else if (peer_addr.sin_port == ctx->fcc.media_port)
+        else if (peer_addr.sin_port == ctx->fcc->media_port)
         {
             /* RTP media packet from FCC unicast stream */
             result = fcc_handle_unicast_media(ctx, recv_buf);
@@ -168,68 +796,11 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
         return result;
     }
 
-    /* Process multicast socket events */
-    if (ctx->mcast_sock > 0 && fd == ctx->mcast_sock)
-    {
-        /* Allocate a fresh buffer from pool for this receive operation */
-        buffer_ref_t *recv_buf = buffer_pool_alloc();
-        if (!recv_buf)
-        {
-            /* Buffer pool exhausted - drop this packet */
-            logger(LOG_DEBUG, "Multicast: Buffer pool exhausted, dropping packet");
-            ctx->last_mcast_data_time = now;
-            /* Drain the socket to prevent event loop spinning */
-            uint8_t dummy[BUFFER_POOL_BUFFER_SIZE];
-            ssize_t drained = recv(ctx->mcast_sock, dummy, sizeof(dummy), 0);
-            if (drained < 0 && errno != EAGAIN)
-            {
-                logger(LOG_DEBUG, "Multicast: Dummy recv failed while dropping packet: %s", strerror(errno));
-            }
-            return 0;
-        }
-
-        /* Receive directly into zero-copy buffer (true zero-copy receive) */
-        actualr = recv(ctx->mcast_sock, recv_buf->data, BUFFER_POOL_BUFFER_SIZE, 0);
-        if (actualr < 0 && errno != EAGAIN)
-        {
-            logger(LOG_DEBUG, "Multicast receive failed: %s", strerror(errno));
-            buffer_ref_put(recv_buf);
-            return 0;
-        }
-
-        /* Update last data receive timestamp for timeout detection */
-        ctx->last_mcast_data_time = now;
-        recv_buf->data_size = (size_t)actualr;
-
-        int result = 0;
-
-        /* Handle multicast data based on FCC state */
-        switch (ctx->fcc.state)
-        {
-        case FCC_STATE_MCAST_ACTIVE:
-            result = fcc_handle_mcast_active(ctx, recv_buf);
-            break;
-
-        case FCC_STATE_MCAST_REQUESTED:
-            result = fcc_handle_mcast_transition(ctx, recv_buf);
-            break;
-
-        default:
-            /* Shouldn't receive multicast in other states */
-            logger(LOG_DEBUG, "Received multicast data in unexpected state: %d", ctx->fcc.state);
-            break;
-        }
-
-        /* Release our reference to the buffer */
-        buffer_ref_put(recv_buf);
-        return result;
-    }
-
     /* Process RTSP socket events */
-    if (ctx->rtsp.socket > 0 && fd == ctx->rtsp.socket)
+    if (ctx->rtsp && ctx->rtsp->socket > 0 && fd == ctx->rtsp->socket)
     {
         /* Handle RTSP socket events (handshake and RTP data in PLAYING state) */
-        int result = rtsp_handle_socket_event(&ctx->rtsp, events);
+        int result = rtsp_handle_socket_event(ctx->rtsp, events);
         if (result < 0)
         {
             /* -2 indicates graceful TEARDOWN completion, not an error */
@@ -250,9 +821,9 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
     }
 
     /* Process RTSP RTP socket events (UDP mode) */
-    if (ctx->rtsp.rtp_socket > 0 && fd == ctx->rtsp.rtp_socket)
+    if (ctx->rtsp && ctx->rtsp->rtp_socket > 0 && fd == ctx->rtsp->rtp_socket)
     {
-        int result = rtsp_handle_udp_rtp_data(&ctx->rtsp, ctx->conn);
+        int result = rtsp_handle_udp_rtp_data(ctx->rtsp, ctx->conn);
         if (result < 0)
         {
             return -1; /* Error */
@@ -264,14 +835,82 @@ int stream_handle_fd_event(stream_context_t *ctx, int fd, uint32_t events, int64
         return 0; /* Success - processed data, continue with other events */
     }
 
-    /* Handle UDP RTCP socket (for future RTCP processing) */
-    if (ctx->rtsp.rtcp_socket > 0 && fd == ctx->rtsp.rtcp_socket)
+    /* Process RTSP RTCP socket events (UDP mode) - sender reports */
+    if (ctx->rtsp && ctx->rtsp->rtcp_socket > 0 && fd == ctx->rtsp->rtcp_socket)
     {
-        /* RTCP data processing could be added here in the future */
-        /* For now, just consume the data to prevent buffer overflow */
-        uint8_t rtcp_buffer[RTCP_BUFFER_SIZE];
-        recv(ctx->rtsp.rtcp_socket, rtcp_buffer, sizeof(rtcp_buffer), 0);
-        return 0;
+        return rtsp_handle_udp_rtcp_data(ctx->rtsp, ctx->conn);
+    }
+
+    return 0;
+}
+
+/* Initialize the media path depending on service type */
+static int stream_open_upstream(stream_context_t *ctx)
+{
+    service_t *service = ctx->service;
+
+    if (service->service_type == SERVICE_RTSP)
+    {
+        ctx->rtsp = slab_alloc(&rtsp_slab);
+        if (!ctx->rtsp)
+            return -1;
+        rtsp_session_init(ctx->rtsp);
+        ctx->rtsp->status_index = ctx->status_index;
+        ctx->rtsp->epoll_fd = ctx->epoll_fd;
+        ctx->rtsp->conn = ctx->conn;
+        if (!service->rtsp_url)
+        {
+            logger(LOG_ERROR, "RTSP URL not found in service configuration");
+            return -1;
+        }
+
+        /* Parse URL and initiate connection */
+        if (rtsp_parse_server_url(ctx->rtsp, service->rtsp_url,
+                                  service->seek_param_name, service->seek_param_value,
+                                  service->seek_offset_seconds,
+                                  service->user_agent,
+                                  NULL, NULL) < 0)
+        {
+            logger(LOG_ERROR, "RTSP: Failed to parse URL");
+            return -1;
+        }
+
+        if (rtsp_connect(ctx->rtsp) < 0)
+        {
+            logger(LOG_ERROR, "RTSP: Failed to initiate connection");
+            return -1;
+        }
+
+        /* Connection initiated - handshake will proceed asynchronously via event loop */
+        logger(LOG_DEBUG, "RTSP: Async connection initiated, state=%d", ctx->rtsp->state);
+    }
+    else
+    {
+        /* Multicast, optionally started with Fast Channel Change */
+        ctx->fcc = slab_alloc(&fcc_slab);
+        if (!ctx->fcc)
+            return -1;
+        fcc_session_init(ctx->fcc);
+        ctx->fcc->status_index = ctx->status_index;
+
+        if (service->fcc_addr)
+        {
+            /* use Fast Channel Change for quick stream startup */
+            if (fcc_initialize_and_request(ctx) < 0)
+            {
+                logger(LOG_ERROR, "FCC initialization failed");
+                return -1;
+            }
+        }
+        else
+        {
+            /* Direct multicast join */
+            /* Note: Both /rtp/ and /udp/ endpoints now use unified packet detection */
+            /* Packets are automatically detected as RTP or raw UDP at receive time */
+            if (stream_join_mcast_group(ctx) < 0)
+                return -1;
+            fcc_session_set_state(ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Direct multicast");
+        }
     }
 
     return 0;
@@ -288,80 +927,56 @@ int stream_context_init_for_worker(stream_context_t *ctx, connection_t *conn, se
     ctx->service = service;
     ctx->epoll_fd = epoll_fd;
     ctx->status_index = status_index;
-    fcc_session_init(&ctx->fcc);
-    ctx->fcc.status_index = status_index;
-    rtsp_session_init(&ctx->rtsp);
-    ctx->rtsp.status_index = status_index;
+    rtcp_stats_init(&ctx->rtcp);
     ctx->total_bytes_sent = 0;
     ctx->last_bytes_sent = 0;
     ctx->last_status_update = get_time_ms();
     ctx->last_mcast_data_time = get_time_ms();
     ctx->last_fcc_data_time = get_time_ms();
-    ctx->last_mcast_rejoin_time = get_time_ms();
 
     /* Initialize snapshot context if this is a snapshot request */
     if (is_snapshot)
     {
-        if (snapshot_init(&ctx->snapshot) < 0)
+        ctx->snapshot = slab_alloc(&snapshot_slab);
+        if (!ctx->snapshot || snapshot_init(ctx->snapshot) < 0)
         {
             logger(LOG_ERROR, "Snapshot: Failed to initialize snapshot context");
             return -1;
         }
         if (is_snapshot == 2) /* X-Request-Snapshot or Accept: image/jpeg */
         {
-            ctx->snapshot.fallback_to_streaming = 1;
+            ctx->snapshot->fallback_to_streaming = 1;
         }
     }
 
-    /* Initialize media path depending on service type */
-    if (service->service_type == SERVICE_RTSP)
+    /* Capture from a live stream of the same channel if there is one */
+    if (is_snapshot == 1)
     {
-        ctx->rtsp.epoll_fd = ctx->epoll_fd;
-        ctx->rtsp.conn = conn;
-        if (!service->rtsp_url)
+        stream_context_t *src = stream_find_tap_source(service);
+        if (src)
         {
-            logger(LOG_ERROR, "RTSP URL not found in service configuration");
-            return -1;
-        }
-
-        /* Parse URL and initiate connection */
-        if (rtsp_parse_server_url(&ctx->rtsp, service->rtsp_url,
-                                  service->seek_param_name, service->seek_param_value,
-                                  service->seek_offset_seconds,
-                                  service->user_agent,
-                                  NULL, NULL) < 0)
-        {
-            logger(LOG_ERROR, "RTSP: Failed to parse URL");
-            return -1;
+            ctx->tap_source = src;
+            ctx->tap_next = src->taps;
+            src->taps = ctx;
+            src->tap_used_time = ctx->snapshot->start_time;
+            stream_tap_keep_start(src);
+            logger(LOG_DEBUG, "Snapshot: Tapping live stream of the same channel");
+            return 0;
         }
+    }
 
-        if (rtsp_connect(&ctx->rtsp) < 0)
-        {
-            logger(LOG_ERROR, "RTSP: Failed to initiate connection");
-            return -1;
-        }
+    if (stream_open_upstream(ctx) < 0)
+        return -1;
 
-        /* Connection initiated - handshake will proceed asynchronously via event loop */
-        logger(LOG_DEBUG, "RTSP: Async connection initiated, state=%d", ctx->rtsp.state);
-    }
-    else if (service->fcc_addr)
+    /* Record live multicast into the local time-shift ring */
+    if (service->service_type == SERVICE_MRTP && !is_snapshot)
     {
-        /* use Fast Channel Change for quick stream startup */
-        if (fcc_initialize_and_request(ctx) < 0)
-        {
-            logger(LOG_ERROR, "FCC initialization failed");
-            return -1;
-        }
-    }
-    else
-    {
-        /* Direct multicast join */
-        /* Note: Both /rtp/ and /udp/ endpoints now use unified packet detection */
-        /* Packets are automatically detected as RTP or raw UDP at receive time */
-        ctx->mcast_sock = stream_join_mcast_group(ctx);
-        fcc_session_set_state(&ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Direct multicast");
+        ctx->timeshift = timeshift_attach(service);
     }
 
+    if (!is_snapshot)
+        stream_live_register(ctx);
+
     return 0;
 }
 
@@ -370,28 +985,24 @@ int stream_tick(stream_context_t *ctx, int64_t now)
     if (!ctx)
         return 0;
 
-    /* Periodic multicast rejoin (if enabled) */
-    if (config.mcast_rejoin_interval > 0 && ctx->mcast_sock > 0)
+    /* Tapped stream ended before the snapshot got its frame */
+    if (ctx->tap_lost)
     {
-        int64_t elapsed_ms = now - ctx->last_mcast_rejoin_time;
-        if (elapsed_ms >= config.mcast_rejoin_interval * 1000)
-        {
-            logger(LOG_DEBUG, "Multicast: Periodic rejoin (interval: %d seconds)", config.mcast_rejoin_interval);
+        ctx->tap_lost = 0;
+        logger(LOG_DEBUG, "Snapshot: Tapped stream ended, opening own upstream");
+        if (stream_open_upstream(ctx) < 0)
+            return -1;
+    }
 
-            /* Rejoin multicast group on existing socket (LEAVE + JOIN to send IGMP Report) */
-            if (rejoin_mcast_group(ctx->mcast_sock, ctx->service) == 0)
-            {
-                ctx->last_mcast_rejoin_time = now;
-            }
-            else
-            {
-                logger(LOG_ERROR, "Multicast: Failed to rejoin group, will retry next interval");
-            }
-        }
+    /* Nobody took snapshots of this stream for a while */
+    if (ctx->tap_keep && now - ctx->tap_used_time >= SNAPSHOT_TAP_KEEP_MS)
+    {
+        logger(LOG_DEBUG, "Snapshot: Releasing kept IDR frames of stream");
+        stream_tap_keep_stop(ctx);
     }
 
     /* Check for multicast stream timeout */
-    if (ctx->mcast_sock > 0)
+    if (ctx->mcast_channel)
     {
         int64_t elapsed_ms = now - ctx->last_mcast_data_time;
         if (elapsed_ms >= MCAST_TIMEOUT_SEC * 1000)
@@ -403,13 +1014,13 @@ int stream_tick(stream_context_t *ctx, int64_t now)
     }
 
     /* Check for FCC timeouts */
-    if (ctx->fcc.fcc_sock > 0)
+    if (ctx->fcc && ctx->fcc->fcc_sock > 0)
     {
         int64_t elapsed_ms = now - ctx->last_fcc_data_time;
         int timeout_ms = 0;
 
         /* Different timeouts for different FCC states */
-        if (ctx->fcc.state == FCC_STATE_REQUESTED || ctx->fcc.state == FCC_STATE_UNICAST_PENDING)
+        if (ctx->fcc->state == FCC_STATE_REQUESTED || ctx->fcc->state == FCC_STATE_UNICAST_PENDING)
         {
             /* Signaling phase - waiting for server response */
             timeout_ms = FCC_TIMEOUT_SIGNALING_MS;
@@ -418,18 +1029,18 @@ int stream_tick(stream_context_t *ctx, int64_t now)
             {
                 logger(LOG_WARN, "FCC: Server response timeout (%d ms), falling back to multicast",
                        FCC_TIMEOUT_SIGNALING_MS);
-                if (ctx->fcc.state == FCC_STATE_REQUESTED)
+                if (ctx->fcc->state == FCC_STATE_REQUESTED)
                 {
-                    fcc_session_set_state(&ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Signaling timeout");
+                    fcc_session_set_state(ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Signaling timeout");
                 }
                 else
                 {
-                    fcc_session_set_state(&ctx->fcc, FCC_STATE_MCAST_ACTIVE, "First unicast packet timeout");
+                    fcc_session_set_state(ctx->fcc, FCC_STATE_MCAST_ACTIVE, "First unicast packet timeout");
                 }
-                ctx->mcast_sock = stream_join_mcast_group(ctx);
+                stream_join_mcast_group(ctx);
             }
         }
-        else if (ctx->fcc.state == FCC_STATE_UNICAST_ACTIVE || ctx->fcc.state == FCC_STATE_MCAST_REQUESTED)
+        else if (ctx->fcc->state == FCC_STATE_UNICAST_ACTIVE || ctx->fcc->state == FCC_STATE_MCAST_REQUESTED)
         {
             /* Already receiving unicast, check for stream interruption */
             timeout_ms = (int)(FCC_TIMEOUT_UNICAST_SEC * 1000);
@@ -438,17 +1049,17 @@ int stream_tick(stream_context_t *ctx, int64_t now)
             {
                 logger(LOG_WARN, "FCC: Unicast stream interrupted (%.1f seconds), falling back to multicast",
                        FCC_TIMEOUT_UNICAST_SEC);
-                fcc_session_set_state(&ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Unicast interrupted");
-                if (!ctx->mcast_sock)
+                fcc_session_set_state(ctx->fcc, FCC_STATE_MCAST_ACTIVE, "Unicast interrupted");
+                if (!ctx->mcast_channel)
                 {
-                    ctx->mcast_sock = stream_join_mcast_group(ctx);
+                    stream_join_mcast_group(ctx);
                 }
             }
 
             /* Check if we've been waiting too long for sync notification */
-            if (ctx->fcc.state == FCC_STATE_UNICAST_ACTIVE && ctx->fcc.unicast_start_time > 0)
+            if (ctx->fcc->state == FCC_STATE_UNICAST_ACTIVE && ctx->fcc->unicast_start_time > 0)
             {
-                int64_t unicast_duration_ms = now - ctx->fcc.unicast_start_time;
+                int64_t unicast_duration_ms = now - ctx->fcc->unicast_start_time;
                 int64_t sync_wait_timeout_ms = (int64_t)(FCC_TIMEOUT_SYNC_WAIT_SEC * 1000);
 
                 if (unicast_duration_ms >= sync_wait_timeout_ms)
@@ -459,46 +1070,69 @@ int stream_tick(stream_context_t *ctx, int64_t now)
         }
     }
 
-    /* Send periodic RTSP OPTIONS keepalive when using UDP transport */
-    if (ctx->rtsp.state == RTSP_STATE_PLAYING &&
-        ctx->rtsp.transport_mode == RTSP_TRANSPORT_UDP &&
-        ctx->rtsp.keepalive_interval_ms > 0 &&
-        ctx->rtsp.session_id[0] != '\0')
+    if (ctx->rtsp)
     {
-        if (ctx->rtsp.last_keepalive_ms == 0)
+        /* Fail over stalled RTSP handshakes to the next endpoint */
+        if (rtsp_session_tick(ctx->rtsp, now) < 0)
         {
-            ctx->rtsp.last_keepalive_ms = now;
+            return -1; /* Signal connection should be closed */
         }
 
-        int64_t keepalive_elapsed = now - ctx->rtsp.last_keepalive_ms;
-        if (keepalive_elapsed >= ctx->rtsp.keepalive_interval_ms)
+        /* Send periodic RTSP OPTIONS keepalive when using UDP transport */
+        if (ctx->rtsp->state == RTSP_STATE_PLAYING &&
+            ctx->rtsp->transport_mode == RTSP_TRANSPORT_UDP &&
+            ctx->rtsp->keepalive_interval_ms > 0 &&
+            ctx->rtsp->session_id[0] != '\0')
         {
-            int ka_status = rtsp_send_keepalive(&ctx->rtsp);
-            if (ka_status == 0)
+            if (ctx->rtsp->last_keepalive_ms == 0)
+            {
+                ctx->rtsp->last_keepalive_ms = now;
+            }
+
+            int64_t keepalive_elapsed = now - ctx->rtsp->last_keepalive_ms;
+            if (keepalive_elapsed >= ctx->rtsp->keepalive_interval_ms)
             {
-                ctx->rtsp.last_keepalive_ms = now;
+                int ka_status = rtsp_send_keepalive(ctx->rtsp);
+                if (ka_status == 0)
+                {
+                    ctx->rtsp->last_keepalive_ms = now;
+                }
+                else if (ka_status < 0)
+                {
+                    logger(LOG_WARN, "RTSP: Failed to queue OPTIONS keepalive");
+                }
             }
-            else if (ka_status < 0)
+        }
+
+        /* Periodic RTCP receiver reports to the RTSP server */
+        if (ctx->rtsp->state == RTSP_STATE_PLAYING && now - ctx->last_rtcp_rr_time >= RTCP_RR_INTERVAL_MS)
+        {
+            if (rtsp_send_receiver_report(ctx->rtsp, ctx->conn) <= 0)
             {
-                logger(LOG_WARN, "RTSP: Failed to queue OPTIONS keepalive");
+                ctx->last_rtcp_rr_time = now;
             }
         }
     }
 
-    /* Check snapshot timeout (5 seconds) */
-    if (ctx->snapshot.enabled)
+    /* Check snapshot timeouts: I-frame capture, then JPEG conversion */
+    if (ctx->snapshot && ctx->snapshot->enabled)
     {
-        int64_t snapshot_elapsed = now - ctx->snapshot.start_time;
-        if (snapshot_elapsed > SNAPSHOT_TIMEOUT_SEC * 1000) /* 5 seconds */
+        int64_t snapshot_elapsed = now - ctx->snapshot->start_time;
+        if (ctx->snapshot->idr_frame_complete)
+        {
+            if (snapshot_tick(ctx->snapshot, now) < 0)
+                return -1;
+        }
+        else if (snapshot_elapsed > SNAPSHOT_TIMEOUT_SEC * 1000)
         {
             logger(LOG_WARN, "Snapshot: Timeout waiting for I-frame (%lld ms)",
                    (long long)snapshot_elapsed);
-            snapshot_fallback_to_streaming(&ctx->snapshot, ctx->conn);
+            snapshot_fallback_to_streaming(ctx->snapshot, ctx->conn);
         }
     }
 
     /* Update bandwidth calculation every second (skip for snapshot mode) */
-    if (!ctx->snapshot.enabled && now - ctx->last_status_update >= 1000)
+    if (!(ctx->snapshot && ctx->snapshot->enabled) && now - ctx->last_status_update >= 1000)
     {
         /* Calculate bandwidth based on bytes sent since last update */
         uint64_t bytes_diff = ctx->total_bytes_sent - ctx->last_bytes_sent;
@@ -514,6 +1148,12 @@ int stream_tick(stream_context_t *ctx, int64_t now)
         /* Update bytes and bandwidth in status */
         status_update_client_bytes(ctx->status_index, ctx->total_bytes_sent, current_bandwidth);
 
+        /* Upstream quality, to tell upstream loss apart from our own drops */
+        uint32_t jitter_us, lost, expected;
+        rtcp_stats_summary(&ctx->rtcp, &jitter_us, &lost, &expected);
+        status_update_client_upstream(ctx->status_index, jitter_us, lost, expected, ctx->rtcp.rtt_ms);
+        status_update_client_memory(ctx->status_index, (uint32_t)connection_memory_footprint(ctx->conn));
+
         /* Save current bytes for next calculation */
         ctx->last_bytes_sent = ctx->total_bytes_sent;
         ctx->last_status_update = now;
@@ -527,24 +1167,32 @@ int stream_context_cleanup(stream_context_t *ctx)
     if (!ctx)
         return 0;
 
+    stream_tap_detach(ctx);
+    stream_live_unregister(ctx);
+
     /* Clean up snapshot resources if in snapshot mode */
-    if (ctx->snapshot.enabled)
+    if (ctx->snapshot && ctx->snapshot->enabled)
     {
-        snapshot_free(&ctx->snapshot);
+        snapshot_free(ctx->snapshot);
+    }
+
+    if (ctx->timeshift)
+    {
+        timeshift_detach(ctx->timeshift, ctx);
+        ctx->timeshift = NULL;
     }
 
     /* Clean up FCC session (always safe to cleanup immediately) */
-    fcc_session_cleanup(&ctx->fcc, ctx->service, ctx->epoll_fd);
+    if (ctx->fcc)
+        fcc_session_cleanup(ctx->fcc, ctx->service, ctx->epoll_fd);
 
     /* Clean up RTSP session - this may initiate async TEARDOWN */
-    int rtsp_async = rtsp_session_cleanup(&ctx->rtsp);
+    int rtsp_async = ctx->rtsp ? rtsp_session_cleanup(ctx->rtsp) : 0;
 
-    /* Close multicast socket if active (always safe to cleanup immediately) */
-    if (ctx->mcast_sock)
+    /* Leave the multicast channel (always safe to cleanup immediately) */
+    if (ctx->mcast_channel)
     {
-        worker_cleanup_socket_from_epoll(ctx->epoll_fd, ctx->mcast_sock);
-        ctx->mcast_sock = 0;
-        logger(LOG_DEBUG, "Multicast socket closed");
+        stream_mcast_unsubscribe(ctx);
     }
 
     if (rtsp_async)
@@ -565,3 +1213,33 @@ int stream_context_cleanup(stream_context_t *ctx)
 
     return 0; /* Cleanup completed */
 }
+
+void stream_context_release(stream_context_t *ctx)
+{
+    if (!ctx)
+        return;
+
+    slab_free(&fcc_slab, ctx->fcc);
+    ctx->fcc = NULL;
+    slab_free(&rtsp_slab, ctx->rtsp);
+    ctx->rtsp = NULL;
+    slab_free(&snapshot_slab, ctx->snapshot);
+    ctx->snapshot = NULL;
+}
+
+size_t stream_context_memory(const stream_context_t *ctx)
+{
+    size_t bytes = 0;
+
+    if (ctx->fcc)
+        bytes += slab_object_size(&fcc_slab);
+    if (ctx->rtsp)
+        bytes += slab_object_size(&rtsp_slab);
+    if (ctx->snapshot)
+        bytes += slab_object_size(&snapshot_slab);
+    if (ctx->tap_keep)
+        bytes += slab_object_size(&snapshot_slab) + ctx->tap_keep->idr_frame_size;
+    if (ctx->tap_latest)
+        bytes += slab_object_size(&snapshot_slab) + ctx->tap_latest->idr_frame_size;
+    return bytes;
+}
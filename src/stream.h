@@ -6,6 +6,7 @@
 #include "rtsp.h"
 #include "status.h"
 #include "snapshot.h"
+#include "rtcp.h"
 
 /* Multicast stream timeout (seconds) - if no data received for this duration, close connection */
 #define MCAST_TIMEOUT_SEC 1
@@ -13,16 +14,24 @@
 /* Snapshot timeout (seconds) - if no I-frame received for this duration, fallback to streaming */
 #define SNAPSHOT_TIMEOUT_SEC 2
 
+/* A tapped live stream keeps its latest IDR frame until no snapshot tapped it for this long */
+#define SNAPSHOT_TAP_KEEP_MS 60000
+
+/* Oldest kept IDR frame a new snapshot may take instead of waiting for the next one */
+#define SNAPSHOT_TAP_FRAME_AGE_MS 10000
+
 /* Stream processing context */
 typedef struct stream_context_s
 {
   int epoll_fd;
   connection_t *conn; /* Pointer to parent connection for output buffering */
   service_t *service;
-  fcc_session_t fcc;
-  int mcast_sock;
-  rtsp_session_t rtsp; /* RTSP session for SERVICE_RTSP */
-  int status_index;    /* Index in status_shared->clients array for status updates */
+  fcc_session_t *fcc; /* Multicast/FCC session (SERVICE_MRTP only) */
+  struct mcast_channel_s *mcast_channel; /* Multicast group shared with other streams in this worker */
+  struct stream_context_s *mcast_next;   /* Other subscribers of the same channel */
+  struct stream_context_s *mcast_prev;
+  rtsp_session_t *rtsp; /* RTSP session (SERVICE_RTSP only) */
+  int status_index;     /* Index in status_shared->clients array for status updates */
 
   /* Statistics tracking */
   uint64_t total_bytes_sent;
@@ -32,10 +41,30 @@ typedef struct stream_context_s
   /* Stream health monitoring */
   int64_t last_mcast_data_time;   /* Timestamp of last received multicast data in milliseconds */
   int64_t last_fcc_data_time;     /* Timestamp of last received FCC data for timeout detection */
-  int64_t last_mcast_rejoin_time; /* Timestamp of last multicast rejoin for periodic refresh */
 
-  /* Snapshot context */
-  snapshot_context_t snapshot;
+  /* Upstream RTP/RTCP receiver statistics */
+  rtcp_stats_t rtcp;
+  int64_t last_rtcp_rr_time; /* Last RTCP receiver report sent (RTSP only) */
+
+  /* Local time-shift ring this stream records into (multicast only) */
+  struct timeshift_ring_s *timeshift;
+
+  /* Snapshot context (snapshot requests only) */
+  snapshot_context_t *snapshot;
+
+  /* Snapshots of a channel that is already streaming in this worker read
+   * that stream's packets (a tap) instead of opening their own upstream */
+  struct stream_context_s *live_next;  /* Worker's streaming contexts, for tap lookup */
+  struct stream_context_s *live_prev;
+  int live_registered;
+  struct stream_context_s *taps;       /* Snapshots capturing from this stream */
+  struct stream_context_s *tap_source; /* Stream this snapshot captures from, NULL if none */
+  struct stream_context_s *tap_next;
+  int tap_lost;                        /* Source ended mid-capture, open own upstream on next tick */
+  snapshot_context_t *tap_keep;        /* Capturing the next IDR frame for taps (capture only) */
+  snapshot_context_t *tap_latest;      /* Latest complete IDR frame, NULL if none yet */
+  int64_t tap_latest_time;             /* When tap_latest was captured */
+  int64_t tap_used_time;               /* Last snapshot tap, for releasing the kept frames */
 } stream_context_t;
 
 /**
@@ -43,11 +72,30 @@ typedef struct stream_context_s
  * This is a wrapper around join_mcast_group() that also resets last_mcast_data_time
  * to prevent false timeout triggers. Should be used instead of join_mcast_group()
  * directly in all stream-related code.
+ * Streams of the same group within a worker share one socket (or one shared
+ * ring reader); the group is left when its last subscriber is cleaned up.
+ * Joining again while subscribed only resets the timer.
  * @param ctx Stream context
- * @return Socket file descriptor on success, exits on failure
+ * @return 0 on success, -1 on error
  */
 int stream_join_mcast_group(stream_context_t *ctx);
 
+/**
+ * Handle an event on a multicast group socket or the shared ring wakeup fd.
+ * These fds are owned by the worker's channels, not by a connection.
+ * @param fd File descriptor that has events
+ * @param now Current timestamp in milliseconds
+ * @return 1 if the fd belonged to a multicast channel, 0 otherwise
+ */
+int stream_mcast_handle_event(int fd, int64_t now);
+
+/**
+ * Periodic multicast channel maintenance: rejoin, ring ingest takeover and
+ * release of channels only kept for other workers. Called from the worker tick.
+ * @param now Current timestamp in milliseconds
+ */
+void stream_mcast_tick(int64_t now);
+
 /**
  * Initialize a stream context for integration into a worker's unified epoll loop.
  * Does not block; registers any required media sockets with the provided epoll fd.
@@ -57,7 +105,10 @@ int stream_join_mcast_group(stream_context_t *ctx);
  * @param service Service configuration
  * @param epoll_fd epoll file descriptor
  * @param status_id Status tracking ID
- * @param is_snapshot 1 if this is a snapshot request, 0 for normal streaming
+ * @param is_snapshot 1 for snapshot=1, 2 for a snapshot that may fall back to
+ *        streaming, 0 for normal streaming
+ * A snapshot=1 request for a channel already streaming in this worker taps
+ * that stream instead of joining or connecting again.
  * @return 0 on success, -1 on error
  */
 int stream_context_init_for_worker(stream_context_t *ctx, connection_t *conn, service_t *service,
@@ -86,6 +137,21 @@ int stream_tick(stream_context_t *ctx, int64_t now);
  */
 int stream_context_cleanup(stream_context_t *ctx);
 
+/**
+ * Return the lazily allocated sessions to their slabs.
+ * Called once the connection is freed (after any async TEARDOWN).
+ * @param ctx Stream context
+ */
+void stream_context_release(stream_context_t *ctx);
+
+/**
+ * Bytes of session state currently allocated for this stream context
+ * (excluding the context itself, which is embedded in connection_t)
+ * @param ctx Stream context
+ * @return Allocated bytes
+ */
+size_t stream_context_memory(const stream_context_t *ctx);
+
 /**
  * Process RTP payload - either forward to client (streaming) or capture I-frame (snapshot)
  * This function should be used instead of rtp_queue_buf() for stream contexts
@@ -0,0 +1,349 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "supervisor.h"
+#include "rtp2httpd.h"
+#include "status.h"
+#include "mcast_ring.h"
+
+/* Environment passed to the upgraded binary: "<old pid>:<fd>,<fd>;<fd>,<fd>..."
+ * with one ';'-separated group of listeners per worker */
+#define SUPERVISOR_ENV_LISTENERS "RTP2HTTPD_LISTEN_FDS"
+
+/* A worker that dies sooner than this is respawned after the same delay */
+#define SUPERVISOR_RESPAWN_DELAY_MS 1000
+
+static pid_t worker_pids[STATUS_MAX_WORKERS];
+static int64_t worker_started[STATUS_MAX_WORKERS];
+static int64_t worker_respawn_at[STATUS_MAX_WORKERS];
+static pid_t supervisor_pid = 0;
+static pid_t previous_instance_pid = 0;
+static pid_t upgrade_pid = 0;
+static sigset_t supervisor_saved_mask;
+
+int supervisor_inherit_listeners(supervisor_listeners_t *listeners, int num_workers)
+{
+  const char *env = getenv(SUPERVISOR_ENV_LISTENERS);
+  const char *p;
+  char *end;
+  int k = 0;
+
+  if (!env)
+    return 0;
+
+  long pid = strtol(env, &end, 10);
+  p = end;
+  if (*p != ':')
+  {
+    logger(LOG_ERROR, "Upgrade: Malformed %s, binding new sockets", SUPERVISOR_ENV_LISTENERS);
+    unsetenv(SUPERVISOR_ENV_LISTENERS);
+    return 0;
+  }
+  p++;
+
+  while (*p)
+  {
+    int count = 0;
+    while (*p && *p != ';')
+    {
+      long fd = strtol(p, &end, 10);
+      if (end == p)
+        break;
+      p = end;
+      if (*p == ',')
+        p++;
+
+      if (k < num_workers && count < SUPERVISOR_MAX_LISTENERS)
+        listeners[k].fds[count++] = (int)fd;
+      else
+        close((int)fd); /* This instance runs fewer workers */
+    }
+    if (k < num_workers)
+      listeners[k].count = count;
+    k++;
+    if (*p == ';')
+      p++;
+    else if (*p)
+      break;
+  }
+
+  unsetenv(SUPERVISOR_ENV_LISTENERS);
+  if (k > num_workers)
+    k = num_workers;
+
+  /* Only trust the pid of the process that actually executed us */
+  if (pid > 1 && (pid_t)pid == getppid())
+    previous_instance_pid = (pid_t)pid;
+
+  logger(LOG_INFO, "Upgrade: Inherited listening sockets of %d workers from pid %ld", k, pid);
+  return k;
+}
+
+/* Fork one worker; returns 0 in the child, 1 in the supervisor, -1 on error */
+static int supervisor_spawn(int k)
+{
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    logger(LOG_ERROR, "Failed to fork worker %d: %s", k, strerror(errno));
+    worker_respawn_at[k] = get_time_ms() + SUPERVISOR_RESPAWN_DELAY_MS;
+    return -1;
+  }
+
+  if (pid == 0)
+  {
+    sigprocmask(SIG_SETMASK, &supervisor_saved_mask, NULL);
+    /* Child becomes a worker: ensure it dies when the supervisor exits */
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != supervisor_pid)
+      _exit(EXIT_FAILURE);
+    worker_id = k;
+    return 0;
+  }
+
+  worker_pids[k] = pid;
+  worker_started[k] = get_time_ms();
+  worker_respawn_at[k] = 0;
+  return 1;
+}
+
+/* Mark everything except stdio and the listeners close-on-exec */
+static void supervisor_prepare_exec_fds(const supervisor_listeners_t *listeners, int num_workers)
+{
+  DIR *dir = opendir("/proc/self/fd");
+  struct dirent *de;
+
+  if (!dir)
+    return;
+
+  while ((de = readdir(dir)) != NULL)
+  {
+    int fd, k, i, keep = 0;
+
+    if (de->d_name[0] < '0' || de->d_name[0] > '9')
+      continue;
+    fd = atoi(de->d_name);
+    if (fd <= 2 || fd == dirfd(dir))
+      continue;
+
+    for (k = 0; k < num_workers && !keep; k++)
+      for (i = 0; i < listeners[k].count; i++)
+        if (listeners[k].fds[i] == fd)
+          keep = 1;
+
+    fcntl(fd, F_SETFD, keep ? 0 : FD_CLOEXEC);
+  }
+  closedir(dir);
+}
+
+static void supervisor_start_upgrade(supervisor_listeners_t *listeners, int num_workers, char **argv)
+{
+  char env[1024];
+  size_t len;
+  int k, i;
+
+  if (upgrade_pid > 0)
+  {
+    logger(LOG_WARN, "Upgrade: Already in progress (pid %d)", (int)upgrade_pid);
+    return;
+  }
+
+  len = (size_t)snprintf(env, sizeof(env), "%d:", (int)getpid());
+  for (k = 0; k < num_workers && len < sizeof(env); k++)
+  {
+    for (i = 0; i < listeners[k].count && len < sizeof(env); i++)
+      len += (size_t)snprintf(env + len, sizeof(env) - len, i ? ",%d" : "%d", listeners[k].fds[i]);
+    if (k + 1 < num_workers && len < sizeof(env))
+      len += (size_t)snprintf(env + len, sizeof(env) - len, ";");
+  }
+  if (len >= sizeof(env))
+  {
+    logger(LOG_ERROR, "Upgrade: Too many listening sockets to pass on");
+    return;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0)
+  {
+    logger(LOG_ERROR, "Upgrade: fork failed: %s", strerror(errno));
+    return;
+  }
+
+  if (pid == 0)
+  {
+    sigprocmask(SIG_SETMASK, &supervisor_saved_mask, NULL);
+    supervisor_prepare_exec_fds(listeners, num_workers);
+    setenv(SUPERVISOR_ENV_LISTENERS, env, 1);
+    execvp(argv[0], argv);
+    fprintf(stderr, "Upgrade: exec %s failed: %s\n", argv[0], strerror(errno));
+    _exit(EXIT_FAILURE);
+  }
+
+  upgrade_pid = pid;
+  logger(LOG_INFO, "Upgrade: Started %s (pid %d)", argv[0], (int)pid);
+}
+
+static void supervisor_signal_workers(int num_workers, int sig)
+{
+  int k;
+
+  for (k = 0; k < num_workers; k++)
+    if (worker_pids[k] > 0)
+      kill(worker_pids[k], sig);
+}
+
+static void supervisor_close_listeners(supervisor_listeners_t *listeners, int num_workers)
+{
+  int k, i;
+
+  for (k = 0; k < num_workers; k++)
+  {
+    for (i = 0; i < listeners[k].count; i++)
+      close(listeners[k].fds[i]);
+    listeners[k].count = 0;
+  }
+}
+
+/* Collect exited children; returns the number of workers still running */
+static int supervisor_reap(int num_workers, int stopping)
+{
+  int status, k, running = 0;
+  pid_t pid;
+
+  while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+  {
+    if (pid == upgrade_pid)
+    {
+      logger(LOG_ERROR, "Upgrade: New instance exited before taking over (status %d), keeping this one",
+             WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status));
+      upgrade_pid = 0;
+      continue;
+    }
+
+    for (k = 0; k < num_workers; k++)
+    {
+      if (worker_pids[k] != pid)
+        continue;
+
+      int64_t now = get_time_ms();
+      worker_pids[k] = 0;
+
+      if (stopping)
+        logger(LOG_DEBUG, "Worker %d (pid %d) exited", k, (int)pid);
+      else if (WIFSIGNALED(status))
+        logger(LOG_ERROR, "Worker %d (pid %d) killed by signal %d, respawning", k, (int)pid, WTERMSIG(status));
+      else
+        logger(LOG_ERROR, "Worker %d (pid %d) exited with status %d, respawning", k, (int)pid, WEXITSTATUS(status));
+
+      /* Its clients are gone; free their status slots and hand its groups to others */
+      status_worker_reset(k);
+      mcast_ring_reset_worker(k);
+
+      worker_respawn_at[k] = now - worker_started[k] < SUPERVISOR_RESPAWN_DELAY_MS
+                                 ? now + SUPERVISOR_RESPAWN_DELAY_MS
+                                 : now;
+      break;
+    }
+  }
+
+  for (k = 0; k < num_workers; k++)
+    if (worker_pids[k] > 0)
+      running++;
+  return running;
+}
+
+int supervisor_run(supervisor_listeners_t *listeners, int num_workers, char **argv)
+{
+  sigset_t mask;
+  int stopping = 0, draining = 0;
+  int k;
+
+  supervisor_pid = getpid();
+  worker_id = -1;
+
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGTERM);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGQUIT);
+  sigaddset(&mask, SIGUSR2);
+  sigprocmask(SIG_BLOCK, &mask, &supervisor_saved_mask);
+
+  logger(LOG_INFO, "Supervisor started: pid=%d, %d worker%s", (int)supervisor_pid,
+         num_workers, num_workers > 1 ? "s" : "");
+  for (k = 0; k < num_workers; k++)
+  {
+    if (supervisor_spawn(k) == 0)
+      return k;
+  }
+
+  /* The instance we replace stops accepting and drains its streams */
+  if (previous_instance_pid > 0)
+  {
+    logger(LOG_INFO, "Upgrade: Asking previous instance (pid %d) to drain", (int)previous_instance_pid);
+    kill(previous_instance_pid, SIGQUIT);
+    previous_instance_pid = 0;
+  }
+
+  for (;;)
+  {
+    struct timespec timeout = {0, 200 * 1000000L};
+    int sig = sigtimedwait(&mask, NULL, &timeout);
+
+    switch (sig)
+    {
+    case SIGTERM:
+    case SIGINT:
+      if (!stopping)
+        logger(LOG_INFO, "Supervisor: Shutting down");
+      stopping = 1;
+      supervisor_signal_workers(num_workers, SIGTERM);
+      break;
+    case SIGQUIT:
+      if (!draining && !stopping)
+      {
+        logger(LOG_INFO, "Supervisor: Draining workers");
+        draining = 1;
+        supervisor_close_listeners(listeners, num_workers);
+        supervisor_signal_workers(num_workers, SIGQUIT);
+      }
+      break;
+    case SIGUSR2:
+      if (!draining && !stopping)
+        supervisor_start_upgrade(listeners, num_workers, argv);
+      break;
+    default:
+      break;
+    }
+
+    if (supervisor_reap(num_workers, stopping || draining) == 0 && (stopping || draining))
+      break;
+    if (stopping || draining)
+      continue;
+
+    int64_t now = get_time_ms();
+    for (k = 0; k < num_workers; k++)
+    {
+      if (worker_pids[k] == 0 && worker_respawn_at[k] <= now && supervisor_spawn(k) == 0)
+        return k;
+    }
+  }
+
+  sigprocmask(SIG_SETMASK, &supervisor_saved_mask, NULL);
+  supervisor_close_listeners(listeners, num_workers);
+  logger(LOG_INFO, "Supervisor: All workers exited");
+  return -1;
+}
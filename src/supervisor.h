@@ -0,0 +1,45 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+/**
+ * Process supervisor.
+ *
+ * The original process only binds the listeners, forks the workers and
+ * watches them. A worker that dies is respawned with the same worker id
+ * after its shared status and ring slots are released.
+ *
+ * Signals handled by the supervisor:
+ *   SIGTERM/SIGINT  stop workers immediately and exit
+ *   SIGQUIT         let workers finish their streams, then exit
+ *   SIGUSR2         re-execute the binary; the new instance inherits the
+ *                   listening sockets and sends SIGQUIT to the old one
+ */
+
+#define SUPERVISOR_MAX_LISTENERS 10
+
+/* Listening sockets of one worker (one per bind address) */
+typedef struct
+{
+  int fds[SUPERVISOR_MAX_LISTENERS];
+  int count;
+} supervisor_listeners_t;
+
+/**
+ * Take over the listening sockets passed by the instance being upgraded
+ * @param listeners Per-worker listener sets, filled in worker order
+ * @param num_workers Number of workers of this instance
+ * @return Number of worker sets inherited (0 if not started by an upgrade)
+ */
+int supervisor_inherit_listeners(supervisor_listeners_t *listeners, int num_workers);
+
+/**
+ * Start the workers and supervise them until shutdown
+ * Returns in every forked worker and once more in the supervisor at exit.
+ * @param listeners Per-worker listener sets (kept open for respawns and upgrades)
+ * @param num_workers Number of workers
+ * @param argv Command line used to re-execute on SIGUSR2
+ * @return Worker id in a worker process, -1 in the supervisor when it should exit
+ */
+int supervisor_run(supervisor_listeners_t *listeners, int num_workers, char **argv);
+
+#endif /* SUPERVISOR_H */
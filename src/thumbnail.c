@@ -0,0 +1,627 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include "thumbnail.h"
+#include "rtp2httpd.h"
+#include "connection.h"
+#include "service.h"
+#include "multicast.h"
+#include "http.h"
+#include "worker.h"
+
+#define THUMBNAIL_BATCH_MAX 1024                  /* Channels per request */
+#define THUMBNAIL_NAME_MAX 512                    /* Longest service name accepted */
+#define THUMBNAIL_IFACE_SLOTS 4                   /* Default, FCC, RTSP and multicast interfaces */
+#define THUMBNAIL_CAPTURE_TIMEOUT_MS 20000        /* Snapshots give up earlier; catches stuck captures */
+#define THUMBNAIL_RESPONSE_MAX (8 * 1024 * 1024)  /* Largest capture response accepted */
+#define THUMBNAIL_BACKLOG_MAX (1024 * 1024)       /* Unsent output before a batch starts more captures */
+
+/* Item states */
+#define THUMBNAIL_ITEM_PENDING 0
+#define THUMBNAIL_ITEM_RUNNING 1
+#define THUMBNAIL_ITEM_DONE 2
+
+typedef struct thumbnail_item_s
+{
+    char *name;                /* Service name */
+    int state;                 /* THUMBNAIL_ITEM_* */
+    int status;                /* HTTP status of the capture once done */
+    int iface;                 /* Interface slot while running */
+    int fd;                    /* Our end of the capture socketpair, -1 if not running */
+    int64_t start_time;
+    char *resp;                /* Capture response read so far */
+    size_t resp_len;
+    size_t resp_cap;
+    size_t jpeg_size;          /* JPEG size once done (json manifest) */
+    thumbnail_batch_t *batch;
+    struct thumbnail_item_s *run_next;
+} thumbnail_item_t;
+
+struct thumbnail_batch_s
+{
+    connection_t *conn;        /* Client receiving the batch */
+    int json;                  /* format=json: manifest at the end instead of multipart */
+    char host[256];            /* Host header passed on to the captures */
+    char token[256 * 3];       /* r2h-token passed on to the captures, URL encoded */
+    thumbnail_item_t *items;
+    int count;
+    int first_pending;         /* Items before this one are running or done */
+    int done;
+    struct thumbnail_batch_s *next;
+};
+
+static thumbnail_batch_t *batches = NULL;
+static thumbnail_item_t *running_items = NULL;
+
+/* Captures running per upstream interface, across all batches of this worker */
+static struct
+{
+    int in_use;
+    char name[IFNAMSIZ];
+    int running;
+} iface_slots[THUMBNAIL_IFACE_SLOTS];
+
+/* Interface the service's capture will use upstream */
+static int thumbnail_iface_slot(const service_t *service)
+{
+    const struct ifreq *ifr;
+    const char *name;
+    int i, spare = -1;
+
+    if (service->service_type == SERVICE_RTSP)
+        ifr = get_upstream_interface_for_rtsp();
+    else if (service->fcc_addr)
+        ifr = get_upstream_interface_for_fcc();
+    else
+        ifr = get_upstream_interface_for_multicast();
+    name = ifr ? ifr->ifr_name : "";
+
+    for (i = 0; i < THUMBNAIL_IFACE_SLOTS; i++)
+    {
+        if (iface_slots[i].in_use && strncmp(iface_slots[i].name, name, IFNAMSIZ) == 0)
+            return i;
+        if (spare < 0 && (!iface_slots[i].in_use || iface_slots[i].running == 0))
+            spare = i;
+    }
+    if (spare < 0)
+        return 0; /* Interfaces changed while captures ran: share a slot */
+
+    iface_slots[spare].in_use = 1;
+    iface_slots[spare].running = 0;
+    snprintf(iface_slots[spare].name, sizeof(iface_slots[spare].name), "%s", name);
+    return spare;
+}
+
+static void thumbnail_flush(connection_t *c)
+{
+    connection_epoll_update_events(c->epfd, c->fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLHUP | EPOLLERR);
+}
+
+/* Queue a JPEG body from a memfd, so large parts do not count against the output buffers */
+static int thumbnail_queue_body(connection_t *c, const char *data, size_t len)
+{
+    int fd = memfd_create("rtp2httpd-thumbnail", MFD_CLOEXEC);
+    size_t off = 0;
+
+    if (fd < 0)
+        return -1;
+    while (off < len)
+    {
+        ssize_t n = write(fd, data + off, len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        off += (size_t)n;
+    }
+    if (connection_queue_file(c, fd, 0, len) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+/* One multipart part per channel; failed captures get an empty part */
+static int thumbnail_send_part(thumbnail_batch_t *b, thumbnail_item_t *item, const char *jpeg)
+{
+    char headers[THUMBNAIL_NAME_MAX * 3 + 256];
+    char *location = http_url_encode(item->name);
+    int len;
+
+    if (!location)
+        return -1;
+    len = snprintf(headers, sizeof(headers),
+                   "--" HTTP_MULTIPART_BOUNDARY "\r\n"
+                   "Content-Type: %s\r\n"
+                   "Content-Length: %zu\r\n"
+                   "Content-Location: /%s\r\n"
+                   "X-Snapshot-Status: %d\r\n"
+                   "\r\n",
+                   jpeg ? "image/jpeg" : "text/plain", jpeg ? item->jpeg_size : 0,
+                   location, item->status);
+    free(location);
+    if (len < 0 || (size_t)len >= sizeof(headers))
+        return -1;
+
+    if (connection_queue_output(b->conn, (const uint8_t *)headers, (size_t)len) < 0)
+        return -1;
+    if (jpeg && thumbnail_queue_body(b->conn, jpeg, item->jpeg_size) < 0)
+        return -1;
+    if (connection_queue_output(b->conn, (const uint8_t *)"\r\n", 2) < 0)
+        return -1;
+    thumbnail_flush(b->conn);
+    return 0;
+}
+
+/* Parse the capture's HTTP response; returns the JPEG or NULL */
+static const char *thumbnail_parse_response(thumbnail_item_t *item)
+{
+    char *end;
+
+    if (item->resp_len < 12 || strncmp(item->resp, "HTTP/1.", 7) != 0)
+    {
+        item->status = 502;
+        return NULL;
+    }
+    item->status = atoi(item->resp + 9);
+
+    end = memmem(item->resp, item->resp_len, "\r\n\r\n", 4);
+    if (!end)
+    {
+        item->status = 502;
+        return NULL;
+    }
+    *end = '\0'; /* Headers become a string, the body follows the blank line */
+
+    if (item->status != 200)
+        return NULL;
+
+    const char *length = strcasestr(item->resp, "\r\nContent-Length:");
+    size_t body_len = item->resp_len - (size_t)(end + 4 - item->resp);
+    if (!strcasestr(item->resp, "\r\nContent-Type: image/jpeg") || !length ||
+        strtoul(length + 17, NULL, 10) != body_len || body_len == 0)
+    {
+        /* Streaming fallback or a truncated JPEG */
+        item->status = 502;
+        return NULL;
+    }
+
+    item->jpeg_size = body_len;
+    return end + 4;
+}
+
+/* Capture ended (response complete, failed or timed out): report it to the client */
+static void thumbnail_item_finish(thumbnail_item_t *item, int status)
+{
+    thumbnail_batch_t *b = item->batch;
+    const char *jpeg = NULL;
+
+    if (item->state == THUMBNAIL_ITEM_RUNNING)
+    {
+        thumbnail_item_t **pp = &running_items;
+        while (*pp && *pp != item)
+            pp = &(*pp)->run_next;
+        if (*pp)
+            *pp = item->run_next;
+        item->run_next = NULL;
+
+        worker_cleanup_socket_from_epoll(b->conn->epfd, item->fd);
+        item->fd = -1;
+        iface_slots[item->iface].running--;
+    }
+
+    if (status)
+        item->status = status;
+    else
+        jpeg = thumbnail_parse_response(item);
+
+    item->state = THUMBNAIL_ITEM_DONE;
+    b->done++;
+
+    logger(LOG_DEBUG, "Thumbnail: %s finished (status %d, %zu bytes, %d/%d)",
+           item->name, item->status, item->jpeg_size, b->done, b->count);
+
+    if (!b->json && thumbnail_send_part(b, item, jpeg) < 0)
+    {
+        logger(LOG_WARN, "Thumbnail: Failed to queue part for %s, closing batch", item->name);
+        b->conn->state = CONN_CLOSING;
+        thumbnail_flush(b->conn);
+    }
+
+    free(item->resp);
+    item->resp = NULL;
+    item->resp_len = item->resp_cap = 0;
+}
+
+/* Run the item as a snapshot=1 request on an internal connection */
+static int thumbnail_start_capture(thumbnail_batch_t *b, thumbnail_item_t *item, int slot)
+{
+    char request[THUMBNAIL_NAME_MAX * 3 + sizeof(b->token) + 768];
+    char *path = http_url_encode(item->name);
+    int sv[2];
+    int len;
+
+    if (!path)
+        return -1;
+    len = snprintf(request, sizeof(request),
+                   "GET /%s?snapshot=1%s%s HTTP/1.1\r\n"
+                   "%s%s%s"
+                   "Connection: close\r\n"
+                   "\r\n",
+                   path, b->token[0] ? "&r2h-token=" : "", b->token,
+                   b->host[0] ? "Host: " : "", b->host, b->host[0] ? "\r\n" : "");
+    free(path);
+    if (len < 0 || (size_t)len >= sizeof(request))
+        return -1;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) < 0)
+    {
+        logger(LOG_ERROR, "Thumbnail: socketpair failed: %s", strerror(errno));
+        return -1;
+    }
+
+    /* The request fits the empty socket buffer */
+    if (write(sv[1], request, (size_t)len) != len)
+    {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+
+    connection_t *capture = connection_create(sv[0], b->conn->epfd, NULL, 0);
+    if (!capture)
+    {
+        close(sv[0]);
+        close(sv[1]);
+        return -1;
+    }
+    if (worker_adopt_connection(capture) < 0)
+    {
+        close(sv[1]);
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.fd = sv[1];
+    if (epoll_ctl(b->conn->epfd, EPOLL_CTL_ADD, sv[1], &ev) < 0)
+    {
+        logger(LOG_ERROR, "Thumbnail: Failed to add capture socket to epoll: %s", strerror(errno));
+        close(sv[1]); /* The capture sees the hangup and closes itself */
+        return -1;
+    }
+
+    item->fd = sv[1];
+    item->iface = slot;
+    item->state = THUMBNAIL_ITEM_RUNNING;
+    item->start_time = get_time_ms();
+    item->run_next = running_items;
+    running_items = item;
+    iface_slots[slot].running++;
+    return 0;
+}
+
+/* Send the closing boundary or the manifest, then let the write handler close */
+static void thumbnail_batch_finish(thumbnail_batch_t *b)
+{
+    connection_t *c = b->conn;
+    thumbnail_batch_t **pp = &batches;
+    int i;
+
+    while (*pp && *pp != b)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = b->next;
+    c->thumbnail_batch = NULL;
+
+    if (!b->json)
+    {
+        static const char closing[] = "--" HTTP_MULTIPART_BOUNDARY "--\r\n";
+        connection_queue_output(c, (const uint8_t *)closing, sizeof(closing) - 1);
+    }
+    else
+    {
+        size_t cap = 64;
+        char *json;
+        size_t len = 0;
+
+        /* Worst case: every name byte escaped as \u00XX plus its URL encoding */
+        for (i = 0; i < b->count; i++)
+            cap += strlen(b->items[i].name) * 9 + sizeof(b->token) + 128;
+        json = malloc(cap);
+
+        if (json)
+        {
+            len += snprintf(json + len, cap - len, "{\"thumbnails\":[");
+            for (i = 0; i < b->count; i++)
+            {
+                thumbnail_item_t *item = &b->items[i];
+                char *path = http_url_encode(item->name);
+                const char *p;
+
+                len += snprintf(json + len, cap - len, "%s{\"service\":\"", i ? "," : "");
+                for (p = item->name; *p && len + 8 < cap; p++)
+                {
+                    unsigned char ch = (unsigned char)*p;
+                    if (ch == '"' || ch == '\\')
+                        len += snprintf(json + len, cap - len, "\\%c", ch);
+                    else if (ch < 0x20)
+                        len += snprintf(json + len, cap - len, "\\u%04x", ch);
+                    else
+                        json[len++] = (char)ch;
+                }
+                len += snprintf(json + len, cap - len,
+                                "\",\"url\":\"/%s?snapshot=1%s%s\",\"status\":%d,\"size\":%zu}",
+                                path ? path : "", b->token[0] ? "&r2h-token=" : "", b->token,
+                                item->status, item->jpeg_size);
+                free(path);
+            }
+            len += snprintf(json + len, cap - len, "]}");
+
+            char extra_headers[64];
+            snprintf(extra_headers, sizeof(extra_headers), "Content-Length: %zu\r\n", len);
+            send_http_headers(c, STATUS_200, CONTENT_JSON, extra_headers);
+            connection_queue_output(c, (const uint8_t *)json, len);
+            free(json);
+        }
+    }
+
+    logger(LOG_INFO, "Thumbnail: Batch of %d channels finished", b->count);
+
+    for (i = 0; i < b->count; i++)
+        free(b->items[i].name);
+    free(b->items);
+    free(b);
+
+    c->state = CONN_CLOSING;
+    thumbnail_flush(c);
+}
+
+/* Start pending captures wherever their interface has room */
+static void thumbnail_schedule(void)
+{
+    int limit = config.thumbnail_concurrency > 0 ? config.thumbnail_concurrency : 1;
+    thumbnail_batch_t *b, *next;
+    int i;
+
+    for (b = batches; b; b = next)
+    {
+        next = b->next;
+
+        /* Let a slow client drain the parts it has before capturing more */
+        if (b->conn->zc_queue.num_queued * BUFFER_POOL_BUFFER_SIZE > THUMBNAIL_BACKLOG_MAX)
+            continue;
+
+        for (i = b->first_pending; i < b->count; i++)
+        {
+            thumbnail_item_t *item = &b->items[i];
+            if (item->state != THUMBNAIL_ITEM_PENDING)
+                continue;
+
+            service_t *service = service_find(item->name);
+            if (!service)
+            {
+                thumbnail_item_finish(item, 404);
+                continue;
+            }
+
+            int slot = thumbnail_iface_slot(service);
+            if (iface_slots[slot].running >= limit)
+                continue;
+
+            if (thumbnail_start_capture(b, item, slot) < 0)
+                thumbnail_item_finish(item, 500);
+        }
+
+        while (b->first_pending < b->count && b->items[b->first_pending].state != THUMBNAIL_ITEM_PENDING)
+            b->first_pending++;
+
+        if (b->done == b->count)
+            thumbnail_batch_finish(b);
+    }
+}
+
+static int thumbnail_add_item(thumbnail_batch_t *b, const char *name)
+{
+    if (b->count >= THUMBNAIL_BATCH_MAX)
+        return -1;
+    if (strlen(name) > THUMBNAIL_NAME_MAX)
+        return 0; /* Not a playlist name; skipped */
+    b->items[b->count].name = strdup(name);
+    if (!b->items[b->count].name)
+        return -1;
+    b->items[b->count].fd = -1;
+    b->items[b->count].batch = b;
+    b->count++;
+    return 0;
+}
+
+int thumbnail_handle_request(connection_t *c, const char *query)
+{
+    thumbnail_batch_t *b = calloc(1, sizeof(*b));
+    char value[sizeof(c->http_req.url)];
+
+    if (b)
+        b->items = calloc(THUMBNAIL_BATCH_MAX, sizeof(thumbnail_item_t));
+    if (!b || !b->items)
+    {
+        free(b);
+        http_send_500(c);
+        return -1;
+    }
+    b->conn = c;
+
+    if (query && http_parse_query_param(query, "format", value, sizeof(value)) == 0)
+        b->json = strcasecmp(value, "json") == 0;
+    /* Pass the token on in canonical form: decoded as the check compares
+     * it, then encoded again for the request line and the manifest URLs */
+    if (query && http_parse_query_param(query, "r2h-token", value, sizeof(b->token) / 3) == 0 &&
+        http_url_decode(value) == 0)
+    {
+        char *token = http_url_encode(value);
+        snprintf(b->token, sizeof(b->token), "%s", token ? token : "");
+        free(token);
+    }
+    snprintf(b->host, sizeof(b->host), "%s", c->http_req.hostname);
+
+    if (query && http_parse_query_param(query, "services", value, sizeof(value)) == 0)
+    {
+        /* Comma separated, each name URL encoded on its own */
+        char *save = NULL;
+        char *name;
+        for (name = strtok_r(value, ",", &save); name; name = strtok_r(NULL, ",", &save))
+        {
+            if (http_url_decode(name) == 0 && name[0] && thumbnail_add_item(b, name) < 0)
+                break;
+        }
+    }
+    else
+    {
+        /* Every channel of the playlist */
+        service_t *s;
+        for (s = services; s; s = s->next)
+        {
+            if (s->url && thumbnail_add_item(b, s->url) < 0)
+                break;
+        }
+    }
+
+    logger(LOG_INFO, "Thumbnail: Batch of %d channels requested (%s)", b->count,
+           b->json ? "json" : "multipart");
+
+    c->keepalive = 0;
+    c->thumbnail_batch = b;
+    c->state = CONN_THUMBNAILS;
+    if (!b->json)
+    {
+        send_http_headers(c, STATUS_200, CONTENT_MULTIPART, NULL);
+        thumbnail_flush(c);
+    }
+
+    b->next = batches;
+    batches = b;
+    thumbnail_schedule();
+    return 0;
+}
+
+int thumbnail_handle_event(int fd, uint32_t events)
+{
+    thumbnail_item_t *item;
+
+    (void)events;
+    for (item = running_items; item; item = item->run_next)
+    {
+        if (item->fd == fd)
+            break;
+    }
+    if (!item)
+        return 0;
+
+    for (;;)
+    {
+        if (item->resp_len == item->resp_cap)
+        {
+            size_t cap = item->resp_cap ? item->resp_cap * 2 : 64 * 1024;
+            char *resp = cap <= THUMBNAIL_RESPONSE_MAX ? realloc(item->resp, cap + 1) : NULL;
+            if (!resp)
+            {
+                thumbnail_item_finish(item, 502);
+                break;
+            }
+            item->resp = resp;
+            item->resp_cap = cap;
+        }
+
+        ssize_t n = read(fd, item->resp + item->resp_len, item->resp_cap - item->resp_len);
+        if (n > 0)
+        {
+            item->resp_len += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            return 1;
+
+        /* The capture connection closes once its response is sent */
+        if (item->resp)
+            item->resp[item->resp_len] = '\0';
+        thumbnail_item_finish(item, n < 0 ? 502 : 0);
+        break;
+    }
+
+    thumbnail_schedule();
+    return 1;
+}
+
+void thumbnail_tick(int64_t now)
+{
+    thumbnail_item_t *item, *next;
+
+    for (item = running_items; item; item = next)
+    {
+        next = item->run_next;
+        if (now - item->start_time >= THUMBNAIL_CAPTURE_TIMEOUT_MS)
+        {
+            logger(LOG_WARN, "Thumbnail: Capture of %s timed out", item->name);
+            thumbnail_item_finish(item, 504);
+        }
+    }
+
+    if (batches)
+        thumbnail_schedule();
+}
+
+void thumbnail_cancel(connection_t *c)
+{
+    thumbnail_batch_t *b = c->thumbnail_batch;
+    thumbnail_batch_t **pp = &batches;
+    int i;
+
+    if (!b)
+        return;
+    c->thumbnail_batch = NULL;
+
+    while (*pp && *pp != b)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = b->next;
+
+    /* Closing our end makes the capture connections close themselves */
+    for (i = 0; i < b->count; i++)
+    {
+        thumbnail_item_t *item = &b->items[i];
+        if (item->state == THUMBNAIL_ITEM_RUNNING)
+        {
+            thumbnail_item_t **rp = &running_items;
+            while (*rp && *rp != item)
+                rp = &(*rp)->run_next;
+            if (*rp)
+                *rp = item->run_next;
+            worker_cleanup_socket_from_epoll(c->epfd, item->fd);
+            iface_slots[item->iface].running--;
+        }
+        free(item->resp);
+        free(item->name);
+    }
+
+    logger(LOG_DEBUG, "Thumbnail: Client left, batch cancelled (%d/%d done)", b->done, b->count);
+    free(b->items);
+    free(b);
+}
@@ -0,0 +1,58 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <stdint.h>
+
+/**
+ * Batch thumbnails (per worker)
+ *
+ * GET /thumbnails[?services=A,B,...][&format=json] takes snapshots of many
+ * channels in one request: the listed services, or every service of the
+ * playlist. Each capture runs as an ordinary snapshot=1 request on an
+ * internal socketpair connection, so it gets the snapshot cache, capture
+ * coalescing, live stream taps, FCC and the decoder pool like any client.
+ *
+ * - At most thumbnail-concurrency captures run at once per upstream
+ *   interface (multicast, FCC or RTSP), across all batches of the worker
+ * - The default response is multipart/mixed with one image/jpeg part per
+ *   channel, sent as each capture completes; format=json returns a
+ *   manifest once all are done (the JPEGs are then in the snapshot cache)
+ * - Capture sockets are registered with the worker epoll instance
+ *   directly (not in fdmap); the worker dispatches their events via
+ *   thumbnail_handle_event()
+ */
+
+/* Upper bound of thumbnail-concurrency */
+#define THUMBNAIL_CONCURRENCY_MAX 64
+
+typedef struct connection_s connection_t;
+typedef struct thumbnail_batch_s thumbnail_batch_t;
+
+/**
+ * Start a batch for a /thumbnails request
+ * @param c Client connection (CONN_THUMBNAILS while the batch runs)
+ * @param query Query string without the leading '?', or NULL
+ * @return 0 on success, -1 if an error response was queued
+ */
+int thumbnail_handle_request(connection_t *c, const char *query);
+
+/**
+ * Handle epoll event for a capture socket
+ * @param fd File descriptor from epoll event
+ * @param events Epoll events
+ * @return 1 if fd belongs to a batch (event consumed), 0 otherwise
+ */
+int thumbnail_handle_event(int fd, uint32_t events);
+
+/**
+ * Start queued captures and expire stuck ones
+ * @param now Current time in milliseconds
+ */
+void thumbnail_tick(int64_t now);
+
+/**
+ * Drop the batch of a closing client connection
+ */
+void thumbnail_cancel(connection_t *c);
+
+#endif /* THUMBNAIL_H */
@@ -0,0 +1,802 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <linux/sockios.h>
+#include "timeshift.h"
+#include "rtp2httpd.h"
+#include "http.h"
+#include "timezone.h"
+
+#define TIMESHIFT_MAGIC 0x53543252u /* "R2TS" */
+#define TIMESHIFT_VERSION 1
+#define TIMESHIFT_PAGE_SIZE 4096
+
+/* Payload is staged and written in chunks of this size */
+#define TIMESHIFT_STAGE_SIZE (64 * 1024)
+
+/* Staged chunks the writer thread may fall behind by before payload is dropped */
+#define TIMESHIFT_BACKLOG 16
+
+/* Catch-up data is queued to the client in chunks of at most this size */
+#define TIMESHIFT_SERVE_CHUNK (1024 * 1024)
+
+/* Data this close to being overwritten is not served (1/16 of the ring) */
+#define TIMESHIFT_SAFETY_SHIFT 4
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t data_size;   /* Capacity of the data ring in bytes */
+    uint64_t write_pos;   /* Total bytes written (logical position, flushed data only) */
+    uint32_t index_slots; /* Number of time index entries */
+    uint32_t index_head;  /* Next index slot to overwrite */
+} timeshift_header_t;
+
+typedef struct
+{
+    int64_t time_ms; /* Wall clock time (ms since epoch), 0 = unused */
+    uint64_t pos;    /* Logical data position at that time */
+} timeshift_index_entry_t;
+
+struct timeshift_ring_s
+{
+    char key[64];                   /* Channel key (multicast group and port) */
+    int fd;                         /* Ring file */
+    int refcount;                   /* Attached streams in this worker */
+    const void *owner;              /* Stream currently recording */
+    timeshift_header_t *hdr;        /* Mapped header (NULL unless this worker records) */
+    timeshift_index_entry_t *index; /* Mapped time index, follows the header */
+    size_t map_size;                /* Size of the header + index mapping */
+    off_t data_offset;              /* File offset of the data ring */
+    int64_t last_index_sec;         /* Second of the newest index entry */
+    int64_t last_lock_attempt_sec;  /* Rate limit for taking over the writer lock */
+    uint64_t dropped;               /* Payload bytes lost to a full backlog */
+
+    /* The event loop fills chunk queue_head, the writer thread pwrite()s the
+     * published chunks up to it, so a slow disk never stalls the loop */
+    uint8_t *stage;                 /* TIMESHIFT_BACKLOG chunks */
+    size_t stage_len;               /* Bytes in the chunk being filled */
+    size_t chunk_len[TIMESHIFT_BACKLOG];
+    unsigned queue_head;            /* Chunk being filled (published when it moves on) */
+    unsigned queue_tail;            /* Next chunk to write */
+    uint64_t staged_pos;            /* Logical position of the chunk being filled */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int writer_running;
+    int closing; /* Writer drains the backlog, then releases the ring */
+};
+
+/* Catch-up response sent from a ring, re-validated before each chunk */
+struct timeshift_reader_s
+{
+    int fd;
+    off_t data_offset;
+    uint64_t data_size;
+    uint64_t pos;         /* Next logical position to queue */
+    uint64_t end;         /* Logical end of the range */
+    uint64_t chunk_start; /* Start of the chunk queued last */
+};
+
+static timeshift_ring_t *rings[TIMESHIFT_MAX_CHANNELS];
+
+/* Writer threads of closed rings still draining their backlog */
+static pthread_mutex_t draining_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t draining_cond = PTHREAD_COND_INITIALIZER;
+static int draining;
+
+static size_t timeshift_meta_size(uint32_t index_slots)
+{
+    size_t size = sizeof(timeshift_header_t) + (size_t)index_slots * sizeof(timeshift_index_entry_t);
+    return (size + TIMESHIFT_PAGE_SIZE - 1) & ~(size_t)(TIMESHIFT_PAGE_SIZE - 1);
+}
+
+/* Channel key from the multicast group, e.g. "239.1.1.1_5000" */
+static int timeshift_service_key(const service_t *service, char *key, size_t key_size)
+{
+    char host[NI_MAXHOST], port[NI_MAXSERV];
+
+    if (!service || service->service_type != SERVICE_MRTP || !service->addr)
+        return -1;
+
+    if (getnameinfo(service->addr->ai_addr, service->addr->ai_addrlen,
+                    host, sizeof(host), port, sizeof(port),
+                    NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+        return -1;
+
+    for (char *p = host; *p; p++)
+    {
+        if (*p == ':' || *p == '%')
+            *p = '-';
+    }
+
+    if (snprintf(key, key_size, "%s_%s", host, port) >= (int)key_size)
+        return -1;
+    return 0;
+}
+
+static int timeshift_path(const char *key, char *path, size_t path_size)
+{
+    int len = snprintf(path, path_size, "%s/%s.ts", config.timeshift_dir, key);
+    return (len < 0 || (size_t)len >= path_size) ? -1 : 0;
+}
+
+static void timeshift_write_chunk(timeshift_ring_t *ring, const uint8_t *data, size_t len)
+{
+    timeshift_header_t *hdr = ring->hdr;
+    size_t done = 0;
+
+    while (done < len)
+    {
+        uint64_t ring_off = (hdr->write_pos + done) % hdr->data_size;
+        size_t chunk = min(len - done, (size_t)(hdr->data_size - ring_off));
+        ssize_t n = pwrite(ring->fd, data + done, chunk, ring->data_offset + (off_t)ring_off);
+        if (n <= 0)
+        {
+            /* The index already points past this chunk - keep positions in step */
+            logger(LOG_ERROR, "Timeshift: Write to %s failed: %s", ring->key, strerror(errno));
+            break;
+        }
+        done += (size_t)n;
+    }
+
+    /* Publish only after the data is in the file */
+    hdr->write_pos += len;
+}
+
+static void timeshift_release(timeshift_ring_t *ring)
+{
+    if (ring->hdr)
+        munmap(ring->hdr, ring->map_size);
+    close(ring->fd); /* Also drops the writer lock */
+    if (ring->writer_running)
+    {
+        pthread_mutex_destroy(&ring->lock);
+        pthread_cond_destroy(&ring->cond);
+    }
+    free(ring->stage);
+    free(ring);
+}
+
+static void *timeshift_writer(void *arg)
+{
+    timeshift_ring_t *ring = arg;
+
+    pthread_mutex_lock(&ring->lock);
+    for (;;)
+    {
+        while (ring->queue_tail == ring->queue_head && !ring->closing)
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        if (ring->queue_tail == ring->queue_head)
+            break;
+
+        unsigned slot = ring->queue_tail % TIMESHIFT_BACKLOG;
+        pthread_mutex_unlock(&ring->lock);
+        timeshift_write_chunk(ring, ring->stage + (size_t)slot * TIMESHIFT_STAGE_SIZE, ring->chunk_len[slot]);
+        pthread_mutex_lock(&ring->lock);
+        ring->queue_tail++;
+    }
+    pthread_mutex_unlock(&ring->lock);
+
+    timeshift_release(ring);
+
+    pthread_mutex_lock(&draining_lock);
+    draining--;
+    pthread_cond_signal(&draining_cond);
+    pthread_mutex_unlock(&draining_lock);
+    return NULL;
+}
+
+/* Hand the chunk being filled to the writer thread */
+static void timeshift_flush(timeshift_ring_t *ring)
+{
+    if (ring->stage_len == 0)
+        return;
+
+    pthread_mutex_lock(&ring->lock);
+    ring->chunk_len[ring->queue_head % TIMESHIFT_BACKLOG] = ring->stage_len;
+    ring->queue_head++;
+    pthread_cond_signal(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+
+    ring->staged_pos += ring->stage_len;
+    ring->stage_len = 0;
+}
+
+/* Whether the chunk at queue_head is free to be filled */
+static int timeshift_stage_ready(timeshift_ring_t *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    int ready = ring->queue_head - ring->queue_tail < TIMESHIFT_BACKLOG;
+    pthread_mutex_unlock(&ring->lock);
+    return ready;
+}
+
+static int timeshift_start_writer(timeshift_ring_t *ring)
+{
+    sigset_t all, saved;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int err;
+
+    if (pthread_mutex_init(&ring->lock, NULL) != 0)
+        return -1;
+    if (pthread_cond_init(&ring->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&ring->lock);
+        return -1;
+    }
+
+    /* Signals stay with the event loop thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &saved);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    err = pthread_create(&thread, &attr, timeshift_writer, ring);
+    pthread_attr_destroy(&attr);
+    pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+    if (err != 0)
+    {
+        logger(LOG_ERROR, "Timeshift: Cannot start writer for %s: %s", ring->key, strerror(err));
+        pthread_mutex_destroy(&ring->lock);
+        pthread_cond_destroy(&ring->cond);
+        return -1;
+    }
+
+    ring->writer_running = 1;
+    return 0;
+}
+
+/* Size and map the file of a ring we hold the lock of, start its writer */
+static int timeshift_map(timeshift_ring_t *ring)
+{
+    uint32_t index_slots = (uint32_t)config.timeshift_duration;
+    uint64_t data_size = (uint64_t)config.timeshift_size_mb * 1024 * 1024;
+    size_t meta_size = timeshift_meta_size(index_slots);
+    struct stat st;
+
+    if (fstat(ring->fd, &st) < 0 ||
+        (uint64_t)st.st_size != meta_size + data_size)
+    {
+        /* New file or different geometry - (re)create it, sparse */
+        if (ftruncate(ring->fd, 0) < 0 || ftruncate(ring->fd, (off_t)(meta_size + data_size)) < 0)
+        {
+            logger(LOG_ERROR, "Timeshift: Cannot size ring for %s: %s", ring->key, strerror(errno));
+            return -1;
+        }
+    }
+
+    ring->hdr = mmap(NULL, meta_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, 0);
+    if (ring->hdr == MAP_FAILED)
+    {
+        ring->hdr = NULL;
+        logger(LOG_ERROR, "Timeshift: Cannot map ring for %s: %s", ring->key, strerror(errno));
+        return -1;
+    }
+    ring->map_size = meta_size;
+    ring->index = (timeshift_index_entry_t *)(ring->hdr + 1);
+    ring->data_offset = (off_t)meta_size;
+
+    /* Keep recorded history across restarts when the geometry matches */
+    if (ring->hdr->magic != TIMESHIFT_MAGIC || ring->hdr->version != TIMESHIFT_VERSION ||
+        ring->hdr->data_size != data_size || ring->hdr->index_slots != index_slots ||
+        ring->hdr->index_head >= index_slots)
+    {
+        memset(ring->hdr, 0, meta_size);
+        ring->hdr->version = TIMESHIFT_VERSION;
+        ring->hdr->data_size = data_size;
+        ring->hdr->index_slots = index_slots;
+        ring->hdr->magic = TIMESHIFT_MAGIC;
+    }
+
+    ring->stage = malloc((size_t)TIMESHIFT_BACKLOG * TIMESHIFT_STAGE_SIZE);
+    if (!ring->stage || timeshift_start_writer(ring) < 0)
+    {
+        free(ring->stage);
+        ring->stage = NULL;
+        munmap(ring->hdr, ring->map_size);
+        ring->hdr = NULL;
+        return -1;
+    }
+    ring->staged_pos = ring->hdr->write_pos;
+
+    logger(LOG_INFO, "Timeshift: Recording %s (%u s, %llu MB)", ring->key,
+           index_slots, (unsigned long long)(data_size / (1024 * 1024)));
+    return 0;
+}
+
+/* Become the writer of a ring: take the lock, size and map the file */
+static int timeshift_claim(timeshift_ring_t *ring)
+{
+    if (flock(ring->fd, LOCK_EX | LOCK_NB) < 0)
+        return 0; /* Another worker records this channel */
+
+    if (timeshift_map(ring) < 0)
+    {
+        /* The ring stays open for a retry; let other workers record meanwhile */
+        flock(ring->fd, LOCK_UN);
+        return -1;
+    }
+    return 0;
+}
+
+static void timeshift_close(timeshift_ring_t *ring)
+{
+    if (!ring->writer_running)
+    {
+        timeshift_release(ring);
+        return;
+    }
+
+    /* The writer thread finishes the backlog and releases the ring */
+    timeshift_flush(ring);
+    pthread_mutex_lock(&draining_lock);
+    draining++;
+    pthread_mutex_unlock(&draining_lock);
+
+    pthread_mutex_lock(&ring->lock);
+    ring->closing = 1;
+    pthread_cond_signal(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+timeshift_ring_t *timeshift_attach(const service_t *service)
+{
+    char key[64];
+    int free_slot = -1;
+
+    if (!config.timeshift_dir || config.timeshift_duration <= 0 || config.timeshift_size_mb <= 0)
+        return NULL;
+
+    if (timeshift_service_key(service, key, sizeof(key)) < 0)
+        return NULL;
+
+    for (int i = 0; i < TIMESHIFT_MAX_CHANNELS; i++)
+    {
+        if (rings[i] && strcmp(rings[i]->key, key) == 0)
+        {
+            rings[i]->refcount++;
+            return rings[i];
+        }
+        if (!rings[i] && free_slot < 0)
+            free_slot = i;
+    }
+
+    if (free_slot < 0)
+    {
+        logger(LOG_WARN, "Timeshift: Too many channels, not recording %s", key);
+        return NULL;
+    }
+
+    timeshift_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return NULL;
+    snprintf(ring->key, sizeof(ring->key), "%s", key);
+    ring->refcount = 1;
+
+    char path[1024];
+    if (timeshift_path(key, path, sizeof(path)) < 0 ||
+        (ring->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644)) < 0)
+    {
+        logger(LOG_ERROR, "Timeshift: Cannot open ring for %s: %s", key, strerror(errno));
+        free(ring);
+        return NULL;
+    }
+
+    if (timeshift_claim(ring) < 0)
+    {
+        timeshift_close(ring);
+        return NULL;
+    }
+
+    rings[free_slot] = ring;
+    return ring;
+}
+
+void timeshift_write(timeshift_ring_t *ring, const void *owner, const uint8_t *data, size_t len)
+{
+    if (!ring || len == 0)
+        return;
+
+    if (ring->owner != owner)
+    {
+        if (ring->owner)
+            return; /* Another stream of this channel is recording */
+        ring->owner = owner;
+    }
+
+    int64_t now_ms = get_realtime_ms();
+    int64_t now_sec = now_ms / 1000;
+
+    if (!ring->hdr)
+    {
+        /* Take over once the recording worker lets go (at most once a second) */
+        if (now_sec == ring->last_lock_attempt_sec)
+            return;
+        ring->last_lock_attempt_sec = now_sec;
+        if (timeshift_claim(ring) < 0 || !ring->hdr)
+            return;
+    }
+
+    timeshift_header_t *hdr = ring->hdr;
+
+    /* The disk is not keeping up - drop; no index entries are written meanwhile,
+     * so ranges across a long stall are not served */
+    if (ring->stage_len == 0 && !timeshift_stage_ready(ring))
+    {
+        if (ring->dropped == 0)
+            logger(LOG_WARN, "Timeshift: Writes to %s are falling behind, dropping payload", ring->key);
+        ring->dropped += len;
+        return;
+    }
+    if (ring->dropped)
+    {
+        logger(LOG_WARN, "Timeshift: Dropped %llu bytes of %s while the disk was behind",
+               (unsigned long long)ring->dropped, ring->key);
+        ring->dropped = 0;
+    }
+
+    /* One index entry per second, pointing at the first payload of that second */
+    if (now_sec != ring->last_index_sec)
+    {
+        timeshift_index_entry_t *entry = &ring->index[hdr->index_head];
+        entry->pos = ring->staged_pos + ring->stage_len;
+        entry->time_ms = now_ms;
+        hdr->index_head = (hdr->index_head + 1) % hdr->index_slots;
+        ring->last_index_sec = now_sec;
+    }
+
+    while (len > 0)
+    {
+        uint8_t *stage = ring->stage + (size_t)(ring->queue_head % TIMESHIFT_BACKLOG) * TIMESHIFT_STAGE_SIZE;
+        size_t chunk = min(len, TIMESHIFT_STAGE_SIZE - ring->stage_len);
+        memcpy(stage + ring->stage_len, data, chunk);
+        ring->stage_len += chunk;
+        data += chunk;
+        len -= chunk;
+        if (ring->stage_len == TIMESHIFT_STAGE_SIZE)
+        {
+            timeshift_flush(ring);
+            if (len > 0 && !timeshift_stage_ready(ring))
+            {
+                ring->dropped += len;
+                return;
+            }
+        }
+    }
+}
+
+void timeshift_detach(timeshift_ring_t *ring, const void *owner)
+{
+    if (!ring)
+        return;
+
+    if (ring->owner == owner)
+    {
+        if (ring->hdr)
+            timeshift_flush(ring);
+        ring->owner = NULL;
+    }
+
+    if (--ring->refcount > 0)
+        return;
+
+    for (int i = 0; i < TIMESHIFT_MAX_CHANNELS; i++)
+    {
+        if (rings[i] == ring)
+            rings[i] = NULL;
+    }
+    timeshift_close(ring);
+}
+
+void timeshift_cleanup(void)
+{
+    pthread_mutex_lock(&draining_lock);
+    while (draining > 0)
+        pthread_cond_wait(&draining_cond, &draining_lock);
+    pthread_mutex_unlock(&draining_lock);
+}
+
+/* Convert a seek time (any format accepted by the RTSP path) to ms since epoch */
+static int timeshift_parse_time(const char *str, int tz_offset, int extra_offset, int64_t *out_ms)
+{
+    char utc[64];
+    struct tm tm;
+    size_t len, digits;
+
+    if (timezone_convert_time_with_offset(str, tz_offset, extra_offset, utc, sizeof(utc)) != 0)
+        return -1;
+
+    len = strlen(utc);
+    digits = strspn(utc, "0123456789");
+    memset(&tm, 0, sizeof(tm));
+
+    if (digits == len && len > 0 && len <= 10)
+    {
+        *out_ms = strtoll(utc, NULL, 10) * 1000;
+        return 0;
+    }
+
+    if (digits == 14 && (len == 14 || strcmp(utc + 14, "GMT") == 0))
+    {
+        if (sscanf(utc, "%4d%2d%2d%2d%2d%2d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                   &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+            return -1;
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        *out_ms = (int64_t)timegm(&tm) * 1000;
+        return 0;
+    }
+
+    int ms, has_tz, tz_seconds;
+    char suffix[16];
+    if (timezone_parse_iso8601(utc, &tm, &ms, &has_tz, &tz_seconds, suffix, sizeof(suffix)) == 0)
+    {
+        int64_t t = (int64_t)timegm(&tm) - (has_tz ? tz_seconds : 0);
+        *out_ms = t * 1000 + (ms > 0 ? ms : 0);
+        return 0;
+    }
+
+    return -1;
+}
+
+static int timeshift_parse_range(const service_t *service, int64_t *begin_ms, int64_t *end_ms)
+{
+    char begin_str[64], end_str[64];
+    const char *value = service->seek_param_value;
+    const char *dash;
+    int tz_offset = 0;
+
+    if (!value || !value[0])
+        return -1;
+
+    /* Open-ended ranges follow the live edge - leave those to the headend */
+    dash = strchr(value, '-');
+    if (!dash || !dash[1] || (size_t)(dash - value) >= sizeof(begin_str) ||
+        strlen(dash + 1) >= sizeof(end_str))
+        return -1;
+
+    memcpy(begin_str, value, (size_t)(dash - value));
+    begin_str[dash - value] = '\0';
+    snprintf(end_str, sizeof(end_str), "%s", dash + 1);
+
+    if (service->user_agent)
+        timezone_parse_from_user_agent(service->user_agent, &tz_offset);
+
+    if (timeshift_parse_time(begin_str, tz_offset, service->seek_offset_seconds, begin_ms) < 0 ||
+        timeshift_parse_time(end_str, tz_offset, service->seek_offset_seconds, end_ms) < 0 ||
+        *end_ms <= *begin_ms)
+        return -1;
+    return 0;
+}
+
+/* Oldest logical position that is not about to be overwritten by the writer */
+static uint64_t timeshift_oldest_safe(const timeshift_header_t *hdr)
+{
+    return hdr->write_pos > hdr->data_size
+               ? hdr->write_pos - hdr->data_size + (hdr->data_size >> TIMESHIFT_SAFETY_SHIFT)
+               : 0;
+}
+
+/* Locate [begin_ms, end_ms] in a ring file
+ * Returns 0 with the logical start position and length if the ring holds a
+ * continuous recording of the whole range, -1 otherwise */
+static int timeshift_find_range(int fd, int64_t begin_ms, int64_t end_ms,
+                                timeshift_header_t *hdr, uint64_t *start_pos, uint64_t *length)
+{
+    timeshift_index_entry_t *index;
+    const timeshift_index_entry_t *start = NULL, *end = NULL, *prev = NULL;
+    size_t index_bytes;
+    uint64_t oldest_safe;
+
+    if (pread(fd, hdr, sizeof(*hdr), 0) != (ssize_t)sizeof(*hdr) ||
+        hdr->magic != TIMESHIFT_MAGIC || hdr->version != TIMESHIFT_VERSION ||
+        hdr->index_slots == 0 || hdr->index_head >= hdr->index_slots || hdr->data_size == 0)
+        return -1;
+
+    index_bytes = (size_t)hdr->index_slots * sizeof(timeshift_index_entry_t);
+    index = malloc(index_bytes);
+    if (!index)
+        return -1;
+    if (pread(fd, index, index_bytes, sizeof(*hdr)) != (ssize_t)index_bytes)
+    {
+        free(index);
+        return -1;
+    }
+
+    /* Walk oldest to newest; a recording gap invalidates any earlier start */
+    for (uint32_t n = 0; n < hdr->index_slots; n++)
+    {
+        const timeshift_index_entry_t *e = &index[(hdr->index_head + n) % hdr->index_slots];
+        if (e->time_ms == 0)
+            continue;
+
+        if (prev && (e->time_ms - prev->time_ms > TIMESHIFT_MAX_GAP_MS || e->pos < prev->pos))
+            start = NULL;
+
+        if (e->time_ms <= begin_ms)
+            start = e; /* Latest entry at or before begin */
+        else if (!start && e->time_ms - begin_ms <= TIMESHIFT_MAX_GAP_MS)
+            start = e; /* Recording began just after begin */
+
+        if (start && e->time_ms >= end_ms)
+        {
+            end = e;
+            break;
+        }
+        prev = e;
+    }
+
+    /* Data about to be overwritten by the writer is not served */
+    oldest_safe = timeshift_oldest_safe(hdr);
+
+    int found = start && end && start->pos >= oldest_safe &&
+                end->pos <= hdr->write_pos && end->pos > start->pos;
+    if (found)
+    {
+        *start_pos = start->pos;
+        *length = end->pos - start->pos;
+    }
+
+    free(index);
+    return found ? 0 : -1;
+}
+
+static void timeshift_reader_free(connection_t *c)
+{
+    close(c->timeshift_reader->fd);
+    free(c->timeshift_reader);
+    c->timeshift_reader = NULL;
+}
+
+int timeshift_check(connection_t *c)
+{
+    struct timeshift_reader_s *reader = c->timeshift_reader;
+    timeshift_header_t hdr;
+    int outq = 0;
+
+    if (!reader)
+        return 0;
+
+    if (pread(reader->fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) ||
+        hdr.magic != TIMESHIFT_MAGIC || hdr.data_size != reader->data_size)
+    {
+        logger(LOG_ERROR, "Timeshift: Ring changed while serving, ending response");
+        timeshift_reader_free(c);
+        return -1;
+    }
+
+    /* Oldest byte the client has not received: sendfile() leaves queued data
+     * in the socket as page references, so it must stay intact until sent */
+    uint64_t unsent = c->zc_queue.head ? reader->chunk_start : reader->pos;
+    if (ioctl(c->fd, SIOCOUTQ, &outq) == 0 && outq > 0)
+        unsent = unsent > (uint64_t)outq ? unsent - (uint64_t)outq : 0;
+
+    if (unsent < timeshift_oldest_safe(&hdr))
+    {
+        /* Reset rather than let the kernel send what the writer is about to overwrite */
+        struct linger reset = {1, 0};
+        logger(LOG_WARN, "Timeshift: Client fell behind the ring writer, ending response");
+        setsockopt(c->fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+        timeshift_reader_free(c);
+        return -1;
+    }
+    return 0;
+}
+
+int timeshift_continue(connection_t *c)
+{
+    struct timeshift_reader_s *reader = c->timeshift_reader;
+
+    if (!reader)
+        return 0;
+    if (timeshift_check(c) < 0)
+        return -1;
+
+    if (reader->pos >= reader->end)
+    {
+        timeshift_reader_free(c);
+        return 0;
+    }
+
+    uint64_t ring_off = reader->pos % reader->data_size;
+    size_t chunk = (size_t)min(min(reader->end - reader->pos, (uint64_t)TIMESHIFT_SERVE_CHUNK),
+                               reader->data_size - ring_off);
+
+    /* The queue takes ownership of the fd it is given */
+    int fd = dup(reader->fd);
+    if (fd < 0 || connection_queue_file(c, fd, reader->data_offset + (off_t)ring_off, chunk) < 0)
+    {
+        logger(LOG_ERROR, "Timeshift: Failed to queue ring data");
+        if (fd >= 0)
+            close(fd);
+        timeshift_reader_free(c);
+        return -1;
+    }
+
+    reader->chunk_start = reader->pos;
+    reader->pos += chunk;
+    return 1;
+}
+
+void timeshift_cancel(connection_t *c)
+{
+    if (c && c->timeshift_reader)
+        timeshift_reader_free(c);
+}
+
+int timeshift_serve(connection_t *c, const service_t *service, const char *service_name)
+{
+    char live_name[HTTP_URL_BUFFER_SIZE];
+    char key[64], path[1024], extra_headers[64];
+    const char *suffix;
+    const service_t *live;
+    int64_t begin_ms, end_ms;
+    timeshift_header_t hdr;
+    uint64_t start_pos, total;
+    struct timeshift_reader_s *reader;
+    int fd;
+
+    if (!config.timeshift_dir || !service_name || timeshift_parse_range(service, &begin_ms, &end_ms) < 0)
+        return -1;
+
+    /* Catch-up services from M3U are named "<channel>/catchup" */
+    suffix = strrchr(service_name, '/');
+    if (!suffix || strcmp(suffix, "/catchup") != 0 ||
+        (size_t)(suffix - service_name) >= sizeof(live_name))
+        return -1;
+    memcpy(live_name, service_name, (size_t)(suffix - service_name));
+    live_name[suffix - service_name] = '\0';
+
+    live = service_find(live_name);
+    if (live && live->service_type != SERVICE_MRTP)
+        live = NULL;
+    if (timeshift_service_key(live, key, sizeof(key)) < 0 || timeshift_path(key, path, sizeof(path)) < 0)
+        return -1;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    reader = calloc(1, sizeof(*reader));
+    if (!reader || timeshift_find_range(fd, begin_ms, end_ms, &hdr, &start_pos, &total) < 0)
+    {
+        free(reader);
+        close(fd);
+        return -1;
+    }
+
+    reader->fd = fd;
+    reader->data_offset = (off_t)timeshift_meta_size(hdr.index_slots);
+    reader->data_size = hdr.data_size;
+    reader->pos = start_pos;
+    reader->end = start_pos + total;
+    reader->chunk_start = start_pos;
+    c->timeshift_reader = reader;
+
+    logger(LOG_INFO, "Timeshift: Serving %s from local ring (%llu bytes)",
+           service_name, (unsigned long long)total);
+
+    snprintf(extra_headers, sizeof(extra_headers), "Content-Length: %llu\r\n", (unsigned long long)total);
+    send_http_headers(c, STATUS_200, CONTENT_MP2T, extra_headers);
+
+    /* The rest is queued as the client drains it (connection_handle_write) */
+    timeshift_continue(c);
+    return 0; /* Headers are out - the request is handled either way */
+}
@@ -0,0 +1,98 @@
+#ifndef __TIMESHIFT_H__
+#define __TIMESHIFT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "connection.h"
+#include "service.h"
+
+/**
+ * Local time-shift ring buffer (per live multicast channel)
+ *
+ * While a multicast channel is being watched, its MPEG-TS payload is also
+ * appended to a fixed-size ring file in config.timeshift_dir, together with
+ * a one-entry-per-second time index. Catch-up requests (RTSP services with a
+ * seek parameter) whose whole time range is covered by the ring are then
+ * served from that file with sendfile() instead of going to the headend.
+ *
+ * The event loop only stages payload; a writer thread per recorded ring
+ * does the pwrite() calls, so a slow disk cannot stall the worker.
+ *
+ * File layout: [header][time index][data ring], page aligned. Only one
+ * process writes a given ring (flock), any worker may read it.
+ */
+
+/* Maximum number of channels with an open ring per worker */
+#define TIMESHIFT_MAX_CHANNELS 16
+
+/* Largest tolerated hole in the time index inside a served range */
+#define TIMESHIFT_MAX_GAP_MS 3000
+
+typedef struct timeshift_ring_s timeshift_ring_t;
+
+/**
+ * Open (or share) the ring of a multicast service for recording
+ * @param service Live multicast service
+ * @return Ring handle, or NULL if time-shift is disabled or unavailable
+ */
+timeshift_ring_t *timeshift_attach(const service_t *service);
+
+/**
+ * Append MPEG-TS payload to the ring
+ * Only the first attached stream of a channel records; when it detaches the
+ * next stream writing to the ring takes over.
+ * @param ring Ring handle from timeshift_attach()
+ * @param owner Recording stream (used to pick a single writer per ring)
+ * @param data Payload data
+ * @param len Payload length
+ */
+void timeshift_write(timeshift_ring_t *ring, const void *owner, const uint8_t *data, size_t len);
+
+/**
+ * Release a ring handle, flushing pending data if owner was the writer
+ * @param ring Ring handle from timeshift_attach()
+ * @param owner Stream that attached the ring
+ */
+void timeshift_detach(timeshift_ring_t *ring, const void *owner);
+
+/**
+ * Wait for the writer threads of closed rings to finish their backlog
+ * Called once when the worker exits.
+ */
+void timeshift_cleanup(void);
+
+/**
+ * Serve a catch-up request from the local ring if it covers the requested range
+ * Sends HTTP headers and queues the first chunk of ring data for sendfile() on
+ * success; the rest follows through timeshift_continue().
+ * @param c Client connection
+ * @param service Catch-up (RTSP) service with seek parameters
+ * @param service_name Name of the matched configured service ("<channel>/catchup")
+ * @return 0 if served locally, -1 if the request must go upstream
+ */
+int timeshift_serve(connection_t *c, const service_t *service, const char *service_name);
+
+/**
+ * Queue the next chunk of a catch-up response once the previous one is sent
+ * The unsent data is checked against the ring's write position first, and
+ * the response is cut short before the writer overwrites it.
+ * @param c Client connection
+ * @return 1 if a chunk was queued, 0 if the response is complete, -1 if it was ended early
+ */
+int timeshift_continue(connection_t *c);
+
+/**
+ * Check that the unsent part of a catch-up response is still safe in the ring
+ * Called from the worker tick, as a slow client can sit on queued data.
+ * @param c Client connection
+ * @return 0 if the response can go on, -1 if the connection must be closed
+ */
+int timeshift_check(connection_t *c);
+
+/**
+ * Release the catch-up response state of a closing connection
+ * @param c Client connection
+ */
+void timeshift_cancel(connection_t *c);
+
+#endif /* __TIMESHIFT_H__ */
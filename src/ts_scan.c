@@ -0,0 +1,139 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#if defined(TS_SCAN_SCALAR)
+/* Scalar code only, for comparing against the SIMD paths */
+#elif defined(__SSE2__)
+#define TS_SCAN_SSE2 1
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define TS_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#include "ts_scan.h"
+
+void ts_scan_packet(const uint8_t *packet, ts_scan_packet_t *pkt)
+{
+    int payload = 4;
+    uint8_t flags = 0;
+
+    pkt->offset = 0;
+    pkt->pid = (uint16_t)(((packet[1] & 0x1F) << 8) | packet[2]);
+    pkt->es = TS_PACKET_SIZE;
+
+    if (packet[1] & 0x40)
+        flags |= TS_SCAN_PUSI;
+
+    if (packet[3] & 0x20)
+    {
+        flags |= TS_SCAN_ADAPTATION;
+        payload += 1 + packet[4];
+        if (packet[4] > 0 && (packet[5] & 0x40))
+            flags |= TS_SCAN_RAI;
+    }
+
+    if ((packet[3] & 0x10) && payload < TS_PACKET_SIZE)
+        flags |= TS_SCAN_PAYLOAD;
+    else
+        payload = TS_PACKET_SIZE;
+
+    /* Video PES header at the start of a unit */
+    if ((flags & TS_SCAN_PUSI) && TS_PACKET_SIZE - payload >= 9)
+    {
+        const uint8_t *pes = packet + payload;
+        if (pes[0] == 0x00 && pes[1] == 0x00 && pes[2] == 0x01 && pes[3] >= 0xE0 && pes[3] <= 0xEF)
+        {
+            int es = payload + 9 + pes[8];
+            flags |= TS_SCAN_VIDEO_PES;
+            pkt->es = (uint8_t)(es < TS_PACKET_SIZE ? es : TS_PACKET_SIZE);
+        }
+    }
+
+    pkt->flags = flags;
+    pkt->payload = (uint8_t)payload;
+}
+
+int ts_scan_packets(const uint8_t *data, size_t len, ts_scan_packet_t *pkts, int max, size_t *consumed)
+{
+    size_t offset = 0;
+    int n = 0;
+
+    while (n < max && offset + TS_PACKET_SIZE <= len)
+    {
+        if (data[offset] != TS_SYNC_BYTE)
+        {
+            /* Lost sync: continue at the next sync byte */
+            const uint8_t *sync = memchr(data + offset + 1, TS_SYNC_BYTE, len - offset - 1);
+            if (!sync)
+                break;
+            offset = (size_t)(sync - data);
+            continue;
+        }
+
+        ts_scan_packet(data + offset, &pkts[n]);
+        pkts[n].offset = (uint32_t)offset;
+        n++;
+        offset += TS_PACKET_SIZE;
+    }
+
+    /* Stopped early only when the output filled up; a short tail is not a packet */
+    *consumed = (n == max && offset + TS_PACKET_SIZE <= len) ? offset : len;
+    return n;
+}
+
+int ts_scan_start_code(const uint8_t *data, size_t len)
+{
+    size_t i = 0;
+
+#if defined(TS_SCAN_SSE2)
+    /* 16 candidate positions per step: data[i] == 0 && data[i+1] == 0 && data[i+2] == 1 */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 18 <= len; i += 16)
+    {
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(const void *)(data + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(const void *)(data + i + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i *)(const void *)(data + i + 2));
+        __m128i hit = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                                    _mm_cmpeq_epi8(b2, one));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask)
+            return (int)i + __builtin_ctz((unsigned int)mask);
+    }
+#elif defined(TS_SCAN_NEON)
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 18 <= len; i += 16)
+    {
+        uint8x16_t b0 = vld1q_u8(data + i);
+        uint8x16_t b1 = vld1q_u8(data + i + 1);
+        uint8x16_t b2 = vld1q_u8(data + i + 2);
+        /* (b0 | b1) == 0 && b2 == 1 */
+        uint8x16_t hit = vandq_u8(vceqq_u8(vorrq_u8(b0, b1), vdupq_n_u8(0)), vceqq_u8(b2, one));
+        uint64x2_t lanes = vreinterpretq_u64_u8(hit);
+        uint64_t lo = vgetq_lane_u64(lanes, 0);
+        uint64_t hi = vgetq_lane_u64(lanes, 1);
+        if (lo)
+            return (int)i + __builtin_ctzll(lo) / 8;
+        if (hi)
+            return (int)i + 8 + __builtin_ctzll(hi) / 8;
+    }
+#endif
+
+    /* Scalar: a byte above 1 at i+2 rules out start codes at i, i+1 and i+2 */
+    while (i + 3 <= len)
+    {
+        if (data[i + 2] > 1)
+            i += 3;
+        else if (data[i + 2] == 1 && data[i + 1] == 0 && data[i] == 0)
+            return (int)i;
+        else
+            i++;
+    }
+
+    return -1;
+}
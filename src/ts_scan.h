@@ -0,0 +1,71 @@
+#ifndef TS_SCAN_H
+#define TS_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * MPEG2-TS packet scanner
+ *
+ * Classifies the TS packets of a received payload in one pass (sync,
+ * PID, PUSI, adaptation field, random access indicator, video PES start)
+ * so hot-path consumers look at a small array instead of re-parsing
+ * headers byte by byte. Resync uses memchr; the start code search uses
+ * SSE2 or NEON when the target has them, with a scalar fallback
+ * (TS_SCAN_SCALAR forces the fallback, so tests can compare the two).
+ */
+
+/* MPEG2-TS constants */
+#define TS_PACKET_SIZE 188
+#define TS_SYNC_BYTE 0x47
+#define TS_PAT_PID 0x0000
+
+/* Packet flags */
+#define TS_SCAN_PUSI 0x01         /* payload_unit_start_indicator */
+#define TS_SCAN_PAYLOAD 0x02      /* Packet carries payload */
+#define TS_SCAN_ADAPTATION 0x04   /* Adaptation field present */
+#define TS_SCAN_RAI 0x08          /* random_access_indicator set */
+#define TS_SCAN_VIDEO_PES 0x10    /* PES header of a video stream (stream_id 0xE0-0xEF) starts here */
+
+/* Packets classified per call by typical callers (7 per RTP payload) */
+#define TS_SCAN_BATCH 64
+
+typedef struct
+{
+    uint32_t offset;  /* Packet position in the scanned buffer */
+    uint16_t pid;
+    uint8_t flags;    /* TS_SCAN_* */
+    uint8_t payload;  /* Payload position in the packet (TS_PACKET_SIZE if none) */
+    uint8_t es;       /* Elementary stream position after the PES header (TS_SCAN_VIDEO_PES only) */
+} ts_scan_packet_t;
+
+/**
+ * Classify one TS packet
+ * @param packet TS packet (TS_PACKET_SIZE bytes, sync byte already checked)
+ * @param pkt Filled in (offset is set to 0)
+ */
+void ts_scan_packet(const uint8_t *packet, ts_scan_packet_t *pkt);
+
+/**
+ * Classify the TS packets of a buffer
+ * Bytes that do not start with a sync byte are skipped until the next one,
+ * so the scan resynchronises after a lost or truncated packet.
+ * @param data Buffer (e.g. an RTP payload)
+ * @param len Length of data
+ * @param pkts Output array
+ * @param max Capacity of pkts
+ * @param consumed Set to the bytes scanned; less than len when pkts filled up
+ * @return Number of packets classified
+ */
+int ts_scan_packets(const uint8_t *data, size_t len, ts_scan_packet_t *pkts, int max, size_t *consumed);
+
+/**
+ * Find the next Annex B start code (00 00 01; a 4-byte 00 00 00 01 is
+ * found at its last three bytes)
+ * @param data Elementary stream data
+ * @param len Length of data
+ * @return Offset of the start code, or -1 if there is none
+ */
+int ts_scan_start_code(const uint8_t *data, size_t len);
+
+#endif /* TS_SCAN_H */
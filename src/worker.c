@@ -8,9 +8,15 @@
 #include "status.h"
 #include "stream.h"
 #include "rtsp.h"
+#include "rtsp_pool.h"
 #include "zerocopy.h"
 #include "configuration.h"
 #include "http_fetch.h"
+#include "handoff.h"
+#include "snapshot_cache.h"
+#include "snapshot_decoder.h"
+#include "thumbnail.h"
+#include "timeshift.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -19,75 +25,124 @@
 #include <sys/epoll.h>
 #include <sys/socket.h>
 #include <netdb.h>
-
-/* fd -> connection map */
-static fdmap_entry_t fd_map[FD_MAP_SIZE];
+#include <time.h>
 
 /* Connection list head */
 static connection_t *conn_head = NULL;
 
 /* Stop flag for graceful shutdown */
 static volatile sig_atomic_t stop_flag = 0;
+static volatile sig_atomic_t drain_flag = 0;
 
 #define WORKER_MAX_WRITE_BATCH 128
 
-static inline unsigned fd_hash(int fd) { return (unsigned)fd & (FD_MAP_SIZE - 1); }
+/* Event loop timing: the handler currently running and when it started */
+static struct
+{
+  int64_t start_us;
+  loop_phase_t phase; /* LOOP_PHASE_COUNT while not classified */
+  const char *handler;
+  int line;
+  int fd;
+} loop_current = {0, LOOP_PHASE_COUNT, NULL, 0, -1};
+static int64_t loop_last_stall_log = 0;
+
+#define LOOP_STATS() (&status_shared->worker_stats[worker_id])
+#define LOOP_STATS_ENABLED() (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS)
+
+/* Attribute the running event to a phase and handler */
+#define LOOP_EVENT(phase, handler, fd) \
+  loop_event_classify((phase), (handler), __LINE__, (fd))
+
+/* Stall check for the tick step that just ended */
+#define LOOP_TICK_STEP(step_start_us, handler) \
+  loop_tick_step(&(step_start_us), (handler), __LINE__)
+
+/* Close the running event and time what follows as another handler */
+#define LOOP_EVENT_NEXT(phase, handler, fd) \
+  do                                        \
+  {                                         \
+    loop_event_begin(loop_now_us());        \
+    LOOP_EVENT(phase, handler, fd);         \
+  } while (0)
+
+static int64_t loop_now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
 
-void fdmap_init(void)
+static void loop_record(loop_phase_t phase, int64_t elapsed_us)
 {
-  memset(fd_map, 0, sizeof(fd_map));
+  if (!LOOP_STATS_ENABLED() || elapsed_us < 0)
+    return;
+
+  loop_phase_stats_t *ps = &LOOP_STATS()->loop_phases[phase];
+  uint64_t us = (uint64_t)elapsed_us;
+  int bucket = us < 4 ? 0 : 64 - __builtin_clzll(us >> 2);
+  if (bucket >= STATUS_LOOP_HIST_BUCKETS)
+    bucket = STATUS_LOOP_HIST_BUCKETS - 1;
+
+  ps->count++;
+  ps->total_us += us;
+  if (us > ps->max_us)
+    ps->max_us = us;
+  ps->hist[bucket]++;
 }
 
-void fdmap_set(int fd, connection_t *c)
+/* Flag a single handler that held the loop longer than loop-stall-threshold */
+static void loop_check_stall(int64_t elapsed_us, const char *handler, int line, int fd)
 {
-  if (fd < 0)
+  if (config.loop_stall_threshold <= 0 || elapsed_us < (int64_t)config.loop_stall_threshold * 1000)
     return;
-  unsigned idx = fd_hash(fd);
-  for (unsigned n = 0; n < FD_MAP_SIZE; n++)
+
+  if (LOOP_STATS_ENABLED())
   {
-    unsigned i = (idx + n) & (FD_MAP_SIZE - 1);
-    if (fd_map[i].conn == NULL || fd_map[i].fd == fd)
-    {
-      fd_map[i].fd = fd;
-      fd_map[i].conn = c;
-      return;
-    }
+    worker_stats_t *ws = LOOP_STATS();
+    ws->loop_stalls++;
+    ws->loop_last_stall_us = (uint64_t)elapsed_us;
+    ws->loop_last_stall_time = get_realtime_ms();
+    snprintf(ws->loop_last_stall_site, sizeof(ws->loop_last_stall_site), "%s (worker.c:%d)", handler, line);
   }
-}
 
-connection_t *fdmap_get(int fd)
-{
-  if (fd < 0)
-    return NULL;
-  unsigned idx = fd_hash(fd);
-  for (unsigned n = 0; n < FD_MAP_SIZE; n++)
+  /* Every stall is counted, the log is limited to one line per second */
+  int64_t now = get_time_ms();
+  if (now - loop_last_stall_log >= 1000)
   {
-    unsigned i = (idx + n) & (FD_MAP_SIZE - 1);
-    if (fd_map[i].conn == NULL)
-      return NULL;
-    if (fd_map[i].fd == fd)
-      return fd_map[i].conn;
+    loop_last_stall_log = now;
+    logger(LOG_WARN, "Event loop stall: %s took %lld.%03lld ms (fd %d, worker.c:%d)",
+           handler, (long long)(elapsed_us / 1000), (long long)(elapsed_us % 1000), fd, line);
   }
-  return NULL;
 }
 
-void fdmap_del(int fd)
+/* Finish the running event (if classified) and start timing the next one at now_us */
+static void loop_event_begin(int64_t now_us)
 {
-  if (fd < 0)
-    return;
-  unsigned idx = fd_hash(fd);
-  for (unsigned n = 0; n < FD_MAP_SIZE; n++)
+  if (loop_current.phase != LOOP_PHASE_COUNT)
   {
-    unsigned i = (idx + n) & (FD_MAP_SIZE - 1);
-    if (fd_map[i].conn == NULL)
-      return;
-    if (fd_map[i].fd == fd)
-    {
-      fd_map[i].conn = NULL;
-      fd_map[i].fd = -1;
-      return;
-    }
+    int64_t elapsed = now_us - loop_current.start_us;
+    loop_record(loop_current.phase, elapsed);
+    loop_check_stall(elapsed, loop_current.handler, loop_current.line, loop_current.fd);
   }
+  loop_current.start_us = now_us;
+  loop_current.phase = LOOP_PHASE_COUNT;
+}
+
+static void loop_event_classify(loop_phase_t phase, const char *handler, int line, int fd)
+{
+  loop_current.phase = phase;
+  loop_current.handler = handler;
+  loop_current.line = line;
+  loop_current.fd = fd;
+}
+
+/* Stall check for one step of the periodic tick; advances *step_start_us */
+static void loop_tick_step(int64_t *step_start_us, const char *handler, int line)
+{
+  int64_t now_us = loop_now_us();
+  loop_check_stall(now_us - *step_start_us, handler, line, -1);
+  *step_start_us = now_us;
 }
 
 void worker_cleanup_socket_from_epoll(int epoll_fd, int sock)
@@ -124,23 +179,45 @@ void worker_set_conn_head(connection_t *head)
   conn_head = head;
 }
 
+static void add_connection_to_list(connection_t *c)
+{
+  c->prev = NULL;
+  c->next = conn_head;
+  if (conn_head)
+    conn_head->prev = c;
+  conn_head = c;
+}
+
 static void remove_connection_from_list(connection_t *c)
 {
   if (!c)
     return;
-  if (conn_head == c)
-  {
+  if (c->prev)
+    c->prev->next = c->next;
+  else if (conn_head == c)
     conn_head = c->next;
-    return;
-  }
-  for (connection_t *p = conn_head; p; p = p->next)
+  if (c->next)
+    c->next->prev = c->prev;
+  c->prev = NULL;
+  c->next = NULL;
+}
+
+int worker_adopt_connection(connection_t *c)
+{
+  add_connection_to_list(c);
+
+  struct epoll_event cev;
+  memset(&cev, 0, sizeof(cev));
+  cev.events = EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR;
+  cev.data.fd = c->fd;
+  if (epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->fd, &cev) < 0)
   {
-    if (p->next == c)
-    {
-      p->next = c->next;
-      return;
-    }
+    logger(LOG_ERROR, "epoll_ctl ADD adopted client failed: %s", strerror(errno));
+    worker_close_and_free_connection(c);
+    return -1;
   }
+  fdmap_set(c->fd, c);
+  return 0;
 }
 
 void worker_close_and_free_connection(connection_t *c)
@@ -148,6 +225,10 @@ void worker_close_and_free_connection(connection_t *c)
   if (!c)
     return;
 
+  snapshot_cache_cancel_wait(c);
+  thumbnail_cancel(c);
+  timeshift_cancel(c);
+
   /* CRITICAL: For streaming connections, initiate cleanup first to check if async TEARDOWN will be started
    * This prevents use-after-free when TEARDOWN response arrives after connection is freed. */
   if (c->streaming)
@@ -209,7 +290,41 @@ static void term_handler(int signum)
   stop_flag = 1;
 }
 
-int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
+static void drain_handler(int signum)
+{
+  (void)signum;
+  drain_flag = 1;
+}
+
+/* Stop accepting: a new instance (or nobody) owns the listening sockets now */
+static void worker_start_drain(int epfd, int *listen_sockets, int num_sockets)
+{
+  int i, active = 0;
+
+  for (i = 0; i < num_sockets; i++)
+  {
+    if (listen_sockets[i] < 0)
+      continue;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, listen_sockets[i], NULL);
+    close(listen_sockets[i]);
+    listen_sockets[i] = -1;
+  }
+
+  for (connection_t *c = conn_head; c; c = c->next)
+    active++;
+  logger(LOG_INFO, "Draining: stopped accepting, waiting for %d connections", active);
+}
+
+/* While draining, only streams keep the worker alive */
+static int worker_drain_idle(connection_t *c)
+{
+  if (c->sse_active)
+    return 1;
+  return !c->streaming && !c->zc_queue.head &&
+         c->state == CONN_READ_REQ_LINE && c->requests_served > 0;
+}
+
+int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd, int handoff_fd)
 {
   int i;
   struct sockaddr_storage client;
@@ -225,6 +340,10 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
     return -1;
   }
 
+  /* Warm RTSP connections share this worker's epoll instance */
+  rtsp_pool_init(epfd);
+  snapshot_decoder_init(epfd);
+
   struct epoll_event ev, events[1024];
   for (i = 0; i < num_sockets; i++)
   {
@@ -252,17 +371,41 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
     }
   }
 
+  if (handoff_fd >= 0)
+  {
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = handoff_fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, handoff_fd, &ev) < 0)
+    {
+      logger(LOG_ERROR, "epoll_ctl ADD handoff_fd failed: %s", strerror(errno));
+      handoff_fd = -1;
+    }
+  }
+
   /* Register signal handlers */
   signal(SIGTERM, &term_handler);
   signal(SIGINT, &term_handler);
+  signal(SIGQUIT, &drain_handler);
 
   /* Unified event loop: accept + clients + stream fds */
   int64_t last_tick = get_time_ms();
 
+  int draining = 0;
+
   while (!stop_flag)
   {
     int timeout_ms = 100;
+
+    if (drain_flag && !draining)
+    {
+      draining = 1;
+      worker_start_drain(epfd, listen_sockets, num_sockets);
+    }
+
+    int64_t wait_start_us = loop_now_us();
     int n = epoll_wait(epfd, events, (int)(sizeof(events) / sizeof(events[0])), timeout_ms);
+    int64_t wait_end_us = loop_now_us();
     if (n < 0)
     {
       if (errno == EINTR)
@@ -270,6 +413,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
       logger(LOG_FATAL, "epoll_wait failed: %s", strerror(errno));
       break;
     }
+    loop_record(LOOP_PHASE_WAIT, wait_end_us - wait_start_us);
 
     int64_t now = get_time_ms();
 
@@ -277,6 +421,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
     for (int e = 0; e < n; e++)
     {
       int fd_ready = events[e].data.fd;
+      loop_event_begin(loop_now_us());
       int is_listener = 0;
       for (i = 0; i < num_sockets; i++)
         if (fd_ready == listen_sockets[i])
@@ -287,6 +432,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
 
       if (notif_fd >= 0 && fd_ready == notif_fd)
       {
+        LOOP_EVENT(LOOP_PHASE_CONTROL, "status notification", fd_ready);
         /* Read event notifications from pipe */
         uint8_t event_buf[256];
         ssize_t bytes_read;
@@ -336,13 +482,32 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
         continue;
       }
 
+      if (handoff_fd >= 0 && fd_ready == handoff_fd)
+      {
+        /* Adopt connections other workers parsed for a channel this worker owns */
+        LOOP_EVENT(LOOP_PHASE_CONTROL, "handoff_receive", fd_ready);
+        connection_t *c;
+        while (handoff_receive(handoff_fd, epfd, &c) > 0)
+        {
+          if (worker_adopt_connection(c) < 0)
+            continue;
+
+          connection_route_and_start(c);
+          if (!c->zc_queue.head && !c->streaming && c->state != CONN_SNAPSHOT_WAIT &&
+              c->state != CONN_READ_REQ_LINE && c->state != CONN_READ_HEADERS)
+            worker_close_and_free_connection(c);
+        }
+        continue;
+      }
+
       if (is_listener)
       {
+        LOOP_EVENT(LOOP_PHASE_ACCEPT, "accept", fd_ready);
         /* Accept as many as possible */
         for (;;)
         {
           socklen_t alen = sizeof(client);
-          int cfd = accept(fd_ready, (struct sockaddr *)&client, &alen);
+          int cfd = accept4(fd_ready, (struct sockaddr *)&client, &alen, SOCK_CLOEXEC);
           if (cfd < 0)
           {
             if (errno == EAGAIN || errno == EINTR)
@@ -363,8 +528,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
           }
 
           /* link */
-          c->next = conn_head;
-          conn_head = c;
+          add_connection_to_list(c);
 
           /* Add client fd to epoll and map */
           struct epoll_event cev;
@@ -388,6 +552,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
       http_fetch_ctx_t *fetch_ctx = http_fetch_find_by_fd(fd_ready);
       if (fetch_ctx)
       {
+        LOOP_EVENT(LOOP_PHASE_FETCH, "http_fetch_handle_event", fd_ready);
         /* Handle HTTP fetch event */
         (void)http_fetch_handle_event(fetch_ctx);
         /* Return value: 0 = more data expected, 1 = completed, -1 = error
@@ -402,6 +567,8 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
         if (fd_ready == c->fd)
         {
           /* Client socket events */
+          LOOP_EVENT((events[e].events & ~EPOLLOUT) ? LOOP_PHASE_CLIENT_READ : LOOP_PHASE_CLIENT_WRITE,
+                     "client socket event", fd_ready);
 
           /* First, handle EPOLLERR for MSG_ZEROCOPY completions before checking for real errors */
           if (events[e].events & EPOLLERR)
@@ -487,8 +654,11 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
             else
             {
               /* Normal HTTP request handling */
+              LOOP_EVENT(LOOP_PHASE_CLIENT_READ, "connection_handle_read", fd_ready);
               connection_handle_read(c);
-              if (!c->zc_queue.head && !c->streaming)
+              if (!c->zc_queue.head && !c->streaming && c->state != CONN_SNAPSHOT_WAIT &&
+                  c->state != CONN_THUMBNAILS && c->state != CONN_READ_REQ_LINE &&
+                  c->state != CONN_READ_HEADERS)
               {
                 worker_close_and_free_connection(c);
                 continue; /* Skip further processing for this connection */
@@ -498,6 +668,10 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
 
           if (events[e].events & EPOLLOUT)
           {
+            if (events[e].events & ~EPOLLOUT)
+              LOOP_EVENT_NEXT(LOOP_PHASE_CLIENT_WRITE, "connection_handle_write", fd_ready);
+            else
+              LOOP_EVENT(LOOP_PHASE_CLIENT_WRITE, "connection_handle_write", fd_ready);
             connection_write_status_t status = connection_handle_write(c);
             if (status == CONNECTION_WRITE_CLOSED)
             {
@@ -508,6 +682,7 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
         }
         else
         {
+          LOOP_EVENT(LOOP_PHASE_STREAM, "stream_handle_fd_event", fd_ready);
           int res = stream_handle_fd_event(&c->stream, fd_ready, events[e].events, now);
           if (res < 0)
           {
@@ -516,16 +691,46 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
           }
         }
       }
+      else
+      {
+        /* Not owned by a connection: a shared multicast group, an idle warm
+         * RTSP socket, a snapshot decoder pipe or a thumbnail capture socket */
+        LOOP_EVENT(LOOP_PHASE_SHARED, "stream_mcast_handle_event", fd_ready);
+        if (!stream_mcast_handle_event(fd_ready, now))
+        {
+          LOOP_EVENT(LOOP_PHASE_SHARED, "rtsp_pool_handle_event", fd_ready);
+          if (!rtsp_pool_handle_event(fd_ready, events[e].events))
+          {
+            LOOP_EVENT(LOOP_PHASE_SHARED, "snapshot_decoder_handle_event", fd_ready);
+            if (!snapshot_decoder_handle_event(fd_ready, events[e].events))
+            {
+              LOOP_EVENT(LOOP_PHASE_SHARED, "thumbnail_handle_event", fd_ready);
+              (void)thumbnail_handle_event(fd_ready, events[e].events);
+            }
+          }
+        }
+      }
     }
 
+    int64_t tick_start_us = loop_now_us();
+    loop_event_begin(tick_start_us);
+
     /* 2) Periodic tick: update streams and SSE heartbeats */
     if (now - last_tick >= timeout_ms)
     {
+      int64_t step_us = tick_start_us;
       last_tick = now;
       connection_t *c = conn_head;
       while (c)
       {
         connection_t *next = c->next; /* Save next pointer before potential cleanup */
+        if (draining && worker_drain_idle(c))
+        {
+          /* Status pages and idle keep-alive clients reconnect to the new instance */
+          worker_close_and_free_connection(c);
+          c = next;
+          continue;
+        }
         if (c->streaming)
         {
           if (stream_tick(&c->stream, now) < 0)
@@ -536,10 +741,60 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
             continue;
           }
         }
+        else if (c->timeshift_reader && timeshift_check(c) < 0)
+        {
+          /* Catch-up client fell behind the time-shift ring writer */
+          worker_close_and_free_connection(c);
+          c = next;
+          continue;
+        }
+        else if (connection_keepalive_expired(c, now))
+        {
+          /* Idle persistent connection or incomplete request */
+          worker_close_and_free_connection(c);
+          c = next;
+          continue;
+        }
         status_handle_sse_heartbeat(c, now);
         c = next;
       }
 
+      LOOP_TICK_STEP(step_us, "stream_tick");
+
+      /* Rejoin, hand over and release shared multicast groups */
+      stream_mcast_tick(now);
+      LOOP_TICK_STEP(step_us, "stream_mcast_tick");
+
+      /* Route clients of abandoned snapshot captures, expire cached JPEGs */
+      snapshot_cache_tick(now);
+      LOOP_TICK_STEP(step_us, "snapshot_cache_tick");
+
+      /* Feed fillers, restart stalled and stop idle snapshot decoders */
+      snapshot_decoder_tick(now);
+      LOOP_TICK_STEP(step_us, "snapshot_decoder_tick");
+
+      /* Start queued batch thumbnail captures, expire stuck ones */
+      thumbnail_tick(now);
+      LOOP_TICK_STEP(step_us, "thumbnail_tick");
+
+      if (draining && !conn_head)
+      {
+        logger(LOG_INFO, "Draining: all connections finished, exiting");
+        break;
+      }
+
+      /* Follow the memory budget (buffer-pool-max-size = auto) */
+      zerocopy_budget_tick(now);
+      LOOP_TICK_STEP(step_us, "zerocopy_budget_tick");
+
+      /* Free idle pool segments once the decayed demand allows it, also when no client disconnects */
+      buffer_pool_try_shrink();
+      LOOP_TICK_STEP(step_us, "buffer_pool_try_shrink");
+
+      /* Refill, health-check and expire warm RTSP connections */
+      rtsp_pool_tick(now);
+      LOOP_TICK_STEP(step_us, "rtsp_pool_tick");
+
       /* Check if external M3U needs to be reloaded (all workers perform this with staggered timing) */
       if (config.external_m3u_update_interval > 0)
       {
@@ -572,16 +827,27 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
             reload_external_m3u_async(epfd);
             /* Note: We always update timestamp regardless of success/failure to avoid
              * hammering the server with repeated requests */
+            LOOP_TICK_STEP(step_us, "reload_external_m3u_async");
           }
         }
       }
+
+      loop_record(LOOP_PHASE_TICK, loop_now_us() - tick_start_us);
     }
+
+    loop_record(LOOP_PHASE_BUSY, loop_now_us() - wait_end_us);
   }
 
   /* Cleanup: close all active connections */
   while (conn_head)
     worker_close_and_free_connection(conn_head);
 
+  rtsp_pool_cleanup();
+  snapshot_decoder_cleanup();
+  timeshift_cleanup();
+
+  fdmap_free();
+
   /* Close notification pipe read end */
   if (notif_fd >= 0)
   {
@@ -591,7 +857,8 @@ int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd)
   /* Close epoll and listeners */
   close(epfd);
   for (i = 0; i < num_sockets; i++)
-    close(listen_sockets[i]);
+    if (listen_sockets[i] >= 0)
+      close(listen_sockets[i]);
 
   return 0;
 }
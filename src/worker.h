@@ -2,51 +2,17 @@
 #define WORKER_H
 
 #include "connection.h"
-
-/**
- * fd -> connection map to avoid O(N) scans
- */
-#define FD_MAP_SIZE 16384 /* power of two */
-
-typedef struct
-{
-  int fd;
-  connection_t *conn;
-} fdmap_entry_t;
-
-/**
- * Initialize the fd map
- */
-void fdmap_init(void);
-
-/**
- * Set fd -> connection mapping
- * @param fd File descriptor
- * @param c Connection pointer
- */
-void fdmap_set(int fd, connection_t *c);
-
-/**
- * Get connection by fd
- * @param fd File descriptor
- * @return Connection pointer or NULL
- */
-connection_t *fdmap_get(int fd);
-
-/**
- * Delete fd from map
- * @param fd File descriptor
- */
-void fdmap_del(int fd);
+#include "fdmap.h"
 
 /**
  * Run the worker event loop
  * @param listen_sockets Array of listening socket fds
  * @param num_sockets Number of listening sockets
  * @param notif_fd Notification pipe fd for SSE events (-1 if disabled)
+ * @param handoff_fd Receive end for connections handed over by other workers (-1 if disabled)
  * @return 0 on clean exit, non-zero on error
  */
-int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd);
+int worker_run_event_loop(int *listen_sockets, int num_sockets, int notif_fd, int handoff_fd);
 
 /**
  * Get the connection list head (for iteration)
@@ -60,6 +26,14 @@ connection_t *worker_get_conn_head(void);
  */
 void worker_set_conn_head(connection_t *head);
 
+/**
+ * Add a connection created outside the accept loop (handoff, internal
+ * requests) to the worker: connection list, epoll and fdmap
+ * @param c Connection to adopt (freed on failure)
+ * @return 0 on success, -1 on failure
+ */
+int worker_adopt_connection(connection_t *c);
+
 /**
  * Close and free a connection, removing it from the list
  * @param c Connection to close
@@ -5,9 +5,11 @@
 #include "zerocopy.h"
 #include "rtp2httpd.h"
 #include "status.h"
+#include "mem_budget.h"
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <sys/sendfile.h>
@@ -37,7 +39,7 @@ zerocopy_state_t zerocopy_state = {0};
  */
 static int detect_msg_zerocopy_support(void)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (sock < 0)
         return 0;
 
@@ -64,6 +66,96 @@ size_t zerocopy_active_streams(void)
     return zerocopy_state.active_streams;
 }
 
+/**
+ * Media pool limit for this worker's share of available memory
+ * Memory the pool already holds counts as used in MemAvailable and the
+ * cgroup usage, so it is added back before taking the share.
+ * @param budget_bytes Set to the budget the limit was derived from
+ */
+static size_t zerocopy_budget_buffers(size_t *budget_bytes)
+{
+    size_t per_buffer = BUFFER_POOL_BUFFER_SIZE + sizeof(buffer_ref_t);
+    size_t available;
+    size_t buffers;
+
+    /* A cgroup at its limit reports 0 and gets the minimum, not the fallback */
+    if (mem_budget_available(NULL, &available) < 0)
+    {
+        *budget_bytes = 0;
+        return ZEROCOPY_BUDGET_FALLBACK;
+    }
+
+    available += zerocopy_state.pool.num_buffers * per_buffer;
+    *budget_bytes = available / 100 * ZEROCOPY_BUDGET_PERCENT / (size_t)(config.workers > 0 ? config.workers : 1);
+
+    buffers = *budget_bytes / per_buffer;
+    if (buffers < BUFFER_POOL_INITIAL_SIZE)
+        buffers = BUFFER_POOL_INITIAL_SIZE;
+    if (buffers > ZEROCOPY_BUDGET_MAX_BUFFERS)
+        buffers = ZEROCOPY_BUDGET_MAX_BUFFERS;
+    return buffers;
+}
+
+static void zerocopy_budget_update_stats(size_t budget_bytes, int pressure)
+{
+    if (status_shared && worker_id >= 0 && worker_id < STATUS_MAX_WORKERS)
+    {
+        status_shared->worker_stats[worker_id].pool_budget_bytes = budget_bytes;
+        status_shared->worker_stats[worker_id].mem_pressure = pressure;
+    }
+}
+
+void zerocopy_budget_tick(int64_t now)
+{
+    if (!zerocopy_state.initialized || config.buffer_pool_max_size > 0 ||
+        now - zerocopy_state.budget_time < ZEROCOPY_BUDGET_INTERVAL_MS)
+        return;
+    zerocopy_state.budget_time = now;
+
+    buffer_pool_t *pool = &zerocopy_state.pool;
+    size_t budget_bytes;
+    size_t target = zerocopy_budget_buffers(&budget_bytes);
+    int pressure = mem_budget_pressure(NULL);
+    size_t max_buffers = pool->max_buffers;
+
+    if (pressure >= ZEROCOPY_BUDGET_PRESSURE)
+    {
+        /* Back off hard; the kernel is already reclaiming or stalling */
+        max_buffers /= 2;
+        if (max_buffers > target)
+            max_buffers = target;
+    }
+    else if (target + max_buffers / 16 >= max_buffers && target <= max_buffers + max_buffers / 16)
+    {
+        /* Within 1/16 of the current limit: not worth a change */
+    }
+    else if (target > max_buffers)
+    {
+        /* Grow back gradually so a short lull in pressure does not undo the back-off */
+        max_buffers += max_buffers / 4;
+        if (max_buffers > target)
+            max_buffers = target;
+    }
+    else
+    {
+        max_buffers = target;
+    }
+
+    if (max_buffers < BUFFER_POOL_INITIAL_SIZE)
+        max_buffers = BUFFER_POOL_INITIAL_SIZE;
+
+    if (max_buffers != pool->max_buffers)
+    {
+        logger(pressure >= ZEROCOPY_BUDGET_PRESSURE ? LOG_INFO : LOG_DEBUG,
+               "Zero-copy: Buffer pool limit %zu -> %zu buffers (budget %zu KB, memory pressure %d.%02d%%)",
+               pool->max_buffers, max_buffers, budget_bytes / 1024,
+               pressure < 0 ? 0 : pressure / 100, pressure < 0 ? 0 : pressure % 100);
+        buffer_pool_set_max(pool, max_buffers);
+    }
+
+    zerocopy_budget_update_stats(budget_bytes, pressure);
+}
+
 int zerocopy_init(void)
 {
     if (zerocopy_state.initialized)
@@ -101,14 +193,25 @@ int zerocopy_init(void)
         logger(LOG_INFO, "Zero-copy: Using regular send (default). Enable zerocopy-on-send for better performance on supported devices.");
     }
 
+    /* A limit of 0 (auto) is derived from available memory */
+    size_t max_buffers = (size_t)config.buffer_pool_max_size;
+    size_t budget_bytes = 0;
+    if (max_buffers == 0)
+    {
+        max_buffers = zerocopy_budget_buffers(&budget_bytes);
+        logger(LOG_INFO, "Zero-copy: Buffer pool limit %zu buffers (budget %zu KB, %d%% of available memory over %d worker(s))",
+               max_buffers, budget_bytes / 1024, ZEROCOPY_BUDGET_PERCENT, config.workers);
+    }
+
     /* Initialize buffer pool with dynamic expansion support */
     if (buffer_pool_init(&zerocopy_state.pool,
                          BUFFER_POOL_BUFFER_SIZE,
                          BUFFER_POOL_INITIAL_SIZE,
-                         config.buffer_pool_max_size,
+                         max_buffers,
                          BUFFER_POOL_EXPAND_SIZE,
                          BUFFER_POOL_LOW_WATERMARK,
-                         BUFFER_POOL_HIGH_WATERMARK) < 0)
+                         BUFFER_POOL_HIGH_WATERMARK,
+                         config.buffer_pool_hugepages) < 0)
     {
         logger(LOG_FATAL, "Zero-copy: Failed to initialize buffer pool");
         return -1;
@@ -121,14 +224,42 @@ int zerocopy_init(void)
                          CONTROL_POOL_MAX_BUFFERS,
                          CONTROL_POOL_EXPAND_SIZE,
                          CONTROL_POOL_LOW_WATERMARK,
-                         CONTROL_POOL_HIGH_WATERMARK) < 0)
+                         CONTROL_POOL_HIGH_WATERMARK,
+                         0) < 0)
     {
         logger(LOG_FATAL, "Zero-copy: Failed to initialize control buffer pool");
         buffer_pool_cleanup(&zerocopy_state.pool);
         return -1;
     }
 
+    /* Initialize small and jumbo size classes */
+    if (buffer_pool_init(&zerocopy_state.small_pool,
+                         BUFFER_POOL_SMALL_SIZE,
+                         SMALL_POOL_INITIAL_SIZE,
+                         SMALL_POOL_MAX_BUFFERS,
+                         SMALL_POOL_EXPAND_SIZE,
+                         SMALL_POOL_LOW_WATERMARK,
+                         SMALL_POOL_HIGH_WATERMARK,
+                         0) < 0 ||
+        buffer_pool_init(&zerocopy_state.jumbo_pool,
+                         BUFFER_POOL_JUMBO_SIZE,
+                         JUMBO_POOL_INITIAL_SIZE,
+                         JUMBO_POOL_MAX_BUFFERS,
+                         JUMBO_POOL_EXPAND_SIZE,
+                         JUMBO_POOL_LOW_WATERMARK,
+                         JUMBO_POOL_HIGH_WATERMARK,
+                         0) < 0)
+    {
+        logger(LOG_FATAL, "Zero-copy: Failed to initialize size class buffer pools");
+        buffer_pool_cleanup(&zerocopy_state.small_pool);
+        buffer_pool_cleanup(&zerocopy_state.control_pool);
+        buffer_pool_cleanup(&zerocopy_state.pool);
+        return -1;
+    }
+
     zerocopy_state.active_streams = 0;
+    zerocopy_state.budget_time = 0;
+    zerocopy_budget_update_stats(budget_bytes, mem_budget_pressure(NULL));
 
     /* Sync initial buffer pool state to shared memory */
     buffer_pool_update_stats(&zerocopy_state.pool);
@@ -146,6 +277,8 @@ void zerocopy_cleanup(void)
 
     buffer_pool_cleanup(&zerocopy_state.pool);
     buffer_pool_cleanup(&zerocopy_state.control_pool);
+    buffer_pool_cleanup(&zerocopy_state.small_pool);
+    buffer_pool_cleanup(&zerocopy_state.jumbo_pool);
     buffer_pool_update_stats(&zerocopy_state.pool);
     buffer_pool_update_stats(&zerocopy_state.control_pool);
     zerocopy_state.initialized = 0;
@@ -187,10 +320,11 @@ int zerocopy_queue_add(zerocopy_queue_t *queue, buffer_ref_t *buf_ref)
 
     uint8_t *base = (uint8_t *)buf_ref->data;
 
-    if (!base || buf_ref->data_offset > BUFFER_POOL_BUFFER_SIZE || buf_ref->data_size > BUFFER_POOL_BUFFER_SIZE - buf_ref->data_offset)
+    size_t capacity = buffer_ref_capacity(buf_ref);
+    if (!base || buf_ref->data_offset > capacity || buf_ref->data_size > capacity - buf_ref->data_offset)
     {
         logger(LOG_ERROR, "zerocopy_queue_add: Invalid buffer parameters (offset=%zu len=%zu size=%zu)",
-               buf_ref->data_offset, buf_ref->data_size, BUFFER_POOL_BUFFER_SIZE);
+               buf_ref->data_offset, buf_ref->data_size, capacity);
         return -1;
     }
 
@@ -272,6 +406,62 @@ int zerocopy_queue_add_file(zerocopy_queue_t *queue, int file_fd, off_t file_off
     return 0;
 }
 
+int zerocopy_queue_add_pipe(zerocopy_queue_t *queue, int pipe_fd, size_t len)
+{
+    if (pipe_fd < 0 || len == 0)
+        return -1;
+
+    /* Same pipe drains in order, so a pending tail entry simply grows */
+    if (queue->tail && queue->tail->type == BUFFER_TYPE_PIPE)
+    {
+        queue->tail->file_size += len;
+        queue->total_bytes += len;
+        return 0;
+    }
+
+    buffer_ref_t *buf_ref = calloc(1, sizeof(buffer_ref_t));
+    if (!buf_ref)
+    {
+        logger(LOG_ERROR, "zerocopy_queue_add_pipe: Failed to allocate buffer_ref");
+        return -1;
+    }
+
+    /* Private descriptor: the entry stays valid if the producer closes its pipe */
+    int fd = fcntl(pipe_fd, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        logger(LOG_ERROR, "zerocopy_queue_add_pipe: dup failed: %s", strerror(errno));
+        free(buf_ref);
+        return -1;
+    }
+
+    buf_ref->type = BUFFER_TYPE_PIPE;
+    buf_ref->file_fd = fd;
+    buf_ref->file_offset = 0;
+    buf_ref->file_size = len;
+    buf_ref->file_sent = 0;
+    buf_ref->refcount = 1;
+    buf_ref->segment = NULL;
+    buf_ref->zerocopy_id = 0;
+    buf_ref->send_next = NULL;
+
+    if (queue->tail)
+    {
+        queue->tail->send_next = buf_ref;
+        queue->tail = buf_ref;
+    }
+    else
+    {
+        queue->head = queue->tail = buf_ref;
+    }
+
+    /* Unlike files, pipe bytes take part in batching like RTP payloads */
+    queue->total_bytes += len;
+    queue->num_queued++;
+
+    return 0;
+}
+
 int zerocopy_should_flush(zerocopy_queue_t *queue)
 {
     if (!queue || !queue->head)
@@ -348,6 +538,48 @@ int zerocopy_send(int fd, zerocopy_queue_t *queue, size_t *bytes_sent)
         return 0;
     }
 
+    /* Pipe data (RTSP passthrough) goes out with splice() */
+    if (queue->head->type == BUFFER_TYPE_PIPE)
+    {
+        buffer_ref_t *pipe_buf = queue->head;
+        size_t remaining = pipe_buf->file_size - pipe_buf->file_sent;
+
+        ssize_t sent = splice(pipe_buf->file_fd, NULL, fd, NULL, remaining,
+                              SPLICE_F_NONBLOCK | SPLICE_F_MOVE);
+        if (sent < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                WORKER_STATS_INC(eagain_count);
+                *bytes_sent = 0;
+                return -2; /* Would block */
+            }
+
+            logger(LOG_ERROR, "Zero-copy: splice failed: %s", strerror(errno));
+            *bytes_sent = 0;
+            return -1;
+        }
+
+        *bytes_sent = (size_t)sent;
+        pipe_buf->file_sent += sent;
+        queue->total_bytes -= sent;
+
+        if (pipe_buf->file_sent >= pipe_buf->file_size)
+        {
+            queue->head = pipe_buf->send_next;
+            if (!queue->head)
+                queue->tail = NULL;
+            queue->num_queued--;
+
+            /* Closes our duplicate of the pipe read end */
+            buffer_ref_put(pipe_buf);
+        }
+
+        WORKER_STATS_INC(total_sends);
+
+        return 0;
+    }
+
     /* Build iovec array from queue buffers (memory buffers only) */
     struct iovec iovecs[ZEROCOPY_MAX_IOVECS];
     buffer_ref_t *buffers[ZEROCOPY_MAX_IOVECS];
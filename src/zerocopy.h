@@ -22,6 +22,13 @@
 /* Batching configuration - accumulate small packets before sending */
 #define ZEROCOPY_BATCH_BYTES 65536 /* Send when accumulated >= 64KB */
 
+/* Automatic pool sizing (buffer-pool-max-size = auto) */
+#define ZEROCOPY_BUDGET_PERCENT 25           /* Share of available memory for the media pools of all workers */
+#define ZEROCOPY_BUDGET_INTERVAL_MS 5000     /* How often the budget is recomputed */
+#define ZEROCOPY_BUDGET_PRESSURE 1000        /* Memory PSI some avg10 (1/100 %) that halves the pool limit */
+#define ZEROCOPY_BUDGET_FALLBACK 16384       /* Limit when available memory cannot be determined */
+#define ZEROCOPY_BUDGET_MAX_BUFFERS 1048576  /* Upper bound of the limit */
+
 /**
  * Zero-copy send queue for a connection
  */
@@ -45,7 +52,10 @@ typedef struct zerocopy_state_s
 {
     buffer_pool_t pool;         /* Global buffer pool */
     buffer_pool_t control_pool; /* Dedicated pool for status/API control plane */
+    buffer_pool_t small_pool;   /* BUFFER_POOL_SMALL_SIZE class */
+    buffer_pool_t jumbo_pool;   /* BUFFER_POOL_JUMBO_SIZE class */
     size_t active_streams;      /* Number of active media streaming clients */
+    int64_t budget_time;        /* Last automatic pool sizing (ms) */
     int initialized;            /* Whether initialized */
 } zerocopy_state_t;
 
@@ -65,6 +75,15 @@ int zerocopy_init(void);
  */
 void zerocopy_cleanup(void);
 
+/**
+ * Resize the media pool to this worker's share of available memory
+ * Runs every ZEROCOPY_BUDGET_INTERVAL_MS when buffer-pool-max-size is auto.
+ * Memory pressure halves the limit and frees idle segments; the limit then
+ * grows back by a quarter per interval.
+ * @param now Current time in milliseconds
+ */
+void zerocopy_budget_tick(int64_t now);
+
 /**
  * Initialize zero-copy queue for a connection
  * @param queue Queue to initialize
@@ -99,6 +118,18 @@ int zerocopy_queue_add(zerocopy_queue_t *queue, buffer_ref_t *buf_ref);
  */
 int zerocopy_queue_add_file(zerocopy_queue_t *queue, int file_fd, off_t file_offset, size_t file_size);
 
+/**
+ * Queue bytes already written into a pipe for send using splice()
+ * Extends the tail entry if it is a pipe entry, otherwise duplicates pipe_fd
+ * into a new entry, so the caller keeps ownership of its pipe. Pipe data must
+ * be queued in the order it was written and only through one queue.
+ * @param queue Send queue
+ * @param pipe_fd Read end of the pipe (non-blocking)
+ * @param len Number of bytes written into the pipe
+ * @return 0 on success, -1 on error
+ */
+int zerocopy_queue_add_pipe(zerocopy_queue_t *queue, int pipe_fd, size_t len);
+
 /**
  * Send queued data using zero-copy techniques
  * @param fd Socket file descriptor
@@ -0,0 +1,254 @@
+/*
+ * Buffer pool alloc/free cost and dTLB misses under many clients
+ *
+ * Models a worker fanning packets out to N clients: each client keeps a
+ * send queue of DEPTH buffers; per packet one buffer is allocated and
+ * filled (the receive) and the client's oldest one is read and released
+ * (the send). The buffers in flight span tens of megabytes, so with 4 KiB
+ * pages most buffers sit on their own TLB entry. Each run is done with
+ * the media pool on regular pages, on huge pages, and with malloc/free
+ * per packet for reference.
+ *
+ * dTLB load misses and page faults come from perf_event_open(); on
+ * systems without hardware counters (most VMs, perf_event_paranoid > 2)
+ * the miss column reads n/a.
+ *
+ * Usage: bench_buffer_pool [clients, default 500] [queue depth, default 64]
+ *                          [packets per client, default 2000]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "buffer_pool.h"
+#include "zerocopy.h"
+#include "rtp2httpd.h"
+#include "status.h"
+
+zerocopy_state_t zerocopy_state;
+status_shared_t *status_shared = NULL;
+int worker_id = -1;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+#define BENCH_MODE_POOL 0
+#define BENCH_MODE_POOL_HUGE 1
+#define BENCH_MODE_MALLOC 2
+
+static const char *mode_names[] = {"pool, 4 KiB pages", "pool, huge pages", "malloc/free"};
+
+/* Mostly 7-packet RTP payloads, some control output, a few jumbo frames */
+static size_t packet_size(unsigned int n)
+{
+    unsigned int r = n % 64;
+    return r < 52 ? 1316 : r < 62 ? 200 : 4000;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void counter_start(int fd)
+{
+    if (fd >= 0)
+    {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static long long counter_stop(int fd)
+{
+    long long value = -1;
+
+    if (fd >= 0)
+    {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        if (read(fd, &value, sizeof(value)) != sizeof(value))
+            value = -1;
+    }
+    return value;
+}
+
+/* Anonymous memory of the process backed by transparent huge pages */
+static long anon_huge_kb(void)
+{
+    char line[128];
+    long kb = -1;
+    FILE *f = fopen("/proc/self/smaps_rollup", "r");
+
+    if (!f)
+        return -1;
+    while (fgets(line, sizeof(line), f))
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1)
+            break;
+    fclose(f);
+    return kb;
+}
+
+static void pools_init(int huge_pages, size_t max_buffers)
+{
+    memset(&zerocopy_state, 0, sizeof(zerocopy_state));
+    buffer_pool_init(&zerocopy_state.pool, BUFFER_POOL_BUFFER_SIZE, BUFFER_POOL_INITIAL_SIZE, max_buffers,
+                     BUFFER_POOL_EXPAND_SIZE, BUFFER_POOL_LOW_WATERMARK, BUFFER_POOL_HIGH_WATERMARK, huge_pages);
+    buffer_pool_init(&zerocopy_state.small_pool, BUFFER_POOL_SMALL_SIZE, SMALL_POOL_INITIAL_SIZE,
+                     max_buffers, SMALL_POOL_EXPAND_SIZE, SMALL_POOL_LOW_WATERMARK, SMALL_POOL_HIGH_WATERMARK, 0);
+    buffer_pool_init(&zerocopy_state.jumbo_pool, BUFFER_POOL_JUMBO_SIZE, JUMBO_POOL_INITIAL_SIZE, max_buffers,
+                     JUMBO_POOL_EXPAND_SIZE, JUMBO_POOL_LOW_WATERMARK, JUMBO_POOL_HIGH_WATERMARK, 0);
+}
+
+static void pools_cleanup(void)
+{
+    buffer_pool_cleanup(&zerocopy_state.pool);
+    buffer_pool_cleanup(&zerocopy_state.small_pool);
+    buffer_pool_cleanup(&zerocopy_state.jumbo_pool);
+}
+
+static void *packet_alloc(int mode, size_t size, void **data)
+{
+    if (mode == BENCH_MODE_MALLOC)
+        return *data = malloc(size);
+
+    buffer_ref_t *ref = buffer_pool_alloc_size(size);
+    *data = ref ? ref->data : NULL;
+    return ref;
+}
+
+static void packet_free(int mode, void *handle)
+{
+    if (mode == BENCH_MODE_MALLOC)
+        free(handle);
+    else
+        buffer_ref_put(handle);
+}
+
+static void run(int mode, int clients, int depth, int packets)
+{
+    size_t slots = (size_t)clients * (size_t)depth;
+    void **handles = calloc(slots, sizeof(void *));
+    void **datas = calloc(slots, sizeof(void *));
+    size_t *sizes = calloc(slots, sizeof(size_t));
+    int tlb_fd = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    int fault_fd = counter_open(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    unsigned long checksum = 0;
+    unsigned int n = 0;
+    long long ops = 0;
+    int c, p, i;
+
+    if (!handles || !datas || !sizes)
+        exit(1);
+
+    if (mode != BENCH_MODE_MALLOC)
+        pools_init(mode == BENCH_MODE_POOL_HUGE, slots + BUFFER_POOL_INITIAL_SIZE);
+
+    /* Fill the queues first so the timed loop runs at steady state */
+    for (i = 0; i < (int)slots; i++)
+    {
+        sizes[i] = packet_size(n++);
+        handles[i] = packet_alloc(mode, sizes[i], &datas[i]);
+        if (!handles[i])
+        {
+            fprintf(stderr, "allocation failed\n");
+            exit(1);
+        }
+        memset(datas[i], (int)i, sizes[i]);
+    }
+
+    counter_start(tlb_fd);
+    counter_start(fault_fd);
+    double start = now_sec();
+
+    for (p = 0; p < packets; p++)
+    {
+        int slot_in_queue = p % depth;
+        for (c = 0; c < clients; c++)
+        {
+            size_t slot = (size_t)c * (size_t)depth + (size_t)slot_in_queue;
+            const uint8_t *old = datas[slot];
+
+            /* Send the oldest: read it through, then release it */
+            for (size_t off = 0; off < sizes[slot]; off += 64)
+                checksum += old[off];
+            packet_free(mode, handles[slot]);
+
+            /* Receive the next one into a fresh buffer */
+            sizes[slot] = packet_size(n++);
+            handles[slot] = packet_alloc(mode, sizes[slot], &datas[slot]);
+            if (!handles[slot])
+            {
+                fprintf(stderr, "allocation failed\n");
+                exit(1);
+            }
+            memset(datas[slot], (int)n, sizes[slot]);
+            ops++;
+        }
+    }
+
+    double elapsed = now_sec() - start;
+    long long tlb_misses = counter_stop(tlb_fd);
+    long long faults = counter_stop(fault_fd);
+
+    char tlb[32];
+    if (tlb_misses >= 0)
+        snprintf(tlb, sizeof(tlb), "%.3f", (double)tlb_misses / (double)ops);
+    else
+        snprintf(tlb, sizeof(tlb), "n/a");
+
+    printf("  %-20s %7.1f ns/packet  dTLB misses/packet %-6s  page faults %-6lld  huge pages %ld KiB (%lu)\n",
+           mode_names[mode], elapsed * 1e9 / (double)ops, tlb, faults, anon_huge_kb(), checksum & 0xFF);
+
+    for (i = 0; i < (int)slots; i++)
+        packet_free(mode, handles[i]);
+    if (mode != BENCH_MODE_MALLOC)
+        pools_cleanup();
+    if (tlb_fd >= 0)
+        close(tlb_fd);
+    if (fault_fd >= 0)
+        close(fault_fd);
+    free(handles);
+    free(datas);
+    free(sizes);
+}
+
+int main(int argc, char *argv[])
+{
+    int clients = argc > 1 ? atoi(argv[1]) : 500;
+    int depth = argc > 2 ? atoi(argv[2]) : 64;
+    int packets = argc > 3 ? atoi(argv[3]) : 2000;
+
+    if (clients <= 0 || depth <= 0 || packets <= 0)
+        return 1;
+
+    printf("%d clients, %d buffers queued each, %d packets per client\n", clients, depth, packets);
+    run(BENCH_MODE_POOL, clients, depth, packets);
+    run(BENCH_MODE_POOL_HUGE, clients, depth, packets);
+    run(BENCH_MODE_MALLOC, clients, depth, packets);
+    return 0;
+}
@@ -0,0 +1,228 @@
+/*
+ * HTTP request parsing cost
+ *
+ * Parses typical requests with http_parse_request() and with the parser
+ * it replaced, which searched each line with strstr() and memmove()d the
+ * buffer down after every line (condensed below). Each request is parsed
+ * as received in one read and as received in small segments, where the
+ * parser is called after every segment (slow clients, small MSS).
+ *
+ * Usage: bench_http [requests per case, default 200000]
+ */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "http.h"
+#include "connection.h"
+#include "rtp2httpd.h"
+
+config_t config;
+
+int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int connection_queue_output_and_flush(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+#define BENCH_SEGMENT_SIZE 64
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* The previous parser without body handling, extracting the same headers
+ * as the current one; needs a NUL after the received data */
+static void shifting_copy_header(char *dst, size_t size, const char *value)
+{
+    strncpy(dst, value, size - 1);
+    dst[size - 1] = '\0';
+}
+
+static int shifting_parse_request(char *inbuf, int *in_len, http_request_t *req)
+{
+    if (req->parse_state == HTTP_PARSE_REQ_LINE)
+    {
+        char *line_end = strstr(inbuf, "\r\n");
+        if (!line_end)
+            return 0;
+
+        size_t line_len = (size_t)(line_end - inbuf) + 2;
+        *line_end = '\0';
+
+        char *sp1 = strchr(inbuf, ' ');
+        if (sp1)
+        {
+            *sp1 = '\0';
+            shifting_copy_header(req->method, sizeof(req->method), inbuf);
+            char *sp2 = strchr(sp1 + 1, ' ');
+            if (sp2)
+            {
+                *sp2 = '\0';
+                shifting_copy_header(req->url, sizeof(req->url), sp1 + 1);
+            }
+        }
+
+        memmove(inbuf, inbuf + line_len, *in_len - (int)line_len + 1);
+        *in_len -= (int)line_len;
+        req->parse_state = HTTP_PARSE_HEADERS;
+    }
+
+    for (;;)
+    {
+        char *line_end = strstr(inbuf, "\r\n");
+        if (!line_end)
+            return 0;
+
+        size_t line_len = (size_t)(line_end - inbuf) + 2;
+        if (line_len == 2)
+        {
+            memmove(inbuf, inbuf + 2, *in_len - 2 + 1);
+            *in_len -= 2;
+            req->parse_state = HTTP_PARSE_COMPLETE;
+            return 1;
+        }
+
+        *line_end = '\0';
+        char *colon = strchr(inbuf, ':');
+        if (colon)
+        {
+            *colon = '\0';
+            char *value = colon + 1;
+            while (*value == ' ' || *value == '\t')
+                value++;
+            char *value_end = value + strlen(value);
+            while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t'))
+                *--value_end = '\0';
+
+            if (strcasecmp(inbuf, "Host") == 0)
+                shifting_copy_header(req->hostname, sizeof(req->hostname), value);
+            else if (strcasecmp(inbuf, "User-Agent") == 0)
+                shifting_copy_header(req->user_agent, sizeof(req->user_agent), value);
+            else if (strcasecmp(inbuf, "Accept") == 0)
+                shifting_copy_header(req->accept, sizeof(req->accept), value);
+            else if (strcasecmp(inbuf, "If-None-Match") == 0)
+                shifting_copy_header(req->if_none_match, sizeof(req->if_none_match), value);
+            else if (strcasecmp(inbuf, "X-Request-Snapshot") == 0)
+                req->x_request_snapshot = (value[0] == '1');
+            else if (strcasecmp(inbuf, "X-Forwarded-For") == 0)
+                shifting_copy_header(req->x_forwarded_for, sizeof(req->x_forwarded_for), value);
+            else if (strcasecmp(inbuf, "Content-Length") == 0)
+                req->content_length = atoi(value);
+            else if (strcasecmp(inbuf, "Connection") == 0)
+                req->keepalive = strcasestr(value, "close") == NULL;
+        }
+
+        memmove(inbuf, inbuf + line_len, *in_len - (int)line_len + 1);
+        *in_len -= (int)line_len;
+    }
+}
+
+/* A media player opening a stream */
+static const char player_request[] = "GET /rtp/239.1.1.1:5000?fcc=10.0.0.1:8027 HTTP/1.1\r\n"
+                                     "Host: iptv.lan:5140\r\n"
+                                     "User-Agent: VLC/3.0.20 LibVLC/3.0.20\r\n"
+                                     "Range: bytes=0-\r\n"
+                                     "Connection: close\r\n"
+                                     "Icy-MetaData: 1\r\n"
+                                     "\r\n";
+
+/* A browser loading the status page */
+static const char browser_request[] =
+    "GET /status HTTP/1.1\r\n"
+    "Host: iptv.lan:5140\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: max-age=0\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"128\", \"Not;A=Brand\";v=\"24\", \"Google Chrome\";v=\"128\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "sec-ch-ua-platform: \"Windows\"\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) "
+    "Chrome/128.0.0.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,image/apng,*/*;"
+    "q=0.8,application/signed-exchange;v=b3;q=0.7\r\n"
+    "Sec-Fetch-Site: none\r\n"
+    "Sec-Fetch-Mode: navigate\r\n"
+    "Sec-Fetch-User: ?1\r\n"
+    "Sec-Fetch-Dest: document\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-US,en;q=0.9,zh-CN;q=0.8,zh;q=0.7\r\n"
+    "If-None-Match: \"5f3c-18e2a\"\r\n"
+    "\r\n";
+
+static void bench(const char *name, int shifting, const char *request, size_t segment, int rounds)
+{
+    static char inbuf[INBUF_SIZE + 1];
+    http_request_t req;
+    size_t len = strlen(request);
+    long calls = 0;
+    int i;
+
+    double start = now_sec();
+    for (i = 0; i < rounds; i++)
+    {
+        size_t sent = 0;
+        int in_len = 0;
+        int ret = 0;
+
+        http_request_init(&req);
+        while (ret == 0 && sent < len)
+        {
+            size_t n = len - sent < segment ? len - sent : segment;
+            memcpy(inbuf + in_len, request + sent, n);
+            in_len += (int)n;
+            inbuf[in_len] = '\0';
+            sent += n;
+            ret = shifting ? shifting_parse_request(inbuf, &in_len, &req) : http_parse_request(inbuf, &in_len, &req);
+            calls++;
+        }
+        if (ret != 1 || req.hostname[0] == '\0')
+        {
+            fprintf(stderr, "%s: parse failed\n", name);
+            exit(1);
+        }
+    }
+    double elapsed = now_sec() - start;
+
+    printf("  %-36s %8.1f ns/request  (%.1f calls each)\n", name, elapsed * 1e9 / rounds,
+           (double)calls / rounds);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 200000;
+
+    if (rounds <= 0)
+        return 1;
+
+    printf("Player request (%zu bytes), %d requests per case\n", strlen(player_request), rounds);
+    bench("one read", 0, player_request, INBUF_SIZE, rounds);
+    bench("one read, shifting parser", 1, player_request, INBUF_SIZE, rounds);
+    bench("64-byte segments", 0, player_request, BENCH_SEGMENT_SIZE, rounds);
+    bench("64-byte segments, shifting parser", 1, player_request, BENCH_SEGMENT_SIZE, rounds);
+
+    printf("Browser request (%zu bytes), %d requests per case\n", strlen(browser_request), rounds);
+    bench("one read", 0, browser_request, INBUF_SIZE, rounds);
+    bench("one read, shifting parser", 1, browser_request, INBUF_SIZE, rounds);
+    bench("64-byte segments", 0, browser_request, BENCH_SEGMENT_SIZE, rounds);
+    bench("64-byte segments, shifting parser", 1, browser_request, BENCH_SEGMENT_SIZE, rounds);
+    return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Service lookup and playlist load cost with many services
+ *
+ * Loads N services the way the M3U loader does (unique name check, then
+ * append) and routes lookups over them, once through the name index
+ * (service_register / service_find) and once with the list walks they
+ * replaced: strcmp() over the global list per lookup, and a walk to the
+ * tail per append. Lookups alternate between configured names, spread
+ * over the whole list, and unknown names (404s, which walk it all).
+ *
+ * Usage: bench_service [services, default 2000] [lookups, default 1000000]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "service.h"
+#include "connection.h"
+#include "rtp2httpd.h"
+
+config_t config;
+service_t *services = NULL;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int connection_queue_output_and_flush(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static service_t *list_find(const char *name)
+{
+    service_t *service;
+
+    for (service = services; service; service = service->next)
+    {
+        if (service->url && strcmp(name, service->url) == 0)
+            return service;
+    }
+    return NULL;
+}
+
+static void list_append(service_t *service)
+{
+    service_t **tail = &services;
+
+    while (*tail)
+        tail = &(*tail)->next;
+    service->next = NULL;
+    *tail = service;
+}
+
+/* Channel names as found in IPTV playlists */
+static void channel_name(char *buf, size_t size, int n)
+{
+    snprintf(buf, size, "%s-%d HD", n % 3 == 0 ? "CCTV" : n % 3 == 1 ? "Satellite" : "Local", n);
+}
+
+static void free_services(void)
+{
+    while (services)
+    {
+        service_t *next = services->next;
+        service_free(services);
+        services = next;
+    }
+    service_index_reset();
+}
+
+/* Lookup names are formatted up front so only the lookup is timed */
+static char (*known)[64];
+static char (*unknown)[64];
+
+static void run(int indexed, int count, int lookups)
+{
+    service_t *(*find)(const char *) = indexed ? service_find : list_find;
+    char name[64];
+    long found = 0;
+    int i;
+
+    double start = now_sec();
+    for (i = 0; i < count; i++)
+    {
+        service_t *service = calloc(1, sizeof(*service));
+        channel_name(name, sizeof(name), i);
+        if (!service || find(name))
+            exit(1);
+        service->url = strdup(name);
+        service->service_type = SERVICE_MRTP;
+        if (indexed)
+            service_register(service);
+        else
+            list_append(service);
+    }
+    double load = now_sec() - start;
+
+    start = now_sec();
+    for (i = 0; i < lookups; i++)
+    {
+        int n = (int)(((unsigned int)i * 2654435761u) % (unsigned int)count);
+        if (find(i & 1 ? unknown[n] : known[n]))
+            found++;
+    }
+    double route = now_sec() - start;
+
+    printf("  %-14s load %9.2f ms  lookup %8.1f ns  (%ld found)\n", indexed ? "name index" : "list walk",
+           load * 1e3, route * 1e9 / lookups, found);
+    free_services();
+}
+
+int main(int argc, char *argv[])
+{
+    int count = argc > 1 ? atoi(argv[1]) : 2000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 1000000;
+    int i;
+
+    if (count <= 0 || lookups <= 0)
+        return 1;
+
+    known = calloc((size_t)count, sizeof(*known));
+    unknown = calloc((size_t)count, sizeof(*unknown));
+    if (!known || !unknown)
+        return 1;
+    for (i = 0; i < count; i++)
+    {
+        channel_name(known[i], sizeof(known[i]), i);
+        snprintf(unknown[i], sizeof(unknown[i]), "Unknown-%d", i);
+    }
+
+    printf("%d services, %d lookups (half of them unknown names)\n", count, lookups);
+    run(1, count, lookups);
+    run(0, count, lookups);
+    free(known);
+    free(unknown);
+    return 0;
+}
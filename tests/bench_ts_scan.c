@@ -0,0 +1,129 @@
+/*
+ * ts_scan throughput
+ *
+ * Start code search over start-code free data (the whole buffer is
+ * scanned) and over an elementary stream with a NAL unit every 1 KiB,
+ * against the byte-by-byte loop it replaced; then packet classification
+ * of 7-packet RTP payloads. bench_ts_scan_scalar is the same program
+ * built with TS_SCAN_SCALAR, so the SIMD gain is the ratio of the two.
+ *
+ * Usage: bench_ts_scan [MiB scanned per case, default 1024]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ts_scan.h"
+
+#define BENCH_BUF_SIZE (1024 * 1024)
+#define BENCH_NAL_SPACING 1024
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int byte_loop_start_code(const uint8_t *data, size_t len)
+{
+    size_t i;
+    for (i = 0; i + 3 <= len; i++)
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+            return (int)i;
+    return -1;
+}
+
+/* Walk every start code of buf; returns how many were found */
+static long count_start_codes(int (*find)(const uint8_t *, size_t), const uint8_t *buf, size_t len)
+{
+    size_t pos = 0;
+    long count = 0;
+
+    for (;;)
+    {
+        int off = find(buf + pos, len - pos);
+        if (off < 0)
+            return count;
+        count++;
+        pos += (size_t)off + 3;
+    }
+}
+
+static void bench_start_codes(const char *name, int (*find)(const uint8_t *, size_t), const uint8_t *buf,
+                              int rounds)
+{
+    double start = now_sec();
+    long found = 0;
+    int i;
+
+    for (i = 0; i < rounds; i++)
+        found += count_start_codes(find, buf, BENCH_BUF_SIZE);
+
+    double elapsed = now_sec() - start;
+    printf("  %-28s %8.2f GB/s  (%ld start codes)\n", name,
+           (double)BENCH_BUF_SIZE * rounds / elapsed / 1e9, found);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 1024;
+    uint8_t *plain = malloc(BENCH_BUF_SIZE);
+    uint8_t *es = malloc(BENCH_BUF_SIZE);
+    uint8_t *ts = malloc(7 * TS_PACKET_SIZE);
+    ts_scan_packet_t pkts[TS_SCAN_BATCH];
+    unsigned int seed = 1;
+    size_t i;
+
+    if (!plain || !es || !ts || rounds <= 0)
+        return 1;
+
+    /* Compressed video looks random; keep bytes above 1 so only planted
+     * start codes count */
+    for (i = 0; i < BENCH_BUF_SIZE; i++)
+        plain[i] = (uint8_t)(2 + rand_r(&seed) % 254);
+    memcpy(es, plain, BENCH_BUF_SIZE);
+    for (i = 0; i + 4 <= BENCH_BUF_SIZE; i += BENCH_NAL_SPACING)
+        memcpy(es + i, "\x00\x00\x01\x41", 4);
+
+#if defined(TS_SCAN_SCALAR)
+    printf("ts_scan_start_code (scalar build), %d MiB per case\n", rounds);
+#else
+    printf("ts_scan_start_code (SIMD build where available), %d MiB per case\n", rounds);
+#endif
+    bench_start_codes("no start codes", ts_scan_start_code, plain, rounds);
+    bench_start_codes("no start codes, byte loop", byte_loop_start_code, plain, rounds);
+    bench_start_codes("NAL every 1 KiB", ts_scan_start_code, es, rounds);
+    bench_start_codes("NAL every 1 KiB, byte loop", byte_loop_start_code, es, rounds);
+
+    /* One RTP payload: a video PES start and six continuation packets */
+    for (i = 0; i < 7; i++)
+    {
+        uint8_t *p = ts + i * TS_PACKET_SIZE;
+        memcpy(p, plain + i * TS_PACKET_SIZE, TS_PACKET_SIZE);
+        p[0] = TS_SYNC_BYTE;
+        p[1] = (uint8_t)(i == 0 ? 0x41 : 0x01);
+        p[2] = 0x00;
+        p[3] = (uint8_t)(0x10 | i);
+        if (i == 0)
+            memcpy(p + 4, "\x00\x00\x01\xE0\x00\x00\x80\x80\x05", 9);
+    }
+
+    long payloads = (long)rounds * (BENCH_BUF_SIZE / (7 * TS_PACKET_SIZE));
+    long classified = 0;
+    double start = now_sec();
+    for (long n = 0; n < payloads; n++)
+    {
+        size_t consumed;
+        classified += ts_scan_packets(ts, 7 * TS_PACKET_SIZE, pkts, TS_SCAN_BATCH, &consumed);
+        __asm__ __volatile__("" : : "r"(pkts) : "memory");
+    }
+    double elapsed = now_sec() - start;
+    printf("ts_scan_packets\n  %-28s %8.1f M packets/s (%.2f GB/s)\n", "7-packet payloads",
+           (double)classified / elapsed / 1e6, (double)classified * TS_PACKET_SIZE / elapsed / 1e9);
+
+    free(plain);
+    free(es);
+    free(ts);
+    return 0;
+}
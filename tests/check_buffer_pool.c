@@ -0,0 +1,468 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "buffer_pool.h"
+#include "zerocopy.h"
+#include "rtp2httpd.h"
+#include "status.h"
+
+/* What buffer_pool.c uses from the rest of the server */
+zerocopy_state_t zerocopy_state;
+status_shared_t *status_shared = NULL;
+int worker_id = -1;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+/* The size classes as zerocopy_init() sets them up */
+static void setup_size_classes(void)
+{
+    memset(&zerocopy_state, 0, sizeof(zerocopy_state));
+    ck_assert_int_eq(buffer_pool_init(&zerocopy_state.pool, BUFFER_POOL_BUFFER_SIZE, BUFFER_POOL_INITIAL_SIZE,
+                                      BUFFER_POOL_INITIAL_SIZE * 4, BUFFER_POOL_EXPAND_SIZE,
+                                      BUFFER_POOL_LOW_WATERMARK, BUFFER_POOL_HIGH_WATERMARK, 0),
+                     0);
+    ck_assert_int_eq(buffer_pool_init(&zerocopy_state.control_pool, BUFFER_POOL_BUFFER_SIZE,
+                                      CONTROL_POOL_INITIAL_SIZE, CONTROL_POOL_MAX_BUFFERS, CONTROL_POOL_EXPAND_SIZE,
+                                      CONTROL_POOL_LOW_WATERMARK, CONTROL_POOL_HIGH_WATERMARK, 0),
+                     0);
+    ck_assert_int_eq(buffer_pool_init(&zerocopy_state.small_pool, BUFFER_POOL_SMALL_SIZE, SMALL_POOL_INITIAL_SIZE,
+                                      SMALL_POOL_MAX_BUFFERS, SMALL_POOL_EXPAND_SIZE, SMALL_POOL_LOW_WATERMARK,
+                                      SMALL_POOL_HIGH_WATERMARK, 0),
+                     0);
+    ck_assert_int_eq(buffer_pool_init(&zerocopy_state.jumbo_pool, BUFFER_POOL_JUMBO_SIZE, JUMBO_POOL_INITIAL_SIZE,
+                                      JUMBO_POOL_MAX_BUFFERS, JUMBO_POOL_EXPAND_SIZE, JUMBO_POOL_LOW_WATERMARK,
+                                      JUMBO_POOL_HIGH_WATERMARK, 0),
+                     0);
+}
+
+static void teardown_size_classes(void)
+{
+    buffer_pool_cleanup(&zerocopy_state.pool);
+    buffer_pool_cleanup(&zerocopy_state.control_pool);
+    buffer_pool_cleanup(&zerocopy_state.small_pool);
+    buffer_pool_cleanup(&zerocopy_state.jumbo_pool);
+}
+
+/* Allocate size bytes and check the class it landed in by its capacity */
+static void check_class(size_t size, size_t expected_capacity)
+{
+    buffer_ref_t *ref = buffer_pool_alloc_size(size);
+
+    ck_assert_ptr_nonnull(ref);
+    ck_assert_uint_eq(buffer_ref_capacity(ref), expected_capacity);
+    ck_assert_uint_ge(buffer_ref_capacity(ref), size);
+    memset(ref->data, 0xA5, buffer_ref_capacity(ref));
+    buffer_ref_put(ref);
+}
+
+START_TEST(test_capacity_small_class)
+{
+    check_class(1, BUFFER_POOL_SMALL_SIZE);
+    check_class(BUFFER_POOL_SMALL_SIZE, BUFFER_POOL_SMALL_SIZE);
+}
+END_TEST
+
+START_TEST(test_capacity_media_class)
+{
+    check_class(BUFFER_POOL_SMALL_SIZE + 1, BUFFER_POOL_BUFFER_SIZE);
+    check_class(1316, BUFFER_POOL_BUFFER_SIZE);
+    check_class(BUFFER_POOL_BUFFER_SIZE, BUFFER_POOL_BUFFER_SIZE);
+}
+END_TEST
+
+START_TEST(test_capacity_jumbo_class)
+{
+    check_class(BUFFER_POOL_BUFFER_SIZE + 1, BUFFER_POOL_JUMBO_SIZE);
+    check_class(BUFFER_POOL_JUMBO_SIZE, BUFFER_POOL_JUMBO_SIZE);
+    ck_assert_ptr_null(buffer_pool_alloc_size(BUFFER_POOL_JUMBO_SIZE + 1));
+}
+END_TEST
+
+START_TEST(test_capacity_control_pool)
+{
+    buffer_ref_t *ref = buffer_pool_alloc_control();
+
+    ck_assert_ptr_nonnull(ref);
+    ck_assert_uint_eq(buffer_ref_capacity(ref), BUFFER_POOL_BUFFER_SIZE);
+    buffer_ref_put(ref);
+}
+END_TEST
+
+START_TEST(test_capacity_small_falls_back_to_media)
+{
+    buffer_ref_t *held[SMALL_POOL_MAX_BUFFERS];
+    buffer_ref_t *ref;
+    size_t i;
+
+    for (i = 0; i < SMALL_POOL_MAX_BUFFERS; i++)
+    {
+        held[i] = buffer_pool_alloc_from(&zerocopy_state.small_pool);
+        ck_assert_ptr_nonnull(held[i]);
+    }
+    ck_assert_ptr_null(buffer_pool_alloc_from(&zerocopy_state.small_pool));
+
+    ref = buffer_pool_alloc_size(64);
+    ck_assert_ptr_nonnull(ref);
+    ck_assert_uint_eq(buffer_ref_capacity(ref), BUFFER_POOL_BUFFER_SIZE);
+    buffer_ref_put(ref);
+
+    for (i = 0; i < SMALL_POOL_MAX_BUFFERS; i++)
+        buffer_ref_put(held[i]);
+}
+END_TEST
+
+START_TEST(test_capacity_not_memory)
+{
+    buffer_ref_t file_ref;
+
+    memset(&file_ref, 0, sizeof(file_ref));
+    file_ref.type = BUFFER_TYPE_FILE;
+    file_ref.file_fd = -1;
+    ck_assert_uint_eq(buffer_ref_capacity(&file_ref), 0);
+
+    file_ref.type = BUFFER_TYPE_PIPE;
+    ck_assert_uint_eq(buffer_ref_capacity(&file_ref), 0);
+
+    ck_assert_uint_eq(buffer_ref_capacity(NULL), 0);
+}
+END_TEST
+
+START_TEST(test_capacity_huge_page_segments)
+{
+    buffer_pool_t pool;
+    buffer_ref_t *ref;
+
+    /* Huge page backed (or the heap fallback): same buffer size, whole pages filled */
+    ck_assert_int_eq(buffer_pool_init(&pool, BUFFER_POOL_BUFFER_SIZE, 16, 4096, 16, 0, 4096, 1), 0);
+    ck_assert_uint_ge(pool.num_buffers, 16);
+    ref = buffer_pool_alloc_from(&pool);
+    ck_assert_ptr_nonnull(ref);
+    ck_assert_uint_eq(buffer_ref_capacity(ref), BUFFER_POOL_BUFFER_SIZE);
+    buffer_ref_put(ref);
+    buffer_pool_cleanup(&pool);
+}
+END_TEST
+
+/* Segment behaviour on a small pool: 8 buffers per segment, at most 64 */
+#define SEG_BUFFERS 8
+#define SEG_MAX 64
+#define SEG_HIGH_WATERMARK 4
+
+static buffer_pool_t *seg_pool;
+
+static void setup_segments(void)
+{
+    memset(&zerocopy_state, 0, sizeof(zerocopy_state));
+    /* The jumbo pool, as buffer_pool_try_shrink() keeps no minimum for it */
+    seg_pool = &zerocopy_state.jumbo_pool;
+    ck_assert_int_eq(buffer_pool_init(seg_pool, 128, 0, SEG_MAX, SEG_BUFFERS, 0, SEG_HIGH_WATERMARK, 0), 0);
+}
+
+static void teardown_segments(void)
+{
+    buffer_pool_cleanup(seg_pool);
+}
+
+static int segment_count(const buffer_pool_t *pool)
+{
+    int n = 0;
+    for (const buffer_pool_segment_t *seg = pool->segments; seg; seg = seg->next)
+        n++;
+    return n;
+}
+
+static int ref_in_segment(const buffer_ref_t *ref, const buffer_pool_segment_t *seg)
+{
+    return ref >= seg->refs && ref < seg->refs + seg->num_buffers;
+}
+
+/* Counters agree with the free lists, and the available list holds
+ * exactly the segments with free buffers */
+static void check_bookkeeping(const buffer_pool_t *pool)
+{
+    size_t total = 0, free_total = 0;
+    int with_free = 0, avail = 0;
+
+    for (const buffer_pool_segment_t *seg = pool->segments; seg; seg = seg->next)
+    {
+        size_t listed = 0;
+        for (const buffer_ref_t *ref = seg->free_list; ref; ref = ref->free_next)
+        {
+            ck_assert(ref_in_segment(ref, seg));
+            listed++;
+        }
+        ck_assert_uint_eq(listed, seg->num_free);
+        total += seg->num_buffers;
+        free_total += seg->num_free;
+        if (seg->num_free > 0)
+            with_free++;
+    }
+
+    for (const buffer_pool_segment_t *seg = pool->avail; seg; seg = seg->avail_next)
+    {
+        ck_assert_uint_gt(seg->num_free, 0);
+        ck_assert_ptr_eq(seg->avail_next ? seg->avail_next->avail_prev : pool->avail_tail, seg);
+        avail++;
+    }
+
+    ck_assert_uint_eq(total, pool->num_buffers);
+    ck_assert_uint_eq(free_total, pool->num_free);
+    ck_assert_int_eq(avail, with_free);
+}
+
+START_TEST(test_segment_free_lists)
+{
+    buffer_ref_t *refs[SEG_BUFFERS + 1];
+    int i;
+
+    for (i = 0; i < SEG_BUFFERS + 1; i++)
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+    ck_assert_int_eq(segment_count(seg_pool), 2);
+    ck_assert_ptr_ne(refs[0]->segment, refs[SEG_BUFFERS]->segment);
+
+    /* Handed out in address order within a segment */
+    for (i = 1; i < SEG_BUFFERS; i++)
+        ck_assert_ptr_eq(refs[i]->data, (uint8_t *)refs[i - 1]->data + 128);
+
+    /* A freed buffer goes back to its own segment's list */
+    buffer_pool_segment_t *first = refs[3]->segment;
+    buffer_ref_put(refs[3]);
+    ck_assert_ptr_eq(first->free_list, refs[3]);
+    ck_assert_uint_eq(first->num_free, 1);
+    check_bookkeeping(seg_pool);
+
+    for (i = 0; i < SEG_BUFFERS + 1; i++)
+        if (i != 3)
+            buffer_ref_put(refs[i]);
+    check_bookkeeping(seg_pool);
+}
+END_TEST
+
+START_TEST(test_avail_list_order)
+{
+    buffer_ref_t *refs[2 * SEG_BUFFERS + 1];
+    int i;
+
+    for (i = 0; i < 2 * SEG_BUFFERS + 1; i++)
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+
+    buffer_pool_segment_t *a = refs[0]->segment;
+    buffer_pool_segment_t *b = refs[SEG_BUFFERS]->segment;
+    buffer_pool_segment_t *c = refs[2 * SEG_BUFFERS]->segment;
+
+    /* Full segments leave the list; the newest one is the only entry */
+    ck_assert_ptr_eq(seg_pool->avail, c);
+    ck_assert_ptr_eq(seg_pool->avail_tail, c);
+
+    /* A segment getting a buffer back goes first, ahead of the new one */
+    buffer_ref_put(refs[5]);
+    ck_assert_ptr_eq(seg_pool->avail, a);
+    ck_assert_ptr_eq(seg_pool->avail_tail, c);
+    buffer_ref_put(refs[SEG_BUFFERS + 2]);
+    ck_assert_ptr_eq(seg_pool->avail, b);
+    ck_assert_ptr_eq(b->avail_next, a);
+    check_bookkeeping(seg_pool);
+
+    /* Allocation drains the head first */
+    refs[SEG_BUFFERS + 2] = buffer_pool_alloc_from(seg_pool);
+    ck_assert_ptr_eq(refs[SEG_BUFFERS + 2]->segment, b);
+    refs[5] = buffer_pool_alloc_from(seg_pool);
+    ck_assert_ptr_eq(refs[5]->segment, a);
+    ck_assert_ptr_eq(seg_pool->avail, c);
+    check_bookkeeping(seg_pool);
+
+    for (i = 0; i < 2 * SEG_BUFFERS + 1; i++)
+        buffer_ref_put(refs[i]);
+    check_bookkeeping(seg_pool);
+}
+END_TEST
+
+START_TEST(test_num_free_bookkeeping)
+{
+    buffer_ref_t *held[SEG_MAX];
+    unsigned int seed = 7;
+    int count = 0;
+    int round;
+
+    memset(held, 0, sizeof(held));
+    for (round = 0; round < 5000; round++)
+    {
+        int slot = rand_r(&seed) % SEG_MAX;
+        if (held[slot])
+        {
+            buffer_ref_put(held[slot]);
+            held[slot] = NULL;
+            count--;
+        }
+        else
+        {
+            held[slot] = buffer_pool_alloc_from(seg_pool);
+            ck_assert_ptr_nonnull(held[slot]);
+            count++;
+        }
+        ck_assert_uint_eq(seg_pool->num_buffers - seg_pool->num_free, (size_t)count);
+        if (round % 97 == 0)
+            check_bookkeeping(seg_pool);
+    }
+    check_bookkeeping(seg_pool);
+
+    for (round = 0; round < SEG_MAX; round++)
+        buffer_ref_put(held[round]);
+    ck_assert_uint_eq(seg_pool->num_free, seg_pool->num_buffers);
+}
+END_TEST
+
+START_TEST(test_alloc_free_across_segments)
+{
+    buffer_ref_t *refs[SEG_MAX];
+    int i;
+
+    for (i = 0; i < SEG_MAX; i++)
+    {
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+        ck_assert_ptr_nonnull(refs[i]);
+        ck_assert(ref_in_segment(refs[i], refs[i]->segment));
+    }
+    ck_assert_int_eq(segment_count(seg_pool), SEG_MAX / SEG_BUFFERS);
+    ck_assert_uint_eq(seg_pool->num_free, 0);
+    ck_assert_ptr_null(seg_pool->avail);
+
+    /* At the maximum: no more buffers */
+    ck_assert_ptr_null(buffer_pool_alloc_from(seg_pool));
+
+    /* Free with a stride so every release lands in a different segment */
+    for (i = 0; i < SEG_MAX; i++)
+    {
+        int idx = (i * SEG_BUFFERS) % SEG_MAX + (i * SEG_BUFFERS) / SEG_MAX;
+        buffer_ref_put(refs[idx]);
+    }
+    check_bookkeeping(seg_pool);
+    ck_assert_uint_eq(seg_pool->num_free, SEG_MAX);
+    for (const buffer_pool_segment_t *seg = seg_pool->segments; seg; seg = seg->next)
+        ck_assert_uint_eq(seg->num_free, seg->num_buffers);
+}
+END_TEST
+
+START_TEST(test_idle_segment_release)
+{
+    buffer_ref_t *refs[SEG_MAX];
+    int i;
+
+    for (i = 0; i < SEG_MAX; i++)
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+
+    /* Keep one buffer of the third segment in use */
+    buffer_ref_t *kept = refs[2 * SEG_BUFFERS + 1];
+    for (i = 0; i < SEG_MAX; i++)
+        if (refs[i] != kept)
+            buffer_ref_put(refs[i]);
+
+    /* Recent demand (the peak of 64) keeps everything */
+    buffer_pool_try_shrink();
+    ck_assert_uint_eq(seg_pool->num_buffers, SEG_MAX);
+
+    /* Once demand has decayed, idle segments go down to the high watermark;
+     * the one with a buffer in use stays */
+    seg_pool->demand_time_us -= 8 * BUFFER_POOL_DEMAND_HALF_LIFE_US;
+    buffer_pool_try_shrink();
+    ck_assert_uint_le(seg_pool->num_free, SEG_HIGH_WATERMARK + SEG_BUFFERS);
+    ck_assert_uint_lt(seg_pool->num_buffers, SEG_MAX);
+    ck_assert(ref_in_segment(kept, kept->segment));
+    int found = 0;
+    for (const buffer_pool_segment_t *seg = seg_pool->segments; seg; seg = seg->next)
+        if (seg == kept->segment)
+            found = 1;
+    ck_assert(found);
+    check_bookkeeping(seg_pool);
+
+    buffer_ref_put(kept);
+    check_bookkeeping(seg_pool);
+}
+END_TEST
+
+START_TEST(test_demand_decay)
+{
+    buffer_ref_t *refs[SEG_MAX];
+    int i;
+
+    for (i = 0; i < 40; i++)
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+    ck_assert_uint_eq(seg_pool->demand, 40);
+
+    /* Back to 4 in use: the peak stays until half-lives pass */
+    for (i = 4; i < 40; i++)
+        buffer_ref_put(refs[i]);
+    buffer_pool_try_shrink();
+    ck_assert_uint_eq(seg_pool->demand, 40);
+
+    seg_pool->demand_time_us -= BUFFER_POOL_DEMAND_HALF_LIFE_US;
+    buffer_pool_try_shrink();
+    ck_assert_uint_eq(seg_pool->demand, 20);
+
+    /* Never below what is in use now */
+    seg_pool->demand_time_us -= 10 * BUFFER_POOL_DEMAND_HALF_LIFE_US;
+    buffer_pool_try_shrink();
+    ck_assert_uint_eq(seg_pool->demand, 4);
+
+    /* A new burst raises it at once */
+    for (i = 4; i < 30; i++)
+        refs[i] = buffer_pool_alloc_from(seg_pool);
+    ck_assert_uint_eq(seg_pool->demand, 30);
+
+    for (i = 0; i < 30; i++)
+        buffer_ref_put(refs[i]);
+}
+END_TEST
+
+Suite *buffer_pool_suite(void)
+{
+    Suite *s;
+    TCase *tc_capacity;
+    TCase *tc_segments;
+
+    s = suite_create("Buffer Pool");
+
+    tc_capacity = tcase_create("Capacity");
+    tcase_add_checked_fixture(tc_capacity, setup_size_classes, teardown_size_classes);
+    tcase_add_test(tc_capacity, test_capacity_small_class);
+    tcase_add_test(tc_capacity, test_capacity_media_class);
+    tcase_add_test(tc_capacity, test_capacity_jumbo_class);
+    tcase_add_test(tc_capacity, test_capacity_control_pool);
+    tcase_add_test(tc_capacity, test_capacity_small_falls_back_to_media);
+    tcase_add_test(tc_capacity, test_capacity_not_memory);
+    tcase_add_test(tc_capacity, test_capacity_huge_page_segments);
+    suite_add_tcase(s, tc_capacity);
+
+    tc_segments = tcase_create("Segments");
+    tcase_add_checked_fixture(tc_segments, setup_segments, teardown_segments);
+    tcase_add_test(tc_segments, test_segment_free_lists);
+    tcase_add_test(tc_segments, test_avail_list_order);
+    tcase_add_test(tc_segments, test_num_free_bookkeeping);
+    tcase_add_test(tc_segments, test_alloc_free_across_segments);
+    tcase_add_test(tc_segments, test_idle_segment_release);
+    tcase_add_test(tc_segments, test_demand_decay);
+    suite_add_tcase(s, tc_segments);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = buffer_pool_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
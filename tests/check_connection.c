@@ -0,0 +1,593 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "connection.h"
+#include "buffer_pool.h"
+#include "epg.h"
+#include "handoff.h"
+#include "m3u.h"
+#include "service.h"
+#include "snapshot_cache.h"
+#include "status.h"
+#include "stream.h"
+#include "thumbnail.h"
+#include "timeshift.h"
+#include "worker.h"
+#include "zerocopy.h"
+#include "rtp2httpd.h"
+
+/*
+ * Request handling of a persistent connection: connection_handle_read()
+ * reads from one end of a socket pair and routes every complete request.
+ * The status page and log level handlers record what was routed; media
+ * routes and responses are not exercised (the buffer pool is empty).
+ */
+
+/* Globals and functions connection.c takes from the server */
+config_t config;
+status_shared_t *status_shared = NULL;
+int worker_id = -1;
+zerocopy_state_t zerocopy_state;
+
+#define MAX_ROUTED 8
+
+static char routed[MAX_ROUTED][HTTP_URL_BUFFER_SIZE];
+static char routed_body[MAX_ROUTED][1024];
+static int routed_count;
+
+static void record(connection_t *c)
+{
+    ck_assert_int_lt(routed_count, MAX_ROUTED);
+    snprintf(routed[routed_count], sizeof(routed[0]), "%s %s", c->http_req.method, c->http_req.url);
+    snprintf(routed_body[routed_count], sizeof(routed_body[0]), "%s", c->http_req.body);
+    routed_count++;
+}
+
+void handle_status_page(connection_t *c)
+{
+    record(c);
+}
+
+void handle_set_log_level(connection_t *c)
+{
+    record(c);
+}
+
+void handle_player_page(connection_t *c)
+{
+    (void)c;
+}
+
+void handle_disconnect_client(connection_t *c)
+{
+    (void)c;
+}
+
+int status_handle_sse_init(connection_t *c)
+{
+    (void)c;
+    return -1;
+}
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+int64_t get_time_ms(void)
+{
+    return 0;
+}
+
+char *get_server_address(void)
+{
+    return NULL;
+}
+
+buffer_ref_t *buffer_pool_alloc(void)
+{
+    return NULL;
+}
+
+buffer_ref_t *buffer_pool_alloc_control(void)
+{
+    return NULL;
+}
+
+buffer_ref_t *buffer_pool_alloc_from(buffer_pool_t *pool)
+{
+    (void)pool;
+    return NULL;
+}
+
+void buffer_pool_try_shrink(void)
+{
+}
+
+size_t buffer_ref_capacity(const buffer_ref_t *ref)
+{
+    (void)ref;
+    return 0;
+}
+
+void buffer_ref_put(buffer_ref_t *ref)
+{
+    (void)ref;
+}
+
+int epg_get_data_fd(int *fd, size_t *size, int *is_gzipped)
+{
+    (void)fd;
+    (void)size;
+    (void)is_gzipped;
+    return -1;
+}
+
+int handoff_send(connection_t *c, int target)
+{
+    (void)c;
+    (void)target;
+    return -1;
+}
+
+int handoff_target_worker(const service_t *service)
+{
+    (void)service;
+    return -1;
+}
+
+const char *m3u_get_transformed_playlist(void)
+{
+    return NULL;
+}
+
+service_t *service_clone(const service_t *service)
+{
+    (void)service;
+    return NULL;
+}
+
+service_t *service_create_from_udpxy_url(char *url)
+{
+    (void)url;
+    return NULL;
+}
+
+service_t *service_create_with_query_merge(const service_t *configured_service, const char *request_url,
+                                           service_type_t expected_type)
+{
+    (void)configured_service;
+    (void)request_url;
+    (void)expected_type;
+    return NULL;
+}
+
+service_t *service_find(const char *name)
+{
+    (void)name;
+    return NULL;
+}
+
+void service_free(service_t *service)
+{
+    (void)service;
+}
+
+int snapshot_cache_request(connection_t *c, const service_t *service, int can_wait, snapshot_cache_entry_t **entry)
+{
+    (void)c;
+    (void)service;
+    (void)can_wait;
+    (void)entry;
+    return -1;
+}
+
+void snapshot_cache_attach(snapshot_cache_entry_t *entry, snapshot_context_t *ctx)
+{
+    (void)entry;
+    (void)ctx;
+}
+
+void snapshot_cache_abandon(snapshot_cache_entry_t *entry)
+{
+    (void)entry;
+}
+
+int status_register_client(const char *client_addr_str, const char *service_url)
+{
+    (void)client_addr_str;
+    (void)service_url;
+    return -1;
+}
+
+void status_unregister_client(int status_index)
+{
+    (void)status_index;
+}
+
+void status_update_client_queue(int status_index, size_t queue_bytes, size_t queue_buffers,
+                                size_t queue_limit_bytes, size_t queue_bytes_highwater,
+                                size_t queue_buffers_highwater, uint64_t dropped_packets, uint64_t dropped_bytes,
+                                uint32_t backpressure_events, int slow_active)
+{
+    (void)status_index;
+    (void)queue_bytes;
+    (void)queue_buffers;
+    (void)queue_limit_bytes;
+    (void)queue_bytes_highwater;
+    (void)queue_buffers_highwater;
+    (void)dropped_packets;
+    (void)dropped_bytes;
+    (void)backpressure_events;
+    (void)slow_active;
+}
+
+int stream_context_cleanup(stream_context_t *ctx)
+{
+    (void)ctx;
+    return 0;
+}
+
+int stream_context_init_for_worker(stream_context_t *ctx, connection_t *conn, service_t *service, int epoll_fd,
+                                   int status_index, int is_snapshot)
+{
+    (void)ctx;
+    (void)conn;
+    (void)service;
+    (void)epoll_fd;
+    (void)status_index;
+    (void)is_snapshot;
+    return -1;
+}
+
+size_t stream_context_memory(const stream_context_t *ctx)
+{
+    (void)ctx;
+    return 0;
+}
+
+void stream_context_release(stream_context_t *ctx)
+{
+    (void)ctx;
+}
+
+int thumbnail_handle_request(connection_t *c, const char *query)
+{
+    (void)c;
+    (void)query;
+    return -1;
+}
+
+int timeshift_continue(connection_t *c)
+{
+    (void)c;
+    return 0;
+}
+
+int timeshift_serve(connection_t *c, const service_t *service, const char *service_name)
+{
+    (void)c;
+    (void)service;
+    (void)service_name;
+    return -1;
+}
+
+size_t zerocopy_active_streams(void)
+{
+    return 0;
+}
+
+int zerocopy_queue_add(zerocopy_queue_t *queue, buffer_ref_t *buf_ref)
+{
+    (void)queue;
+    (void)buf_ref;
+    return -1;
+}
+
+int zerocopy_queue_add_file(zerocopy_queue_t *queue, int file_fd, off_t file_offset, size_t file_size)
+{
+    (void)queue;
+    (void)file_fd;
+    (void)file_offset;
+    (void)file_size;
+    return -1;
+}
+
+int zerocopy_queue_add_pipe(zerocopy_queue_t *queue, int pipe_fd, size_t len)
+{
+    (void)queue;
+    (void)pipe_fd;
+    (void)len;
+    return -1;
+}
+
+void zerocopy_queue_cleanup(zerocopy_queue_t *queue)
+{
+    (void)queue;
+}
+
+void zerocopy_queue_init(zerocopy_queue_t *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+void zerocopy_register_stream_client(void)
+{
+}
+
+void zerocopy_unregister_stream_client(void)
+{
+}
+
+int zerocopy_send(int fd, zerocopy_queue_t *queue, size_t *bytes_sent)
+{
+    (void)fd;
+    (void)queue;
+    (void)bytes_sent;
+    return 0;
+}
+
+int zerocopy_should_flush(zerocopy_queue_t *queue)
+{
+    (void)queue;
+    return 0;
+}
+
+static connection_t *conn;
+static int peer;
+
+static void setup(void)
+{
+    int fds[2];
+
+    memset(&config, 0, sizeof(config));
+    config.http_keepalive_timeout = 15;
+    config.http_keepalive_max = 100;
+    routed_count = 0;
+
+    ck_assert_int_eq(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds), 0);
+    conn = connection_create(fds[0], -1, NULL, 0);
+    ck_assert_ptr_nonnull(conn);
+    peer = fds[1];
+}
+
+static void teardown(void)
+{
+    connection_free(conn);
+    close(peer);
+}
+
+/* Send data from the client and let the connection read it once */
+static void receive(const char *data)
+{
+    size_t len = strlen(data);
+
+    ck_assert_int_eq(write(peer, data, len), (ssize_t)len);
+    connection_handle_read(conn);
+}
+
+static const char status_request[] = "GET /status HTTP/1.1\r\nHost: a\r\n\r\n";
+
+START_TEST(test_single_request)
+{
+    receive(status_request);
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_str_eq(routed[0], "GET /status");
+
+    /* Ready for the next request on the same connection */
+    ck_assert_int_eq(conn->state, CONN_READ_REQ_LINE);
+    ck_assert_int_eq(conn->requests_served, 1);
+    ck_assert_int_eq(conn->in_len, 0);
+    ck_assert_int_eq(conn->http_req.parse_state, HTTP_PARSE_REQ_LINE);
+}
+END_TEST
+
+START_TEST(test_pipelined_in_one_read)
+{
+    receive("GET /status HTTP/1.1\r\nHost: a\r\n\r\n"
+            "GET /status/?view=2 HTTP/1.1\r\nHost: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 2);
+    ck_assert_str_eq(routed[0], "GET /status");
+    ck_assert_str_eq(routed[1], "GET /status/?view=2");
+    ck_assert_int_eq(conn->state, CONN_READ_REQ_LINE);
+    ck_assert_int_eq(conn->requests_served, 2);
+    ck_assert_int_eq(conn->in_len, 0);
+}
+END_TEST
+
+START_TEST(test_pipelined_partial_second)
+{
+    /* The second request is completed by the next read */
+    receive("GET /status HTTP/1.1\r\nHost: a\r\n\r\nGET /status?view=2 HTTP/1.1\r\nHo");
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_int_eq(conn->state, CONN_READ_REQ_LINE);
+    ck_assert_int_eq(conn->in_len, (int)strlen("GET /status?view=2 HTTP/1.1\r\nHo"));
+
+    receive("st: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 2);
+    ck_assert_str_eq(routed[1], "GET /status?view=2");
+    ck_assert_int_eq(conn->requests_served, 2);
+}
+END_TEST
+
+START_TEST(test_split_across_reads)
+{
+    receive("GET /sta");
+    receive("tus HTTP/1.1\r\n");
+    receive("Host: a\r\n\r");
+    ck_assert_int_eq(routed_count, 0);
+    ck_assert_int_eq(conn->state, CONN_READ_REQ_LINE);
+
+    receive("\n");
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_str_eq(routed[0], "GET /status");
+    ck_assert_int_eq(conn->in_len, 0);
+
+    /* And the next one, too */
+    receive("GET /status?view=2 HTTP/1.1\r\n");
+    receive("Host: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 2);
+    ck_assert_int_eq(conn->requests_served, 2);
+}
+END_TEST
+
+START_TEST(test_keepalive_max_requests)
+{
+    config.http_keepalive_max = 3;
+
+    /* The third request is answered, then the connection closes */
+    receive("GET /status?n=1 HTTP/1.1\r\nHost: a\r\n\r\n"
+            "GET /status?n=2 HTTP/1.1\r\nHost: a\r\n\r\n"
+            "GET /status?n=3 HTTP/1.1\r\nHost: a\r\n\r\n"
+            "GET /status?n=4 HTTP/1.1\r\nHost: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 3);
+    ck_assert_str_eq(routed[2], "GET /status?n=3");
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+    ck_assert_int_eq(conn->requests_served, 2);
+}
+END_TEST
+
+START_TEST(test_keepalive_max_one)
+{
+    config.http_keepalive_max = 1;
+
+    receive("GET /status?n=1 HTTP/1.1\r\nHost: a\r\n\r\nGET /status?n=2 HTTP/1.1\r\nHost: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+    ck_assert_int_eq(conn->requests_served, 0);
+}
+END_TEST
+
+START_TEST(test_keepalive_disabled)
+{
+    /* Connection: close, HTTP/1.0, and keep-alive switched off */
+    receive("GET /status HTTP/1.1\r\nHost: a\r\nConnection: close\r\n\r\n"
+            "GET /status?n=2 HTTP/1.1\r\nHost: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+    teardown();
+
+    setup();
+    receive("GET /status HTTP/1.0\r\n\r\nGET /status?n=2 HTTP/1.0\r\n\r\n");
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+    teardown();
+
+    setup();
+    config.http_keepalive_timeout = 0;
+    receive(status_request);
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+}
+END_TEST
+
+START_TEST(test_post_body)
+{
+    receive("POST /status/api/log-level HTTP/1.1\r\nHost: a\r\nContent-Length: 7\r\n\r\nlevel=4"
+            "GET /status HTTP/1.1\r\nHost: a\r\n\r\n");
+    ck_assert_int_eq(routed_count, 2);
+    ck_assert_str_eq(routed[0], "POST /status/api/log-level");
+    ck_assert_str_eq(routed_body[0], "level=4");
+    ck_assert_str_eq(routed[1], "GET /status");
+    ck_assert_int_eq(conn->state, CONN_READ_REQ_LINE);
+}
+END_TEST
+
+START_TEST(test_post_body_too_large)
+{
+    char body[4000 + 1];
+
+    /* The body only partly fits the request: it must not be read as the next request */
+    memset(body, 'b', sizeof(body) - 1);
+    memcpy(body + 2000, "GET /status HTTP/1.1\r\nHost: a\r\n\r\n", 34);
+    body[sizeof(body) - 1] = '\0';
+
+    receive("POST /status/api/log-level HTTP/1.1\r\nHost: a\r\nContent-Length: 4000\r\n\r\n");
+    ck_assert_int_eq(routed_count, 0);
+    receive(body);
+    ck_assert_int_eq(routed_count, 1);
+    ck_assert_str_eq(routed[0], "POST /status/api/log-level");
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+    ck_assert_int_eq(conn->requests_served, 0);
+
+    /* Nothing more is routed from this connection */
+    receive(status_request);
+    ck_assert_int_eq(routed_count, 1);
+}
+END_TEST
+
+START_TEST(test_request_too_large)
+{
+    char header[INBUF_SIZE];
+
+    memset(header, 'a', sizeof(header) - 1);
+    header[sizeof(header) - 1] = '\0';
+    memcpy(header, "X-Long: ", 8);
+
+    receive("GET /status HTTP/1.1\r\n");
+    receive(header);
+    ck_assert_int_eq(routed_count, 0);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+}
+END_TEST
+
+START_TEST(test_peer_closed)
+{
+    receive("GET /status HTTP/1.1\r\n");
+    shutdown(peer, SHUT_WR);
+    connection_handle_read(conn);
+    ck_assert_int_eq(routed_count, 0);
+    ck_assert_int_eq(conn->state, CONN_CLOSING);
+}
+END_TEST
+
+Suite *connection_suite(void)
+{
+    Suite *s;
+    TCase *tc_pipeline;
+    TCase *tc_keepalive;
+
+    s = suite_create("Connection");
+
+    tc_pipeline = tcase_create("Pipelining");
+    tcase_add_checked_fixture(tc_pipeline, setup, teardown);
+    tcase_add_test(tc_pipeline, test_single_request);
+    tcase_add_test(tc_pipeline, test_pipelined_in_one_read);
+    tcase_add_test(tc_pipeline, test_pipelined_partial_second);
+    tcase_add_test(tc_pipeline, test_split_across_reads);
+    tcase_add_test(tc_pipeline, test_post_body);
+    tcase_add_test(tc_pipeline, test_request_too_large);
+    tcase_add_test(tc_pipeline, test_peer_closed);
+    suite_add_tcase(s, tc_pipeline);
+
+    tc_keepalive = tcase_create("Keepalive");
+    tcase_add_checked_fixture(tc_keepalive, setup, teardown);
+    tcase_add_test(tc_keepalive, test_keepalive_max_requests);
+    tcase_add_test(tc_keepalive, test_keepalive_max_one);
+    tcase_add_test(tc_keepalive, test_keepalive_disabled);
+    tcase_add_test(tc_keepalive, test_post_body_too_large);
+    suite_add_tcase(s, tc_keepalive);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = connection_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
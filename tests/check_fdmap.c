@@ -0,0 +1,186 @@
+#include <check.h>
+#include <stdlib.h>
+#include "fdmap.h"
+#include "rtp2httpd.h"
+
+/* Functions fdmap.c takes from the server */
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+/* Only the addresses are compared; the map never dereferences them */
+static connection_t conns[8];
+
+static void setup(void)
+{
+    fdmap_init();
+}
+
+static void teardown(void)
+{
+    fdmap_free();
+}
+
+START_TEST(test_set_get_del)
+{
+    ck_assert_ptr_null(fdmap_get(5));
+
+    fdmap_set(5, &conns[0]);
+    fdmap_set(6, &conns[1]);
+    ck_assert_ptr_eq(fdmap_get(5), &conns[0]);
+    ck_assert_ptr_eq(fdmap_get(6), &conns[1]);
+
+    /* fds are reused after close */
+    fdmap_set(5, &conns[2]);
+    ck_assert_ptr_eq(fdmap_get(5), &conns[2]);
+
+    fdmap_del(5);
+    ck_assert_ptr_null(fdmap_get(5));
+    ck_assert_ptr_eq(fdmap_get(6), &conns[1]);
+    fdmap_del(5);
+    ck_assert_ptr_null(fdmap_get(5));
+}
+END_TEST
+
+START_TEST(test_out_of_range)
+{
+    fdmap_set(-1, &conns[0]);
+    ck_assert_ptr_null(fdmap_get(-1));
+    fdmap_del(-1);
+
+    /* Lookups beyond the table don't grow it or read past it */
+    ck_assert_ptr_null(fdmap_get(FD_MAP_INITIAL_SIZE));
+    ck_assert_ptr_null(fdmap_get(1 << 24));
+    fdmap_del(1 << 24);
+}
+END_TEST
+
+START_TEST(test_above_initial_size)
+{
+    int fd = FD_MAP_INITIAL_SIZE;
+
+    fdmap_set(3, &conns[0]);
+    fdmap_set(FD_MAP_INITIAL_SIZE - 1, &conns[1]);
+    fdmap_set(fd, &conns[2]);
+    ck_assert_ptr_eq(fdmap_get(fd), &conns[2]);
+    ck_assert_ptr_null(fdmap_get(fd + 1));
+
+    /* Entries set before the growth are kept, new slots start empty */
+    ck_assert_ptr_eq(fdmap_get(3), &conns[0]);
+    ck_assert_ptr_eq(fdmap_get(FD_MAP_INITIAL_SIZE - 1), &conns[1]);
+
+    fdmap_del(fd);
+    ck_assert_ptr_null(fdmap_get(fd));
+    ck_assert_ptr_eq(fdmap_get(3), &conns[0]);
+}
+END_TEST
+
+START_TEST(test_growth)
+{
+    int fd;
+
+    /* Several doublings, and one jump far past the current capacity */
+    for (fd = 0; fd < 8 * FD_MAP_INITIAL_SIZE; fd++)
+        fdmap_set(fd, &conns[fd % 8]);
+    fdmap_set(100000, &conns[7]);
+
+    for (fd = 0; fd < 8 * FD_MAP_INITIAL_SIZE; fd++)
+        ck_assert_ptr_eq(fdmap_get(fd), &conns[fd % 8]);
+    ck_assert_ptr_eq(fdmap_get(100000), &conns[7]);
+    for (fd = 8 * FD_MAP_INITIAL_SIZE; fd < 100000; fd++)
+        ck_assert_ptr_null(fdmap_get(fd));
+}
+END_TEST
+
+START_TEST(test_without_init)
+{
+    /* The first set allocates the table */
+    fdmap_free();
+    ck_assert_ptr_null(fdmap_get(0));
+    fdmap_del(0);
+    fdmap_set(0, &conns[0]);
+    fdmap_set(2000, &conns[1]);
+    ck_assert_ptr_eq(fdmap_get(0), &conns[0]);
+    ck_assert_ptr_eq(fdmap_get(2000), &conns[1]);
+}
+END_TEST
+
+/*
+ * The previous map hashed fd & 16383 with linear probing and deleted
+ * entries without tombstones: deleting the first fd of a chain hid every
+ * fd stored after it. Raised RLIMIT_NOFILE makes such fds real.
+ */
+START_TEST(test_delete_inside_collisions)
+{
+    int base = 5;
+    int stride = 16384;
+    int i;
+
+    for (i = 0; i < 4; i++)
+        fdmap_set(base + i * stride, &conns[i]);
+    /* Would have taken the next probe slots */
+    fdmap_set(base + 1, &conns[4]);
+    fdmap_set(base + 2, &conns[5]);
+
+    fdmap_del(base);
+    ck_assert_ptr_null(fdmap_get(base));
+    for (i = 1; i < 4; i++)
+        ck_assert_ptr_eq(fdmap_get(base + i * stride), &conns[i]);
+
+    fdmap_del(base + 2 * stride);
+    ck_assert_ptr_null(fdmap_get(base + 2 * stride));
+    ck_assert_ptr_eq(fdmap_get(base + stride), &conns[1]);
+    ck_assert_ptr_eq(fdmap_get(base + 3 * stride), &conns[3]);
+    ck_assert_ptr_eq(fdmap_get(base + 1), &conns[4]);
+    ck_assert_ptr_eq(fdmap_get(base + 2), &conns[5]);
+
+    /* A deleted slot is reused by the same fd only */
+    fdmap_set(base, &conns[6]);
+    ck_assert_ptr_eq(fdmap_get(base), &conns[6]);
+    ck_assert_ptr_eq(fdmap_get(base + stride), &conns[1]);
+}
+END_TEST
+
+Suite *fdmap_suite(void)
+{
+    Suite *s;
+    TCase *tc_map;
+    TCase *tc_growth;
+
+    s = suite_create("FdMap");
+
+    tc_map = tcase_create("Map");
+    tcase_add_checked_fixture(tc_map, setup, teardown);
+    tcase_add_test(tc_map, test_set_get_del);
+    tcase_add_test(tc_map, test_out_of_range);
+    tcase_add_test(tc_map, test_delete_inside_collisions);
+    suite_add_tcase(s, tc_map);
+
+    tc_growth = tcase_create("Growth");
+    tcase_add_checked_fixture(tc_growth, setup, teardown);
+    tcase_add_test(tc_growth, test_above_initial_size);
+    tcase_add_test(tc_growth, test_growth);
+    tcase_add_test(tc_growth, test_without_init);
+    suite_add_tcase(s, tc_growth);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = fdmap_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
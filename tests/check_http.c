@@ -0,0 +1,271 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "http.h"
+#include "connection.h"
+#include "rtp2httpd.h"
+
+/* Globals and functions http.c takes from the server */
+config_t config;
+
+int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int connection_queue_output_and_flush(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static char inbuf[INBUF_SIZE];
+static int in_len;
+static http_request_t req;
+
+static void setup(void)
+{
+    /* No NUL after the data: the parser must stay within in_len */
+    memset(inbuf, 'X', sizeof(inbuf));
+    in_len = 0;
+    http_request_init(&req);
+}
+
+static void append(const char *data, size_t len)
+{
+    ck_assert_int_le(in_len + (int)len, INBUF_SIZE);
+    memcpy(inbuf + in_len, data, len);
+    in_len += (int)len;
+}
+
+static int feed(const char *data)
+{
+    append(data, strlen(data));
+    return http_parse_request(inbuf, &in_len, &req);
+}
+
+static const char player_request[] = "GET /rtp/239.1.1.1:5000?fcc=10.0.0.1:8027 HTTP/1.1\r\n"
+                                     "Host: iptv.lan:5140\r\n"
+                                     "User-Agent: VLC/3.0.20 LibVLC/3.0.20\r\n"
+                                     "Accept: */*\r\n"
+                                     "Icy-MetaData: 1\r\n"
+                                     "\r\n";
+
+static void check_player_request(void)
+{
+    ck_assert_str_eq(req.method, "GET");
+    ck_assert_str_eq(req.url, "/rtp/239.1.1.1:5000?fcc=10.0.0.1:8027");
+    ck_assert_str_eq(req.hostname, "iptv.lan:5140");
+    ck_assert_str_eq(req.user_agent, "VLC/3.0.20 LibVLC/3.0.20");
+    ck_assert_str_eq(req.accept, "*/*");
+    ck_assert_int_eq(req.keepalive, 1);
+    ck_assert_int_eq(req.parse_state, HTTP_PARSE_COMPLETE);
+}
+
+START_TEST(test_complete_request)
+{
+    ck_assert_int_eq(feed(player_request), 1);
+    check_player_request();
+    ck_assert_int_eq(in_len, 0);
+    ck_assert_int_eq(req.body_len, 0);
+}
+END_TEST
+
+START_TEST(test_byte_by_byte)
+{
+    size_t len = strlen(player_request);
+    size_t i;
+
+    for (i = 0; i + 1 < len; i++)
+    {
+        append(player_request + i, 1);
+        ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), 0);
+        /* Nothing is rescanned on the next call */
+        ck_assert_int_eq(req.scan_offset, in_len);
+    }
+    append(player_request + i, 1);
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), 1);
+    check_player_request();
+    ck_assert_int_eq(in_len, 0);
+}
+END_TEST
+
+START_TEST(test_split_line_ending)
+{
+    ck_assert_int_eq(feed("GET / HTTP/1.1\r"), 0);
+    ck_assert_int_eq(feed("\nHost: a\r"), 0);
+    ck_assert_int_eq(req.parse_state, HTTP_PARSE_HEADERS);
+    ck_assert_int_eq(feed("\n\r"), 0);
+    ck_assert_int_eq(feed("\n"), 1);
+    ck_assert_str_eq(req.url, "/");
+    ck_assert_str_eq(req.hostname, "a");
+}
+END_TEST
+
+START_TEST(test_bare_lf_and_leading_empty_lines)
+{
+    ck_assert_int_eq(feed("\r\n\nGET /status HTTP/1.0\nHost: box\n\n"), 1);
+    ck_assert_str_eq(req.method, "GET");
+    ck_assert_str_eq(req.url, "/status");
+    ck_assert_str_eq(req.hostname, "box");
+    ck_assert_int_eq(req.keepalive, 0); /* HTTP/1.0 default */
+}
+END_TEST
+
+START_TEST(test_header_values)
+{
+    char long_agent[400];
+
+    memset(long_agent, 'a', sizeof(long_agent) - 1);
+    long_agent[sizeof(long_agent) - 1] = '\0';
+
+    feed("GET /playlist.m3u HTTP/1.1\r\n"
+         "hOsT:\t example.com \t\r\n"
+         "x-forwarded-for:  203.0.113.7 , 10.0.0.1\r\n"
+         "X-Request-Snapshot: 1\r\n"
+         "If-None-Match: \"abc\"\r\n"
+         "Not a header line\r\n"
+         "Connection: close\r\n"
+         "User-Agent: ");
+    ck_assert_int_eq(feed(long_agent), 0);
+    ck_assert_int_eq(feed("\r\n\r\n"), 1);
+
+    ck_assert_str_eq(req.hostname, "example.com");
+    ck_assert_str_eq(req.x_forwarded_for, "203.0.113.7");
+    ck_assert_int_eq(req.x_request_snapshot, 1);
+    ck_assert_str_eq(req.if_none_match, "\"abc\"");
+    ck_assert_int_eq(req.keepalive, 0);
+    ck_assert_uint_eq(strlen(req.user_agent), sizeof(req.user_agent) - 1);
+    ck_assert_int_eq(req.user_agent[0], 'a');
+}
+END_TEST
+
+START_TEST(test_pipelined_requests)
+{
+    append(player_request, strlen(player_request));
+    ck_assert_int_eq(feed("GET /second HTTP/1.1\r\nHost: b\r\n"), 1);
+    check_player_request();
+
+    /* The next request is moved to the start of the buffer */
+    ck_assert_int_eq(in_len, (int)strlen("GET /second HTTP/1.1\r\nHost: b\r\n"));
+    ck_assert_int_eq(memcmp(inbuf, "GET /second", 11), 0);
+
+    http_request_init(&req);
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), 0);
+    ck_assert_int_eq(feed("\r\n"), 1);
+    ck_assert_str_eq(req.url, "/second");
+    ck_assert_str_eq(req.hostname, "b");
+    ck_assert_int_eq(in_len, 0);
+}
+END_TEST
+
+START_TEST(test_body)
+{
+    ck_assert_int_eq(feed("POST /api/reload HTTP/1.1\r\nContent-Length: 11\r\n\r\nhello"), 0);
+    ck_assert_int_eq(req.parse_state, HTTP_PARSE_BODY);
+    ck_assert_int_eq(feed(" world"), 1);
+    ck_assert_str_eq(req.method, "POST");
+    ck_assert_int_eq(req.body_len, 11);
+    ck_assert_str_eq(req.body, "hello world");
+    ck_assert_int_eq(in_len, 0);
+
+    /* Bytes after the body stay for the next request */
+    http_request_init(&req);
+    ck_assert_int_eq(feed("POST / HTTP/1.1\r\nContent-Length: 2\r\n\r\nokGET"), 1);
+    ck_assert_str_eq(req.body, "ok");
+    ck_assert_int_eq(in_len, 3);
+    ck_assert_int_eq(memcmp(inbuf, "GET", 3), 0);
+}
+END_TEST
+
+START_TEST(test_body_too_large)
+{
+    char body[2048];
+
+    memset(body, 'b', sizeof(body) - 1);
+    body[sizeof(body) - 1] = '\0';
+
+    ck_assert_int_eq(feed("POST / HTTP/1.1\r\nContent-Length: 2047\r\n\r\n"), 0);
+    ck_assert_int_eq(feed(body), 1);
+    ck_assert_int_eq(req.body_len, (int)sizeof(req.body) - 1);
+    /* The rest of the body is not read: the connection cannot be reused */
+    ck_assert_int_eq(req.keepalive, 0);
+}
+END_TEST
+
+START_TEST(test_stays_within_length)
+{
+    /* The terminating empty line is in memory but not yet received */
+    memcpy(inbuf, "GET / HTTP/1.1\r\nHost: a\r\n\r\n", 27);
+    in_len = 25;
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), 0);
+    ck_assert_int_eq(req.parse_state, HTTP_PARSE_HEADERS);
+
+    in_len = 27;
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), 1);
+    ck_assert_str_eq(req.hostname, "a");
+}
+END_TEST
+
+START_TEST(test_invalid_arguments)
+{
+    ck_assert_int_eq(http_parse_request(NULL, &in_len, &req), -1);
+    ck_assert_int_eq(http_parse_request(inbuf, NULL, &req), -1);
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, NULL), -1);
+
+    /* Progress beyond the data (the buffer was reset under the parser) */
+    ck_assert_int_eq(feed("GET / HTTP/1.1\r\nHo"), 0);
+    in_len = 4;
+    ck_assert_int_eq(http_parse_request(inbuf, &in_len, &req), -1);
+}
+END_TEST
+
+Suite *http_suite(void)
+{
+    Suite *s;
+    TCase *tc_request;
+    TCase *tc_buffer;
+
+    s = suite_create("HTTP");
+
+    tc_request = tcase_create("Request");
+    tcase_add_checked_fixture(tc_request, setup, NULL);
+    tcase_add_test(tc_request, test_complete_request);
+    tcase_add_test(tc_request, test_bare_lf_and_leading_empty_lines);
+    tcase_add_test(tc_request, test_header_values);
+    tcase_add_test(tc_request, test_body);
+    tcase_add_test(tc_request, test_body_too_large);
+    suite_add_tcase(s, tc_request);
+
+    tc_buffer = tcase_create("Incremental");
+    tcase_add_checked_fixture(tc_buffer, setup, NULL);
+    tcase_add_test(tc_buffer, test_byte_by_byte);
+    tcase_add_test(tc_buffer, test_split_line_ending);
+    tcase_add_test(tc_buffer, test_pipelined_requests);
+    tcase_add_test(tc_buffer, test_stays_within_length);
+    tcase_add_test(tc_buffer, test_invalid_arguments);
+    suite_add_tcase(s, tc_buffer);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = http_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
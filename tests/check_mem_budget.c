@@ -0,0 +1,155 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "mem_budget.h"
+
+/*
+ * Each directory under fixtures/mem_budget is a copy of the /proc and
+ * /sys/fs/cgroup files of one setup, passed to mem_budget as the prefix.
+ */
+
+static const char *fixture(const char *name)
+{
+    static char path[1024];
+    const char *srcdir = getenv("SRCDIR");
+
+    snprintf(path, sizeof(path), "%s/fixtures/mem_budget/%s", srcdir ? srcdir : ".", name);
+    return path;
+}
+
+/* MemAvailable of the fixtures' /proc/meminfo */
+#define FIXTURE_MEM_AVAILABLE (4000000ULL * 1024)
+
+START_TEST(test_v2_limited_group)
+{
+    size_t bytes = 0;
+
+    /* memory.max minus memory.current, less inactive_file; the parent is "max" */
+    ck_assert_int_eq(mem_budget_available(fixture("v2_limited"), &bytes), 0);
+    ck_assert_uint_eq(bytes, 268435456ULL - (104857600ULL - 20971520ULL));
+}
+END_TEST
+
+START_TEST(test_v2_unlimited)
+{
+    size_t bytes = 0;
+
+    ck_assert_int_eq(mem_budget_available(fixture("v2_unlimited"), &bytes), 0);
+    ck_assert_uint_eq(bytes, FIXTURE_MEM_AVAILABLE);
+}
+END_TEST
+
+START_TEST(test_v2_namespace_uses_mount_root)
+{
+    size_t bytes = 0;
+
+    ck_assert_int_eq(mem_budget_available(fixture("v2_namespace"), &bytes), 0);
+    ck_assert_uint_eq(bytes, 536870912ULL - 134217728ULL);
+}
+END_TEST
+
+START_TEST(test_v2_full_group_is_zero)
+{
+    size_t bytes = 12345;
+
+    /* Usage above the limit and no meminfo: known, and nothing left */
+    ck_assert_int_eq(mem_budget_available(fixture("v2_full"), &bytes), 0);
+    ck_assert_uint_eq(bytes, 0);
+}
+END_TEST
+
+START_TEST(test_v1_limited_group)
+{
+    size_t bytes = 0;
+
+    /* Hybrid layout: the memory controller line wins over the "0::" one,
+     * total_inactive_file (not inactive_file) is subtracted, and the
+     * ancestors' page-rounded LLONG_MAX means no limit */
+    ck_assert_int_eq(mem_budget_available(fixture("v1_limited"), &bytes), 0);
+    ck_assert_uint_eq(bytes, 536870912ULL - (524288000ULL - 12582912ULL));
+}
+END_TEST
+
+START_TEST(test_v1_unlimited_sentinel)
+{
+    size_t bytes = 0;
+
+    /* The sentinel is no limit, not 8 EiB of headroom; without meminfo
+     * nothing is known */
+    ck_assert_int_eq(mem_budget_available(fixture("v1_unlimited"), &bytes), -1);
+}
+END_TEST
+
+START_TEST(test_nothing_known)
+{
+    size_t bytes = 0;
+
+    ck_assert_int_eq(mem_budget_available(fixture("bare"), &bytes), -1);
+    ck_assert_int_eq(mem_budget_available(fixture("does_not_exist"), &bytes), -1);
+}
+END_TEST
+
+START_TEST(test_pressure_cgroup_file)
+{
+    /* The group's memory.pressure is preferred over the system one */
+    ck_assert_int_eq(mem_budget_pressure(fixture("v2_limited")), 150);
+}
+END_TEST
+
+START_TEST(test_pressure_system_file)
+{
+    /* "some" line only; "full" comes after it */
+    ck_assert_int_eq(mem_budget_pressure(fixture("v2_unlimited")), 1234);
+    ck_assert_int_eq(mem_budget_pressure(fixture("bare")), 0);
+}
+END_TEST
+
+START_TEST(test_pressure_unavailable)
+{
+    ck_assert_int_eq(mem_budget_pressure(fixture("v1_limited")), -1);
+    ck_assert_int_eq(mem_budget_pressure(fixture("does_not_exist")), -1);
+}
+END_TEST
+
+Suite *mem_budget_suite(void)
+{
+    Suite *s;
+    TCase *tc_available;
+    TCase *tc_pressure;
+
+    s = suite_create("Memory Budget");
+
+    tc_available = tcase_create("Available");
+    tcase_add_test(tc_available, test_v2_limited_group);
+    tcase_add_test(tc_available, test_v2_unlimited);
+    tcase_add_test(tc_available, test_v2_namespace_uses_mount_root);
+    tcase_add_test(tc_available, test_v2_full_group_is_zero);
+    tcase_add_test(tc_available, test_v1_limited_group);
+    tcase_add_test(tc_available, test_v1_unlimited_sentinel);
+    tcase_add_test(tc_available, test_nothing_known);
+    suite_add_tcase(s, tc_available);
+
+    tc_pressure = tcase_create("Pressure");
+    tcase_add_test(tc_pressure, test_pressure_cgroup_file);
+    tcase_add_test(tc_pressure, test_pressure_system_file);
+    tcase_add_test(tc_pressure, test_pressure_unavailable);
+    suite_add_tcase(s, tc_pressure);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = mem_budget_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
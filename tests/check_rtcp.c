@@ -0,0 +1,524 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rtcp.h"
+
+/* rtcp.c takes its clocks from the server; the tests drive them */
+static int64_t fake_time_ms;
+static int64_t fake_realtime_ms;
+
+int64_t get_time_ms(void)
+{
+    return fake_time_ms;
+}
+
+int64_t get_realtime_ms(void)
+{
+    return fake_realtime_ms;
+}
+
+/* Seconds between 1900-01-01 (NTP epoch) and 1970-01-01 */
+#define NTP_OFFSET 2208988800u
+
+/* A whole second, so the NTP fraction is zero */
+#define FAKE_REALTIME_SEC 1700000000u
+
+static rtcp_stats_t stats;
+
+static void setup(void)
+{
+    rtcp_stats_init(&stats);
+    fake_time_ms = 1000;
+    fake_realtime_ms = (int64_t)FAKE_REALTIME_SEC * 1000;
+}
+
+static void put_be16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* Middle 32 bits of the fake wall clock as NTP */
+static uint32_t ntp_mid_now(void)
+{
+    return (uint32_t)((fake_realtime_ms / 1000 + NTP_OFFSET) << 16);
+}
+
+static void rtp(uint32_t ssrc, uint16_t seq, uint32_t ts)
+{
+    uint8_t pkt[12 + 188];
+
+    memset(pkt, 0, sizeof(pkt));
+    pkt[0] = 0x80;
+    pkt[1] = 33;
+    put_be16(pkt + 2, seq);
+    put_be32(pkt + 4, ts);
+    put_be32(pkt + 8, ssrc);
+    rtcp_stats_on_rtp(&stats, pkt, sizeof(pkt));
+}
+
+/* RTCP header; length is in bytes */
+static void rtcp_header(uint8_t *p, uint8_t count, uint8_t pt, size_t len, uint32_t ssrc)
+{
+    p[0] = (uint8_t)(0x80 | count);
+    p[1] = pt;
+    put_be16(p + 2, (uint16_t)(len / 4 - 1));
+    put_be32(p + 4, ssrc);
+}
+
+static void report_block(uint8_t *p, uint32_t ssrc, uint32_t lsr, uint32_t dlsr)
+{
+    memset(p, 0, 24);
+    put_be32(p, ssrc);
+    put_be32(p + 16, lsr);
+    put_be32(p + 20, dlsr);
+}
+
+static void summary(uint32_t *jitter_us, uint32_t *lost, uint32_t *expected)
+{
+    rtcp_stats_summary(&stats, jitter_us, lost, expected);
+}
+
+START_TEST(test_no_source)
+{
+    uint32_t jitter_us, lost, expected;
+    uint8_t junk[12] = {0x40, 33};
+
+    /* Not RTP version 2, and too short */
+    rtcp_stats_on_rtp(&stats, junk, sizeof(junk));
+    junk[0] = 0x80;
+    rtcp_stats_on_rtp(&stats, junk, 11);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_int_eq(stats.have_source, 0);
+    ck_assert_uint_eq(expected, 0);
+    ck_assert_uint_eq(lost, 0);
+    ck_assert_int_eq(stats.rtt_ms, -1);
+}
+END_TEST
+
+START_TEST(test_loss_counting)
+{
+    uint32_t jitter_us, lost, expected;
+    uint16_t seq;
+
+    for (seq = 100; seq < 110; seq++)
+        if (seq != 103 && seq != 105)
+            rtp(0x1234, seq, 0);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(stats.received, 8);
+    ck_assert_uint_eq(expected, 10);
+    ck_assert_uint_eq(lost, 2);
+}
+END_TEST
+
+START_TEST(test_sequence_wrap)
+{
+    uint32_t jitter_us, lost, expected;
+    uint16_t seq = 65530;
+    int i;
+
+    /* 65530..65535, then 0..5 with 2 missing */
+    for (i = 0; i < 12; i++, seq++)
+        if (seq != 2)
+            rtp(0x1234, seq, 0);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(stats.cycles, 65536);
+    ck_assert_uint_eq(stats.max_seq, 5);
+    ck_assert_uint_eq(expected, 12);
+    ck_assert_uint_eq(lost, 1);
+}
+END_TEST
+
+START_TEST(test_reordered_and_duplicate)
+{
+    uint32_t jitter_us, lost, expected;
+
+    rtp(0x1234, 10, 0);
+    rtp(0x1234, 12, 0);
+    rtp(0x1234, 11, 0); /* late, does not move max_seq back */
+    rtp(0x1234, 12, 0); /* duplicate */
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(stats.max_seq, 12);
+    ck_assert_uint_eq(stats.cycles, 0);
+    ck_assert_uint_eq(expected, 3);
+    ck_assert_uint_eq(stats.received, 4);
+    ck_assert_uint_eq(lost, 0); /* more received than expected is no loss */
+}
+END_TEST
+
+START_TEST(test_source_restart)
+{
+    uint32_t jitter_us, lost, expected;
+
+    rtp(0x1234, 10, 0);
+    rtp(0x1234, 14, 0);
+
+    /* Jump far beyond the dropout window: the sender restarted */
+    rtp(0x1234, 20000, 0);
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(stats.base_seq, 20000);
+    ck_assert_uint_eq(expected, 1);
+    ck_assert_uint_eq(lost, 0);
+
+    /* Another SSRC (FCC unicast -> multicast) starts over too */
+    rtp(0x5678, 7, 0);
+    rtp(0x5678, 9, 0);
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(stats.ssrc, 0x5678);
+    ck_assert_uint_eq(expected, 3);
+    ck_assert_uint_eq(lost, 1);
+}
+END_TEST
+
+/*
+ * Jitter is taken against the monotonic clock; the packets here arrive
+ * within microseconds of each other (well under one 90 kHz tick), so
+ * the RTP timestamps alone set the transit differences.
+ */
+START_TEST(test_jitter_first_step)
+{
+    uint32_t jitter_us, lost, expected;
+
+    rtp(0x1234, 1, 0);
+    ck_assert_uint_eq(stats.jitter, 0);
+
+    /* 10 ms of timestamp for no arrival time: |D| = 900, J = D/16 */
+    rtp(0x1234, 2, 900);
+    ck_assert_uint_ge(stats.jitter, 899);
+    ck_assert_uint_le(stats.jitter, 901);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_eq(jitter_us, 56 * 1000000 / 90000);
+}
+END_TEST
+
+START_TEST(test_jitter_converges)
+{
+    uint32_t jitter_us, lost, expected;
+    uint16_t seq;
+
+    /* Every packet is 10 ms off: J converges to 10 ms */
+    for (seq = 0; seq < 300; seq++)
+        rtp(0x1234, seq, (uint32_t)seq * 900);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_ge(jitter_us, 9980);
+    ck_assert_uint_le(jitter_us, 10000);
+}
+END_TEST
+
+START_TEST(test_jitter_steady_stream)
+{
+    uint32_t jitter_us, lost, expected;
+    uint16_t seq;
+
+    /* Timestamps advancing with arrival time: no jitter */
+    for (seq = 0; seq < 100; seq++)
+        rtp(0x1234, seq, 0);
+
+    summary(&jitter_us, &lost, &expected);
+    ck_assert_uint_lt(jitter_us, 1000);
+}
+END_TEST
+
+START_TEST(test_jitter_ignores_discontinuity)
+{
+    rtp(0x1234, 1, 0);
+    rtp(0x1234, 2, 900);
+    uint32_t before = stats.jitter;
+
+    /* A 20 s timestamp jump is a discontinuity, not jitter */
+    rtp(0x1234, 3, 900 + 20 * 90000);
+    ck_assert_uint_eq(stats.jitter, before);
+}
+END_TEST
+
+START_TEST(test_not_rtcp)
+{
+    uint8_t pkt[32];
+
+    memset(pkt, 0, sizeof(pkt));
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), -1);
+
+    /* Length beyond the datagram */
+    rtcp_header(pkt, 0, RTCP_PT_RR, 8, 0x1234);
+    put_be16(pkt + 2, 20);
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), -1);
+
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, 3), -1);
+    ck_assert_uint_eq(stats.sender_reports, 0);
+}
+END_TEST
+
+START_TEST(test_sender_report)
+{
+    uint8_t pkt[28 + 12];
+
+    memset(pkt, 0, sizeof(pkt));
+    rtcp_header(pkt, 0, RTCP_PT_SR, 28, 0x1234);
+    put_be32(pkt + 8, 0xAABBCCDD);  /* NTP seconds */
+    put_be32(pkt + 12, 0x11223344); /* NTP fraction */
+    put_be32(pkt + 20, 4242);       /* sender packet count */
+    /* Trailing SDES, parsed as a second packet of the compound */
+    rtcp_header(pkt + 28, 0, RTCP_PT_SDES, 12, 0x1234);
+
+    fake_time_ms = 5000;
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 2);
+    ck_assert_uint_eq(stats.last_sr, 0xCCDD1122);
+    ck_assert_uint_eq(stats.sender_packets, 4242);
+    ck_assert_uint_eq(stats.sender_reports, 1);
+    ck_assert_int_eq(stats.last_sr_time_ms, 5000);
+    ck_assert_int_eq(stats.rtt_ms, -1);
+}
+END_TEST
+
+START_TEST(test_rtt_from_report_block)
+{
+    uint8_t pkt[8 + 2 * 24];
+
+    /* Our RR was sent 1 s ago, the server held it 750 ms: RTT 250 ms */
+    rtcp_header(pkt, 2, RTCP_PT_RR, sizeof(pkt), 0x1234);
+    report_block(pkt + 8, stats.own_ssrc ^ 1, ntp_mid_now() - 65536, 0);
+    report_block(pkt + 32, stats.own_ssrc, ntp_mid_now() - 65536, 65536 * 3 / 4);
+
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, 250);
+}
+END_TEST
+
+START_TEST(test_rtt_from_sender_report_block)
+{
+    uint8_t pkt[28 + 24];
+
+    rtcp_header(pkt, 1, RTCP_PT_SR, sizeof(pkt), 0x1234);
+    memset(pkt + 8, 0, 20);
+    report_block(pkt + 28, stats.own_ssrc, ntp_mid_now() - 65536 / 2, 0);
+
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, 500);
+}
+END_TEST
+
+START_TEST(test_rtt_from_dlrr)
+{
+    uint8_t pkt[8 + 4 + 2 * 12];
+
+    rtcp_header(pkt, 0, RTCP_PT_XR, sizeof(pkt), 0x1234);
+    pkt[8] = 5; /* BT=5 DLRR */
+    pkt[9] = 0;
+    put_be16(pkt + 10, 2 * 3);
+    put_be32(pkt + 12, stats.own_ssrc ^ 1);
+    put_be32(pkt + 16, ntp_mid_now() - 65536);
+    put_be32(pkt + 20, 0);
+    put_be32(pkt + 24, stats.own_ssrc);
+    put_be32(pkt + 28, ntp_mid_now() - 65536 / 4);
+    put_be32(pkt + 32, 65536 / 8);
+
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, 125);
+}
+END_TEST
+
+START_TEST(test_rtt_ignores_bogus_reports)
+{
+    uint8_t pkt[8 + 24];
+
+    /* LSR 0: no SR/RRTR received yet */
+    rtcp_header(pkt, 1, RTCP_PT_RR, sizeof(pkt), 0x1234);
+    report_block(pkt + 8, stats.own_ssrc, 0, 0);
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, -1);
+
+    /* Delay longer than the round trip (clock skew) */
+    report_block(pkt + 8, stats.own_ssrc, ntp_mid_now() - 65536, 2 * 65536);
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, -1);
+
+    /* Report count larger than the packet holds */
+    report_block(pkt + 8, stats.own_ssrc ^ 1, ntp_mid_now() - 65536, 0);
+    pkt[0] = 0x80 | 2;
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, pkt, sizeof(pkt)), 1);
+    ck_assert_int_eq(stats.rtt_ms, -1);
+}
+END_TEST
+
+START_TEST(test_report_without_source)
+{
+    uint8_t buf[RTCP_RR_BUFFER_SIZE];
+    int len = rtcp_build_receiver_report(&stats, buf, sizeof(buf));
+
+    /* RR with no blocks, SDES CNAME "rtp2httpd", XR RRTR */
+    ck_assert_int_eq(len, 8 + 20 + 20);
+    ck_assert_uint_eq(buf[0], 0x80);
+    ck_assert_uint_eq(buf[1], RTCP_PT_RR);
+    ck_assert_uint_eq(get_be32(buf) & 0xFFFF, 1);
+    ck_assert_uint_eq(get_be32(buf + 4), stats.own_ssrc);
+
+    ck_assert_uint_eq(buf[8], 0x81);
+    ck_assert_uint_eq(buf[9], RTCP_PT_SDES);
+    ck_assert_uint_eq(get_be32(buf + 8) & 0xFFFF, 4);
+    ck_assert_uint_eq(get_be32(buf + 12), stats.own_ssrc);
+    ck_assert_uint_eq(buf[16], 1);
+    ck_assert_uint_eq(buf[17], 9);
+    ck_assert_mem_eq(buf + 18, "rtp2httpd\0", 10);
+
+    ck_assert_uint_eq(buf[28], 0x80);
+    ck_assert_uint_eq(buf[29], RTCP_PT_XR);
+    ck_assert_uint_eq(get_be32(buf + 28) & 0xFFFF, 4);
+    ck_assert_uint_eq(buf[36], 4);
+    ck_assert_uint_eq(get_be32(buf + 36) & 0xFFFF, 2);
+    ck_assert_uint_eq(get_be32(buf + 40), FAKE_REALTIME_SEC + NTP_OFFSET);
+    ck_assert_uint_eq(get_be32(buf + 44), 0);
+
+    /* The report parses back as three packets */
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, buf, (size_t)len), 3);
+
+    ck_assert_int_eq(rtcp_build_receiver_report(&stats, buf, (size_t)len - 1), -1);
+}
+END_TEST
+
+START_TEST(test_report_block)
+{
+    uint8_t buf[RTCP_RR_BUFFER_SIZE];
+    uint8_t sr[28];
+    uint16_t seq;
+    int len;
+
+    /* 100 expected, every 4th lost: fraction 64/256 */
+    for (seq = 65500; seq != 64; seq++)
+        if (seq % 4 != 1)
+            rtp(0x1234, seq, 0);
+
+    memset(sr, 0, sizeof(sr));
+    rtcp_header(sr, 0, RTCP_PT_SR, sizeof(sr), 0x1234);
+    put_be32(sr + 8, 0x00010002);
+    put_be32(sr + 12, 0x00030004);
+    fake_time_ms = 1000;
+    ck_assert_int_eq(rtcp_stats_on_rtcp(&stats, sr, sizeof(sr)), 1);
+
+    /* Sent 500 ms after the SR came in */
+    fake_time_ms = 1500;
+    len = rtcp_build_receiver_report(&stats, buf, sizeof(buf));
+    ck_assert_int_eq(len, 8 + 24 + 20 + 20);
+    ck_assert_uint_eq(buf[0], 0x81);
+    ck_assert_uint_eq(get_be32(buf) & 0xFFFF, 7);
+    ck_assert_uint_eq(get_be32(buf + 8), 0x1234);
+    ck_assert_uint_eq(buf[12], 64);
+    ck_assert_uint_eq(get_be32(buf + 12) & 0xFFFFFF, 25);
+    ck_assert_uint_eq(get_be32(buf + 16), 65536 + 63);
+    ck_assert_uint_eq(get_be32(buf + 20), stats.jitter >> 4);
+    ck_assert_uint_eq(get_be32(buf + 24), 0x00020003);
+    ck_assert_uint_eq(get_be32(buf + 28), 65536 / 2);
+    ck_assert_uint_eq(stats.fraction_lost, 64);
+
+    /* Next interval has no loss: the fraction drops, the total stays */
+    for (seq = 64; seq < 164; seq++)
+        rtp(0x1234, seq, 0);
+    len = rtcp_build_receiver_report(&stats, buf, sizeof(buf));
+    ck_assert_int_eq(len, 72);
+    ck_assert_uint_eq(buf[12], 0);
+    ck_assert_uint_eq(get_be32(buf + 12) & 0xFFFFFF, 25);
+
+    /* Nothing received in an interval: no division by zero */
+    len = rtcp_build_receiver_report(&stats, buf, sizeof(buf));
+    ck_assert_int_eq(len, 72);
+    ck_assert_uint_eq(buf[12], 0);
+}
+END_TEST
+
+START_TEST(test_report_negative_loss)
+{
+    uint8_t buf[RTCP_RR_BUFFER_SIZE];
+
+    /* Duplicates: cumulative loss goes negative (24-bit two's complement) */
+    rtp(0x1234, 1, 0);
+    rtp(0x1234, 1, 0);
+    rtp(0x1234, 1, 0);
+    ck_assert_int_eq(rtcp_build_receiver_report(&stats, buf, sizeof(buf)), 72);
+    ck_assert_uint_eq(buf[12], 0);
+    ck_assert_uint_eq(get_be32(buf + 12) & 0xFFFFFF, 0xFFFFFE);
+    /* No SR yet: LSR and DLSR are zero */
+    ck_assert_uint_eq(get_be32(buf + 24), 0);
+    ck_assert_uint_eq(get_be32(buf + 28), 0);
+}
+END_TEST
+
+Suite *rtcp_suite(void)
+{
+    Suite *s;
+    TCase *tc_rtp;
+    TCase *tc_jitter;
+    TCase *tc_rtcp;
+    TCase *tc_report;
+
+    s = suite_create("RTCP");
+
+    tc_rtp = tcase_create("Sequence");
+    tcase_add_checked_fixture(tc_rtp, setup, NULL);
+    tcase_add_test(tc_rtp, test_no_source);
+    tcase_add_test(tc_rtp, test_loss_counting);
+    tcase_add_test(tc_rtp, test_sequence_wrap);
+    tcase_add_test(tc_rtp, test_reordered_and_duplicate);
+    tcase_add_test(tc_rtp, test_source_restart);
+    suite_add_tcase(s, tc_rtp);
+
+    tc_jitter = tcase_create("Jitter");
+    tcase_add_checked_fixture(tc_jitter, setup, NULL);
+    tcase_add_test(tc_jitter, test_jitter_first_step);
+    tcase_add_test(tc_jitter, test_jitter_converges);
+    tcase_add_test(tc_jitter, test_jitter_steady_stream);
+    tcase_add_test(tc_jitter, test_jitter_ignores_discontinuity);
+    suite_add_tcase(s, tc_jitter);
+
+    tc_rtcp = tcase_create("Parse");
+    tcase_add_checked_fixture(tc_rtcp, setup, NULL);
+    tcase_add_test(tc_rtcp, test_not_rtcp);
+    tcase_add_test(tc_rtcp, test_sender_report);
+    tcase_add_test(tc_rtcp, test_rtt_from_report_block);
+    tcase_add_test(tc_rtcp, test_rtt_from_sender_report_block);
+    tcase_add_test(tc_rtcp, test_rtt_from_dlrr);
+    tcase_add_test(tc_rtcp, test_rtt_ignores_bogus_reports);
+    suite_add_tcase(s, tc_rtcp);
+
+    tc_report = tcase_create("Receiver Report");
+    tcase_add_checked_fixture(tc_report, setup, NULL);
+    tcase_add_test(tc_report, test_report_without_source);
+    tcase_add_test(tc_report, test_report_block);
+    tcase_add_test(tc_report, test_report_negative_loss);
+    suite_add_tcase(s, tc_report);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = rtcp_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
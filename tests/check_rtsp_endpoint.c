@@ -0,0 +1,245 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rtsp_endpoint.h"
+#include "rtsp_health.h"
+#include "rtp2httpd.h"
+
+/* Functions rtsp_endpoint.c takes from the server */
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+/* Health scores by "host:port", RTSP_HEALTH_SCORE_UNKNOWN for others */
+#define MAX_SCORES 8
+
+static struct
+{
+    char endpoint[64];
+    int score;
+} scores[MAX_SCORES];
+static int score_count;
+
+int rtsp_health_score(const char *host, int port)
+{
+    char endpoint[64];
+    int i;
+
+    snprintf(endpoint, sizeof(endpoint), "%s:%d", host, port);
+    for (i = 0; i < score_count; i++)
+        if (strcmp(scores[i].endpoint, endpoint) == 0)
+            return scores[i].score;
+    return RTSP_HEALTH_SCORE_UNKNOWN;
+}
+
+static void set_score(const char *endpoint, int score)
+{
+    ck_assert_int_lt(score_count, MAX_SCORES);
+    snprintf(scores[score_count].endpoint, sizeof(scores[0].endpoint), "%s", endpoint);
+    scores[score_count].score = score;
+    score_count++;
+}
+
+static rtsp_session_t session;
+static char list[1024];
+
+static void setup(void)
+{
+    memset(&session, 0, sizeof(session));
+    score_count = 0;
+}
+
+static int parse(const char *endpoints)
+{
+    snprintf(list, sizeof(list), "%s", endpoints);
+    return rtsp_parse_endpoints(list, session.endpoints, &session.endpoint_count);
+}
+
+static void check_endpoint(int index, const char *host, int port)
+{
+    ck_assert_str_eq(session.endpoints[index].host, host);
+    ck_assert_int_eq(session.endpoints[index].port, port);
+}
+
+START_TEST(test_single_endpoint)
+{
+    ck_assert_int_eq(parse("10.0.0.1"), 0);
+    ck_assert_int_eq(session.endpoint_count, 1);
+    check_endpoint(0, "10.0.0.1", 554);
+
+    ck_assert_int_eq(parse("iptv.example.com:8554"), 0);
+    ck_assert_int_eq(session.endpoint_count, 1);
+    check_endpoint(0, "iptv.example.com", 8554);
+
+    /* Empty port: the default */
+    ck_assert_int_eq(parse("10.0.0.1:"), 0);
+    check_endpoint(0, "10.0.0.1", 554);
+}
+END_TEST
+
+START_TEST(test_ipv6)
+{
+    ck_assert_int_eq(parse("[2001:db8::1]"), 0);
+    check_endpoint(0, "2001:db8::1", 554);
+
+    ck_assert_int_eq(parse("[2001:db8::1]:8554"), 0);
+    check_endpoint(0, "2001:db8::1", 8554);
+
+    ck_assert_int_eq(parse("[fe80::1]:1554,10.0.0.2:2554,[::1]"), 0);
+    ck_assert_int_eq(session.endpoint_count, 3);
+    check_endpoint(0, "fe80::1", 1554);
+    check_endpoint(1, "10.0.0.2", 2554);
+    check_endpoint(2, "::1", 554);
+
+    ck_assert_int_eq(parse("[2001:db8::1"), -1);
+    ck_assert_int_eq(parse("10.0.0.1,[2001:db8::1:8554"), -1);
+}
+END_TEST
+
+START_TEST(test_list)
+{
+    ck_assert_int_eq(parse("a.example:1001,b.example,10.0.0.3:1003"), 0);
+    ck_assert_int_eq(session.endpoint_count, 3);
+    check_endpoint(0, "a.example", 1001);
+    check_endpoint(1, "b.example", 554);
+    check_endpoint(2, "10.0.0.3", 1003);
+}
+END_TEST
+
+START_TEST(test_too_many_endpoints)
+{
+    /* Entries beyond RTSP_MAX_ENDPOINTS are ignored, even invalid ones */
+    ck_assert_int_eq(RTSP_MAX_ENDPOINTS, 4);
+    ck_assert_int_eq(parse("h1:1,h2:2,h3:3,h4:4,h5:5,,[bad"), 0);
+    ck_assert_int_eq(session.endpoint_count, RTSP_MAX_ENDPOINTS);
+    check_endpoint(0, "h1", 1);
+    check_endpoint(3, "h4", 4);
+}
+END_TEST
+
+START_TEST(test_invalid_entries)
+{
+    char host[RTSP_SERVER_HOST_SIZE + 8];
+
+    ck_assert_int_eq(parse(""), -1);
+    ck_assert_int_eq(parse("10.0.0.1,,10.0.0.2"), -1);
+    ck_assert_int_eq(parse("10.0.0.1,"), -1);
+
+    memset(host, 'h', sizeof(host) - 1);
+    host[sizeof(host) - 1] = '\0';
+    ck_assert_int_eq(parse(host), -1);
+
+    host[0] = '[';
+    host[sizeof(host) - 2] = ']';
+    ck_assert_int_eq(parse(host), -1);
+
+    /* One too long, and the longest host that fits */
+    memset(host, 'h', RTSP_SERVER_HOST_SIZE);
+    strcpy(host + RTSP_SERVER_HOST_SIZE, ":80");
+    ck_assert_int_eq(parse(host), -1);
+    memset(host, 'h', RTSP_SERVER_HOST_SIZE - 1);
+    strcpy(host + RTSP_SERVER_HOST_SIZE - 1, ":80");
+    ck_assert_int_eq(parse(host), 0);
+    ck_assert_uint_eq(strlen(session.endpoints[0].host), RTSP_SERVER_HOST_SIZE - 1);
+    ck_assert_int_eq(session.endpoints[0].port, 80);
+}
+END_TEST
+
+START_TEST(test_pick_list_order)
+{
+    ck_assert_int_eq(parse("a:1,b:2,c:3"), 0);
+
+    /* No history: the first one */
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 0);
+
+    /* Later endpoints within the margin don't displace earlier ones */
+    set_score("a:1", 80);
+    set_score("b:2", 80 + RTSP_ENDPOINT_SCORE_MARGIN);
+    set_score("c:3", 85);
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 0);
+}
+END_TEST
+
+START_TEST(test_pick_clearly_better)
+{
+    ck_assert_int_eq(parse("a:1,b:2,c:3,d:4"), 0);
+
+    set_score("a:1", 50);
+    set_score("b:2", 65);
+    set_score("c:3", 70); /* Within the margin of b, not of a */
+    set_score("d:4", 76);
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 3);
+
+    /* Scores are per host and port */
+    set_score("d:5", 0);
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 3);
+}
+END_TEST
+
+START_TEST(test_pick_skips_tried)
+{
+    ck_assert_int_eq(parse("a:1,b:2,c:3"), 0);
+    set_score("a:1", 20);
+    set_score("b:2", 100);
+    set_score("c:3", 40);
+
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 1);
+    session.endpoints_tried |= 1u << 1;
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 2);
+    session.endpoints_tried |= 1u << 2;
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), 0);
+    session.endpoints_tried |= 1u << 0;
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), -1);
+
+    session.endpoint_count = 0;
+    session.endpoints_tried = 0;
+    ck_assert_int_eq(rtsp_pick_endpoint(&session), -1);
+}
+END_TEST
+
+Suite *rtsp_endpoint_suite(void)
+{
+    Suite *s;
+    TCase *tc_parse;
+    TCase *tc_pick;
+
+    s = suite_create("RTSP endpoints");
+
+    tc_parse = tcase_create("Parse");
+    tcase_add_checked_fixture(tc_parse, setup, NULL);
+    tcase_add_test(tc_parse, test_single_endpoint);
+    tcase_add_test(tc_parse, test_ipv6);
+    tcase_add_test(tc_parse, test_list);
+    tcase_add_test(tc_parse, test_too_many_endpoints);
+    tcase_add_test(tc_parse, test_invalid_entries);
+    suite_add_tcase(s, tc_parse);
+
+    tc_pick = tcase_create("Pick");
+    tcase_add_checked_fixture(tc_pick, setup, NULL);
+    tcase_add_test(tc_pick, test_pick_list_order);
+    tcase_add_test(tc_pick, test_pick_clearly_better);
+    tcase_add_test(tc_pick, test_pick_skips_tried);
+    suite_add_tcase(s, tc_pick);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = rtsp_endpoint_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,258 @@
+#include <check.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include "rtsp_pool.h"
+#include "connection.h"
+#include "multicast.h"
+#include "rtp2httpd.h"
+
+/*
+ * Warm connections to an RTSP "server" listening on the loopback address.
+ * rtsp_pool_tick() runs on the event loop: it must never resolve names.
+ */
+
+/* Globals and functions rtsp_pool.c takes from the server */
+config_t config;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+int64_t get_time_ms(void)
+{
+    return 0;
+}
+
+int connection_set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+const struct ifreq *get_upstream_interface_for_rtsp(void)
+{
+    return NULL;
+}
+
+void bind_to_upstream_interface(int sock, const struct ifreq *ifr)
+{
+    (void)sock;
+    (void)ifr;
+}
+
+/* Blocking resolvers */
+struct hostent *gethostbyname(const char *name)
+{
+    ck_abort_msg("gethostbyname(%s) called", name);
+    return NULL;
+}
+
+int getaddrinfo(const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res)
+{
+    (void)service;
+    (void)hints;
+    (void)res;
+    ck_abort_msg("getaddrinfo(%s) called", node);
+    return EAI_FAIL;
+}
+
+static int epfd;
+static int listener;
+static int port;
+static struct in_addr loopback;
+
+static void setup(void)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset(&config, 0, sizeof(config));
+    config.rtsp_warm_pool = 1;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    ck_assert_int_ge(epfd, 0);
+    rtsp_pool_init(epfd);
+
+    listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    ck_assert_int_ge(listener, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ck_assert_int_eq(bind(listener, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    ck_assert_int_eq(listen(listener, 4), 0);
+    ck_assert_int_eq(getsockname(listener, (struct sockaddr *)&addr, &len), 0);
+    port = ntohs(addr.sin_port);
+    loopback = addr.sin_addr;
+}
+
+static void teardown(void)
+{
+    rtsp_pool_cleanup();
+    close(listener);
+    close(epfd);
+}
+
+/* Accept the pool's connection if one arrives within timeout_ms */
+static int accept_warm(int timeout_ms)
+{
+    struct pollfd pfd = {.fd = listener, .events = POLLIN};
+
+    if (poll(&pfd, 1, timeout_ms) != 1)
+        return -1;
+    return accept(listener, NULL, NULL);
+}
+
+/* Answer the OPTIONS health check and pass pool events until the socket is idle */
+static void serve_options(int server)
+{
+    static const char reply[] = "RTSP/1.0 200 OK\r\nCSeq: 1\r\n\r\n";
+    struct epoll_event ev;
+    struct pollfd pfd = {.fd = server, .events = POLLIN};
+    char request[512];
+    ssize_t n;
+
+    /* Connect completes: the pool sends OPTIONS */
+    ck_assert_int_eq(epoll_wait(epfd, &ev, 1, 1000), 1);
+    ck_assert_int_eq(rtsp_pool_handle_event(ev.data.fd, ev.events), 1);
+
+    ck_assert_int_eq(poll(&pfd, 1, 1000), 1);
+    n = recv(server, request, sizeof(request) - 1, 0);
+    ck_assert_int_gt(n, 0);
+    request[n] = '\0';
+    ck_assert_msg(strncmp(request, "OPTIONS rtsp://", 15) == 0, "request: %s", request);
+
+    ck_assert_int_eq(send(server, reply, sizeof(reply) - 1, 0), (ssize_t)sizeof(reply) - 1);
+    ck_assert_int_eq(epoll_wait(epfd, &ev, 1, 1000), 1);
+    ck_assert_int_eq(rtsp_pool_handle_event(ev.data.fd, ev.events), 1);
+}
+
+START_TEST(test_named_host_waits_for_address)
+{
+    int fd;
+
+    /* A session asks for a warm socket to a named host and gets none */
+    ck_assert_int_eq(rtsp_pool_acquire("iptv.example", port, NULL), -1);
+    rtsp_pool_tick(0);
+    ck_assert_int_eq(accept_warm(100), -1);
+
+    /* Its connect resolves the name and hands the address over */
+    rtsp_pool_set_address("IPTV.example", port, &loopback);
+    rtsp_pool_tick(0);
+    fd = accept_warm(1000);
+    ck_assert_int_ge(fd, 0);
+    serve_options(fd);
+
+    uint32_t cseq = 0;
+    int warm = rtsp_pool_acquire("iptv.example", port, &cseq);
+    ck_assert_int_ge(warm, 0);
+    ck_assert_uint_eq(cseq, 2);
+    close(warm);
+    close(fd);
+}
+END_TEST
+
+START_TEST(test_numeric_host)
+{
+    int fd;
+
+    ck_assert_int_eq(rtsp_pool_acquire("127.0.0.1", port, NULL), -1);
+    rtsp_pool_tick(0);
+    fd = accept_warm(1000);
+    ck_assert_int_ge(fd, 0);
+    serve_options(fd);
+
+    int warm = rtsp_pool_acquire("127.0.0.1", port, NULL);
+    ck_assert_int_ge(warm, 0);
+    close(warm);
+    close(fd);
+}
+END_TEST
+
+START_TEST(test_address_for_other_endpoint)
+{
+    /* Only the host and port the address was resolved for */
+    ck_assert_int_eq(rtsp_pool_acquire("iptv.example", port, NULL), -1);
+    rtsp_pool_set_address("iptv.example", port + 1, &loopback);
+    rtsp_pool_set_address("other.example", port, &loopback);
+    rtsp_pool_tick(0);
+    ck_assert_int_eq(accept_warm(100), -1);
+}
+END_TEST
+
+START_TEST(test_address_without_demand)
+{
+    /* Resolving alone does not make the pool warm a host */
+    rtsp_pool_set_address("iptv.example", port, &loopback);
+    rtsp_pool_tick(0);
+    ck_assert_int_eq(accept_warm(100), -1);
+    ck_assert_int_eq(rtsp_pool_acquire("iptv.example", port, NULL), -1);
+}
+END_TEST
+
+START_TEST(test_evicted_host_forgets_address)
+{
+    char name[32];
+    int i;
+
+    ck_assert_int_eq(rtsp_pool_acquire("iptv.example", port, NULL), -1);
+    rtsp_pool_set_address("iptv.example", port, &loopback);
+
+    /* More demanded hosts take over the table, then the host comes back */
+    for (i = 0; i < RTSP_POOL_MAX_HOSTS; i++)
+    {
+        snprintf(name, sizeof(name), "busy%d.example", i);
+        ck_assert_int_eq(rtsp_pool_acquire(name, port, NULL), -1);
+        ck_assert_int_eq(rtsp_pool_acquire(name, port, NULL), -1);
+    }
+    ck_assert_int_eq(rtsp_pool_acquire("iptv.example", port, NULL), -1);
+    rtsp_pool_tick(0);
+    ck_assert_int_eq(accept_warm(100), -1);
+}
+END_TEST
+
+Suite *rtsp_pool_suite(void)
+{
+    Suite *s;
+    TCase *tc_address;
+
+    s = suite_create("RTSP pool");
+
+    tc_address = tcase_create("Address");
+    tcase_add_checked_fixture(tc_address, setup, teardown);
+    tcase_add_test(tc_address, test_named_host_waits_for_address);
+    tcase_add_test(tc_address, test_numeric_host);
+    tcase_add_test(tc_address, test_address_for_other_endpoint);
+    tcase_add_test(tc_address, test_address_without_demand);
+    tcase_add_test(tc_address, test_evicted_host_forgets_address);
+    suite_add_tcase(s, tc_address);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = rtsp_pool_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,242 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "service.h"
+#include "connection.h"
+#include "rtp2httpd.h"
+
+/* Globals and functions service.c and http.c take from the server */
+config_t config;
+service_t *services = NULL;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+int connection_queue_output(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+int connection_queue_output_and_flush(connection_t *c, const uint8_t *data, size_t len)
+{
+    (void)c;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static service_t *make_service(const char *name, service_source_t source)
+{
+    service_t *service = calloc(1, sizeof(*service));
+
+    ck_assert_ptr_nonnull(service);
+    service->url = strdup(name);
+    service->service_type = SERVICE_MRTP;
+    service->source = source;
+    return service;
+}
+
+static service_t *add(const char *name, service_source_t source)
+{
+    service_t *service = make_service(name, source);
+
+    service_register(service);
+    return service;
+}
+
+static void teardown(void)
+{
+    while (services)
+    {
+        service_t *next = services->next;
+        service_free(services);
+        services = next;
+    }
+    service_index_reset();
+}
+
+START_TEST(test_empty)
+{
+    ck_assert_ptr_null(service_find("CCTV-1"));
+    ck_assert_ptr_null(service_find(""));
+    ck_assert_ptr_null(service_find(NULL));
+}
+END_TEST
+
+START_TEST(test_find)
+{
+    service_t *a = add("CCTV-1", SERVICE_SOURCE_INLINE);
+    service_t *b = add("CCTV-2", SERVICE_SOURCE_INLINE);
+
+    ck_assert_ptr_eq(service_find("CCTV-1"), a);
+    ck_assert_ptr_eq(service_find("CCTV-2"), b);
+    ck_assert_ptr_null(service_find("CCTV-3"));
+    ck_assert_ptr_null(service_find("CCTV-"));
+    ck_assert_ptr_null(service_find("cctv-1"));
+
+    /* Appended in order */
+    ck_assert_ptr_eq(services, a);
+    ck_assert_ptr_eq(a->next, b);
+    ck_assert_ptr_null(b->next);
+}
+END_TEST
+
+START_TEST(test_first_of_duplicates)
+{
+    service_t *first = add("News", SERVICE_SOURCE_INLINE);
+    service_t *second = add("News", SERVICE_SOURCE_EXTERNAL);
+
+    /* Same answer as walking the list */
+    ck_assert_ptr_eq(service_find("News"), first);
+    ck_assert_ptr_eq(first->next, second);
+}
+END_TEST
+
+START_TEST(test_unnamed_service)
+{
+    service_t *unnamed = make_service("x", SERVICE_SOURCE_INLINE);
+
+    free(unnamed->url);
+    unnamed->url = NULL;
+    service_register(unnamed);
+    add("Named", SERVICE_SOURCE_INLINE);
+
+    ck_assert_ptr_eq(services, unnamed);
+    ck_assert_ptr_nonnull(service_find("Named"));
+}
+END_TEST
+
+START_TEST(test_many_services)
+{
+    char name[32];
+    service_t **all = calloc(5000, sizeof(*all));
+    int i;
+
+    /* Grows the table several times; every name stays reachable */
+    for (i = 0; i < 5000; i++)
+    {
+        snprintf(name, sizeof(name), "channel/%d", i);
+        all[i] = add(name, SERVICE_SOURCE_EXTERNAL);
+    }
+    for (i = 0; i < 5000; i++)
+    {
+        snprintf(name, sizeof(name), "channel/%d", i);
+        ck_assert_ptr_eq(service_find(name), all[i]);
+        snprintf(name, sizeof(name), "channel/%d", i + 5000);
+        ck_assert_ptr_null(service_find(name));
+    }
+    free(all);
+}
+END_TEST
+
+START_TEST(test_free_external)
+{
+    char name[32];
+    service_t *inline_a = add("Inline A", SERVICE_SOURCE_INLINE);
+    int i;
+
+    for (i = 0; i < 100; i++)
+    {
+        snprintf(name, sizeof(name), "external/%d", i);
+        add(name, SERVICE_SOURCE_EXTERNAL);
+    }
+    service_t *inline_b = add("Inline B", SERVICE_SOURCE_INLINE);
+    add("Inline A", SERVICE_SOURCE_EXTERNAL);
+
+    service_free_external();
+
+    ck_assert_ptr_eq(services, inline_a);
+    ck_assert_ptr_eq(inline_a->next, inline_b);
+    ck_assert_ptr_null(inline_b->next);
+    ck_assert_ptr_eq(service_find("Inline A"), inline_a);
+    ck_assert_ptr_eq(service_find("Inline B"), inline_b);
+    ck_assert_ptr_null(service_find("external/0"));
+    ck_assert_ptr_null(service_find("external/99"));
+
+    /* A reloaded playlist appends after the kept services */
+    service_t *reloaded = add("external/0", SERVICE_SOURCE_EXTERNAL);
+    ck_assert_ptr_eq(inline_b->next, reloaded);
+    ck_assert_ptr_eq(service_find("external/0"), reloaded);
+}
+END_TEST
+
+START_TEST(test_free_external_keeps_first_inline)
+{
+    service_t *external = add("Sports", SERVICE_SOURCE_EXTERNAL);
+    service_t *kept = add("Sports", SERVICE_SOURCE_INLINE);
+
+    ck_assert_ptr_eq(service_find("Sports"), external);
+    service_free_external();
+    ck_assert_ptr_eq(service_find("Sports"), kept);
+}
+END_TEST
+
+START_TEST(test_reset_after_reload)
+{
+    add("Old", SERVICE_SOURCE_INLINE);
+
+    /* Configuration reload frees the list itself, then resets the index */
+    service_free(services);
+    services = NULL;
+    service_index_reset();
+    ck_assert_ptr_null(service_find("Old"));
+
+    /* A list built by the config parser is picked up as the append point */
+    services = make_service("Parsed", SERVICE_SOURCE_INLINE);
+    service_index_reset();
+    service_t *added = add("Added", SERVICE_SOURCE_INLINE);
+    ck_assert_ptr_eq(services->next, added);
+    ck_assert_ptr_eq(service_find("Added"), added);
+}
+END_TEST
+
+Suite *service_suite(void)
+{
+    Suite *s;
+    TCase *tc_index;
+    TCase *tc_reload;
+
+    s = suite_create("Service");
+
+    tc_index = tcase_create("Index");
+    tcase_add_checked_fixture(tc_index, NULL, teardown);
+    tcase_add_test(tc_index, test_empty);
+    tcase_add_test(tc_index, test_find);
+    tcase_add_test(tc_index, test_first_of_duplicates);
+    tcase_add_test(tc_index, test_unnamed_service);
+    tcase_add_test(tc_index, test_many_services);
+    suite_add_tcase(s, tc_index);
+
+    tc_reload = tcase_create("Reload");
+    tcase_add_checked_fixture(tc_reload, NULL, teardown);
+    tcase_add_test(tc_reload, test_free_external);
+    tcase_add_test(tc_reload, test_free_external_keeps_first_inline);
+    tcase_add_test(tc_reload, test_reset_after_reload);
+    suite_add_tcase(s, tc_reload);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = service_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
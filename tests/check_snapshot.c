@@ -0,0 +1,529 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "snapshot_cache.h"
+#include "snapshot_decoder.h"
+#include "connection.h"
+#include "http.h"
+#include "worker.h"
+#include "zerocopy.h"
+#include "rtp2httpd.h"
+#include "ts_scan.h"
+
+/*
+ * Frame detection of snapshot_process_packet(): the contexts only capture
+ * (capture_only), so no conversion is started and the server functions
+ * below are never reached.
+ */
+
+/* Globals and functions snapshot.c and rtp.c take from the server */
+config_t config;
+
+int logger(enum loglevel level, const char *format, ...)
+{
+    (void)level;
+    (void)format;
+    return 0;
+}
+
+int64_t get_time_ms(void)
+{
+    return 0;
+}
+
+void connection_epoll_update_events(int epfd, int fd, uint32_t events)
+{
+    (void)epfd;
+    (void)fd;
+    (void)events;
+}
+
+int connection_queue_file(connection_t *c, int file_fd, off_t file_offset, size_t file_size)
+{
+    (void)c;
+    (void)file_fd;
+    (void)file_offset;
+    (void)file_size;
+    return -1;
+}
+
+int connection_queue_zerocopy(connection_t *c, buffer_ref_t *buf_ref)
+{
+    (void)c;
+    (void)buf_ref;
+    return -1;
+}
+
+void send_http_headers(connection_t *c, http_status_t status, content_type_t type, const char *extra_headers)
+{
+    (void)c;
+    (void)status;
+    (void)type;
+    (void)extra_headers;
+}
+
+void http_send_500(connection_t *conn)
+{
+    (void)conn;
+}
+
+void fdmap_set(int fd, connection_t *c)
+{
+    (void)fd;
+    (void)c;
+}
+
+void worker_cleanup_socket_from_epoll(int epoll_fd, int sock)
+{
+    (void)epoll_fd;
+    (void)sock;
+}
+
+void zerocopy_register_stream_client(void)
+{
+}
+
+void snapshot_cache_complete(snapshot_cache_entry_t *entry, int jpeg_fd, size_t jpeg_size)
+{
+    (void)entry;
+    (void)jpeg_fd;
+    (void)jpeg_size;
+}
+
+void snapshot_cache_fail(snapshot_cache_entry_t *entry)
+{
+    (void)entry;
+}
+
+void snapshot_cache_abandon(snapshot_cache_entry_t *entry)
+{
+    (void)entry;
+}
+
+int snapshot_decoder_enabled(void)
+{
+    return 0;
+}
+
+int snapshot_decoder_submit(snapshot_context_t *ctx, int codec, uint8_t *es, size_t es_len)
+{
+    (void)ctx;
+    (void)codec;
+    (void)es;
+    (void)es_len;
+    return -1;
+}
+
+void snapshot_decoder_cancel(snapshot_context_t *ctx)
+{
+    (void)ctx;
+}
+
+#define PMT_PID 0x1000
+#define VIDEO_PID 0x0100
+#define HEADER_SIZE (2 * TS_PACKET_SIZE)
+
+/* ES bytes of the packet that starts a PES: 184 minus the 9-byte PES header */
+#define FIRST_ES_SIZE 175
+#define NEXT_ES_SIZE 184
+
+static snapshot_context_t ctx;
+static int counter;
+
+/* Elementary stream under construction */
+static uint8_t es[4096];
+static size_t es_len;
+
+static void setup(void)
+{
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.enabled = 1;
+    ctx.capture_only = 1;
+    ctx.idr_frame_fd = -1;
+    ctx.idr_frame_capacity = 256 * TS_PACKET_SIZE;
+    ctx.idr_frame_mmap = malloc(ctx.idr_frame_capacity);
+    ck_assert_ptr_nonnull(ctx.idr_frame_mmap);
+    counter = 0;
+    es_len = 0;
+}
+
+static void teardown(void)
+{
+    free(ctx.idr_frame_mmap);
+}
+
+static void feed(uint8_t *packets, int count)
+{
+    ck_assert_int_eq(snapshot_process_packet(&ctx, count * TS_PACKET_SIZE, packets, NULL), 0);
+}
+
+static void ts_header(uint8_t *p, uint16_t pid, int pusi)
+{
+    memset(p, 0xFF, TS_PACKET_SIZE);
+    p[0] = TS_SYNC_BYTE;
+    p[1] = (uint8_t)((pusi ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+    p[2] = (uint8_t)(pid & 0xFF);
+    p[3] = (uint8_t)(0x10 | (counter++ & 0x0F));
+}
+
+static void feed_pat_pmt(uint8_t stream_type)
+{
+    static const uint8_t pat[] = {0x00, 0x00, 0xB0, 0x0D, 0x00, 0x01, 0xC1, 0x00, 0x00,
+                                  0x00, 0x01, 0xE0 | (PMT_PID >> 8), PMT_PID & 0xFF};
+    uint8_t pmt[] = {0x00, 0x02, 0xB0, 0x12, 0x00, 0x01, 0xC1, 0x00, 0x00, 0xE1, 0x00, 0xF0, 0x00,
+                     stream_type, 0xE0 | (VIDEO_PID >> 8), VIDEO_PID & 0xFF, 0xF0, 0x00};
+    uint8_t packets[2 * TS_PACKET_SIZE];
+
+    /* CRCs are not checked */
+    ts_header(packets, TS_PAT_PID, 1);
+    memcpy(packets + 4, pat, sizeof(pat));
+    ts_header(packets + TS_PACKET_SIZE, PMT_PID, 1);
+    memcpy(packets + TS_PACKET_SIZE + 4, pmt, sizeof(pmt));
+    feed(packets, 2);
+    ck_assert_int_eq(ctx.ts_header_size, HEADER_SIZE);
+}
+
+/* Send es as one video PES; returns the number of TS packets */
+static int feed_pes(const uint8_t *es, size_t len, int rai)
+{
+    uint8_t packets[64 * TS_PACKET_SIZE];
+    size_t sent = 0;
+    int count = 0;
+
+    do
+    {
+        uint8_t *p = packets + count * TS_PACKET_SIZE;
+        int pos = 4;
+
+        ck_assert_int_lt(count, 64);
+        ts_header(p, VIDEO_PID, count == 0);
+        if (count == 0 && rai)
+        {
+            p[3] |= 0x20;
+            p[4] = 1;
+            p[5] = 0x40; /* random_access_indicator */
+            pos = 6;
+        }
+        if (count == 0)
+        {
+            static const uint8_t pes[] = {0x00, 0x00, 0x01, 0xE0, 0x00, 0x00, 0x80, 0x00, 0x00};
+            memcpy(p + pos, pes, sizeof(pes));
+            pos += sizeof(pes);
+        }
+        /* 0xFF stuffing after the last NAL unit */
+        size_t n = len - sent < (size_t)(TS_PACKET_SIZE - pos) ? len - sent : (size_t)(TS_PACKET_SIZE - pos);
+        memcpy(p + pos, es + sent, n);
+        sent += n;
+        count++;
+    } while (sent < len);
+
+    feed(packets, count);
+    return count;
+}
+
+static void nal(const uint8_t *bytes, size_t len)
+{
+    static const uint8_t start_code[] = {0x00, 0x00, 0x00, 0x01};
+
+    ck_assert_uint_le(es_len + sizeof(start_code) + len, sizeof(es));
+    memcpy(es + es_len, start_code, sizeof(start_code));
+    memcpy(es + es_len + sizeof(start_code), bytes, len);
+    es_len += sizeof(start_code) + len;
+}
+
+#define NAL(...)                                                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static const uint8_t bytes_[] = {__VA_ARGS__};                                                                 \
+        nal(bytes_, sizeof(bytes_));                                                                                   \
+    } while (0)
+
+/* Grow the last NAL unit to end at ES offset end */
+static void pad_to(size_t end)
+{
+    ck_assert_uint_le(es_len, end);
+    memset(es + es_len, 0x5A, end - es_len);
+    es_len = end;
+}
+
+static int send_es(int rai)
+{
+    int count = feed_pes(es, es_len, rai);
+    es_len = 0;
+    return count;
+}
+
+/* H.264 parameter sets: SPS, then a PPS whose second byte looks like an HEVC header */
+static void h264_parameter_sets(void)
+{
+    NAL(0x67, 0x64, 0x00, 0x1E, 0xAC, 0xD9);
+    NAL(0x28, 0x01, 0xCE, 0x3C, 0x80);
+}
+
+/* The frame started at the PES start and spans packets of it, followed by the next PES */
+static void check_captured(int codec, int packets)
+{
+    ts_scan_packet_t first;
+
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.idr_frame_complete, 1);
+    ck_assert_int_eq(ctx.video_pid, VIDEO_PID);
+    ck_assert_int_eq(ctx.video_codec, codec);
+    ck_assert_uint_eq(ctx.idr_frame_size, HEADER_SIZE + (size_t)packets * TS_PACKET_SIZE);
+    ts_scan_packet(ctx.idr_frame_mmap + HEADER_SIZE, &first);
+    ck_assert_int_eq(first.pid, VIDEO_PID);
+    ck_assert_int_eq(first.flags & TS_SCAN_VIDEO_PES, TS_SCAN_VIDEO_PES);
+}
+
+static void check_not_started(void)
+{
+    ck_assert_int_eq(ctx.idr_frame_started, 0);
+    ck_assert_int_eq(ctx.idr_frame_complete, 0);
+}
+
+START_TEST(test_h264_slices_not_hevc_irap)
+{
+    int packets;
+
+    feed_pat_pmt(0x1B);
+
+    /* nal_ref_idc 1 with types 1 and 8 reads as HEVC BLA_W_LP (16) and IDR_N_LP (20) */
+    h264_parameter_sets();
+    NAL(0x21, 0x01, 0x9A, 0x00);
+    send_es(0);
+    check_not_started();
+    ck_assert_uint_eq(ctx.idr_frame_size, HEADER_SIZE);
+
+    /* The next IDR picture (nal_ref_idc 1, type 5) */
+    h264_parameter_sets();
+    NAL(0x25, 0x01, 0x88, 0x84);
+    packets = send_es(0);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.video_codec, SNAPSHOT_CODEC_H264);
+
+    NAL(0x21, 0x9A, 0x00);
+    send_es(0);
+    check_captured(SNAPSHOT_CODEC_H264, packets);
+}
+END_TEST
+
+START_TEST(test_h264_before_pmt)
+{
+    int packets;
+
+    /* Slices starting a picture (first_mb_in_slice 0) don't pass as HEVC */
+    NAL(0x67, 0x64, 0x00, 0x1E, 0xAC, 0xD9);
+    NAL(0x28, 0xEE, 0x3C, 0x80);
+    NAL(0x21, 0x9A, 0x00);
+    send_es(0);
+    check_not_started();
+
+    NAL(0x65, 0x88, 0x84);
+    packets = send_es(0);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.video_codec, SNAPSHOT_CODEC_H264);
+
+    NAL(0x41, 0x9A, 0x00);
+    send_es(0);
+    ck_assert_int_eq(ctx.idr_frame_complete, 1);
+    ck_assert_uint_eq(ctx.idr_frame_size, (size_t)packets * TS_PACKET_SIZE);
+}
+END_TEST
+
+START_TEST(test_hevc_cra_only)
+{
+    int packets;
+
+    feed_pat_pmt(0x24);
+
+    /* TRAIL_R picture, the first NAL unit of an enhancement layer reads as an H.264 IDR */
+    NAL(0x05, 0x01, 0xD0);
+    NAL(0x02, 0x01, 0xD0);
+    send_es(0);
+    check_not_started();
+    ck_assert_uint_eq(ctx.idr_frame_size, HEADER_SIZE);
+
+    /* VPS, SPS, PPS and a CRA picture, no IDR anywhere */
+    NAL(0x40, 0x01, 0x0C, 0x01);
+    NAL(0x42, 0x01, 0x01, 0x01);
+    NAL(0x44, 0x01, 0xC1, 0x72);
+    NAL(0x2A, 0x01, 0xAF, 0x08);
+    packets = send_es(0);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+
+    NAL(0x02, 0x01, 0xD0);
+    send_es(0);
+    check_captured(SNAPSHOT_CODEC_HEVC, packets);
+}
+END_TEST
+
+START_TEST(test_hevc_cra_before_pmt)
+{
+    NAL(0x40, 0x01, 0x0C, 0x01);
+    NAL(0x42, 0x01, 0x01, 0x01);
+    NAL(0x2A, 0x01, 0xAF, 0x08);
+    send_es(0);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.video_codec, SNAPSHOT_CODEC_HEVC);
+}
+END_TEST
+
+/*
+ * The IDR slice follows 4 packets of parameter sets and SEI. Its start
+ * code and NAL header straddle the 4th and 5th packet at each position,
+ * from "00 00 01 65" ending the 4th packet to all of it in the 5th.
+ */
+START_TEST(test_slice_in_later_packet)
+{
+    size_t fifth = FIRST_ES_SIZE + 3 * NEXT_ES_SIZE;
+    int packets;
+
+    feed_pat_pmt(0x1B);
+
+    NAL(0x09, 0xF0);
+    h264_parameter_sets();
+    NAL(0x06, 0x05, 0xFF);
+    /* The IDR's 4-byte start code begins one byte earlier, its zero byte ends the SEI */
+    pad_to(fifth - 5 + (size_t)_i);
+    NAL(0x65, 0x88, 0x84);
+    pad_to(fifth + NEXT_ES_SIZE + 10);
+    packets = send_es(0);
+    ck_assert_int_eq(packets, 6);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.video_codec, SNAPSHOT_CODEC_H264);
+
+    NAL(0x41, 0x9A, 0x00);
+    send_es(0);
+    check_captured(SNAPSHOT_CODEC_H264, packets);
+}
+END_TEST
+
+START_TEST(test_other_slice_in_later_packet)
+{
+    size_t fifth = FIRST_ES_SIZE + 3 * NEXT_ES_SIZE;
+
+    feed_pat_pmt(0x1B);
+
+    /* Same layout with a non-IDR slice: the kept packets are dropped */
+    h264_parameter_sets();
+    NAL(0x06, 0x05, 0xFF);
+    pad_to(fifth);
+    NAL(0x41, 0x9A, 0x00);
+    ck_assert_int_eq(send_es(0), 5);
+    check_not_started();
+    ck_assert_uint_eq(ctx.idr_frame_size, HEADER_SIZE);
+    ck_assert_int_eq(ctx.probe_pid, 0);
+}
+END_TEST
+
+START_TEST(test_random_access_indicator_with_sps)
+{
+    int packets;
+
+    feed_pat_pmt(0x1B);
+
+    /* An I picture without IDR, first without the indicator */
+    h264_parameter_sets();
+    NAL(0x21, 0x88, 0x84);
+    send_es(0);
+    check_not_started();
+
+    h264_parameter_sets();
+    NAL(0x21, 0x88, 0x84);
+    packets = send_es(1);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+    ck_assert_int_eq(ctx.video_codec, SNAPSHOT_CODEC_H264);
+
+    NAL(0x21, 0x9A, 0x00);
+    send_es(0);
+    check_captured(SNAPSHOT_CODEC_H264, packets);
+}
+END_TEST
+
+START_TEST(test_random_access_indicator_without_sps)
+{
+    feed_pat_pmt(0x1B);
+
+    /* Multiplexers that flag every PES: only access units with an SPS count */
+    NAL(0x09, 0xF0);
+    NAL(0x21, 0x9A, 0x00);
+    send_es(1);
+    check_not_started();
+
+    NAL(0x42, 0x01, 0x01, 0x01); /* An HEVC SPS is not one of this H.264 stream */
+    NAL(0x21, 0x9A, 0x00);
+    send_es(1);
+    check_not_started();
+
+    /* An SPS counts for its own PES only */
+    NAL(0x67, 0x64, 0x00, 0x1E, 0xAC, 0xD9);
+    NAL(0x21, 0x9A, 0x00);
+    send_es(0);
+    NAL(0x21, 0x9A, 0x00);
+    send_es(1);
+    check_not_started();
+}
+END_TEST
+
+START_TEST(test_hevc_random_access_indicator)
+{
+    int packets;
+
+    feed_pat_pmt(0x24);
+
+    NAL(0x40, 0x01, 0x0C, 0x01);
+    NAL(0x42, 0x01, 0x01, 0x01);
+    NAL(0x02, 0x01, 0xD0);
+    packets = send_es(1);
+    ck_assert_int_eq(ctx.idr_frame_started, 1);
+
+    NAL(0x02, 0x01, 0xD0);
+    send_es(0);
+    check_captured(SNAPSHOT_CODEC_HEVC, packets);
+}
+END_TEST
+
+Suite *snapshot_suite(void)
+{
+    Suite *s;
+    TCase *tc_codec;
+    TCase *tc_probe;
+
+    s = suite_create("Snapshot");
+
+    tc_codec = tcase_create("Codec");
+    tcase_add_checked_fixture(tc_codec, setup, teardown);
+    tcase_add_test(tc_codec, test_h264_slices_not_hevc_irap);
+    tcase_add_test(tc_codec, test_h264_before_pmt);
+    tcase_add_test(tc_codec, test_hevc_cra_only);
+    tcase_add_test(tc_codec, test_hevc_cra_before_pmt);
+    suite_add_tcase(s, tc_codec);
+
+    tc_probe = tcase_create("Probe");
+    tcase_add_checked_fixture(tc_probe, setup, teardown);
+    tcase_add_loop_test(tc_probe, test_slice_in_later_packet, 0, 6);
+    tcase_add_test(tc_probe, test_other_slice_in_later_packet);
+    tcase_add_test(tc_probe, test_random_access_indicator_with_sps);
+    tcase_add_test(tc_probe, test_random_access_indicator_without_sps);
+    tcase_add_test(tc_probe, test_hevc_random_access_indicator);
+    suite_add_tcase(s, tc_probe);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = snapshot_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,277 @@
+#include <check.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ts_scan.h"
+
+/*
+ * Built twice: check_ts_scan uses the SSE2/NEON start code search of the
+ * target, check_ts_scan_scalar the fallback (TS_SCAN_SCALAR). Both are
+ * held against the byte-by-byte reference below.
+ */
+
+static int reference_start_code(const uint8_t *data, size_t len)
+{
+    size_t i;
+    for (i = 0; i + 3 <= len; i++)
+        if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+            return (int)i;
+    return -1;
+}
+
+static void make_packet(uint8_t *p, uint16_t pid, int pusi, int counter)
+{
+    memset(p, 0xFF, TS_PACKET_SIZE);
+    p[0] = TS_SYNC_BYTE;
+    p[1] = (uint8_t)((pusi ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+    p[2] = (uint8_t)(pid & 0xFF);
+    p[3] = (uint8_t)(0x10 | (counter & 0x0F));
+}
+
+START_TEST(test_start_code_every_offset)
+{
+    uint8_t buf[96];
+    size_t len, pos;
+
+    for (len = 0; len <= sizeof(buf); len++)
+    {
+        memset(buf, 0xAB, sizeof(buf));
+        ck_assert_int_eq(ts_scan_start_code(buf, len), -1);
+
+        for (pos = 0; pos + 3 <= len; pos++)
+        {
+            memset(buf, 0xAB, sizeof(buf));
+            buf[pos] = 0;
+            buf[pos + 1] = 0;
+            buf[pos + 2] = 1;
+            ck_assert_int_eq(ts_scan_start_code(buf, len), (int)pos);
+        }
+    }
+}
+END_TEST
+
+START_TEST(test_start_code_four_byte)
+{
+    static const uint8_t data[] = {0x80, 0x00, 0x00, 0x00, 0x01, 0x65, 0x88};
+    ck_assert_int_eq(ts_scan_start_code(data, sizeof(data)), 2);
+}
+END_TEST
+
+START_TEST(test_start_code_cut_at_end)
+{
+    uint8_t buf[40];
+
+    /* 00 00 with the 01 beyond len is no start code */
+    memset(buf, 0x55, sizeof(buf));
+    buf[30] = 0;
+    buf[31] = 0;
+    buf[32] = 1;
+    ck_assert_int_eq(ts_scan_start_code(buf, 32), -1);
+    ck_assert_int_eq(ts_scan_start_code(buf, 33), 30);
+}
+END_TEST
+
+START_TEST(test_start_code_matches_reference)
+{
+    uint8_t buf[512];
+    unsigned int seed = 1;
+    int round;
+
+    /* Mostly zeros and ones so near misses (00 00 00, 00 01, 01 00 01) are common */
+    for (round = 0; round < 20000; round++)
+    {
+        size_t len = (size_t)(rand_r(&seed) % sizeof(buf));
+        size_t start = (size_t)(rand_r(&seed) % 16);
+        size_t i;
+
+        if (start > len)
+            start = len;
+        for (i = 0; i < len; i++)
+        {
+            int r = rand_r(&seed) % 16;
+            buf[i] = (uint8_t)(r < 10 ? 0 : r < 12 ? 1 : r);
+        }
+        ck_assert_int_eq(ts_scan_start_code(buf + start, len - start),
+                         reference_start_code(buf + start, len - start));
+    }
+}
+END_TEST
+
+START_TEST(test_packet_video_pes)
+{
+    uint8_t p[TS_PACKET_SIZE];
+    ts_scan_packet_t pkt;
+
+    make_packet(p, 0x100, 1, 0);
+    /* Adaptation field with random_access_indicator, then a video PES header */
+    p[3] = 0x30;
+    p[4] = 1;
+    p[5] = 0x40;
+    memcpy(p + 6, "\x00\x00\x01\xE0\x00\x00\x80\x80\x05", 9);
+    ts_scan_packet(p, &pkt);
+
+    ck_assert_uint_eq(pkt.pid, 0x100);
+    ck_assert_uint_eq(pkt.flags, TS_SCAN_PUSI | TS_SCAN_PAYLOAD | TS_SCAN_ADAPTATION | TS_SCAN_RAI |
+                                     TS_SCAN_VIDEO_PES);
+    ck_assert_uint_eq(pkt.payload, 6);
+    ck_assert_uint_eq(pkt.es, 6 + 9 + 5);
+}
+END_TEST
+
+START_TEST(test_packet_audio_and_adaptation_only)
+{
+    uint8_t p[TS_PACKET_SIZE];
+    ts_scan_packet_t pkt;
+
+    make_packet(p, 0x101, 1, 0);
+    memcpy(p + 4, "\x00\x00\x01\xC0\x00\x00\x80\x80\x05", 9);
+    ts_scan_packet(p, &pkt);
+    ck_assert_uint_eq(pkt.flags, TS_SCAN_PUSI | TS_SCAN_PAYLOAD);
+    ck_assert_uint_eq(pkt.es, TS_PACKET_SIZE);
+
+    /* Adaptation field filling the packet: no payload */
+    make_packet(p, 0x100, 0, 0);
+    p[3] = 0x30;
+    p[4] = 183;
+    p[5] = 0x00;
+    ts_scan_packet(p, &pkt);
+    ck_assert_uint_eq(pkt.flags, TS_SCAN_ADAPTATION);
+    ck_assert_uint_eq(pkt.payload, TS_PACKET_SIZE);
+}
+END_TEST
+
+START_TEST(test_packets_aligned)
+{
+    uint8_t buf[7 * TS_PACKET_SIZE];
+    ts_scan_packet_t pkts[TS_SCAN_BATCH];
+    size_t consumed;
+    int i, n;
+
+    for (i = 0; i < 7; i++)
+        make_packet(buf + i * TS_PACKET_SIZE, (uint16_t)(0x100 + i), i == 0, i);
+
+    n = ts_scan_packets(buf, sizeof(buf), pkts, TS_SCAN_BATCH, &consumed);
+    ck_assert_int_eq(n, 7);
+    ck_assert_uint_eq(consumed, sizeof(buf));
+    for (i = 0; i < 7; i++)
+    {
+        ck_assert_uint_eq(pkts[i].offset, (uint32_t)(i * TS_PACKET_SIZE));
+        ck_assert_uint_eq(pkts[i].pid, (uint16_t)(0x100 + i));
+    }
+}
+END_TEST
+
+START_TEST(test_packets_resync)
+{
+    uint8_t buf[3 * TS_PACKET_SIZE + 20];
+    ts_scan_packet_t pkts[TS_SCAN_BATCH];
+    size_t consumed;
+    int n;
+
+    /* Junk before the first packet and a cut packet between the others */
+    memset(buf, 0x00, sizeof(buf));
+    make_packet(buf + 7, 0x100, 0, 0);
+    buf[7 + TS_PACKET_SIZE] = TS_SYNC_BYTE;
+    buf[7 + TS_PACKET_SIZE + 1] = 0x01;
+    make_packet(buf + 7 + TS_PACKET_SIZE + 13, 0x101, 0, 1);
+    make_packet(buf + 7 + 2 * TS_PACKET_SIZE + 13, 0x102, 0, 2);
+
+    n = ts_scan_packets(buf, sizeof(buf), pkts, TS_SCAN_BATCH, &consumed);
+
+    /* The cut packet's sync byte passes for a packet start; 188 bytes on
+     * there is no sync byte and the scan moves to the next one */
+    ck_assert_int_eq(n, 3);
+    ck_assert_uint_eq(pkts[0].offset, 7);
+    ck_assert_uint_eq(pkts[0].pid, 0x100);
+    ck_assert_uint_eq(pkts[1].offset, 7 + TS_PACKET_SIZE);
+    ck_assert_uint_eq(pkts[n - 1].pid, 0x102);
+    ck_assert_uint_eq(pkts[n - 1].offset, 7 + 2 * TS_PACKET_SIZE + 13);
+    ck_assert_uint_eq(consumed, sizeof(buf));
+}
+END_TEST
+
+START_TEST(test_packets_truncated_tail)
+{
+    uint8_t buf[2 * TS_PACKET_SIZE + 100];
+    ts_scan_packet_t pkts[TS_SCAN_BATCH];
+    size_t consumed;
+    int n;
+
+    memset(buf, 0xFF, sizeof(buf));
+    make_packet(buf, 0x100, 1, 0);
+    make_packet(buf + TS_PACKET_SIZE, 0x100, 0, 1);
+    buf[2 * TS_PACKET_SIZE] = TS_SYNC_BYTE; /* Only 100 bytes of the third */
+
+    n = ts_scan_packets(buf, sizeof(buf), pkts, TS_SCAN_BATCH, &consumed);
+    ck_assert_int_eq(n, 2);
+    ck_assert_uint_eq(consumed, sizeof(buf));
+
+    /* No sync byte at all */
+    memset(buf, 0x00, sizeof(buf));
+    n = ts_scan_packets(buf, sizeof(buf), pkts, TS_SCAN_BATCH, &consumed);
+    ck_assert_int_eq(n, 0);
+    ck_assert_uint_eq(consumed, sizeof(buf));
+}
+END_TEST
+
+START_TEST(test_packets_output_full)
+{
+    uint8_t buf[5 * TS_PACKET_SIZE];
+    ts_scan_packet_t pkts[3];
+    size_t consumed;
+    int i, n;
+
+    for (i = 0; i < 5; i++)
+        make_packet(buf + i * TS_PACKET_SIZE, 0x100, 0, i);
+
+    n = ts_scan_packets(buf, sizeof(buf), pkts, 3, &consumed);
+    ck_assert_int_eq(n, 3);
+    ck_assert_uint_eq(consumed, 3 * TS_PACKET_SIZE);
+
+    n = ts_scan_packets(buf + consumed, sizeof(buf) - consumed, pkts, 3, &consumed);
+    ck_assert_int_eq(n, 2);
+    ck_assert_uint_eq(consumed, 2 * TS_PACKET_SIZE);
+}
+END_TEST
+
+Suite *ts_scan_suite(void)
+{
+    Suite *s;
+    TCase *tc_start_code;
+    TCase *tc_packets;
+
+    s = suite_create("TS Scan");
+
+    tc_start_code = tcase_create("StartCode");
+    tcase_add_test(tc_start_code, test_start_code_every_offset);
+    tcase_add_test(tc_start_code, test_start_code_four_byte);
+    tcase_add_test(tc_start_code, test_start_code_cut_at_end);
+    tcase_add_test(tc_start_code, test_start_code_matches_reference);
+    suite_add_tcase(s, tc_start_code);
+
+    tc_packets = tcase_create("Packets");
+    tcase_add_test(tc_packets, test_packet_video_pes);
+    tcase_add_test(tc_packets, test_packet_audio_and_adaptation_only);
+    tcase_add_test(tc_packets, test_packets_aligned);
+    tcase_add_test(tc_packets, test_packets_resync);
+    tcase_add_test(tc_packets, test_packets_truncated_tail);
+    tcase_add_test(tc_packets, test_packets_output_full);
+    suite_add_tcase(s, tc_packets);
+
+    return s;
+}
+
+int main(void)
+{
+    int number_failed;
+    Suite *s;
+    SRunner *sr;
+
+    s = ts_scan_suite();
+    sr = srunner_create(s);
+
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -91,6 +91,8 @@ export function ConnectionsSection({
                         queueLimit={client.queueLimitBytes}
                         queueHighwater={client.queueBytesHighwater}
                         droppedBytes={client.droppedBytes}
+                        memoryBytes={client.memoryBytes}
+                        upstream={client.upstream}
                       />
                     </TableCell>
                     <TableCell className="text-center">
@@ -146,6 +148,8 @@ export function ConnectionsSection({
                     queueLimit={client.queueLimitBytes}
                     queueHighwater={client.queueBytesHighwater}
                     droppedBytes={client.droppedBytes}
+                    memoryBytes={client.memoryBytes}
+                    upstream={client.upstream}
                   />
                   <div className="flex items-center justify-between text-xs text-muted-foreground">
                     <span>PID: {client.workerPid}</span>
@@ -1,6 +1,7 @@
 import type { Locale } from "../../lib/locale";
 import { useStatusTranslation } from "../../hooks/use-status-translation";
 import { formatBytes } from "../../lib/format";
+import type { UpstreamStats } from "../../types";
 import { Progress } from "../ui/progress";
 
 interface QueueUsageProps {
@@ -9,9 +10,19 @@ interface QueueUsageProps {
   queueHighwater: number;
   locale: Locale;
   droppedBytes: number;
+  memoryBytes?: number;
+  upstream?: UpstreamStats;
 }
 
-export function QueueUsage({ locale, queueBytes, queueLimit, queueHighwater, droppedBytes }: QueueUsageProps) {
+export function QueueUsage({
+  locale,
+  queueBytes,
+  queueLimit,
+  queueHighwater,
+  droppedBytes,
+  memoryBytes,
+  upstream,
+}: QueueUsageProps) {
   const t = useStatusTranslation(locale);
   const usage = queueLimit > 0 ? Math.min(100, (queueBytes / queueLimit) * 100) : 0;
   const highwaterPercent = queueLimit > 0 ? Math.min(100, (queueHighwater / queueLimit) * 100) : undefined;
@@ -37,7 +48,27 @@ export function QueueUsage({ locale, queueBytes, queueLimit, queueHighwater, dro
         <span>
           {t("queueDroppedBytes")}: {formatBytes(droppedBytes)}
         </span>
+        {typeof memoryBytes === "number" && memoryBytes > 0 && (
+          <span>
+            {t("connectionMemory")}: {formatBytes(memoryBytes)}
+          </span>
+        )}
       </div>
+      {upstream && upstream.expected > 0 && (
+        <div className="grid grid-cols-2 gap-2">
+          <span>
+            {t("upstreamLoss")}: {upstream.lost} ({((upstream.lost / upstream.expected) * 100).toFixed(2)}%)
+          </span>
+          <span>
+            {t("upstreamJitter")}: {(upstream.jitterUs / 1000).toFixed(1)} ms
+          </span>
+          {upstream.rttMs >= 0 && (
+            <span>
+              {t("upstreamRtt")}: {upstream.rttMs} ms
+            </span>
+          )}
+        </div>
+      )}
     </div>
   );
 }
@@ -2,7 +2,7 @@ import type { Locale } from "../../lib/locale";
 import { useStatusTranslation } from "../../hooks/use-status-translation";
 import { formatBandwidth, formatBytes } from "../../lib/format";
 import { cn } from "../../lib/utils";
-import type { PoolStats, WorkerEntry } from "../../types";
+import type { LoopPhase, LoopPhaseStats, LoopStats, PoolStats, RtspEndpointStats, WorkerEntry } from "../../types";
 import { Badge } from "../ui/badge";
 import { Card, CardContent, CardDescription, CardHeader, CardTitle } from "../ui/card";
 import { Separator } from "../ui/separator";
@@ -69,6 +69,36 @@ export function WorkersSection({ workers, locale }: WorkersSectionProps) {
                 value: worker.send.enobufs.toLocaleString(),
               },
             ];
+            if (worker.http) {
+              metrics.push(
+                {
+                  key: "httpRequests",
+                  label: t("httpRequests"),
+                  value: worker.http.requests.toLocaleString(),
+                },
+                {
+                  key: "requestsPerConnection",
+                  label: t("requestsPerConnection"),
+                  value:
+                    worker.http.connections > 0 ? (worker.http.requests / worker.http.connections).toFixed(2) : "-",
+                },
+              );
+              if (worker.http.handoffSent !== undefined && worker.http.handoffReceived !== undefined) {
+                metrics.push({
+                  key: "channelHandoff",
+                  label: t("channelHandoff"),
+                  value: `${worker.http.handoffSent.toLocaleString()} / ${worker.http.handoffReceived.toLocaleString()}`,
+                });
+              }
+            }
+            if (worker.snapshotCache) {
+              const { hits, misses, coalesced } = worker.snapshotCache;
+              metrics.push({
+                key: "snapshotCache",
+                label: t("snapshotCache"),
+                value: `${hits.toLocaleString()} / ${misses.toLocaleString()} / ${coalesced.toLocaleString()}`,
+              });
+            }
             return (
               <Card key={worker.id} className="border border-border/60 bg-card/95">
                 <CardHeader className="pb-4">
@@ -101,6 +131,10 @@ export function WorkersSection({ workers, locale }: WorkersSectionProps) {
                     <PoolCard title={t("bufferPool")} pool={worker.pool} locale={locale} />
                     <PoolCard title={t("controlPool")} pool={worker.controlPool} locale={locale} />
                   </div>
+                  {worker.rtspEndpoints && worker.rtspEndpoints.length > 0 && (
+                    <RtspEndpointsCard endpoints={worker.rtspEndpoints} locale={locale} />
+                  )}
+                  {worker.loop && <EventLoopCard loop={worker.loop} locale={locale} />}
                 </CardContent>
               </Card>
             );
@@ -146,7 +180,132 @@ function PoolCard({ title, pool, locale }: PoolCardProps) {
         <span>
           {t("poolExhaustions")}: {pool.exhaustions}
         </span>
+        {pool.budget ? (
+          <span>
+            {t("poolBudget")}: {formatBytes(pool.budget)}
+          </span>
+        ) : null}
+        {pool.budget && pool.memoryPressure !== undefined && pool.memoryPressure >= 0 ? (
+          <span>
+            {t("memoryPressure")}: {pool.memoryPressure.toFixed(2)}%
+          </span>
+        ) : null}
       </div>
     </div>
   );
 }
+
+interface RtspEndpointsCardProps {
+  endpoints: RtspEndpointStats[];
+  locale: Locale;
+}
+
+function RtspEndpointsCard({ endpoints, locale }: RtspEndpointsCardProps) {
+  const t = useStatusTranslation(locale);
+  return (
+    <div className="space-y-2 rounded-xl border border-border/40 bg-muted/20 p-4">
+      <div className="text-sm font-medium text-muted-foreground">{t("rtspEndpoints")}</div>
+      <div className="space-y-1 text-xs text-muted-foreground">
+        {endpoints.map((endpoint) => (
+          <div key={`${endpoint.host}:${endpoint.port}`} className="flex items-center justify-between gap-2">
+            <span className="truncate font-medium text-card-foreground">
+              {endpoint.host}:{endpoint.port}
+            </span>
+            <span className="shrink-0 text-right">
+              {t("rtspScore")}: {endpoint.score} · {t("rtspLatency")}: {endpoint.latencyMs} ms ·{" "}
+              {t("rtspFailures")}: {endpoint.failures}/{endpoint.attempts} · {t("rtspStalls")}: {endpoint.stalls}
+            </span>
+          </div>
+        ))}
+      </div>
+    </div>
+  );
+}
+
+const LOOP_PHASES: { phase: LoopPhase; labelKey: string }[] = [
+  { phase: "busy", labelKey: "loopPhaseBusy" },
+  { phase: "accept", labelKey: "loopPhaseAccept" },
+  { phase: "clientRead", labelKey: "loopPhaseClientRead" },
+  { phase: "clientWrite", labelKey: "loopPhaseClientWrite" },
+  { phase: "stream", labelKey: "loopPhaseStream" },
+  { phase: "shared", labelKey: "loopPhaseShared" },
+  { phase: "control", labelKey: "loopPhaseControl" },
+  { phase: "fetch", labelKey: "loopPhaseFetch" },
+  { phase: "tick", labelKey: "loopPhaseTick" },
+  { phase: "wait", labelKey: "loopPhaseWait" },
+];
+
+/** Matches STATUS_LOOP_HIST_BUCKETS in status.h */
+const LOOP_HIST_BUCKETS = 16;
+
+function formatMicros(us: number): string {
+  if (us >= 1_000_000) return `${(us / 1_000_000).toFixed(2)} s`;
+  if (us >= 1_000) return `${(us / 1_000).toFixed(1)} ms`;
+  return `${Math.round(us)} µs`;
+}
+
+/** Upper bound of the histogram bucket holding the 99th percentile */
+function loopP99(stats: LoopPhaseStats): string {
+  const target = stats.count * 0.99;
+  let seen = 0;
+  for (let i = 0; i < stats.hist.length; i++) {
+    seen += stats.hist[i];
+    if (seen >= target) {
+      return i === LOOP_HIST_BUCKETS - 1
+        ? `≥ ${formatMicros(4 << (LOOP_HIST_BUCKETS - 2))}`
+        : `< ${formatMicros(4 << i)}`;
+    }
+  }
+  return "-";
+}
+
+interface EventLoopCardProps {
+  loop: LoopStats;
+  locale: Locale;
+}
+
+function EventLoopCard({ loop, locale }: EventLoopCardProps) {
+  const t = useStatusTranslation(locale);
+  return (
+    <div className="space-y-2 rounded-xl border border-border/40 bg-muted/20 p-4">
+      <div className="flex items-center justify-between text-sm font-medium text-muted-foreground">
+        <span>{t("eventLoop")}</span>
+        <span>
+          {t("loopStalls")}: {loop.stalls.toLocaleString()}
+        </span>
+      </div>
+      <table className="w-full text-xs text-muted-foreground">
+        <thead>
+          <tr className="text-left">
+            <th className="font-medium">{t("loopPhase")}</th>
+            <th className="text-right font-medium">{t("loopCalls")}</th>
+            <th className="text-right font-medium">{t("loopAvg")}</th>
+            <th className="text-right font-medium">p99</th>
+            <th className="text-right font-medium">{t("loopMax")}</th>
+          </tr>
+        </thead>
+        <tbody>
+          {LOOP_PHASES.map(({ phase, labelKey }) => {
+            const stats = loop.phases[phase];
+            if (!stats || stats.count === 0) return null;
+            return (
+              <tr key={phase}>
+                <td className="text-card-foreground">{t(labelKey)}</td>
+                <td className="text-right">{stats.count.toLocaleString()}</td>
+                <td className="text-right">{formatMicros(stats.totalUs / stats.count)}</td>
+                <td className="text-right">{loopP99(stats)}</td>
+                <td className="text-right">{formatMicros(stats.maxUs)}</td>
+              </tr>
+            );
+          })}
+        </tbody>
+      </table>
+      {loop.stalls > 0 && loop.lastStallSite && (
+        <div className="text-xs text-muted-foreground">
+          {t("loopLastStall")}: <span className="text-card-foreground">{loop.lastStallSite}</span> ·{" "}
+          {formatMicros(loop.lastStallUs)} · {new Date(loop.lastStallTime).toLocaleTimeString()}
+        </div>
+      )}
+    </div>
+  );
+}
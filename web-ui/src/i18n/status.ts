@@ -41,12 +41,40 @@ const base: TranslationDict = {
   sendEagain: "EAGAIN",
   sendEnobufs: "ENOBUFS",
   sendBatch: "Batch flushes",
+  httpRequests: "HTTP requests",
+  requestsPerConnection: "Requests / connection",
+  channelHandoff: "Handed off / adopted",
+  snapshotCache: "Snapshot hits / misses / coalesced",
   poolTotal: "Total",
   poolFree: "Free",
   poolUsed: "Used",
   poolMax: "Max",
   poolExpansions: "Expansions",
   poolExhaustions: "Exhaustions",
+  poolBudget: "Budget",
+  memoryPressure: "Memory pressure",
+  rtspEndpoints: "RTSP servers",
+  rtspScore: "Score",
+  rtspLatency: "Latency",
+  rtspFailures: "Failures",
+  rtspStalls: "Stalls",
+  eventLoop: "Event loop",
+  loopPhase: "Phase",
+  loopCalls: "Calls",
+  loopAvg: "Avg",
+  loopMax: "Max",
+  loopStalls: "Stalls",
+  loopLastStall: "Last stall",
+  loopPhaseWait: "Waiting (epoll)",
+  loopPhaseBusy: "Busy per iteration",
+  loopPhaseAccept: "Accept",
+  loopPhaseClientRead: "Client requests",
+  loopPhaseClientWrite: "Client sends",
+  loopPhaseStream: "Upstream receive",
+  loopPhaseShared: "Shared groups / RTSP pool",
+  loopPhaseControl: "Status & handoff",
+  loopPhaseFetch: "HTTP fetch",
+  loopPhaseTick: "Periodic tick",
   clientsPerWorker: "Clients",
   language: "Language",
   appearance: "Appearance",
@@ -60,6 +88,10 @@ const base: TranslationDict = {
   queueLimit: "Limit",
   queuePeak: "Peak usage",
   queueDroppedBytes: "Dropped bytes",
+  connectionMemory: "Connection memory",
+  upstreamLoss: "Upstream loss",
+  upstreamJitter: "Jitter",
+  upstreamRtt: "RTT",
   clientStateConnecting: "Connecting",
   clientStateError: "Error",
   clientStateFccInit: "FCC Init",
@@ -130,12 +162,40 @@ const zhHans: TranslationDict = {
   sendEagain: "EAGAIN 次数",
   sendEnobufs: "ENOBUFS 次数",
   sendBatch: "批量刷新",
+  httpRequests: "HTTP 请求数",
+  requestsPerConnection: "每连接请求数",
+  channelHandoff: "频道转交 / 接收",
+  snapshotCache: "快照命中 / 未命中 / 合并",
   poolTotal: "总量",
   poolFree: "空闲",
   poolUsed: "已用",
   poolMax: "最大值",
   poolExpansions: "扩容次数",
   poolExhaustions: "耗尽次数",
+  poolBudget: "内存预算",
+  memoryPressure: "内存压力",
+  rtspEndpoints: "RTSP 服务器",
+  rtspScore: "评分",
+  rtspLatency: "延迟",
+  rtspFailures: "失败",
+  rtspStalls: "卡顿",
+  eventLoop: "事件循环",
+  loopPhase: "阶段",
+  loopCalls: "次数",
+  loopAvg: "平均",
+  loopMax: "最大",
+  loopStalls: "卡顿",
+  loopLastStall: "最近卡顿",
+  loopPhaseWait: "等待 (epoll)",
+  loopPhaseBusy: "单轮处理",
+  loopPhaseAccept: "接受连接",
+  loopPhaseClientRead: "客户端请求",
+  loopPhaseClientWrite: "客户端发送",
+  loopPhaseStream: "上游收流",
+  loopPhaseShared: "共享组播 / RTSP 连接池",
+  loopPhaseControl: "状态通知与转交",
+  loopPhaseFetch: "HTTP 拉取",
+  loopPhaseTick: "定时任务",
   clientsPerWorker: "连接数",
   language: "语言",
   appearance: "外观",
@@ -149,6 +209,10 @@ const zhHans: TranslationDict = {
   queueLimit: "队列上限",
   queuePeak: "峰值占用",
   queueDroppedBytes: "丢弃字节",
+  connectionMemory: "连接内存",
+  upstreamLoss: "上游丢包",
+  upstreamJitter: "抖动",
+  upstreamRtt: "往返时延",
   clientStateConnecting: "连接中",
   clientStateError: "错误",
   clientStateFccInit: "FCC 初始化",
@@ -219,12 +283,40 @@ const zhHant: TranslationDict = {
   sendEagain: "EAGAIN 次數",
   sendEnobufs: "ENOBUFS 次數",
   sendBatch: "批次刷新",
+  httpRequests: "HTTP 請求數",
+  requestsPerConnection: "每連線請求數",
+  channelHandoff: "頻道轉交 / 接收",
+  snapshotCache: "快照命中 / 未命中 / 合併",
   poolTotal: "總量",
   poolFree: "空閒",
   poolUsed: "已用",
   poolMax: "最大值",
   poolExpansions: "擴充次數",
   poolExhaustions: "耗盡次數",
+  poolBudget: "記憶體預算",
+  memoryPressure: "記憶體壓力",
+  rtspEndpoints: "RTSP 伺服器",
+  rtspScore: "評分",
+  rtspLatency: "延遲",
+  rtspFailures: "失敗",
+  rtspStalls: "卡頓",
+  eventLoop: "事件迴圈",
+  loopPhase: "階段",
+  loopCalls: "次數",
+  loopAvg: "平均",
+  loopMax: "最大",
+  loopStalls: "卡頓",
+  loopLastStall: "最近卡頓",
+  loopPhaseWait: "等待 (epoll)",
+  loopPhaseBusy: "單輪處理",
+  loopPhaseAccept: "接受連線",
+  loopPhaseClientRead: "用戶端請求",
+  loopPhaseClientWrite: "用戶端傳送",
+  loopPhaseStream: "上游收流",
+  loopPhaseShared: "共享組播 / RTSP 連線池",
+  loopPhaseControl: "狀態通知與轉交",
+  loopPhaseFetch: "HTTP 拉取",
+  loopPhaseTick: "定時任務",
   clientsPerWorker: "連線數",
   language: "語言",
   appearance: "外觀",
@@ -238,6 +330,10 @@ const zhHant: TranslationDict = {
   queueLimit: "佇列上限",
   queuePeak: "峰值占用",
   queueDroppedBytes: "丟棄位元組",
+  connectionMemory: "連線記憶體",
+  upstreamLoss: "上游丟包",
+  upstreamJitter: "抖動",
+  upstreamRtt: "往返時延",
   clientStateConnecting: "連線中",
   clientStateError: "錯誤",
   clientStateFccInit: "FCC 初始化",
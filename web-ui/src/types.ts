@@ -7,6 +7,20 @@ export interface SendStats {
   batch: number;
 }
 
+export interface HttpStats {
+  connections: number;
+  requests: number;
+  keepaliveReuses: number;
+  handoffSent?: number;
+  handoffReceived?: number;
+}
+
+export interface SnapshotCacheStats {
+  hits: number;
+  misses: number;
+  coalesced: number;
+}
+
 export interface PoolStats {
   total: number;
   free: number;
@@ -15,6 +29,48 @@ export interface PoolStats {
   expansions: number;
   exhaustions: number;
   utilization: number;
+  /** Memory budget in bytes when buffer-pool-max-size is auto, 0 otherwise */
+  budget?: number;
+  /** Memory PSI some avg10 in percent, -1 if unavailable */
+  memoryPressure?: number;
+}
+
+export interface RtspEndpointStats {
+  host: string;
+  port: number;
+  score: number;
+  latencyMs: number;
+  attempts: number;
+  failures: number;
+  stalls: number;
+}
+
+export interface LoopPhaseStats {
+  count: number;
+  totalUs: number;
+  maxUs: number;
+  /** Bucket i counts durations below (4 << i) µs, the last bucket everything slower */
+  hist: number[];
+}
+
+export type LoopPhase =
+  | "wait"
+  | "busy"
+  | "accept"
+  | "clientRead"
+  | "clientWrite"
+  | "stream"
+  | "shared"
+  | "control"
+  | "fetch"
+  | "tick";
+
+export interface LoopStats {
+  stalls: number;
+  lastStallUs: number;
+  lastStallTime: number;
+  lastStallSite: string;
+  phases: Partial<Record<LoopPhase, LoopPhaseStats>>;
 }
 
 export interface WorkerEntry {
@@ -24,8 +80,12 @@ export interface WorkerEntry {
   totalBandwidth: number;
   totalBytes: number;
   send: SendStats;
+  http?: HttpStats;
   pool: PoolStats;
   controlPool: PoolStats;
+  rtspEndpoints?: RtspEndpointStats[];
+  snapshotCache?: SnapshotCacheStats;
+  loop?: LoopStats;
 }
 
 export interface LogEntry {
@@ -65,6 +125,13 @@ export enum ClientState {
   Disconnected = 27,
 }
 
+export interface UpstreamStats {
+  jitterUs: number;
+  lost: number;
+  expected: number;
+  rttMs: number; /* -1 if unknown */
+}
+
 export interface ClientEntry {
   clientId: number;
   workerPid: number;
@@ -79,6 +146,8 @@ export interface ClientEntry {
   queueBytesHighwater: number;
   droppedBytes: number;
   slow: boolean;
+  memoryBytes?: number;
+  upstream?: UpstreamStats;
 }
 
 export interface StatusPayload {